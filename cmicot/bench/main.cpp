@@ -0,0 +1,260 @@
+#include <cmicot/lib/binarize.h>
+#include <cmicot/lib/cmi_calculator.h>
+#include <cmicot/lib/entropy_calculator.h>
+#include <cmicot/lib/mutual_information_calculator.h>
+#include <cmicot/lib/options.h>
+#include <cmicot/lib/test_pool_gen.h>
+
+#include <library/getopt/last_getopt.h>
+#include <library/grid_creator/binarization.h>
+#include <library/json/writer/json.h>
+
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/stream/format.h>
+#include <util/stream/output.h>
+#include <util/system/hp_timer.h>
+
+#include <functional>
+
+using namespace NCmicot;
+
+namespace {
+    struct TBenchOptions {
+        yvector<int> Sizes = {10000, 100000, 1000000};
+        yvector<int> ConditionBits = {1, 2, 4, 8, 16};
+        yvector<int> Cardinalities = {2, 4, 8, 16, 32};
+        int BorderCount = 32;
+        double MinSeconds = 0.2;
+        TString Filter;
+        TString JsonFile;
+    };
+
+    struct TBenchResult {
+        TString Name;
+        int Size = 0;
+        int ConditionBits = 0;
+        int Cardinality = 0;
+        ui64 Iterations = 0;
+        double NsPerSample = 0.0;
+    };
+
+    /// Kept alive so that the benchmarked results can't be optimized away.
+    volatile double Sink = 0.0;
+
+    class TBenchRunner {
+    public:
+        explicit TBenchRunner(const TBenchOptions& options)
+            : Options(options)
+        {
+        }
+
+        bool Enabled(const TString& name) const {
+            return !Options.Filter || name.Contains(Options.Filter);
+        }
+
+        /// Repeats func until MinSeconds pass and reports the time per processed line.
+        void Run(TBenchResult result, const std::function<double()>& func) {
+            func(); // warm up caches and allocator
+            double checksum = 0.0;
+            THPTimer timer;
+            do {
+                checksum += func();
+                ++result.Iterations;
+            } while (timer.Passed() < Options.MinSeconds);
+            const double seconds = timer.Passed();
+            Sink = Sink + checksum;
+
+            result.NsPerSample = seconds * 1e9 / (static_cast<double>(result.Iterations) * result.Size);
+            Cout << RightPad(result.Name, 32) << LeftPad(result.Size, 11) << LeftPad(result.ConditionBits, 6)
+                 << LeftPad(result.Cardinality, 6) << LeftPad(result.Iterations, 10)
+                 << LeftPad(FloatToString(result.NsPerSample, PREC_POINT_DIGITS, 3), 12) << Endl;
+            Results.push_back(std::move(result));
+        }
+
+        const yvector<TBenchResult>& GetResults() const {
+            return Results;
+        }
+
+    private:
+        const TBenchOptions& Options;
+        yvector<TBenchResult> Results;
+    };
+
+    TBenchResult MakeResult(const TString& name, int size, int conditionBits = 0, int cardinality = 0) {
+        TBenchResult result;
+        result.Name = name;
+        result.Size = size;
+        result.ConditionBits = conditionBits;
+        result.Cardinality = cardinality;
+        return result;
+    }
+
+    void BenchEntropy(TBenchRunner& runner, const TBenchOptions& options, int size, TReallyFastRng32& rng) {
+        if (!runner.Enabled("entropy_with_extra_bin")) {
+            return;
+        }
+        const TBin extraBin = RandomBin(size, rng);
+        for (int bits : options.ConditionBits) {
+            TEntropyCalculator calculator(size);
+            for (TBin& bin : RandomFeature(bits, size, rng)) {
+                calculator.AddBin(bin);
+            }
+            runner.Run(MakeResult("entropy_with_extra_bin", size, bits), [&] {
+                return calculator.GetEntropyWithExtraBin(extraBin);
+            });
+        }
+    }
+
+    void BenchCmi(TBenchRunner& runner, const TBenchOptions& options, int size, TReallyFastRng32& rng) {
+        if (!runner.Enabled("cmi_with_condition_bin")) {
+            return;
+        }
+        const TBin secondBin = RandomBin(size, rng);
+        const TBin conditionBin = RandomBin(size, rng);
+        for (int cardinality : options.Cardinalities) {
+            const TLabelCodes label = RandomLabelCodes(size, cardinality, rng);
+            for (int bits : options.ConditionBits) {
+                TCmiCalculator calculator(size);
+                calculator.AddFirstVariableCodes(label);
+                calculator.AddSecondVariableBin(secondBin);
+                // The checked bin is one more condition bit
+                for (TBin& bin : RandomFeature(bits - 1, size, rng)) {
+                    calculator.AddConditionBin(bin);
+                }
+                runner.Run(MakeResult("cmi_with_condition_bin", size, bits, cardinality), [&] {
+                    return calculator.GetValueWithConditionBin(conditionBin);
+                });
+            }
+        }
+    }
+
+    void BenchMutualInformation(TBenchRunner& runner, const TBenchOptions& options, int size, TReallyFastRng32& rng) {
+        if (!runner.Enabled("mi_with_second_bin")) {
+            return;
+        }
+        const TBin secondBin = RandomBin(size, rng);
+        for (int cardinality : options.Cardinalities) {
+            TMutualInformationCalculator calculator(size);
+            calculator.AddFirstVariableCodes(RandomLabelCodes(size, cardinality, rng));
+            runner.Run(MakeResult("mi_with_second_bin", size, 0, cardinality), [&] {
+                return calculator.GetValueWithSecondVariableBin(secondBin);
+            });
+        }
+    }
+
+    void BenchBinarization(TBenchRunner& runner, const TBenchOptions& options, int size, TReallyFastRng32& rng) {
+        const yvector<double> values = RandomFeatureValues(size, rng);
+        const yvector<float> floatValues(values.begin(), values.end());
+
+        if (runner.Enabled("binarize_feature")) {
+            // Borders are fixed, so only the comparisons and the bin layout are measured
+            yvector<float> borderValues = floatValues;
+            const yhash_set<float> borders = NSplitSelection::TMedianBinarizer().BestSplit(borderValues, options.BorderCount, false);
+            runner.Run(MakeResult("binarize_feature", size), [&] {
+                return BinarizeFeature(values, [&borders](yvector<float>&) { return borders; }).size();
+            });
+        }
+
+        using TBinarizerBuilder = std::function<NSplitSelection::IBinarizer*()>;
+        const std::pair<const char*, TBinarizerBuilder> binarizers[] = {
+            {"binarizer_median", [] { return new NSplitSelection::TMedianBinarizer; }},
+            {"binarizer_median_plus_uniform", [] { return new NSplitSelection::TMedianPlusUniformBinarizer; }},
+            {"binarizer_median_in_bin", [] { return new NSplitSelection::TMedianInBinBinarizer; }},
+            {"binarizer_min_entropy", [] { return new NSplitSelection::TMinEntropyBinarizer; }},
+            {"binarizer_max_sum_log", [] { return new NSplitSelection::TMaxSumLogBinarizer; }},
+            {"binarizer_uniform", [] { return new NSplitSelection::TUniformBinarizer; }},
+        };
+        for (const auto& nameAndBuilder : binarizers) {
+            if (!runner.Enabled(nameAndBuilder.first)) {
+                continue;
+            }
+            THolder<NSplitSelection::IBinarizer> binarizer(nameAndBuilder.second());
+            // The copy is part of every iteration, binarizers reorder their input
+            runner.Run(MakeResult(nameAndBuilder.first, size), [&] {
+                yvector<float> copy = floatValues;
+                return binarizer->BestSplit(copy, options.BorderCount).size();
+            });
+        }
+    }
+
+    void OutputJson(const yvector<TBenchResult>& results, IOutputStream& out) {
+        NJsonWriter::TBuf json(NJsonWriter::HEM_DONT_ESCAPE_HTML, &out);
+        json.BeginObject();
+        json.WriteKey("benchmarks").BeginList();
+        for (const TBenchResult& result : results) {
+            json.BeginObject()
+                .WriteKey("name").WriteString(result.Name)
+                .WriteKey("size").WriteInt(result.Size)
+                .WriteKey("condition_bits").WriteInt(result.ConditionBits)
+                .WriteKey("cardinality").WriteInt(result.Cardinality)
+                .WriteKey("iterations").WriteULongLong(result.Iterations)
+                .WriteKey("ns_per_sample").WriteDouble(result.NsPerSample)
+            .EndObject();
+        }
+        json.EndList();
+        json.EndObject();
+        out << '\n';
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TBenchOptions options;
+
+    auto opts = NLastGetopt::TOpts::Default();
+    opts.AddLongOption("sizes", "Comma separated line counts, e.g. 10000,1000000,100000000")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.Sizes = ParseColumnList(list); });
+    opts.AddLongOption("condition-bits", "Condition bit counts of the entropy and CMI kernels, e.g. 1-16")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.ConditionBits = ParseColumnList(list); });
+    opts.AddLongOption("cardinalities", "Label class counts of the CMI and MI kernels, e.g. 2,4,8,16,32")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.Cardinalities = ParseColumnList(list); });
+    opts.AddCharOption('x', "Border count of the binarization benchmarks")
+        .RequiredArgument()
+        .StoreResult(&options.BorderCount)
+        .DefaultValue("32");
+    opts.AddLongOption("min-time", "Seconds to repeat every case for")
+        .RequiredArgument("SECONDS")
+        .StoreResult(&options.MinSeconds)
+        .DefaultValue("0.2");
+    opts.AddLongOption("filter", "Run only the benchmarks whose name contains this string")
+        .RequiredArgument("SUBSTRING")
+        .StoreResult(&options.Filter);
+    opts.AddLongOption("json", "Also write the results to this file as JSON")
+        .RequiredArgument("FILE")
+        .StoreResult(&options.JsonFile);
+    opts.SetFreeArgsMax(0);
+    NLastGetopt::TOptsParseResult parsedOpts(&opts, argc, argv);
+
+    for (int bits : options.ConditionBits) {
+        Y_ENSURE(bits >= 1 && bits <= 16, "Condition bits should be in [1; 16]");
+    }
+    for (int cardinality : options.Cardinalities) {
+        Y_ENSURE(cardinality >= 2 && cardinality <= 32, "Cardinality should be in [2; 32]");
+    }
+
+    Cout << RightPad("benchmark", 32) << LeftPad("size", 11) << LeftPad("bits", 6) << LeftPad("card", 6)
+         << LeftPad("iters", 10) << LeftPad("ns/sample", 12) << Endl;
+
+    // The timer frequency is measured on the first use, which must not happen inside a benchmark
+    NHPTimer::GetClockRate();
+    TBenchRunner runner(options);
+    TReallyFastRng32 rng(20170601);
+    for (int size : options.Sizes) {
+        Y_ENSURE(size > 0, "Sizes should be positive");
+        BenchEntropy(runner, options, size, rng);
+        BenchCmi(runner, options, size, rng);
+        BenchMutualInformation(runner, options, size, rng);
+        BenchBinarization(runner, options, size, rng);
+    }
+
+    if (options.JsonFile) {
+        TOFStream out(options.JsonFile);
+        OutputJson(runner.GetResults(), out);
+    }
+    return 0;
+}
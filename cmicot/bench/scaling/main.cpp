@@ -0,0 +1,320 @@
+#include <cmicot/lib/options.h>
+#include <cmicot/lib/selection.h>
+#include <cmicot/lib/test_pool_gen.h>
+
+#include <library/getopt/last_getopt.h>
+#include <library/json/writer/json.h>
+
+#include <util/generic/maybe.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/stream/format.h>
+#include <util/stream/output.h>
+#include <util/string/cast.h>
+#include <util/system/hp_timer.h>
+
+#if defined(_unix_)
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace NCmicot;
+
+namespace {
+    struct TScalingOptions {
+        yvector<int> ThreadCounts = {1, 2, 4, 8, 16, 32, 64};
+        yvector<int> RowCounts = {20000, 100000};
+        yvector<int> FeatureCounts = {16, 64};
+        int WeakRowsPerThread = 10000;
+        int BinsPerFeature = 4;
+        int EvalStepCount = 6;
+        int SelectCount = 8;
+        ui32 Seed = 20170615;
+        bool CountKernels = false;
+        TString JsonFile;
+    };
+
+    struct TRunConfig {
+        int ThreadCount;
+        int RowCount;
+        int FeatureCount;
+    };
+
+    struct TRunResult {
+        double Seconds = 0.0;
+        double SecondsPerStep = 0.0;
+        /// Peak resident set of the run in kilobytes, known only if the run was made in a child process.
+        TMaybe<ui64> PeakRssKb;
+        /// Mean CMI calls of an outer step, counted by a separate untimed run if kernels are counted.
+        TMaybe<double> CmiCallsPerStep;
+    };
+
+    /// The pool depends only on its shape and the seed, so every run of a grid gets the same data.
+    std::pair<TBinFeatureSet, TBinFeatureSet> MakePool(const TScalingOptions& options, const TRunConfig& config) {
+        TReallyFastRng32 rng(options.Seed + config.RowCount * 31 + config.FeatureCount);
+        const TBinFeatureSet label = MakeRandomLabel(rng, config.RowCount, {2, 2});
+        const TBinFeatureSet features = MakeRandomFeatures(rng, config.FeatureCount, config.RowCount,
+                                                           {options.BinsPerFeature, options.BinsPerFeature});
+        return {label, features};
+    }
+
+    TFastSelectionOptions MakeSelectionOptions(const TScalingOptions& options, const TRunConfig& config) {
+        TFastSelectionOptions selectionOptions;
+        selectionOptions.EvalStepCount = options.EvalStepCount;
+        selectionOptions.ThreadCount = config.ThreadCount;
+        selectionOptions.FeatureCount = options.SelectCount;
+        return selectionOptions;
+    }
+
+    TRunResult RunSelection(const TScalingOptions& options, const TRunConfig& config) {
+        TBinFeatureSet label, features;
+        std::tie(label, features) = MakePool(options, config);
+
+        // Kernels aren't counted here, counting would add its own cost to the times
+        TFastSelectionOptions selectionOptions = MakeSelectionOptions(options, config);
+        double stepSeconds = 0.0;
+        int stepCount = 0;
+        selectionOptions.OnStepFinished = [&](const TSelectionStepMetrics& metrics) {
+            // The first feature is chosen by mutual information, it isn't an outer step of the ranking
+            if (metrics.Step > 1) {
+                stepSeconds += metrics.WallSeconds;
+                ++stepCount;
+            }
+        };
+
+        THPTimer timer;
+        FastFeatureSelection(label, features, selectionOptions, [](int) {});
+
+        TRunResult result;
+        result.Seconds = timer.Passed();
+        result.SecondsPerStep = stepCount ? stepSeconds / stepCount : 0.0;
+        return result;
+    }
+
+    /// Mean CMI calls of an outer step, from a run which counts the kernels and isn't timed.
+    double CountCmiCallsPerStep(const TScalingOptions& options, const TRunConfig& config) {
+        TBinFeatureSet label, features;
+        std::tie(label, features) = MakePool(options, config);
+
+        TFastSelectionOptions selectionOptions = MakeSelectionOptions(options, config);
+        selectionOptions.CountKernels = true;
+        ui64 cmiCalls = 0;
+        int stepCount = 0;
+        selectionOptions.OnStepFinished = [&](const TSelectionStepMetrics& metrics) {
+            if (metrics.Step > 1) {
+                cmiCalls += metrics.Kernels.CmiCalls;
+                ++stepCount;
+            }
+        };
+        FastFeatureSelection(label, features, selectionOptions, [](int) {});
+        return stepCount ? 1.0 * cmiCalls / stepCount : 0.0;
+    }
+
+    /// Runs every configuration in a separate process, so that its peak RSS isn't hidden by the
+    /// previous, larger runs. The counting run, if any, is made by the same child after the timed one,
+    /// so the parent never holds a pool of its own.
+    TRunResult Run(const TScalingOptions& options, const TRunConfig& config) {
+#if defined(_unix_)
+        int fds[2];
+        Y_ENSURE(pipe(fds) == 0, "Failed to create a pipe");
+        const pid_t pid = fork();
+        Y_ENSURE(pid >= 0, "Failed to fork");
+        if (pid == 0) {
+            close(fds[0]);
+            const TRunResult result = RunSelection(options, config);
+            // The peak is taken before the counting run, so it belongs to the timed run alone
+            struct rusage usage;
+            const bool measured = getrusage(RUSAGE_SELF, &usage) == 0;
+            const double values[4] = {
+                result.Seconds,
+                result.SecondsPerStep,
+                static_cast<double>(usage.ru_maxrss),
+                options.CountKernels ? CountCmiCallsPerStep(options, config) : 0.0,
+            };
+            const bool written = write(fds[1], values, sizeof(values)) == sizeof(values);
+            _exit(measured && written ? 0 : 1);
+        }
+
+        close(fds[1]);
+        double values[4];
+        const bool received = read(fds[0], values, sizeof(values)) == sizeof(values);
+        close(fds[0]);
+
+        int status = 0;
+        Y_ENSURE(waitpid(pid, &status, 0) == pid, "Failed to wait for a run");
+        Y_ENSURE(received && WIFEXITED(status) && WEXITSTATUS(status) == 0,
+                 "Run with " << config.ThreadCount << " threads, " << config.RowCount << " rows and "
+                             << config.FeatureCount << " features has failed");
+
+        TRunResult result;
+        result.Seconds = values[0];
+        result.SecondsPerStep = values[1];
+        result.PeakRssKb = static_cast<ui64>(values[2]);
+        if (options.CountKernels) {
+            result.CmiCallsPerStep = values[3];
+        }
+#else
+        TRunResult result = RunSelection(options, config);
+        if (options.CountKernels) {
+            result.CmiCallsPerStep = CountCmiCallsPerStep(options, config);
+        }
+#endif
+        return result;
+    }
+
+    struct TTableRow {
+        TRunConfig Config;
+        TRunResult Result;
+        double Speedup;
+        double Efficiency;
+    };
+
+    void PrintTable(const TString& title, const yvector<TTableRow>& rows) {
+        Cout << title << Endl;
+        Cout << LeftPad("threads", 8) << LeftPad("rows", 11) << LeftPad("features", 10) << LeftPad("seconds", 11)
+             << LeftPad("speedup", 9) << LeftPad("efficiency", 11) << LeftPad("s/step", 10) << LeftPad("peak RSS MB", 13)
+             << LeftPad("CMI/step", 12) << Endl;
+        for (const TTableRow& row : rows) {
+            const TRunResult& result = row.Result;
+            Cout << LeftPad(row.Config.ThreadCount, 8) << LeftPad(row.Config.RowCount, 11) << LeftPad(row.Config.FeatureCount, 10)
+                 << LeftPad(FloatToString(result.Seconds, PREC_POINT_DIGITS, 3), 11)
+                 << LeftPad(FloatToString(row.Speedup, PREC_POINT_DIGITS, 2), 9)
+                 << LeftPad(FloatToString(row.Efficiency, PREC_POINT_DIGITS, 2), 11)
+                 << LeftPad(FloatToString(result.SecondsPerStep, PREC_POINT_DIGITS, 4), 10)
+                 << LeftPad(result.PeakRssKb ? ToString(*result.PeakRssKb / 1024) : TString("n/a"), 13)
+                 << LeftPad(result.CmiCallsPerStep ? FloatToString(*result.CmiCallsPerStep, PREC_POINT_DIGITS, 0) : TString("n/a"), 12) << Endl;
+        }
+        Cout << Endl;
+    }
+
+    void WriteRows(NJsonWriter::TBuf& json, const yvector<TTableRow>& rows) {
+        json.BeginList();
+        for (const TTableRow& row : rows) {
+            json.BeginObject()
+                .WriteKey("threads").WriteInt(row.Config.ThreadCount)
+                .WriteKey("rows").WriteInt(row.Config.RowCount)
+                .WriteKey("features").WriteInt(row.Config.FeatureCount)
+                .WriteKey("seconds").WriteDouble(row.Result.Seconds)
+                .WriteKey("speedup").WriteDouble(row.Speedup)
+                .WriteKey("efficiency").WriteDouble(row.Efficiency)
+                .WriteKey("seconds_per_step").WriteDouble(row.Result.SecondsPerStep);
+            if (row.Result.PeakRssKb) {
+                json.WriteKey("peak_rss_kb").WriteULongLong(*row.Result.PeakRssKb);
+            }
+            if (row.Result.CmiCallsPerStep) {
+                json.WriteKey("cmi_calls_per_step").WriteDouble(*row.Result.CmiCallsPerStep);
+            }
+            json.EndObject();
+        }
+        json.EndList();
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TScalingOptions options;
+
+    auto opts = NLastGetopt::TOpts::Default();
+    opts.AddLongOption("threads", "Thread counts, e.g. 1,2,4,8,16,32,64")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.ThreadCounts = ParseColumnList(list); });
+    opts.AddLongOption("rows", "Row counts of the strong scaling pools")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.RowCounts = ParseColumnList(list); });
+    opts.AddLongOption("features", "Feature counts of the pools")
+        .RequiredArgument("LIST")
+        .Handler1T<TString>([&options](const TString& list) { options.FeatureCounts = ParseColumnList(list); });
+    opts.AddLongOption("weak-rows-per-thread", "Rows per thread of the weak scaling pools, 0 to skip weak scaling")
+        .RequiredArgument("ROWS")
+        .StoreResult(&options.WeakRowsPerThread)
+        .DefaultValue("10000");
+    opts.AddLongOption("bins-per-feature", "Bins of every generated feature")
+        .RequiredArgument()
+        .StoreResult(&options.BinsPerFeature)
+        .DefaultValue("4");
+    opts.AddCharOption('t', "Eval algorithm step count")
+        .RequiredArgument()
+        .StoreResult(&options.EvalStepCount)
+        .DefaultValue("6");
+    opts.AddLongOption("select-count", "How many features every run selects")
+        .RequiredArgument()
+        .StoreResult(&options.SelectCount)
+        .DefaultValue("8");
+    opts.AddLongOption("seed", "Seed of the generated pools")
+        .RequiredArgument()
+        .StoreResult(&options.Seed)
+        .DefaultValue("20170615");
+    opts.AddLongOption("count-kernels", "Count the CMI calls of every configuration in an extra untimed run")
+        .NoArgument()
+        .SetFlag(&options.CountKernels);
+    opts.AddLongOption("json", "Also write the tables to this file as JSON")
+        .RequiredArgument("FILE")
+        .StoreResult(&options.JsonFile);
+    opts.SetFreeArgsMax(0);
+    NLastGetopt::TOptsParseResult parsedOpts(&opts, argc, argv);
+
+    Y_ENSURE(!options.ThreadCounts.empty(), "No thread counts given");
+    for (int threadCount : options.ThreadCounts) {
+        Y_ENSURE(threadCount > 0, "Thread counts should be positive");
+    }
+    NHPTimer::GetClockRate();
+
+    // Speedup and efficiency are relative to the first thread count of the list
+    const int baseThreads = options.ThreadCounts.front();
+    auto addRow = [baseThreads](yvector<TTableRow>& rows, const TRunConfig& config, const TRunResult& result, bool weak) {
+        const TRunResult& base = rows.empty() ? result : rows.front().Result;
+        const double speedup = base.Seconds / result.Seconds;
+        const double threadRatio = 1.0 * config.ThreadCount / baseThreads;
+        rows.push_back({config, result, speedup, weak ? speedup : speedup / threadRatio});
+    };
+
+    yvector<std::pair<TString, yvector<TTableRow>>> strongTables;
+    for (int rowCount : options.RowCounts) {
+        for (int featureCount : options.FeatureCounts) {
+            yvector<TTableRow> rows;
+            for (int threadCount : options.ThreadCounts) {
+                const TRunConfig config{threadCount, rowCount, featureCount};
+                addRow(rows, config, Run(options, config), false);
+            }
+            const TString title = "Strong scaling: " + ToString(rowCount) + " rows, " + ToString(featureCount) + " features";
+            PrintTable(title, rows);
+            strongTables.emplace_back(title, std::move(rows));
+        }
+    }
+
+    yvector<std::pair<TString, yvector<TTableRow>>> weakTables;
+    if (options.WeakRowsPerThread > 0) {
+        for (int featureCount : options.FeatureCounts) {
+            yvector<TTableRow> rows;
+            for (int threadCount : options.ThreadCounts) {
+                const TRunConfig config{threadCount, options.WeakRowsPerThread * threadCount, featureCount};
+                addRow(rows, config, Run(options, config), true);
+            }
+            const TString title = "Weak scaling: " + ToString(options.WeakRowsPerThread) + " rows per thread, " +
+                                  ToString(featureCount) + " features";
+            PrintTable(title, rows);
+            weakTables.emplace_back(title, std::move(rows));
+        }
+    }
+
+    if (options.JsonFile) {
+        TOFStream out(options.JsonFile);
+        NJsonWriter::TBuf json(NJsonWriter::HEM_DONT_ESCAPE_HTML, &out);
+        json.BeginObject();
+        for (const auto& kindAndTables : {std::make_pair("strong", &strongTables), std::make_pair("weak", &weakTables)}) {
+            json.WriteKey(kindAndTables.first).BeginList();
+            for (const auto& titleAndRows : *kindAndTables.second) {
+                json.BeginObject().WriteKey("title").WriteString(titleAndRows.first).WriteKey("runs");
+                WriteRows(json, titleAndRows.second);
+                json.EndObject();
+            }
+            json.EndList();
+        }
+        json.EndObject();
+        out << '\n';
+    }
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include "cmicot.h"
+
+#include <cmicot/lib/in_memory_pool.h>
+
+#include <util/generic/string.h>
+#include <util/generic/yexception.h>
+#include <util/system/tls.h>
+
+struct cmicot_pool {
+    THolder<NCmicot::TInMemoryPool> Pool;
+};
+
+namespace {
+    Y_STATIC_THREAD(TString) LastError;
+
+    /// Runs func and turns its exceptions into the last error, so that none crosses the C interface.
+    template <class TFunc>
+    int Call(TFunc&& func) {
+        try {
+            func();
+            return 0;
+        } catch (...) {
+            LastError.Get() = CurrentExceptionMessage();
+            return -1;
+        }
+    }
+}
+
+extern "C" {
+
+const char* cmicot_last_error(void) {
+    return LastError.Get().data();
+}
+
+cmicot_pool* cmicot_pool_create(const float* label, size_t line_count, const cmicot_binarization* binarization) {
+    THolder<cmicot_pool> result(new cmicot_pool);
+    const int status = Call([&] {
+        Y_ENSURE(label, "Label is null");
+        NCmicot::TInMemoryBinarization options;
+        if (binarization) {
+            if (binarization->binarization) {
+                options.Binarizer = binarization->binarization;
+            }
+            if (binarization->border_count) {
+                options.BorderCount = binarization->border_count;
+            }
+            if (binarization->level_storage) {
+                options.FeatureStorage = NCmicot::EFeatureStorage::Levels;
+            }
+            if (binarization->thread_count) {
+                options.ThreadCount = binarization->thread_count;
+            }
+        }
+        result->Pool.Reset(new NCmicot::TInMemoryPool(NArrayRef::TConstArrayRef<float>(label, line_count), options));
+    });
+    return status == 0 ? result.Release() : nullptr;
+}
+
+void cmicot_pool_free(cmicot_pool* pool) {
+    delete pool;
+}
+
+int cmicot_pool_add_float_features(cmicot_pool* pool, const float* const* columns, size_t column_count) {
+    return Call([&] {
+        Y_ENSURE(pool && columns, "Pool or columns are null");
+        pool->Pool->AddFloatFeatures(NArrayRef::TConstArrayRef<const float*>(columns, column_count));
+    });
+}
+
+int cmicot_pool_add_packed_feature(cmicot_pool* pool, const uint64_t* const* bins, size_t bin_count) {
+    return Call([&] {
+        Y_ENSURE(pool && bins, "Pool or bins are null");
+        static_assert(sizeof(uint64_t) == sizeof(ui64), "");
+        pool->Pool->AddPackedFeature(NArrayRef::TConstArrayRef<const ui64*>(reinterpret_cast<const ui64* const*>(bins), bin_count));
+    });
+}
+
+size_t cmicot_pool_feature_count(const cmicot_pool* pool) {
+    return pool ? pool->Pool->GetFeatures().GetFeatureCount() : 0;
+}
+
+int cmicot_select(const cmicot_pool* pool, const cmicot_selection* options, cmicot_feature_callback callback, void* user_data) {
+    return Call([&] {
+        Y_ENSURE(pool && callback, "Pool or callback are null");
+        NCmicot::TFastSelectionOptions selectionOptions;
+        if (options) {
+            Y_ENSURE(options->eval_step_count >= 0 && options->thread_count >= 0 && options->select_count >= 0,
+                     "Selection options should not be negative");
+            if (options->eval_step_count) {
+                selectionOptions.EvalStepCount = options->eval_step_count;
+            }
+            if (options->thread_count) {
+                selectionOptions.ThreadCount = options->thread_count;
+            }
+            if (options->select_count) {
+                selectionOptions.FeatureCount = options->select_count;
+            }
+        }
+        bool isStopped = false;
+        selectionOptions.IsCancelled = [&isStopped] {
+            return isStopped;
+        };
+        NCmicot::SelectFeatures(*pool->Pool, selectionOptions, [&](const NCmicot::TSelectionStepMetrics& metrics) {
+            cmicot_selected_feature feature;
+            feature.rank = metrics.Step;
+            feature.feature = metrics.SelectedFeature;
+            feature.score = metrics.Score;
+            feature.wall_seconds = metrics.WallSeconds;
+            feature.candidates = metrics.Candidates;
+            isStopped = callback(&feature, user_data) != 0;
+        });
+    });
+}
+
+}
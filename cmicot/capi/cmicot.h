@@ -0,0 +1,78 @@
+#pragma once
+
+/* Plain C interface of the feature selection for linking it into other programs. Pools are built
+ * from column buffers owned by the caller, which are read only while a column is added. Functions
+ * returning int return 0 on success and -1 on error, and cmicot_last_error() describes the error
+ * then. Every object may be used by one thread at a time. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cmicot_pool cmicot_pool;
+
+/* Binarization of the float columns, as the options of the command line. */
+typedef struct {
+    /* --binarization mode, NULL for "medianPlusUniform". */
+    const char* binarization;
+    /* -x, 0 for 10. */
+    int border_count;
+    /* Non-zero to keep every feature as a column of levels, as --feature-storage levels. */
+    int level_storage;
+    /* Threads binarizing the columns, 0 for 1. */
+    int thread_count;
+} cmicot_binarization;
+
+/* Selection options, as the options of the command line. */
+typedef struct {
+    /* -t, 0 for 6. */
+    int eval_step_count;
+    /* --thread-count, 0 for 1. */
+    int thread_count;
+    /* --select-count, 0 for all the features. */
+    int select_count;
+} cmicot_selection;
+
+/* A selected feature with the metrics of its selection step. */
+typedef struct {
+    int rank;
+    int feature;
+    /* Mutual information with the label of its best bin for the first feature, the selection
+     * score of its best bin for the rest. */
+    double score;
+    double wall_seconds;
+    /* Bins scored to choose the feature. */
+    uint64_t candidates;
+} cmicot_selected_feature;
+
+/* Called right after every selection step. Returning non-zero stops the selection. */
+typedef int (*cmicot_feature_callback)(const cmicot_selected_feature* feature, void* user_data);
+
+/* Message of the last error of the calling thread. */
+const char* cmicot_last_error(void);
+
+/* Creates a pool of line_count lines with the label column. binarization may be NULL for the
+ * defaults. Returns NULL on error. */
+cmicot_pool* cmicot_pool_create(const float* label, size_t line_count, const cmicot_binarization* binarization);
+void cmicot_pool_free(cmicot_pool* pool);
+
+/* Binarizes column_count float columns of line_count values in parallel and adds them as the next
+ * features. */
+int cmicot_pool_add_float_features(cmicot_pool* pool, const float* const* columns, size_t column_count);
+
+/* Adds a feature of bin_count already binarized bins. Every bin holds a bit per line, line i is bit
+ * i % 64 of word i / 64. */
+int cmicot_pool_add_packed_feature(cmicot_pool* pool, const uint64_t* const* bins, size_t bin_count);
+
+size_t cmicot_pool_feature_count(const cmicot_pool* pool);
+
+/* Ranks the features of the pool and calls callback for every selected one. options may be NULL
+ * for the defaults. */
+int cmicot_select(const cmicot_pool* pool, const cmicot_selection* options, cmicot_feature_callback callback, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
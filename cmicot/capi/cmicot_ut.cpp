@@ -0,0 +1,106 @@
+#include "cmicot.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+
+namespace {
+    /// Float columns where the label is a noisy function of the first feature.
+    yvector<yvector<float>> MakeColumns(int lineCount, int featureCount) {
+        TReallyFastRng32 rng(17);
+        yvector<yvector<float>> columns(featureCount + 1, yvector<float>(lineCount));
+        for (int line : xrange(lineCount)) {
+            for (int column : xrange(1, featureCount + 1)) {
+                columns[column][line] = rng.GenRandReal1();
+            }
+            columns[0][line] = (columns[1][line] > 0.5) + 0.3 * rng.GenRandReal1();
+        }
+        return columns;
+    }
+
+    struct TCollected {
+        yvector<int> Features;
+        size_t StopAfter = 0;
+    };
+
+    int Collect(const cmicot_selected_feature* feature, void* userData) {
+        TCollected& collected = *static_cast<TCollected*>(userData);
+        collected.Features.push_back(feature->feature);
+        return collected.StopAfter && collected.Features.size() >= collected.StopAfter;
+    }
+}
+
+SIMPLE_UNIT_TEST_SUITE(CApi) {
+    SIMPLE_UNIT_TEST(SelectFromFloatAndPackedFeatures) {
+        const int lineCount = 300;
+        const yvector<yvector<float>> columns = MakeColumns(lineCount, 4);
+        cmicot_pool* pool = cmicot_pool_create(columns[0].data(), lineCount, nullptr);
+        UNIT_ASSERT_C(pool, cmicot_last_error());
+
+        yvector<const float*> features;
+        for (int column : xrange(1, columns.ysize())) {
+            features.push_back(columns[column].data());
+        }
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_pool_add_float_features(pool, features.data(), features.size()), 0, cmicot_last_error());
+
+        // A single bin repeating the first feature above 0.5
+        yvector<uint64_t> words((lineCount + 63) / 64);
+        for (int line : xrange(lineCount)) {
+            words[line / 64] |= static_cast<uint64_t>(columns[1][line] > 0.5) << (line % 64);
+        }
+        const uint64_t* bins[] = {words.data()};
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_pool_add_packed_feature(pool, bins, 1), 0, cmicot_last_error());
+        UNIT_ASSERT_VALUES_EQUAL(cmicot_pool_feature_count(pool), 5u);
+
+        cmicot_selection options = {3, 2, 3};
+        TCollected collected;
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_select(pool, &options, Collect, &collected), 0, cmicot_last_error());
+        UNIT_ASSERT_VALUES_EQUAL(collected.Features.size(), 3u);
+        UNIT_ASSERT(collected.Features[0] == 0 || collected.Features[0] == 4);
+
+        cmicot_pool_free(pool);
+    }
+
+    SIMPLE_UNIT_TEST(CallbackStopsSelection) {
+        const int lineCount = 200;
+        const yvector<yvector<float>> columns = MakeColumns(lineCount, 6);
+        cmicot_pool* pool = cmicot_pool_create(columns[0].data(), lineCount, nullptr);
+        UNIT_ASSERT_C(pool, cmicot_last_error());
+        yvector<const float*> features;
+        for (int column : xrange(1, columns.ysize())) {
+            features.push_back(columns[column].data());
+        }
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_pool_add_float_features(pool, features.data(), features.size()), 0, cmicot_last_error());
+
+        TCollected collected;
+        collected.StopAfter = 2;
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_select(pool, nullptr, Collect, &collected), 0, cmicot_last_error());
+        UNIT_ASSERT_VALUES_EQUAL(collected.Features.size(), 2u);
+
+        cmicot_pool_free(pool);
+    }
+
+    SIMPLE_UNIT_TEST(ErrorsAreReported) {
+        UNIT_ASSERT(!cmicot_pool_create(nullptr, 10, nullptr));
+        UNIT_ASSERT_STRING_CONTAINS(cmicot_last_error(), "Label is null");
+
+        const yvector<yvector<float>> columns = MakeColumns(100, 2);
+        cmicot_pool* pool = cmicot_pool_create(columns[0].data(), 100, nullptr);
+        UNIT_ASSERT_C(pool, cmicot_last_error());
+        UNIT_ASSERT_VALUES_EQUAL(cmicot_pool_add_float_features(pool, nullptr, 1), -1);
+        UNIT_ASSERT_STRING_CONTAINS(cmicot_last_error(), "null");
+
+        const float* features[] = {columns[1].data()};
+        UNIT_ASSERT_VALUES_EQUAL_C(cmicot_pool_add_float_features(pool, features, 1), 0, cmicot_last_error());
+        cmicot_selection options = {-1, 0, 0};
+        TCollected collected;
+        UNIT_ASSERT_VALUES_EQUAL(cmicot_select(pool, &options, Collect, &collected), -1);
+        UNIT_ASSERT_STRING_CONTAINS(cmicot_last_error(), "should not be negative");
+        UNIT_ASSERT(collected.Features.empty());
+
+        cmicot_pool_free(pool);
+    }
+}
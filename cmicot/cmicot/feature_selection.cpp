@@ -1,35 +1,68 @@
 #include <cmicot/lib/io.h>
 #include <cmicot/lib/bin_feature_set.h>
+#include <cmicot/lib/bootstrap.h>
 #include <cmicot/lib/binarize.h>
+#include <cmicot/lib/candidate_shards.h>
 #include <cmicot/lib/options.h>
+#include <cmicot/lib/permutation_test.h>
+#include <cmicot/lib/perf_counters.h>
+#include <cmicot/lib/pool_loader.h>
+#include <cmicot/lib/pool_window.h>
 #include <cmicot/lib/selection.h>
+#include <cmicot/lib/selection_jobs.h>
+#include <cmicot/lib/server.h>
+#include <cmicot/lib/sharded_cmi.h>
+#include <cmicot/lib/trace.h>
 
 #include <library/grid_creator/binarization.h>
 
 #include <library/terminate_handler/terminate_handler.h>
 
+#include <util/generic/algorithm.h>
+#include <util/generic/maybe.h>
 #include <util/generic/string.h>
+#include <util/generic/strbuf.h>
 #include <util/generic/vector.h>
+#include <util/generic/xrange.h>
 #include <util/stream/file.h>
 
 using NCmicot::TBinFeatureSet;
 
-std::pair<TBinFeatureSet, TBinFeatureSet> ReadBinarizedPool(
-    const TString& poolFile,
-    const TString& mapFile,
-    NCmicot::TBorderBuilder borderBuilder
-) {
-    const yvector<yvector<double>> pool = NCmicot::ReadPool(*NCmicot::OpenInput(poolFile));
-    const yvector<int> binToFeatureMap = NCmicot::ReadBinToFeatureMap(*NCmicot::OpenInput(mapFile));
-
-    return {
-        TBinFeatureSet(NCmicot::BinarizeFeature(pool.front(), borderBuilder)),
-        NCmicot::BinarizeWithMap(pool.begin() + 1, pool.end(), binToFeatureMap)
+namespace {
+    /// A command line option or a mode of the run, named as in the error messages.
+    struct TModeOption {
+        template <class T>
+        TModeOption(TStringBuf name, const T& isSet)
+            : Name(name)
+            , IsSet(static_cast<bool>(isSet))
+        {
+        }
+
+        TStringBuf Name;
+        bool IsSet;
     };
-}
 
-void PrintFeature(int featureId) {
-    Cout << featureId << Endl;
+    /// A mode and the options it can't be combined with.
+    struct TModeConflicts {
+        TModeOption Mode;
+        yvector<TModeOption> Conflicts;
+    };
+
+    /// Message for the first mode of the table which is set together with any of its conflicts.
+    template <size_t N>
+    TMaybe<TString> FindModeConflict(const TModeConflicts (&table)[N]) {
+        for (const TModeConflicts& modeConflicts : table) {
+            if (!modeConflicts.Mode.IsSet) {
+                continue;
+            }
+            for (const TModeOption& conflict : modeConflicts.Conflicts) {
+                if (conflict.IsSet) {
+                    return TString(modeConflicts.Mode.Name) + " can't be combined with " + conflict.Name;
+                }
+            }
+        }
+        return Nothing();
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -39,49 +72,304 @@ int main(int argc, char* argv[]) {
     auto clOptions = NCmicot::CreateCommandLineOptions(options);
     NLastGetopt::TOptsParseResult opts(&clOptions, argc, argv);
 
+    if (options.ServeSocket) {
+        NCmicot::TSelectionServer server(options.ThreadCount);
+        server.Listen(*options.ServeSocket);
+        return 0;
+    }
+
     auto borderBuilder = [&options](yvector<float>& values) {
         return options.Binarizer->BestSplit(values, options.BorderCount);
     };
 
-    TBinFeatureSet label, features;
-    if (options.RawPoolFilename) {
-        if (options.BinaryPoolFilename || options.FeatureBinMapFilename) {
-            Cerr << "Provide either only --pool option or both --binary-pool and --map" << Endl;
-            return 1;
-        }
+    if (options.Resume && !options.CheckpointFile) {
+        Cerr << "--resume requires --checkpoint" << Endl;
+        return 2;
+    }
 
-        std::tie(label, features) = NCmicot::BinarizeRawPool(
-            NCmicot::ReadPool(*NCmicot::OpenInput(*options.RawPoolFilename)),
-            borderBuilder,
-            options.ThreadCount
-        );
-    } else if (options.BinaryPoolFilename && options.FeatureBinMapFilename) {
-        std::tie(label, features) = ReadBinarizedPool(
-            *options.BinaryPoolFilename,
-            *options.FeatureBinMapFilename,
-            borderBuilder
-        );
-    } else {
+    if (options.TraceFile) {
+        NCmicot::StartTracing();
+    }
+    if (options.PerfCounters) {
+        NCmicot::StartPerfCounters();
+    }
+
+    const bool isLineSharded = !options.ShardWorkers.empty() || options.ShardProcesses;
+    const bool isCandidateSharded = !options.CandidateWorkers.empty() || options.CandidateProcesses;
+    if ((isLineSharded || options.ServeShardSocket) && !options.PackedPoolFilename) {
+        Cerr << "Sharded selection requires --packed-pool" << Endl;
+        return 1;
+    }
+    if (options.LabelColumns.size() > 1 && !options.RawPoolFilename) {
+        Cerr << "--label-columns requires --pool" << Endl;
+        return 1;
+    }
+    if (options.BootstrapReplicaCount && !options.FeatureCountToSelect) {
+        Cerr << "--bootstrap requires --select-count" << Endl;
+        return 1;
+    }
+    if ((options.AppendBlockFilename || options.WindowBlockCount) && !options.WindowDirectory) {
+        Cerr << "--append-block and --window-blocks require --window" << Endl;
+        return 1;
+    }
+
+    const TModeOption sharding("sharding", isLineSharded || isCandidateSharded || options.ServeShardSocket || options.ServeCandidatesSocket);
+    const TModeOption shardWorkers("shard workers", isLineSharded || options.ServeShardSocket);
+    const TModeOption justBinarize("--just-binarize", options.BinaryPoolOutputFile);
+    const TModeOption checkpoint("--checkpoint", options.CheckpointFile);
+    const TModeOption initialFeatures("--initial-features", options.InitialFeaturesFile);
+    const TModeOption metricsFile("--metrics-file", options.MetricsFile);
+    const TModeOption jobsFile("--jobs", options.JobsFile);
+    const TModeOption labelColumns("--label-columns", options.LabelColumns.size() > 1);
+    const TModeOption sweep("--t-sweep", !options.EvalStepSweep.empty());
+    const TModeOption bootstrap("--bootstrap", options.BootstrapReplicaCount);
+    const TModeOption rawPool("--pool", options.RawPoolFilename);
+    const TModeOption binaryPool("--binary-pool", options.BinaryPoolFilename);
+    const TModeOption binToFeatureMap("--map", options.FeatureBinMapFilename);
+    const TModeOption packedPool("--packed-pool", options.PackedPoolFilename);
+    const TModeOption columnOptions("--use-columns or --ignore-columns",
+                                    !options.ReadPoolOptions.UseColumns.empty() || !options.ReadPoolOptions.IgnoreColumns.empty());
+    const TModeOption rowOptions("--row-sample-rate or --row-limit",
+                                 options.ReadPoolOptions.RowSampleRate < 1 || options.ReadPoolOptions.RowLimit);
+    const TModeConflicts modeConflicts[] = {
+        {justBinarize, {TModeOption("sharded selection", isLineSharded || isCandidateSharded)}},
+        {TModeOption("Candidate sharding", isCandidateSharded), {shardWorkers, checkpoint}},
+        {labelColumns, {sharding, justBinarize, checkpoint, metricsFile, jobsFile}},
+        {sweep, {sharding, justBinarize, checkpoint, metricsFile, jobsFile, labelColumns}},
+        {bootstrap, {sharding, justBinarize, checkpoint, metricsFile, jobsFile, labelColumns, sweep}},
+        {TModeOption("--permutations", options.PermutationCount), {sharding, justBinarize, jobsFile, labelColumns, sweep, bootstrap}},
+        {jobsFile, {sharding, justBinarize, checkpoint, initialFeatures, metricsFile}},
+        {TModeOption("--window", options.WindowDirectory),
+         {rawPool, binaryPool, binToFeatureMap, packedPool, sharding, justBinarize, jobsFile, labelColumns, bootstrap, columnOptions, rowOptions}},
+        {packedPool, {rawPool, binaryPool, binToFeatureMap, columnOptions, rowOptions}},
+        {rawPool, {binaryPool, binToFeatureMap}},
+        {binaryPool, {columnOptions}},
+    };
+    if (const TMaybe<TString> conflict = FindModeConflict(modeConflicts)) {
+        Cerr << *conflict << Endl;
+        return 1;
+    }
+    if (!options.WindowDirectory && !options.PackedPoolFilename && !options.RawPoolFilename &&
+        !(options.BinaryPoolFilename && options.FeatureBinMapFilename)) {
         Cerr << "Provide either only --pool option or both --binary-pool and --map" << Endl;
         return 2;
     }
 
-    if (options.BinaryPoolOutputFile && options.FeatureBinMapOutputFile) {
+    yvector<NCmicot::TSelectionJob> jobs;
+    if (options.JobsFile) {
+        NCmicot::TFastSelectionOptions defaults;
+        defaults.EvalStepCount = options.EvalStepCount;
+        if (options.FeatureCountToSelect) {
+            defaults.FeatureCount = *options.FeatureCountToSelect;
+        }
+        jobs = NCmicot::ReadSelectionJobs(*NCmicot::OpenInput(*options.JobsFile), defaults);
+    }
+
+    TBinFeatureSet label, features;
+    yvector<int> keptColumns;
+    yvector<TBinFeatureSet> otherLabels;
+    NCmicot::TCmiSourcePtr cmiSource;
+    TAtomicSharedPtr<const NCmicot::TSelectionPoolData> windowPoolData;
+    if (options.ServeShardSocket) {
+        NCmicot::TPackedPool packed = NCmicot::ReadPackedPoolShard(
+            *NCmicot::OpenInput(*options.PackedPoolFilename, options.ThreadCount), options.ShardIndex, options.ShardCount);
+        features = NCmicot::BinarizeWithMap(std::move(packed.Pool.Bins), packed.BinToFeatureMap);
+        NCmicot::ServeCmiShard(features, packed.FirstLine, *NCmicot::AcceptShardChannel(*options.ServeShardSocket), options.ThreadCount);
+        return 0;
+    }
+    if (options.PackedPoolFilename && (isLineSharded || !options.CandidateWorkers.empty())) {
+        // The bins stay with the workers, the coordinator keeps only the label and the feature-bin layout
+        NCmicot::TPackedPool packed = NCmicot::ReadPackedPoolLabel(*NCmicot::OpenInput(*options.PackedPoolFilename, options.ThreadCount));
+        label = TBinFeatureSet(NCmicot::BinarizeFeature(packed.Pool.Label, borderBuilder));
+        features = NCmicot::BinarizeWithMap(yvector<NCmicot::TBin>(packed.BinToFeatureMap.size()), packed.BinToFeatureMap);
+    } else if (options.WindowDirectory) {
+        // Only the appended block is counted, the first step comes from the counts of all the blocks
+        NCmicot::TPoolWindow window(*options.WindowDirectory);
+        if (options.AppendBlockFilename) {
+            window.AppendBlock(*options.AppendBlockFilename, borderBuilder, options.ThreadCount);
+        }
+        if (options.WindowBlockCount) {
+            window.RetireBlocks(*options.WindowBlockCount);
+        }
+        window.Save();
+        std::tie(label, features) = window.LoadPool(options.ThreadCount);
+        windowPoolData = window.MakePoolData(label);
+    } else {
+        NCmicot::TLoadedPool pool = NCmicot::LoadPool(options);
+        label = std::move(pool.Label);
+        features = std::move(pool.Features);
+        keptColumns = std::move(pool.KeptColumns);
+        otherLabels = std::move(pool.OtherLabels);
+    }
+    if (isLineSharded) {
+        yvector<THolder<NCmicot::IShardChannel>> workers;
+        if (!options.ShardWorkers.empty()) {
+            for (const TString& socket : options.ShardWorkers) {
+                workers.push_back(NCmicot::ConnectShardChannel(socket, TDuration::Minutes(1)));
+            }
+        } else {
+            const TString poolFile = *options.PackedPoolFilename;
+            const int shardCount = options.ShardProcesses;
+            const int workerThreadCount = Max(1, options.ThreadCount / shardCount);
+            workers = NCmicot::ForkShardWorkers(shardCount, [&](int shardIndex, NCmicot::IShardChannel& coordinator) {
+                NCmicot::TPackedPool shard = NCmicot::ReadPackedPoolShard(*NCmicot::OpenInput(poolFile), shardIndex, shardCount);
+                const TBinFeatureSet shardFeatures = NCmicot::BinarizeWithMap(std::move(shard.Pool.Bins), shard.BinToFeatureMap);
+                NCmicot::ServeCmiShard(shardFeatures, shard.FirstLine, coordinator, workerThreadCount);
+            });
+        }
+        cmiSource = new NCmicot::TShardedCmiSource(MakeAtomicShared<NCmicot::TLabelCodes>(label), features.GetBinCount(),
+                                                   std::move(workers));
+    }
+
+    if (options.ServeCandidatesSocket) {
+        NCmicot::ServeCandidateShard(label, features, options.ShardIndex, options.ShardCount,
+                                     *NCmicot::AcceptShardChannel(*options.ServeCandidatesSocket), options.ThreadCount);
+        return 0;
+    }
+
+    int failedJobCount = 0;
+    if (options.JobsFile) {
+        failedJobCount = NCmicot::RunSelectionJobs(label, features, keptColumns, jobs, options.ThreadCount);
+    } else if (options.BinaryPoolOutputFile && options.FeatureBinMapOutputFile) {
+        NCmicot::TPoolWriterOptions writerOptions;
+        writerOptions.ThreadCount = options.ThreadCount;
+        writerOptions.Compress = options.CompressOutput;
+
         TOFStream poolOutput(*options.BinaryPoolOutputFile);
-        NCmicot::OutputPool(label, features, poolOutput);
+        NCmicot::OutputPool(label, features, poolOutput, writerOptions);
 
         TOFStream mapOutput(*options.FeatureBinMapOutputFile);
-        NCmicot::OutputBinFeatureMap(features, mapOutput);
+        NCmicot::OutputBinFeatureMap(features, mapOutput, writerOptions);
     } else {
-        NCmicot::FastFeatureSelection(
-            label,
-            features,
-            options.EvalStepCount,
-            options.ThreadCount,
-            options.FeatureCountToSelect.GetOrElse(features.GetFeatureCount()),
-            PrintFeature
-        );
+        NCmicot::TFastSelectionOptions selectionOptions;
+        selectionOptions.EvalStepCount = options.EvalStepCount;
+        selectionOptions.ThreadCount = options.ThreadCount;
+        selectionOptions.FeatureCount = options.FeatureCountToSelect.GetOrElse(features.GetFeatureCount());
+        selectionOptions.CheckpointFile = options.CheckpointFile.GetOrElse(TString());
+        selectionOptions.Resume = options.Resume;
+        selectionOptions.PoolData = windowPoolData;
+        if (cmiSource) {
+            selectionOptions.CmiSource = cmiSource;
+            // Workers answer one query at a time, they count with the threads instead
+            selectionOptions.ThreadCount = 1;
+        }
+        if (isCandidateSharded) {
+            yvector<THolder<NCmicot::IShardChannel>> workers;
+            if (!options.CandidateWorkers.empty()) {
+                for (const TString& socket : options.CandidateWorkers) {
+                    workers.push_back(NCmicot::ConnectShardChannel(socket, TDuration::Minutes(1)));
+                }
+            } else {
+                // Forked after reading, so the workers share the pages of the pool until they exit
+                const int shardCount = options.CandidateProcesses;
+                const int workerThreadCount = Max(1, options.ThreadCount / shardCount);
+                workers = NCmicot::ForkShardWorkers(shardCount, [&](int shardIndex, NCmicot::IShardChannel& coordinator) {
+                    NCmicot::ServeCandidateShard(label, features, shardIndex, shardCount, coordinator, workerThreadCount);
+                });
+            }
+            selectionOptions.CandidateShards = new NCmicot::TCandidateShards(
+                label.GetBin(0).size(), features.GetBinCount(), std::move(workers));
+        }
+        if (options.InitialFeaturesFile) {
+            for (int featureId : NCmicot::ReadFeatureList(*NCmicot::OpenInput(*options.InitialFeaturesFile))) {
+                selectionOptions.InitialFeatures.push_back(NCmicot::ToKeptFeature(featureId, keptColumns));
+            }
+        }
+
+        THolder<TOFStream> metricsOutput;
+        if (options.MetricsFile) {
+            metricsOutput.Reset(new TOFStream(*options.MetricsFile));
+            selectionOptions.CountKernels = true;
+            selectionOptions.OnStepFinished = [&metricsOutput, &keptColumns](NCmicot::TSelectionStepMetrics metrics) {
+                metrics.SelectedFeature = NCmicot::ToPoolFeature(metrics.SelectedFeature, keptColumns);
+                NCmicot::OutputStepMetrics(metrics, *metricsOutput);
+                metricsOutput->Flush();
+            };
+        }
+
+        if (options.BootstrapReplicaCount) {
+            const auto replicas = NCmicot::MakeBootstrapReplicas(label.GetBin(0).size(), options.BootstrapReplicaCount,
+                                                                 options.ReadPoolOptions.Seed);
+            const yvector<int> selectionCounts = NCmicot::BootstrapFeatureSelection(label, features, replicas, selectionOptions);
+            yvector<int> selected;
+            for (int featureId : xrange(features.GetFeatureCount())) {
+                if (selectionCounts[featureId] > 0) {
+                    selected.push_back(featureId);
+                }
+            }
+            // Most frequent first, a stable sort keeps the pool order of equally frequent features
+            StableSort(selected.begin(), selected.end(), [&selectionCounts](int left, int right) {
+                return selectionCounts[left] > selectionCounts[right];
+            });
+            for (int featureId : selected) {
+                Cout << NCmicot::ToPoolFeature(featureId, keptColumns) << '\t'
+                     << double(selectionCounts[featureId]) / options.BootstrapReplicaCount << Endl;
+            }
+        } else if (!options.EvalStepSweep.empty()) {
+            // Rankings of every -t are reported together after the sweep
+            yvector<yvector<int>> rankings(options.EvalStepSweep.size());
+            NCmicot::EvalStepSweepFeatureSelection(
+                label,
+                features,
+                options.EvalStepSweep,
+                selectionOptions,
+                [&rankings](int order, int featureId) {
+                    rankings[order].push_back(featureId);
+                }
+            );
+            for (size_t order = 0; order < rankings.size(); ++order) {
+                for (int featureId : rankings[order]) {
+                    Cout << options.EvalStepSweep[order] << '\t' << NCmicot::ToPoolFeature(featureId, keptColumns) << Endl;
+                }
+            }
+        } else if (otherLabels.empty()) {
+            // With --permutations the features are reported with their p-values after the selection
+            yvector<int> ranking;
+            NCmicot::FastFeatureSelection(
+                label,
+                features,
+                selectionOptions,
+                [&options, &keptColumns, &ranking](int featureId) {
+                    if (options.PermutationCount) {
+                        ranking.push_back(featureId);
+                    } else {
+                        // Report features by their index in the original pool, even if some columns weren't read
+                        Cout << NCmicot::ToPoolFeature(featureId, keptColumns) << Endl;
+                    }
+                }
+            );
+            if (options.PermutationCount) {
+                const yvector<double> pValues = NCmicot::PermutationTest(
+                    label, features, ranking, options.PermutationCount, options.ReadPoolOptions.Seed, selectionOptions);
+                for (size_t i = 0; i < ranking.size(); ++i) {
+                    Cout << NCmicot::ToPoolFeature(ranking[i], keptColumns) << '\t' << pValues[i] << Endl;
+                }
+            }
+        } else {
+            yvector<TBinFeatureSet> labels;
+            labels.push_back(std::move(label));
+            for (auto& otherLabel : otherLabels) {
+                labels.push_back(std::move(otherLabel));
+            }
+            NCmicot::MultiLabelFeatureSelection(
+                labels,
+                features,
+                selectionOptions,
+                [&options, &keptColumns](int labelIndex, int featureId) {
+                    Cout << options.LabelColumns[labelIndex] << '\t' << NCmicot::ToPoolFeature(featureId, keptColumns) << Endl;
+                }
+            );
+        }
+    }
+
+    if (options.TraceFile) {
+        TOFStream traceOutput(*options.TraceFile);
+        NCmicot::FinishTracing(traceOutput);
+    }
+    if (options.PerfCounters) {
+        NCmicot::StopPerfCounters();
+        NCmicot::ReportPerfCounters(Cerr);
     }
 
-    return 0;
+    return failedJobCount ? 1 : 0;
 }
@@ -1,8 +1,12 @@
 #pragma once
 
+#include "metrics.h"
+#include "trace.h"
+
 #include <library/threading/algorithm/parallel_algorithm.h>
 
 #include <functional>
+#include <numeric>
 
 namespace NCmicot {
     namespace Impl {
@@ -30,8 +34,24 @@ namespace NCmicot {
         I ParallelExtremeElementBy(I begin, I end, F&& func, P&& pred, int threadCount) {
             using TValue = decltype(func(*begin));
 
+            TTraceSpan span("ParallelExtremeElementBy", "items", end - begin);
+            // Every item is a separate task of the pool. Kernel counts of a task go to a slot of its
+            // own and are added to the target of the calling thread when all the tasks are done
+            TKernelCounters* const callerCounters = GetThreadKernelCounters();
+            yvector<TKernelCounters> taskCounters(callerCounters ? end - begin : 0);
+            yvector<size_t> positions(end - begin);
+            std::iota(positions.begin(), positions.end(), 0);
+            auto tracedFunc = [&func, &taskCounters, begin](size_t position) {
+                TTraceSpan taskSpan("Task");
+                TKernelCountersGuard countersGuard(taskCounters.empty() ? nullptr : &taskCounters[position]);
+                return func(*(begin + position));
+            };
+
             yvector<TValue> values;
-            ParallelForEach(begin, end, std::forward<F>(func), values, threadCount);
+            ParallelForEach(positions.begin(), positions.end(), tracedFunc, values, threadCount);
+            for (const TKernelCounters& counters : taskCounters) {
+                *callerCounters += counters;
+            }
 
             auto identity = [](const TValue& x) { return x; };
             auto iter = ExtremeElementBy(values.begin(), values.end(), identity, std::forward<P>(pred));
@@ -0,0 +1,249 @@
+#include "bgzf.h"
+
+#include <library/threading/future/async.h>
+
+#include <contrib/libs/zlib/zlib.h>
+
+#include <util/generic/vector.h>
+#include <util/generic/yexception.h>
+#include <util/stream/output.h>
+
+#include <cstring>
+
+namespace NCmicot {
+    namespace {
+        constexpr size_t HEADER_SIZE = 12;
+        constexpr size_t BC_HEADER_SIZE = HEADER_SIZE + 6;
+        constexpr size_t FOOTER_SIZE = 8;
+        constexpr size_t MAX_BLOCK_SIZE = 0x10000;
+        constexpr size_t DECOMPRESSED_BATCH_SIZE = 1 << 20;
+
+        constexpr unsigned char BC_HEADER[BC_HEADER_SIZE] = {
+            0x1f, 0x8b, 8, 4, // magic, deflate, FEXTRA
+            0, 0, 0, 0,       // mtime
+            0, 0xff,          // xfl, unknown os
+            6, 0,             // xlen
+            'B', 'C', 2, 0,   // subfield id and length
+            0, 0,             // block size - 1, filled in for every block
+        };
+
+        ui16 ReadUi16(const char* data) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+            return bytes[0] | (bytes[1] << 8);
+        }
+
+        ui32 ReadUi32(const char* data) {
+            return ReadUi16(data) | (static_cast<ui32>(ReadUi16(data + 2)) << 16);
+        }
+
+        void WriteUi32(ui32 value, char* data) {
+            for (int i = 0; i < 4; ++i) {
+                data[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+            }
+        }
+
+        bool HasGzipMagic(TStringBuf header) {
+            return header.size() >= 4 && static_cast<unsigned char>(header[0]) == 0x1f &&
+                   static_cast<unsigned char>(header[1]) == 0x8b && header[2] == 8 && (header[3] & 4);
+        }
+
+        /// Returns BSIZE from the "BC" subfield of the given extra field or 0 if there is none.
+        size_t FindBlockSize(TStringBuf extra) {
+            while (extra.size() >= 4) {
+                const size_t length = ReadUi16(extra.data() + 2);
+                if (extra[0] == 'B' && extra[1] == 'C' && length == 2 && extra.size() >= 6) {
+                    return static_cast<size_t>(ReadUi16(extra.data() + 4)) + 1;
+                }
+                extra.Skip(Min(extra.size(), 4 + length));
+            }
+            return 0;
+        }
+
+        size_t Deflate(TStringBuf data, int level, char* out, size_t outSize) {
+            z_stream stream;
+            memset(&stream, 0, sizeof(stream));
+            Y_ENSURE(deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK,
+                     "Failed to initialize deflate");
+            stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+            stream.avail_in = data.size();
+            stream.next_out = reinterpret_cast<Bytef*>(out);
+            stream.avail_out = outSize;
+            const int status = deflate(&stream, Z_FINISH);
+            const size_t written = stream.total_out;
+            deflateEnd(&stream);
+            return status == Z_STREAM_END ? written : 0;
+        }
+    }
+
+    void WriteBgzfBlock(TStringBuf data, IOutputStream& out, int compressionLevel) {
+        Y_ENSURE(data.size() <= BGZF_MAX_BLOCK_DATA_SIZE, "BGZF block can't hold " << data.size() << " bytes");
+
+        char block[MAX_BLOCK_SIZE];
+        memcpy(block, BC_HEADER, BC_HEADER_SIZE);
+        const size_t capacity = MAX_BLOCK_SIZE - BC_HEADER_SIZE - FOOTER_SIZE;
+
+        size_t compressedSize = Deflate(data, compressionLevel, block + BC_HEADER_SIZE, capacity);
+        if (compressedSize == 0) {
+            // Incompressible data, stored blocks always fit
+            compressedSize = Deflate(data, 0, block + BC_HEADER_SIZE, capacity);
+            Y_ENSURE(compressedSize > 0, "Failed to compress BGZF block");
+        }
+
+        const size_t blockSize = BC_HEADER_SIZE + compressedSize + FOOTER_SIZE;
+        block[16] = static_cast<char>((blockSize - 1) & 0xff);
+        block[17] = static_cast<char>((blockSize - 1) >> 8);
+
+        char* footer = block + BC_HEADER_SIZE + compressedSize;
+        WriteUi32(arc_crc32(0, reinterpret_cast<const Bytef*>(data.data()), data.size()), footer);
+        WriteUi32(data.size(), footer + 4);
+
+        out.Write(block, blockSize);
+    }
+
+    void WriteBgzfEof(IOutputStream& out) {
+        WriteBgzfBlock(TStringBuf(), out);
+    }
+
+    bool IsBgzfHeader(TStringBuf header) {
+        if (!HasGzipMagic(header) || header.size() < HEADER_SIZE) {
+            return false;
+        }
+        const size_t extraLength = ReadUi16(header.data() + 10);
+        return FindBlockSize(header.SubStr(HEADER_SIZE, extraLength)) != 0;
+    }
+
+    bool ReadBgzfBlock(IInputStream& in, TString& block) {
+        char header[HEADER_SIZE];
+        const size_t headerSize = in.Load(header, HEADER_SIZE);
+        if (headerSize == 0) {
+            return false;
+        }
+        Y_ENSURE(headerSize == HEADER_SIZE && HasGzipMagic(TStringBuf(header, HEADER_SIZE)),
+                 "Input is not BGZF: incorrect block header");
+
+        const size_t extraLength = ReadUi16(header + 10);
+        block.ReserveAndResize(HEADER_SIZE + extraLength);
+        memcpy(block.begin(), header, HEADER_SIZE);
+        Y_ENSURE(in.Load(block.begin() + HEADER_SIZE, extraLength) == extraLength, "Truncated BGZF block");
+
+        const size_t blockSize = FindBlockSize(TStringBuf(block).SubStr(HEADER_SIZE));
+        Y_ENSURE(blockSize >= HEADER_SIZE + extraLength + FOOTER_SIZE, "Input is not BGZF: no block size");
+
+        const size_t readSize = block.size();
+        block.ReserveAndResize(blockSize);
+        Y_ENSURE(in.Load(block.begin() + readSize, blockSize - readSize) == blockSize - readSize,
+                 "Truncated BGZF block");
+        return true;
+    }
+
+    TString InflateBgzfBlock(TStringBuf block) {
+        const size_t dataOffset = HEADER_SIZE + ReadUi16(block.data() + 10);
+        Y_ENSURE(block.size() >= dataOffset + FOOTER_SIZE, "Truncated BGZF block");
+        const char* footer = block.data() + block.size() - FOOTER_SIZE;
+        const ui32 expectedCrc = ReadUi32(footer);
+        const size_t dataSize = ReadUi32(footer + 4);
+
+        TString result;
+        result.ReserveAndResize(dataSize);
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        Y_ENSURE(inflateInit2(&stream, -15) == Z_OK, "Failed to initialize inflate");
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.data() + dataOffset));
+        stream.avail_in = block.size() - dataOffset - FOOTER_SIZE;
+        stream.next_out = reinterpret_cast<Bytef*>(result.begin());
+        stream.avail_out = dataSize;
+        const int status = inflate(&stream, Z_FINISH);
+        const size_t inflatedSize = stream.total_out;
+        inflateEnd(&stream);
+
+        Y_ENSURE(status == Z_STREAM_END && inflatedSize == dataSize, "Corrupted BGZF block");
+        Y_ENSURE(arc_crc32(0, reinterpret_cast<const Bytef*>(result.data()), dataSize) == expectedCrc,
+                 "BGZF block checksum mismatch");
+        return result;
+    }
+
+    TParallelBgzfInput::TParallelBgzfInput(THolder<IInputStream> slave, int threadCount)
+        : Slave(std::move(slave))
+        , MaxPending(2 * threadCount)
+    {
+        Y_ENSURE(threadCount > 0);
+        Queue.Start(threadCount);
+    }
+
+    TParallelBgzfInput::~TParallelBgzfInput() {
+        for (const auto& future : Pending) {
+            future.Wait();
+        }
+    }
+
+    void TParallelBgzfInput::Schedule() {
+        while (!SlaveExhausted && Pending.size() < MaxPending) {
+            // Blocks are grouped so that a task isn't dominated by queue overhead
+            yvector<TString> blocks;
+            size_t compressedSize = 0;
+            for (TString block; compressedSize < DECOMPRESSED_BATCH_SIZE / 4;) {
+                if (!ReadBgzfBlock(*Slave, block)) {
+                    SlaveExhausted = true;
+                    break;
+                }
+                compressedSize += block.size();
+                blocks.push_back(std::move(block));
+            }
+            if (blocks.empty()) {
+                break;
+            }
+
+            Pending.push_back(NThreading::Async([blocks = std::move(blocks)] {
+                TString result;
+                for (const TString& block : blocks) {
+                    result += InflateBgzfBlock(block);
+                }
+                return result;
+            }, Queue));
+        }
+    }
+
+    bool TParallelBgzfInput::EnsureData() {
+        while (Offset == Current.size()) {
+            Schedule();
+            if (Pending.empty()) {
+                return false;
+            }
+            Pending.front().Wait();
+            Current = Pending.front().GetValue();
+            Pending.pop_front();
+            Offset = 0;
+        }
+        return true;
+    }
+
+    size_t TParallelBgzfInput::DoRead(void* buf, size_t len) {
+        if (!EnsureData()) {
+            return 0;
+        }
+        const size_t size = Min(len, Current.size() - Offset);
+        memcpy(buf, Current.data() + Offset, size);
+        Offset += size;
+        return size;
+    }
+
+    size_t TParallelBgzfInput::DoReadTo(TString& st, char ch) {
+        st.clear();
+        size_t consumed = 0;
+        while (EnsureData()) {
+            const char* begin = Current.data() + Offset;
+            const size_t available = Current.size() - Offset;
+            const char* found = static_cast<const char*>(memchr(begin, ch, available));
+            if (found) {
+                st.append(begin, found - begin);
+                Offset += found - begin + 1;
+                return consumed + (found - begin) + 1;
+            }
+            st.append(begin, available);
+            Offset += available;
+            consumed += available;
+        }
+        return consumed;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <library/threading/future/future.h>
+
+#include <util/generic/deque.h>
+#include <util/generic/ptr.h>
+#include <util/generic/strbuf.h>
+#include <util/generic/string.h>
+#include <util/stream/input.h>
+#include <util/thread/queue.h>
+
+class IOutputStream;
+
+namespace NCmicot {
+    /// BGZF is gzip split into independent members of at most 64KB, each of them keeping its own
+    /// compressed size in the "BC" extra subfield. It is still a valid gzip file, but its members can
+    /// be found without decompressing anything and inflated in parallel.
+    constexpr size_t BGZF_MAX_BLOCK_DATA_SIZE = 0xff00;
+
+    void WriteBgzfBlock(TStringBuf data, IOutputStream& out, int compressionLevel = 6);
+    void WriteBgzfEof(IOutputStream& out);
+
+    /// Returns true if header is the beginning of a BGZF block.
+    bool IsBgzfHeader(TStringBuf header);
+
+    /// Reads the next compressed block as is. Returns false if the input is over.
+    bool ReadBgzfBlock(IInputStream& in, TString& block);
+    TString InflateBgzfBlock(TStringBuf block);
+
+    /// Decompresses a BGZF stream in the given number of threads ahead of the reader.
+    class TParallelBgzfInput : public IInputStream {
+    public:
+        TParallelBgzfInput(THolder<IInputStream> slave, int threadCount);
+        ~TParallelBgzfInput() override;
+
+    protected:
+        size_t DoRead(void* buf, size_t len) override;
+        size_t DoReadTo(TString& st, char ch) override;
+
+    private:
+        void Schedule();
+        bool EnsureData();
+
+        THolder<IInputStream> Slave;
+        TMtpQueue Queue;
+        size_t MaxPending;
+        bool SlaveExhausted = false;
+        ydeque<NThreading::TFuture<TString>> Pending;
+        TString Current;
+        size_t Offset = 0;
+    };
+}
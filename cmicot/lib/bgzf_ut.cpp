@@ -0,0 +1,74 @@
+#include "bgzf.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+#include <util/stream/str.h>
+
+namespace NCmicot {
+    namespace {
+        TString CompressToBgzf(const TString& data, size_t blockSize) {
+            TStringStream out;
+            for (size_t offset = 0; offset < data.size(); offset += blockSize) {
+                WriteBgzfBlock(TStringBuf(data).SubStr(offset, blockSize), out);
+            }
+            WriteBgzfEof(out);
+            return out.Str();
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(Bgzf) {
+        SIMPLE_UNIT_TEST(BlockRoundTrip) {
+            TReallyFastRng32 rng(20170405);
+            TString data;
+            for (int i : xrange(BGZF_MAX_BLOCK_DATA_SIZE)) {
+                Y_UNUSED(i);
+                // Random bytes don't compress, so the block falls back to stored deflate
+                data.push_back(static_cast<char>(rng.Uniform(256)));
+            }
+
+            TStringStream out;
+            WriteBgzfBlock(data, out);
+            const TString compressed = out.Str();
+            UNIT_ASSERT(IsBgzfHeader(compressed));
+
+            TStringInput in(compressed);
+            TString block;
+            UNIT_ASSERT(ReadBgzfBlock(in, block));
+            UNIT_ASSERT_VALUES_EQUAL(block.size(), compressed.size());
+            UNIT_ASSERT_EQUAL(InflateBgzfBlock(block), data);
+            UNIT_ASSERT(!ReadBgzfBlock(in, block));
+        }
+
+        SIMPLE_UNIT_TEST(CorruptedBlock) {
+            TStringStream out;
+            WriteBgzfBlock("1\t2\t3\n", out);
+            TString compressed = out.Str();
+            compressed.begin()[compressed.size() - 6] ^= 1;
+            UNIT_ASSERT_EXCEPTION(InflateBgzfBlock(compressed), yexception);
+
+            const TString plain = "1\t2\t3\n";
+            TStringInput notBgzf(plain);
+            TString block;
+            UNIT_ASSERT_EXCEPTION(ReadBgzfBlock(notBgzf, block), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(ParallelInputReadsLines) {
+            TStringStream data;
+            for (int i : xrange(100000)) {
+                data << i << '\t' << i * 3 << '\n';
+            }
+
+            // Small blocks so that lines cross block and task boundaries
+            const TString compressed = CompressToBgzf(data.Str(), 1000);
+            TParallelBgzfInput in(new TStringInput(compressed), 3);
+
+            int lineCount = 0;
+            for (TString line; in.ReadLine(line); ++lineCount) {
+                UNIT_ASSERT_VALUES_EQUAL(line, ToString(lineCount) + '\t' + ToString(lineCount * 3));
+            }
+            UNIT_ASSERT_VALUES_EQUAL(lineCount, 100000);
+        }
+    }
+}
@@ -1,7 +1,109 @@
 #pragma once
 
+#include <util/generic/bitops.h>
 #include <util/generic/vector.h>
 
 namespace NCmicot {
     using TBin = yvector<bool>;
+
+    /// A feature kept as one small-integer level per line instead of a set of thermometer bins.
+    /// Level is the number of borders lying below the value, so bin k of the feature is
+    /// (Levels[i] > BinThresholds[k]) and is materialized only when a kernel reads it.
+    struct TLevelFeature {
+        yvector<ui8> Levels;
+        yvector<float> Borders;
+        yvector<ui8> BinThresholds;
+    };
+
+    /// Read-only view of a single bin. It either points to an explicitly stored TBin or to a level
+    /// column of a TLevelFeature together with the threshold defining the bin.
+    class TBinRef {
+    public:
+        TBinRef(const TBin& bin)
+            : Bin(&bin)
+            , Levels(nullptr)
+            , Threshold(0)
+        {
+        }
+
+        TBinRef(const yvector<ui8>& levels, ui8 threshold)
+            : Bin(nullptr)
+            , Levels(&levels)
+            , Threshold(threshold)
+        {
+        }
+
+        size_t size() const {
+            return Bin ? Bin->size() : Levels->size();
+        }
+
+        bool operator[](size_t index) const {
+            return Bin ? (*Bin)[index] : (*Levels)[index] > Threshold;
+        }
+
+        bool IsLevelCoded() const {
+            return Levels != nullptr;
+        }
+
+        /// Calls func(index, bit) for every value of the bin. The storage kind is resolved once,
+        /// outside of the loop, so kernels don't pay for the indirection on every value.
+        template <class TFunc>
+        void ForEach(TFunc&& func) const {
+            if (Bin) {
+                const TBin& bin = *Bin;
+                for (size_t i = 0; i < bin.size(); ++i) {
+                    func(i, static_cast<bool>(bin[i]));
+                }
+            } else {
+                const ui8* levels = Levels->data();
+                const ui8 threshold = Threshold;
+                for (size_t i = 0; i < Levels->size(); ++i) {
+                    func(i, levels[i] > threshold);
+                }
+            }
+        }
+
+        TBin Materialize() const {
+            if (Bin) {
+                return *Bin;
+            }
+            TBin result(Levels->size());
+            ForEach([&result](size_t i, bool bit) { result[i] = bit; });
+            return result;
+        }
+
+    private:
+        const TBin* Bin;
+        const yvector<ui8>* Levels;
+        ui8 Threshold;
+    };
+
+    inline bool operator==(const TBinRef& lhs, const TBinRef& rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (lhs[i] != rhs[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Unpacks a bin of lineCount lines kept as bit (line % 64) of word (line / 64). Only the set
+    /// bits are visited, and the bits of the last word past lineCount are ignored.
+    inline TBin UnpackBin(const ui64* words, size_t lineCount) {
+        TBin result(lineCount);
+        const size_t wordCount = (lineCount + 63) / 64;
+        for (size_t word = 0; word < wordCount; ++word) {
+            ui64 bits = words[word];
+            if (word + 1 == wordCount && lineCount % 64) {
+                bits &= (ui64(1) << (lineCount % 64)) - 1;
+            }
+            for (; bits; bits &= bits - 1) {
+                result[64 * word + CountTrailingZeroBits(bits)] = true;
+            }
+        }
+        return result;
+    }
 }
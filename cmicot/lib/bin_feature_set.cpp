@@ -19,16 +19,25 @@ namespace NCmicot {
         std::fill(begin, end, enabled);
 
         if (enabled) {
-            LastEnabledBins = {*indexRange.begin(), *indexRange.end()};
+            LastEnabledBins = {{*indexRange.begin(), *indexRange.end()}};
         }
     }
 
+    void TBackground::SetFeaturesEnabled(const yvector<int>& indexes) {
+        yvector<std::pair<int, int>> enabledBins;
+        for (int index : indexes) {
+            SetFeatureEnabled(index, true);
+            enabledBins.push_back(LastEnabledBins.front());
+        }
+        LastEnabledBins = std::move(enabledBins);
+    }
+
     void TBackground::SetBinEnabled(int index, bool enabled) {
         Y_ENSURE_EX(0 <= index && index < GetBinCount(), TRangeEx() << index << " " << GetBinCount());
 
         IsBinEnabled[index] = enabled;
         if (enabled) {
-            LastEnabledBins = {index, index + 1};
+            LastEnabledBins = {{index, index + 1}};
         }
     }
 
@@ -44,11 +53,15 @@ namespace NCmicot {
         return result;
     }
 
+    int TBackground::EnabledBinCount() const {
+        return Count(IsBinEnabled.begin(), IsBinEnabled.end(), true);
+    }
+
     yvector<TBin> TBackground::EnabledBins() const {
         yvector<TBin> result;
         for (auto i : xrange(IsBinEnabled.size())) {
             if (IsBinEnabled[i]) {
-                result.push_back(GetBin(i));
+                result.push_back(GetBin(i).Materialize());
             }
         }
         return result;
@@ -84,15 +97,19 @@ namespace NCmicot {
     /* TBinFeatureSet */
 
     TBinFeatureSet::TBinFeatureSet(yvector<TBin> bins)
-        : Bins(std::move(bins))
-        , FeatureStart(1, 0)
+        : FeatureStart(1, 0)
     {
+        for (auto& bin : bins) {
+            BinLocations.push_back({Bins.ysize(), EXPLICIT_BIN});
+            Bins.push_back(std::move(bin));
+        }
     }
 
     int TBinFeatureSet::AddFeature(yvector<TBin> feature) {
-        FeatureStart.push_back(Bins.size());
+        FeatureStart.push_back(BinLocations.size());
 
         for (auto& bin : feature) {
+            BinLocations.push_back({Bins.ysize(), EXPLICIT_BIN});
             Bins.push_back(TBin());
             Bins.back() = std::move(bin);
         }
@@ -100,22 +117,37 @@ namespace NCmicot {
         return GetFeatureCount() - 1;
     }
 
+    int TBinFeatureSet::AddLevelFeature(TLevelFeature feature) {
+        FeatureStart.push_back(BinLocations.size());
+
+        for (ui8 threshold : feature.BinThresholds) {
+            BinLocations.push_back({LevelFeatures.ysize(), threshold});
+        }
+        LevelFeatures.push_back(std::move(feature));
+
+        return GetFeatureCount() - 1;
+    }
+
     int TBinFeatureSet::GetFeatureCount() const {
         return FeatureStart.ysize();
     }
 
-    const TBin& TBinFeatureSet::GetBin(int index) const {
+    TBinRef TBinFeatureSet::GetBin(int index) const {
         Y_ENSURE_EX(0 <= index && index < GetBinCount(), TRangeEx() << index << " " << GetBinCount());
-        return Bins[index];
+
+        const TBinLocation& location = BinLocations[index];
+        if (location.Threshold == EXPLICIT_BIN) {
+            return Bins[location.Column];
+        }
+        return {LevelFeatures[location.Column].Levels, static_cast<ui8>(location.Threshold)};
     }
 
     yvector<TBin> TBinFeatureSet::GetFeature(int index) const {
-        Y_ENSURE_EX(0 <= index && index < GetFeatureCount(), TRangeEx() << index << " " << GetFeatureCount());
-
-        auto begin = Bins.begin() + FeatureStart[index];
-        auto end = index < FeatureStart.ysize() - 1 ? Bins.begin() + FeatureStart[index + 1]
-                                                    : Bins.end();
-        return {begin, end};
+        yvector<TBin> result;
+        for (int binIndex : GetFeatureBinIndexes(index)) {
+            result.push_back(GetBin(binIndex).Materialize());
+        }
+        return result;
     }
 
     int TBinFeatureSet::GetFeatureIndexByBinIndex(int binIndex) const {
@@ -125,13 +157,18 @@ namespace NCmicot {
     }
 
     int TBinFeatureSet::GetBinCount() const {
-        return Bins.ysize();
+        return BinLocations.ysize();
     }
 
     const yvector<TBin>& TBinFeatureSet::AllBins() const {
+        Y_ENSURE(!HasLevelFeatures(), "All bins are requested from a feature set with level-coded features");
         return Bins;
     }
 
+    bool TBinFeatureSet::HasLevelFeatures() const {
+        return !LevelFeatures.empty();
+    }
+
     decltype(xrange(0, 1)) TBinFeatureSet::GetFeatureBinIndexes(int index) const {
         Y_ENSURE_EX(0 <= index && index < GetFeatureCount(), TRangeEx() << index << " " << GetFeatureCount());
 
@@ -144,8 +181,9 @@ namespace NCmicot {
     TBackground TBackground::LastEnabled() const {
         TBackground result(*Features);
         result.DisableAll();
-        std::fill(result.IsBinEnabled.begin() + LastEnabledBins.first,
-                  result.IsBinEnabled.begin() + LastEnabledBins.second, true);
+        for (const auto& range : LastEnabledBins) {
+            std::fill(result.IsBinEnabled.begin() + range.first, result.IsBinEnabled.begin() + range.second, true);
+        }
         return result;
     }
 
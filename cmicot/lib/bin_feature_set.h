@@ -13,13 +13,16 @@ namespace NCmicot {
         explicit TBinFeatureSet(yvector<TBin> bins);
 
         int AddFeature(yvector<TBin> feature);
+        int AddLevelFeature(TLevelFeature feature);
 
         int GetFeatureCount() const;
         int GetBinCount() const;
 
-        const TBin& GetBin(int index) const;
+        TBinRef GetBin(int index) const;
 
+        /// Explicitly stored bins. Can't be used when some features are level-coded.
         const yvector<TBin>& AllBins() const;
+        bool HasLevelFeatures() const;
 
         yvector<TBin> GetFeature(int index) const;
         int GetFeatureIndexByBinIndex(int binIndex) const;
@@ -27,12 +30,23 @@ namespace NCmicot {
         decltype(xrange(0, 1)) GetFeatureBinIndexes(int index) const;
 
     protected:
+        struct TBinLocation {
+            int Column;
+            int Threshold;
+        };
+
+        static constexpr int EXPLICIT_BIN = -1;
+
         yvector<TBin> Bins;
+        yvector<TLevelFeature> LevelFeatures;
+        /// Where each bin lives: Bins[Column] for EXPLICIT_BIN, a threshold over
+        /// LevelFeatures[Column] otherwise.
+        yvector<TBinLocation> BinLocations;
         yvector<int> FeatureStart;
 
     public:
-        auto AllBinIndexes() const -> decltype(xrange(Bins.size())) {
-            return xrange(Bins.size());
+        auto AllBinIndexes() const -> decltype(xrange(BinLocations.size())) {
+            return xrange(BinLocations.size());
         }
     };
 
@@ -41,16 +55,18 @@ namespace NCmicot {
         explicit TBackground(const TBinFeatureSet& features)
             : Features(&features)
             , IsBinEnabled(features.GetBinCount(), true)
-            , LastEnabledBins(0, 0)
         {
         }
 
         void SetFeatureEnabled(int index, bool enabled);
+        /// Enables all the given features at once, so that LastEnabled() returns all of them.
+        void SetFeaturesEnabled(const yvector<int>& indexes);
 
         TBackground LastEnabled() const;
 
         void SetBinEnabled(int index, bool enabled);
         yvector<int> EnabledBinIndexes() const;
+        int EnabledBinCount() const;
         yvector<TBin> EnabledBins() const;
 
         void DisableAll();
@@ -63,7 +79,11 @@ namespace NCmicot {
             return Features->GetBinCount();
         }
 
-        const TBin& GetBin(int index) const {
+        const TBinFeatureSet& GetFeatures() const {
+            return *Features;
+        }
+
+        TBinRef GetBin(int index) const {
             return Features->GetBin(index);
         }
 
@@ -86,6 +106,7 @@ namespace NCmicot {
 
         const TBinFeatureSet* Features;
         yvector<bool> IsBinEnabled;
-        std::pair<int, int> LastEnabledBins;
+        /// Bin ranges enabled by the last enabling call.
+        yvector<std::pair<int, int>> LastEnabledBins;
     };
 };
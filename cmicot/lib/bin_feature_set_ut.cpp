@@ -62,6 +62,38 @@ namespace NCmicot {
             UNIT_ASSERT_EQUAL(fs.GetBin(4), feature2[2]);
         }
 
+        SIMPLE_UNIT_TEST(LevelFeature) {
+            TLevelFeature levelFeature;
+            levelFeature.Levels = {0, 2, 1, 3, 0};
+            levelFeature.Borders = {1.0, 2.0, 3.0};
+            levelFeature.BinThresholds = {1, 0, 2};
+
+            const yvector<TBin> explicitFeature = {TBin(5, true), TBin(5, false)};
+
+            TBinFeatureSet fs;
+            fs.AddFeature(explicitFeature);
+            UNIT_ASSERT_VALUES_EQUAL(fs.AddLevelFeature(levelFeature), 1);
+            UNIT_ASSERT(fs.HasLevelFeatures());
+
+            UNIT_ASSERT_VALUES_EQUAL(fs.GetFeatureCount(), 2);
+            UNIT_ASSERT_VALUES_EQUAL(fs.GetBinCount(), 5);
+            UNIT_ASSERT_VALUES_EQUAL(fs.GetFeatureIndexByBinIndex(4), 1);
+
+            const yvector<TBin> expected = {
+                {false, true, false, true, false},
+                {false, true, true, true, false},
+                {false, false, false, true, false},
+            };
+            UNIT_ASSERT_EQUAL(fs.GetFeature(0), explicitFeature);
+            UNIT_ASSERT_EQUAL(fs.GetFeature(1), expected);
+            UNIT_ASSERT_EQUAL(fs.GetBin(2), expected[0]);
+            UNIT_ASSERT_EQUAL(fs.GetBin(4), expected[2]);
+            UNIT_ASSERT(fs.GetBin(3).IsLevelCoded());
+            UNIT_ASSERT(!fs.GetBin(0).IsLevelCoded());
+
+            UNIT_ASSERT_EXCEPTION(fs.AllBins(), yexception);
+        }
+
         SIMPLE_UNIT_TEST(GetFeatureByBin) {
             const int binSize = 10;
             const int featureBinCount[] = {5, 1, 10, 22, 8, 6, 4, 3, 2};
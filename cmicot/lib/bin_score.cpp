@@ -60,6 +60,11 @@ namespace NCmicot {
 
     THolder<IBinScorer> BuildBinScorerForEval(const TBinFeatureSet& label, int maximizationSteps,
                                               int minimizationSteps, int maxParallel) {
+        return BuildBinScorerForEval(TLabelCodes(label), maximizationSteps, minimizationSteps, maxParallel);
+    }
+
+    THolder<IBinScorer> BuildBinScorerForEval(const TLabelCodes& label, int maximizationSteps,
+                                              int minimizationSteps, int maxParallel) {
         auto miximizer = MakeAtomicShared<TParallelMiximizer>(label, maximizationSteps,
                                                               minimizationSteps, maxParallel);
         return FuncToBinScorer([miximizer](TBackground bg, int binIndex) {
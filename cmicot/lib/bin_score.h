@@ -1,11 +1,16 @@
 #pragma once
 
 #include "bin_feature_set.h"
+#include "label_codes.h"
+
+#include <util/ysaveload.h>
 
 namespace NCmicot {
     struct TStepResult {
         int BinIndex;
         double Cmi;
+
+        Y_SAVELOAD_DEFINE(BinIndex, Cmi);
     };
 
     bool operator==(const TStepResult& lhs, const TStepResult& rhs);
@@ -30,6 +35,8 @@ namespace NCmicot {
             }
             return result;
         }
+
+        Y_SAVELOAD_DEFINE(Score, MaximizingSteps, MinimizingSteps);
     };
 
     bool operator==(const TBinScore& lhs, const TBinScore& rhs);
@@ -65,6 +72,8 @@ namespace NCmicot {
 
     THolder<IBinScorer> BuildBinScorerForEval(const TBinFeatureSet& label, int maximizationSteps,
                                               int minimizationSteps, int maxParallel);
+    THolder<IBinScorer> BuildBinScorerForEval(const TLabelCodes& label, int maximizationSteps,
+                                              int minimizationSteps, int maxParallel);
 
     THolder<IBinScorer> BuildEfamBinScorer(const TBinFeatureSet& label, int stepCount, int maxParallel);
     THolder<IBinScorer> BuildBtmBinScorer(const TBinFeatureSet& label, int stepCount, int maxParallel);
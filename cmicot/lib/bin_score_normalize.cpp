@@ -1,6 +1,7 @@
 #include "bin_score_normalize.h"
 #include "bin_score.h"
 #include "entropy.h"
+#include "label_codes.h"
 
 namespace NCmicot {
     TBinScoreNormalier BuildBinScoreNormalizer(EBinScoreNormalization normalizationType,
@@ -12,7 +13,7 @@ namespace NCmicot {
                 };
 
             case EBinScoreNormalization::LabelEntropy: {
-                const double labelEntropy = Entropy(label.AllBins());
+                const double labelEntropy = TLabelCodes(label).GetEntropy();
                 return [labelEntropy](const TBinScore& bs, const TBackground&, int) {
                     return bs.Score / labelEntropy;
                 };
@@ -24,7 +25,7 @@ namespace NCmicot {
                 };
 
             case EBinScoreNormalization::BinAndLabelEntropy: {
-                const double labelEntropy = Entropy(label.AllBins());
+                const double labelEntropy = TLabelCodes(label).GetEntropy();
                 return [labelEntropy](const TBinScore& bs, const TBackground& bg, int binIndex) {
                     return bs.Score / labelEntropy / Entropy(bg.GetBin(binIndex));
                 };
@@ -1,33 +1,133 @@
 #include "binarize.h"
+#include "perf_counters.h"
+#include "trace.h"
 
 #include <library/getopt/small/last_getopt.h>
 #include <library/threading/algorithm/parallel_algorithm.h>
 
 #include <util/generic/algorithm.h>
 #include <util/generic/xrange.h>
+#include <util/generic/ylimits.h>
+#include <util/stream/labeled.h>
 
 namespace NCmicot {
-    yvector<TBin> BinarizeFeature(const yvector<double>& feature, TBorderBuilder borderBuilder) {
-        yvector<float> values(feature.begin(), feature.end());
-        const yhash_set<float> borders = borderBuilder(values);
+    namespace {
+        /// TValues is a container of doubles or floats.
+        template <class TValues>
+        yvector<TBin> BinarizeWithBorders(const TValues& feature, const yhash_set<float>& borders) {
+            TPerfRegionGuard perfRegion(EPerfRegion::BinarizationCompare);
+            if (borders.empty()) {
+                return {TBin(feature.size(), 0)};
+            }
 
-        if (borders.empty()) {
-            return {TBin(feature.size(), 0)};
+            yvector<TBin> result;
+            result.reserve(borders.size());
+
+            for (float border : borders) {
+                result.push_back(TBin());
+                auto& currentBin = result.back();
+
+                for (auto x : feature) {
+                    currentBin.push_back(x > border);
+                }
+            }
+
+            return result;
         }
 
-        yvector<TBin> result;
-        result.reserve(borders.size());
+        template <class TValues>
+        TLevelFeature LevelsWithBorders(const TValues& feature, const yhash_set<float>& borders) {
+            TPerfRegionGuard perfRegion(EPerfRegion::BinarizationCompare);
+            Y_ENSURE(borders.size() <= Max<ui8>(), "Feature has " << borders.size() << " borders, level-coded "
+                                                        << "storage supports at most " << static_cast<int>(Max<ui8>()));
 
-        for (float border : borders) {
-            result.push_back(TBin());
-            auto& currentBin = result.back();
+            TLevelFeature result;
+            result.Borders.assign(borders.begin(), borders.end());
+            Sort(result.Borders.begin(), result.Borders.end());
 
+            if (borders.empty()) {
+                result.BinThresholds.push_back(0);
+            }
+            for (float border : borders) {
+                const auto rank = LowerBound(result.Borders.begin(), result.Borders.end(), border) - result.Borders.begin();
+                result.BinThresholds.push_back(rank);
+            }
+
+            result.Levels.reserve(feature.size());
             for (auto x : feature) {
-                currentBin.push_back(x > border);
+                // x > border compares in float precision in BinarizeFeature, do the same here
+                const auto level = LowerBound(result.Borders.begin(), result.Borders.end(), x,
+                                              [](float border, double value) { return value > border; });
+                result.Levels.push_back(level - result.Borders.begin());
             }
+
+            return result;
         }
 
-        return result;
+        /// Calls binarize(column, borders) for every column of the pool in parallel.
+        template <class TBordersFunc>
+        std::pair<TBinFeatureSet, TBinFeatureSet> BinarizeColumns(
+            const yvector<yvector<double>>& inputData,
+            TBordersFunc getBorders,
+            int maxParallel,
+            EFeatureStorage featureStorage
+        ) {
+            const size_t columnCount = inputData.size();
+
+            if (featureStorage == EFeatureStorage::Levels) {
+                yvector<TLevelFeature> levelFeatures;
+                levelFeatures.reserve(columnCount - 1);
+
+                auto kernel = [&](size_t column) {
+                    TTraceSpan span("BinarizeColumn", "column", column + 1);
+                    return LevelsWithBorders(inputData[column + 1], getBorders(column + 1));
+                };
+                ParallelForEach(columnCount - 1, kernel, levelFeatures, maxParallel);
+
+                TBinFeatureSet features;
+                for (auto& feature : levelFeatures) {
+                    features.AddLevelFeature(std::move(feature));
+                }
+                return {TBinFeatureSet(BinarizeWithBorders(inputData.front(), getBorders(0))), std::move(features)};
+            }
+
+            yvector<yvector<TBin>> binarizedFeatures;
+            binarizedFeatures.reserve(columnCount);
+
+            auto kernel = [&](size_t column) {
+                TTraceSpan span("BinarizeColumn", "column", column);
+                return BinarizeWithBorders(inputData[column], getBorders(column));
+            };
+            ParallelForEach(columnCount, kernel, binarizedFeatures, maxParallel);
+
+            TBinFeatureSet label(std::move(binarizedFeatures[0]));
+
+            TBinFeatureSet features;
+            for (auto iter = binarizedFeatures.begin() + 1; iter != binarizedFeatures.end(); ++iter) {
+                features.AddFeature(std::move(*iter));
+            }
+            return {label, features};
+        }
+    }
+
+    yvector<TBin> BinarizeFeature(const yvector<double>& feature, TBorderBuilder borderBuilder) {
+        yvector<float> values(feature.begin(), feature.end());
+        return BinarizeWithBorders(feature, borderBuilder(values));
+    }
+
+    TLevelFeature BinarizeFeatureToLevels(const yvector<double>& feature, TBorderBuilder borderBuilder) {
+        yvector<float> values(feature.begin(), feature.end());
+        return LevelsWithBorders(feature, borderBuilder(values));
+    }
+
+    yvector<TBin> BinarizeFeature(NArrayRef::TConstArrayRef<float> feature, TBorderBuilder borderBuilder) {
+        yvector<float> values(feature.begin(), feature.end());
+        return BinarizeWithBorders(feature, borderBuilder(values));
+    }
+
+    TLevelFeature BinarizeFeatureToLevels(NArrayRef::TConstArrayRef<float> feature, TBorderBuilder borderBuilder) {
+        yvector<float> values(feature.begin(), feature.end());
+        return LevelsWithBorders(feature, borderBuilder(values));
     }
 
     yvector<ui64> UniteLabelBins(const yvector<TBin>& binarizedLabel) {
@@ -45,22 +145,46 @@ namespace NCmicot {
     std::pair<TBinFeatureSet, TBinFeatureSet> BinarizeRawPool(
         const yvector<yvector<double>>& inputData,
         TBorderBuilder borderBuilder,
-        int maxParallel
+        int maxParallel,
+        EFeatureStorage featureStorage
     ) {
-        yvector<yvector<TBin>> binarizedFeatures;
-        binarizedFeatures.reserve(inputData.size());
+        auto getBorders = [&](size_t column) {
+            yvector<float> values(inputData[column].begin(), inputData[column].end());
+            return borderBuilder(values);
+        };
+        return BinarizeColumns(inputData, getBorders, maxParallel, featureStorage);
+    }
 
-        auto kernel = [borderBuilder](const yvector<double>& values) {
-            return BinarizeFeature(values, borderBuilder);
+    std::pair<TBinFeatureSet, TBinFeatureSet> BinarizeRawPool(
+        const yvector<yvector<double>>& inputData,
+        yvector<yvector<float>>&& sortedValues,
+        TSortedBorderBuilder borderBuilder,
+        int maxParallel,
+        EFeatureStorage featureStorage
+    ) {
+        Y_ENSURE(sortedValues.size() == inputData.size(), LabeledOutput(sortedValues.size(), inputData.size()));
+        auto getBorders = [&](size_t column) {
+            yvector<float> values = std::move(sortedValues[column]);
+            return borderBuilder(values);
         };
-        ParallelForEach(inputData.begin(), inputData.end(), kernel, binarizedFeatures, maxParallel);
+        return BinarizeColumns(inputData, getBorders, maxParallel, featureStorage);
+    }
 
-        TBinFeatureSet label(std::move(binarizedFeatures[0]));
+    TBinFeatureSet BinarizeWithMap(yvector<TBin> poolBins, const yvector<int>& binToFeatureMap) {
+        Y_ENSURE(poolBins.size() == binToFeatureMap.size(),
+            "Pool has " << poolBins.size() << " bins, but map has only " << binToFeatureMap.size()
+                        << ". These numbers should be the same");
 
-        TBinFeatureSet features;
-        for (auto iter = binarizedFeatures.begin() + 1; iter != binarizedFeatures.end(); ++iter) {
-            features.AddFeature(std::move(*iter));
+        const int featureCount = *MaxElement(binToFeatureMap.begin(), binToFeatureMap.end());
+        yvector<yvector<TBin>> features(featureCount + 1);
+        for (int i : xrange(poolBins.size())) {
+            features[binToFeatureMap[i]].push_back(std::move(poolBins[i]));
         }
-        return {label, features};
+
+        TBinFeatureSet result;
+        for (auto& bins : features) {
+            result.AddFeature(std::move(bins));
+        }
+        return result;
     }
 }
@@ -3,6 +3,7 @@
 #include "bin.h"
 #include "bin_feature_set.h"
 
+#include <util/generic/array_ref.h>
 #include <util/generic/vector.h>
 #include <util/generic/hash_set.h>
 #include <util/generic/xrange.h>
@@ -16,14 +17,44 @@ namespace NSplitSelection {
 
 namespace NCmicot {
     using TBorderBuilder = std::function<yhash_set<float>(yvector<float>& values)>;
+    /// Same as TBorderBuilder, but the values are known to be sorted.
+    using TSortedBorderBuilder = std::function<yhash_set<float>(yvector<float>& sortedValues)>;
+
+    /// How binarized features are kept in memory.
+    enum class EFeatureStorage {
+        /// Every bin is a separate TBin column.
+        Bins,
+        /// Every feature is a single ui8 level column, bins are materialized by the kernels.
+        Levels,
+    };
 
     yvector<TBin> BinarizeFeature(const yvector<double>& feature, TBorderBuilder borderBuilder);
 
+    /// Same bins in the same order as BinarizeFeature, but stored as a level column.
+    TLevelFeature BinarizeFeatureToLevels(const yvector<double>& feature, TBorderBuilder borderBuilder);
+
+    /// Same as above for a column owned by the caller. Only a copy of the values for borderBuilder
+    /// is made.
+    yvector<TBin> BinarizeFeature(NArrayRef::TConstArrayRef<float> feature, TBorderBuilder borderBuilder);
+    TLevelFeature BinarizeFeatureToLevels(NArrayRef::TConstArrayRef<float> feature, TBorderBuilder borderBuilder);
+
     yvector<ui64> UniteLabelBins(const yvector<TBin>& binarizedLabel);
 
     std::pair<TBinFeatureSet, TBinFeatureSet> BinarizeRawPool(
         const yvector<yvector<double>>& inputData,
-        TBorderBuilder borderBuilder, int maxParallel
+        TBorderBuilder borderBuilder, int maxParallel,
+        EFeatureStorage featureStorage = EFeatureStorage::Bins
+    );
+
+    TBinFeatureSet BinarizeWithMap(yvector<TBin> poolBins, const yvector<int>& binToFeatureMap);
+
+    /// Same as above for a pool which comes with sorted values of every column (see ReadPoolSorted).
+    /// The sorted values are consumed.
+    std::pair<TBinFeatureSet, TBinFeatureSet> BinarizeRawPool(
+        const yvector<yvector<double>>& inputData,
+        yvector<yvector<float>>&& sortedValues,
+        TSortedBorderBuilder borderBuilder, int maxParallel,
+        EFeatureStorage featureStorage = EFeatureStorage::Bins
     );
 
     template <class Iter>
@@ -36,21 +67,6 @@ namespace NCmicot {
                 poolBins.back().push_back(static_cast<ui32>(value));
             }
         }
-
-        Y_ENSURE(poolBins.size() == binToFeatureMap.size(),
-            "Pool has " << poolBins.size() << " bins, but map has only " << binToFeatureMap.size()
-                        << ". These numbers should be the same");
-
-        const int featureCount = *MaxElement(binToFeatureMap.begin(), binToFeatureMap.end());
-        yvector<yvector<TBin>> features(featureCount + 1);
-        for (int i : xrange(poolBins.size())) {
-            features[binToFeatureMap[i]].push_back(std::move(poolBins[i]));
-        }
-
-        TBinFeatureSet result;
-        for (auto& bins : features) {
-            result.AddFeature(std::move(bins));
-        }
-        return result;
+        return BinarizeWithMap(std::move(poolBins), binToFeatureMap);
     }
 }
@@ -8,6 +8,7 @@
 #include <util/generic/algorithm.h>
 #include <util/generic/vector.h>
 #include <util/generic/xrange.h>
+#include <util/random/fast.h>
 #include <util/string/join.h>
 
 namespace NCmicot {
@@ -51,5 +52,62 @@ namespace NCmicot {
             UNIT_ASSERT_VALUES_EQUAL(bins.size(), 1);
             UNIT_ASSERT_VALUES_EQUAL(bins.front(), TBin(valueCount, false));
         }
+
+        SIMPLE_UNIT_TEST(LevelsMatchBins) {
+            TReallyFastRng32 rng(20170410);
+            yvector<double> feature(1000);
+            for (auto& x : feature) {
+                x = rng.Uniform(50) / 7.0;
+            }
+
+            auto borderBuilder = [&](yvector<float>& values) {
+                return NSplitSelection::TMedianPlusUniformBinarizer().BestSplit(values, 10, false);
+            };
+
+            const yvector<TBin> bins = BinarizeFeature(feature, borderBuilder);
+            TBinFeatureSet levelCoded;
+            levelCoded.AddLevelFeature(BinarizeFeatureToLevels(feature, borderBuilder));
+
+            UNIT_ASSERT_VALUES_EQUAL(levelCoded.GetBinCount(), bins.size());
+            UNIT_ASSERT_EQUAL(levelCoded.GetFeature(0), bins);
+        }
+
+        SIMPLE_UNIT_TEST(ConstantFeatureLevels) {
+            const int valueCount = 100;
+            auto borderBuilder = [&](yvector<float>& values) {
+                return NSplitSelection::TMedianBinarizer().BestSplit(values, 10, false);
+            };
+
+            TBinFeatureSet levelCoded;
+            levelCoded.AddLevelFeature(BinarizeFeatureToLevels(yvector<double>(valueCount, 1.0), borderBuilder));
+            UNIT_ASSERT_VALUES_EQUAL(levelCoded.GetBinCount(), 1);
+            UNIT_ASSERT_EQUAL(levelCoded.GetBin(0), TBin(valueCount, false));
+        }
+
+        SIMPLE_UNIT_TEST(PresortedPool) {
+            TReallyFastRng32 rng(20170412);
+            yvector<yvector<double>> pool(5, yvector<double>(500));
+            yvector<yvector<float>> sortedValues;
+            for (auto& column : pool) {
+                for (auto& x : column) {
+                    x = rng.Uniform(30) / 3.0;
+                }
+                sortedValues.emplace_back(column.begin(), column.end());
+                Sort(sortedValues.back().begin(), sortedValues.back().end());
+            }
+
+            auto borderBuilder = [](yvector<float>& values) {
+                return NSplitSelection::TMedianPlusUniformBinarizer().BestSplit(values, 6, false);
+            };
+            auto sortedBorderBuilder = [](yvector<float>& values) {
+                UNIT_ASSERT(IsSorted(values.begin(), values.end()));
+                return NSplitSelection::TMedianPlusUniformBinarizer().BestSplit(values, 6, true);
+            };
+
+            const auto expected = BinarizeRawPool(pool, borderBuilder, 2);
+            const auto presorted = BinarizeRawPool(pool, std::move(sortedValues), sortedBorderBuilder, 2);
+            UNIT_ASSERT_EQUAL(presorted.first.AllBins(), expected.first.AllBins());
+            UNIT_ASSERT_EQUAL(presorted.second.AllBins(), expected.second.AllBins());
+        }
     }
 }
@@ -0,0 +1,87 @@
+#include "bootstrap.h"
+#include "algorithm.h"
+#include "mutual_information_calculator.h"
+#include "trace.h"
+
+#include <util/generic/xrange.h>
+#include <util/generic/ylimits.h>
+#include <util/random/fast.h>
+
+namespace NCmicot {
+    yvector<TLineWeightsPtr> MakeBootstrapReplicas(size_t lineCount, int replicaCount, ui64 seed) {
+        Y_ENSURE(lineCount > 0, "Can't draw lines of an empty pool");
+        TReallyFastRng32 rng(seed);
+        yvector<TLineWeightsPtr> result;
+        for (int replica : xrange(replicaCount)) {
+            Y_UNUSED(replica);
+            TAtomicSharedPtr<TLineWeights> weights = new TLineWeights(lineCount, 0);
+            for (size_t draw : xrange(lineCount)) {
+                Y_UNUSED(draw);
+                ui8& weight = (*weights)[rng.Uniform(lineCount)];
+                Y_ENSURE(weight < Max<ui8>(), "A line is drawn more than " << int(Max<ui8>()) << " times");
+                ++weight;
+            }
+            result.push_back(weights);
+        }
+        return result;
+    }
+
+    yvector<TAtomicSharedPtr<const TSelectionPoolData>> MakeBootstrapPoolData(const TBinFeatureSet& label, const TBinFeatureSet& features,
+                                                                              const yvector<TLineWeightsPtr>& replicas, int threadCount) {
+        TTraceSpan span("MakeBootstrapPoolData");
+        const TLabelCodesPtr labelCodes = MakeAtomicShared<TLabelCodes>(label);
+        TEntropyCalculator labelCalc(labelCodes->size());
+        labelCalc.AddCodes(labelCodes->GetCodes(), labelCodes->GetClassCount());
+        // No variables, only for the entropies of the bins
+        const TEntropyCalculator lines(labelCodes->size());
+        const yvector<double> labelEntropies = labelCalc.GetEntropies(replicas);
+
+        // A replica gets exactly the values of a weighted TLocalCmiSource
+        auto kernel = [&](int binIndex) {
+            const TBinRef bin = features.GetBin(binIndex);
+            const yvector<double> binEntropies = lines.GetEntropiesWithExtraBin(bin, replicas);
+            const yvector<double> jointEntropies = labelCalc.GetEntropiesWithExtraBin(bin, replicas);
+            yvector<double> result;
+            for (size_t replica : xrange(replicas.size())) {
+                result.push_back(MutualInformation(labelEntropies[replica], binEntropies[replica], jointEntropies[replica]));
+            }
+            return result;
+        };
+        yvector<yvector<double>> binInformation;
+        const yvector<int> allBins = features.AllBinIndexes();
+        ParallelForEach(allBins.begin(), allBins.end(), kernel, binInformation, threadCount);
+
+        yvector<TAtomicSharedPtr<const TSelectionPoolData>> result;
+        for (size_t replica : xrange(replicas.size())) {
+            auto data = MakeAtomicShared<TSelectionPoolData>();
+            data->LabelCodes = labelCodes;
+            for (const auto& information : binInformation) {
+                data->LabelInformation.push_back(information[replica]);
+            }
+            result.push_back(data);
+        }
+        return result;
+    }
+
+    yvector<int> BootstrapFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<TLineWeightsPtr>& replicas,
+        const TFastSelectionOptions& options)
+    {
+        Y_ENSURE(!options.CmiSource && !options.CandidateShards && !options.PoolData && options.CheckpointFile.empty(),
+                 "Bootstrap selection can't be combined with a CMI source, candidate shards, pool data or a checkpoint");
+        const auto poolData = MakeBootstrapPoolData(label, features, replicas, options.ThreadCount);
+        yvector<int> selectionCounts(features.GetFeatureCount(), 0);
+        for (size_t replica : xrange(replicas.size())) {
+            TTraceSpan span("BootstrapReplica", "replica", replica);
+            TFastSelectionOptions replicaOptions = options;
+            replicaOptions.PoolData = poolData[replica];
+            replicaOptions.CmiSource = new TLocalCmiSource(poolData[replica]->LabelCodes, features, replicas[replica]);
+            FastFeatureSelection(label, features, replicaOptions, [&selectionCounts](int featureIndex) {
+                ++selectionCounts[featureIndex];
+            });
+        }
+        return selectionCounts;
+    }
+}
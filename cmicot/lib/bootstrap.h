@@ -0,0 +1,29 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "entropy_calculator.h"
+#include "selection.h"
+
+#include <util/generic/vector.h>
+#include <util/system/types.h>
+
+namespace NCmicot {
+    /// Line weights of replicaCount bootstrap replicas of a pool of lineCount lines. Every replica
+    /// draws lineCount lines with replacement, and the weight of a line is how many times it is drawn.
+    yvector<TLineWeightsPtr> MakeBootstrapReplicas(size_t lineCount, int replicaCount, ui64 seed);
+
+    /// Pool data of the label weighted by every replica of replicas. Every bin is scanned once for
+    /// all the replicas.
+    yvector<TAtomicSharedPtr<const TSelectionPoolData>> MakeBootstrapPoolData(const TBinFeatureSet& label, const TBinFeatureSet& features,
+                                                                              const yvector<TLineWeightsPtr>& replicas, int threadCount);
+
+    /// Runs FastFeatureSelection with the lines weighted by every replica of replicas, one replica
+    /// after another, and returns how many replicas have selected every feature. The bins are
+    /// shared by all the replicas. options can't have a CMI source, candidate shards, pool data or
+    /// a checkpoint.
+    yvector<int> BootstrapFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<TLineWeightsPtr>& replicas,
+        const TFastSelectionOptions& options);
+}
@@ -0,0 +1,70 @@
+#include "bootstrap.h"
+#include "test_pool_gen.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/generic/algorithm.h>
+#include <util/random/fast.h>
+
+namespace NCmicot {
+    namespace {
+        /// Pool with every line repeated as many times as its weight.
+        TBinFeatureSet RepeatLines(const TBinFeatureSet& pool, const TLineWeights& weights) {
+            TBinFeatureSet result;
+            for (int featureIndex : xrange(pool.GetFeatureCount())) {
+                yvector<TBin> feature;
+                for (const TBin& bin : pool.GetFeature(featureIndex)) {
+                    feature.emplace_back();
+                    for (size_t i : xrange(bin.size())) {
+                        feature.back().insert(feature.back().end(), weights[i], bin[i]);
+                    }
+                }
+                result.AddFeature(std::move(feature));
+            }
+            return result;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(Bootstrap) {
+        SIMPLE_UNIT_TEST(Replicas) {
+            const yvector<TLineWeightsPtr> replicas = MakeBootstrapReplicas(100, 4, 17);
+            UNIT_ASSERT_VALUES_EQUAL(replicas.size(), 4);
+            for (const TLineWeightsPtr& weights : replicas) {
+                UNIT_ASSERT_VALUES_EQUAL(weights->size(), 100);
+                UNIT_ASSERT_VALUES_EQUAL(Accumulate(weights->begin(), weights->end(), 0), 100);
+            }
+            UNIT_ASSERT(*replicas[0] != *replicas[1]);
+            UNIT_ASSERT(*MakeBootstrapReplicas(100, 1, 17)[0] == *replicas[0]);
+        }
+
+        SIMPLE_UNIT_TEST(SameAsRepeatedLines) {
+            TReallyFastRng32 rng(20170921);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 12, binSize, {1, 4});
+            const yvector<TLineWeightsPtr> replicas = MakeBootstrapReplicas(binSize, 3, 5);
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            options.ThreadCount = 2;
+            options.FeatureCount = 4;
+            yvector<int> expected(features.GetFeatureCount(), 0);
+            const auto poolData = MakeBootstrapPoolData(label, features, replicas, 2);
+            for (size_t replica : xrange(replicas.size())) {
+                FastFeatureSelection(RepeatLines(label, *replicas[replica]), RepeatLines(features, *replicas[replica]), options,
+                                     [&expected](int featureIndex) {
+                                         ++expected[featureIndex];
+                                     });
+
+                // The first step counted for all the replicas at once gives the values of a single replica
+                TLocalCmiSource source(poolData[replica]->LabelCodes, features, replicas[replica]);
+                const yvector<int> allBins = features.AllBinIndexes();
+                UNIT_ASSERT_VALUES_EQUAL(poolData[replica]->LabelInformation, source.GetMutualInformation(allBins));
+            }
+
+            const yvector<int> selectionCounts = BootstrapFeatureSelection(label, features, replicas, options);
+            UNIT_ASSERT_VALUES_EQUAL(selectionCounts, expected);
+            UNIT_ASSERT_VALUES_EQUAL(Accumulate(selectionCounts.begin(), selectionCounts.end(), 0), 12);
+        }
+    }
+}
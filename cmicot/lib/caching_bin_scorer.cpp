@@ -1,25 +1,45 @@
 #include "caching_bin_scorer.h"
 #include "cmi_calculator.h"
-#include "entropy.h"
+#include "metrics.h"
+#include "trace.h"
 
 #include <util/generic/algorithm.h>
 #include <util/generic/xrange.h>
 
 namespace NCmicot {
     TCachingBinScorer::TCachingBinScorer(const TBinFeatureSet& label, int binCount)
-        : Label(label)
+        : TCachingBinScorer(MakeAtomicShared<TLabelCodes>(label), binCount)
+    {
+    }
+
+    TCachingBinScorer::TCachingBinScorer(TLabelCodesPtr label, int binCount, TCmiSourcePtr source)
+        : Label(std::move(label))
+        , Source(std::move(source))
+        , LabelCmi(Source ? TMaybe<TCmiCalculator>() : MakeLabelCmiCalculator(*Label))
         , Cache(binCount)
-        , LabelEntropy(Entropy(Label.AllBins()))
+        , LabelEntropy(Label->GetEntropy())
     {
     }
 
-    TBinScore TCachingBinScorer::Evaluate(TBackground background, int evalBinIndex, int stepCount) {
+    THolder<ICmiEstimator> TCachingBinScorer::MakeEstimator(const TBackground& background) const {
+        if (Source) {
+            return Source->MakeEstimator();
+        }
+        return new TLocalCmiEstimator(*LabelCmi, background.GetFeatures());
+    }
+
+    void TCachingBinScorer::RestoreCache(yvector<TBinScore> cache) {
+        Y_ENSURE(cache.size() == Cache.size(), "Cache is for " << cache.size() << " bins, while there are " << Cache.size());
+        Cache = std::move(cache);
+    }
+
+    TBinScore TCachingBinScorer::Evaluate(TBackground background, int evalBinIndex, int stepCount, yvector<double>* stepScores) {
         //    Cerr << __func__ << " " << evalBinIndex << Endl;
         auto binsToProcess = background.LastEnabled();
 
         background.SetBinEnabled(evalBinIndex, true);
 
-        if (background.EnabledBins().ysize() < stepCount + 1) {
+        if (background.EnabledBinCount() < stepCount + 1) {
             ythrow yexception() << "Not enough enabled bins, must be at least " << stepCount + 1;
         }
         if (evalBinIndex < 0 || evalBinIndex >= background.GetBinCount()) {
@@ -32,16 +52,11 @@ namespace NCmicot {
         auto& minStepsCached = Cache[evalBinIndex].MinimizingSteps;
         maxStepsCached.resize(stepCount - 1, {-1, -1.0});
         minStepsCached.resize(stepCount, {-1, 1000000.0});
+        int maxReused = 0, maxRecomputed = 0, minReused = 0, minRecomputed = 0;
         {
-            TCmiCalculator maximizerCmi(Label.AllBins().front().size());
-            for (const auto& bin : Label.AllBins()) {
-                maximizerCmi.AddFirstVariableBin(bin);
-            }
-            maximizerCmi.AddSecondVariableBin(background.GetBin(evalBinIndex));
-
-            auto binValue = [&](int binIndex) {
-                return maximizerCmi.GetValueWithConditionBin(background.GetBin(binIndex));
-            };
+            TTraceSpan span("Maximize", "bin", evalBinIndex);
+            THolder<ICmiEstimator> maximizerCmi = MakeEstimator(background);
+            maximizerCmi->AddSecondVariableBin(evalBinIndex);
 
             for (auto step : xrange(stepCount - 1)) {
                 auto enabledBins = binsToProcess.EnabledBinIndexes();
@@ -62,21 +77,26 @@ namespace NCmicot {
                 //            }
                 //            Cerr << Endl;
 
-                auto bestBinIter = MaxElementBy(enabledBins, binValue);
-                //            auto bestBinIter = ParallelMaxElementBy(enabledBins, binValue, ThreadCount);
-                Y_VERIFY(bestBinIter != enabledBins.end(), "");
+                // All the values are requested at once, so a remote source gets a single batch
+                const yvector<double> binValues = maximizerCmi->GetValuesWithConditionBins(enabledBins);
+                const auto bestValueIter = MaxElement(binValues.begin(), binValues.end());
+                Y_VERIFY(bestValueIter != binValues.end(), "");
 
-                const double binCmi = binValue(*bestBinIter);
+                const auto bestBinIter = enabledBins.begin() + (bestValueIter - binValues.begin());
+                const double binCmi = *bestValueIter;
 
                 if (binCmi > maxStepsCached[step].Cmi) {
+                    ++maxRecomputed;
                     maxStepsCached[step] = {*bestBinIter, binCmi};
                     binsToProcess = background;
                     Fill(maxStepsCached.begin() + step + 1, maxStepsCached.end(),
                          TStepResult{-1, -1.0});
                     Fill(minStepsCached.begin() + step + 1, minStepsCached.end(),
                          TStepResult{-1, 100000.0});
+                } else {
+                    ++maxReused;
                 }
-                maximizerCmi.AddConditionBin(background.GetBin(maxStepsCached[step].BinIndex));
+                maximizerCmi->AddConditionBin(maxStepsCached[step].BinIndex);
             }
         }
         //    Cerr << "Maximizers:" << Endl;
@@ -84,18 +104,12 @@ namespace NCmicot {
         //        Cerr << sr.BinIndex << '\t' << sr.Cmi << Endl;
         //    }
 
+        TTraceSpan span("Minimize", "bin", evalBinIndex);
         binsToProcess.SetBinEnabled(evalBinIndex, false);
         background.SetBinEnabled(evalBinIndex, false);
 
-        TCmiCalculator minimizerCmi(Label.AllBins().front().size());
-        for (const auto& bin : Label.AllBins()) {
-            minimizerCmi.AddFirstVariableBin(bin);
-        }
-        minimizerCmi.AddSecondVariableBin(background.GetBin(evalBinIndex));
-
-        auto binValue = [&](int binIndex) {
-            return minimizerCmi.GetValueWithConditionBin(background.GetBin(binIndex));
-        };
+        THolder<ICmiEstimator> minimizerCmi = MakeEstimator(background);
+        minimizerCmi->AddSecondVariableBin(evalBinIndex);
 
         for (auto step : xrange(stepCount)) {
             const auto enabledBins = binsToProcess.EnabledBinIndexes();
@@ -105,29 +119,38 @@ namespace NCmicot {
             //            Cerr << x << " ";
             //        }
             //        Cerr << Endl;
-            auto bestBinIter = MinElementBy(enabledBins, binValue);
-            //        auto bestBinIter = ParallelMinElementBy(enabledBins, binValue, ThreadCount);
-            Y_VERIFY(bestBinIter != enabledBins.end(), "");
+            const yvector<double> binValues = minimizerCmi->GetValuesWithConditionBins(enabledBins);
+            const auto bestValueIter = MinElement(binValues.begin(), binValues.end());
+            Y_VERIFY(bestValueIter != binValues.end(), "");
 
-            const double binCmi = binValue(*bestBinIter);
+            const auto bestBinIter = enabledBins.begin() + (bestValueIter - binValues.begin());
+            const double binCmi = *bestValueIter;
 
             if (binCmi < minStepsCached[step].Cmi) {
+                ++minRecomputed;
                 minStepsCached[step] = {*bestBinIter, binCmi};
                 Fill(minStepsCached.begin() + step + 1, minStepsCached.end(),
                      TStepResult{-1, 100000.0});
                 binsToProcess = background;
+            } else {
+                ++minReused;
             }
 
             binsToProcess.SetBinEnabled(minStepsCached[step].BinIndex, false);
             background.SetBinEnabled(minStepsCached[step].BinIndex, false);
 
-            minimizerCmi.AddConditionBin(background.GetBin(minStepsCached[step].BinIndex));
+            minimizerCmi->AddConditionBin(minStepsCached[step].BinIndex);
+            if (stepScores) {
+                // With step + 1 steps the maximizing bin of this step would never be added
+                stepScores->push_back(minimizerCmi->GetValue() / LabelEntropy);
+            }
             if (step < maxStepsCached.ysize()) {
-                minimizerCmi.AddSecondVariableBin(background.GetBin(maxStepsCached[step].BinIndex));
+                minimizerCmi->AddSecondVariableBin(maxStepsCached[step].BinIndex);
             }
         }
 
-        Cache[evalBinIndex].Score = minimizerCmi.GetValue() / LabelEntropy;
+        Cache[evalBinIndex].Score = minimizerCmi->GetValue() / LabelEntropy;
+        CountEvaluation(maxReused, maxRecomputed, minReused, minRecomputed);
         //    Cerr << "Minimizers:" << Endl;
         //    for (const auto& sr : minStepsCached) {
         //        Cerr << sr.BinIndex << '\t' << sr.Cmi << Endl;
@@ -1,16 +1,38 @@
 #pragma once
 
 #include "bin_score.h"
+#include "cmi_calculator.h"
+#include "cmi_source.h"
+#include "label_codes.h"
+
+#include <util/generic/maybe.h>
 
 namespace NCmicot {
     class TCachingBinScorer {
     public:
         TCachingBinScorer(const NCmicot::TBinFeatureSet& label, int binCount);
+        /// If source is given, CMI values are requested from it, and the background is used only
+        /// for its enabled bins.
+        TCachingBinScorer(TLabelCodesPtr label, int binCount, TCmiSourcePtr source = nullptr);
+
+        /// If stepScores is given, it receives the score with every prefix of the steps: the score
+        /// an evaluation with i + 1 steps would give is (*stepScores)[i].
+        TBinScore Evaluate(NCmicot::TBackground background, int evalBinIndex, int stepCount, yvector<double>* stepScores = nullptr);
 
-        TBinScore Evaluate(NCmicot::TBackground background, int evalBinIndex, int stepCount);
+        /// Per-bin steps found so far, which is everything needed to continue the selection later.
+        const yvector<NCmicot::TBinScore>& GetCache() const {
+            return Cache;
+        }
+
+        void RestoreCache(yvector<NCmicot::TBinScore> cache);
 
     private:
-        const NCmicot::TBinFeatureSet& Label;
+        THolder<ICmiEstimator> MakeEstimator(const NCmicot::TBackground& background) const;
+
+        TLabelCodesPtr Label;
+        TCmiSourcePtr Source;
+        /// Calculator with the label already added, copied by every local evaluation.
+        const TMaybe<TCmiCalculator> LabelCmi;
         yvector<NCmicot::TBinScore> Cache;
         const double LabelEntropy;
     };
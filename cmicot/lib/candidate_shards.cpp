@@ -0,0 +1,181 @@
+#include "candidate_shards.h"
+#include "caching_bin_scorer.h"
+#include "label_codes.h"
+#include "mutual_information_calculator.h"
+#include "trace.h"
+
+#include <library/threading/algorithm/parallel_algorithm.h>
+
+#include <util/generic/algorithm.h>
+#include <util/generic/yexception.h>
+
+namespace NCmicot {
+    namespace {
+        struct TCandidateHello {
+            i32 ShardIndex = 0;
+            i32 ShardCount = 0;
+            ui64 LineCount = 0;
+            i32 BinCount = 0;
+
+            Y_SAVELOAD_DEFINE(ShardIndex, ShardCount, LineCount, BinCount);
+        };
+
+        using ERequestKind = TCandidateShards::ERequestKind;
+
+        struct TCandidateRequest {
+            ERequestKind Kind = ERequestKind::Finish;
+            /// Features enabled since the previous request.
+            yvector<i32> EnabledFeatures;
+            i32 EvalStepCount = 0;
+
+            Y_SAVELOAD_DEFINE(Kind, EnabledFeatures, EvalStepCount);
+        };
+
+        struct TCandidateAnswer {
+            /// -1 if the worker has no candidates left.
+            i32 BinIndex = -1;
+            double Score = 0.0;
+
+            Y_SAVELOAD_DEFINE(BinIndex, Score);
+        };
+    }
+
+    TCandidateShards::TCandidateShards(ui64 lineCount, int binCount, yvector<THolder<IShardChannel>> workers)
+        : Workers(std::move(workers))
+    {
+        Y_ENSURE(!Workers.empty(), "No candidate workers");
+
+        yvector<bool> isServed(Workers.size());
+        for (auto& worker : Workers) {
+            const TCandidateHello hello = LoadShardMessage<TCandidateHello>(worker->Receive());
+            Y_ENSURE(hello.ShardCount == Workers.ysize(), "Candidate worker serves a shard of " << hello.ShardCount
+                                                                                                  << " instead of " << Workers.size());
+            Y_ENSURE(0 <= hello.ShardIndex && hello.ShardIndex < hello.ShardCount && !isServed[hello.ShardIndex],
+                     "Candidate shard " << hello.ShardIndex << " is out of range or served twice");
+            Y_ENSURE(hello.BinCount == binCount, "Candidate worker has " << hello.BinCount << " bins, while the pool has " << binCount);
+            Y_ENSURE(hello.LineCount == lineCount, "Candidate worker has " << hello.LineCount << " lines, while the pool has " << lineCount);
+            isServed[hello.ShardIndex] = true;
+        }
+    }
+
+    TCandidateShards::~TCandidateShards() {
+        try {
+            const TString finish = SaveShardMessage(TCandidateRequest());
+            for (auto& worker : Workers) {
+                worker->Send(finish);
+            }
+        } catch (...) {
+            // Workers which are already gone don't need to be stopped
+        }
+    }
+
+    void TCandidateShards::EnableFeatures(const yvector<int>& featureIndexes) {
+        PendingFeatures.insert(PendingFeatures.end(), featureIndexes.begin(), featureIndexes.end());
+    }
+
+    std::pair<int, double> TCandidateShards::GetBinWithMaximalMutualInformation() {
+        return Request(ERequestKind::MutualInformation, 0);
+    }
+
+    std::pair<int, double> TCandidateShards::GetBestBin(int evalStepCount) {
+        return Request(ERequestKind::Score, evalStepCount);
+    }
+
+    std::pair<int, double> TCandidateShards::Request(ERequestKind kind, int evalStepCount) {
+        TTraceSpan span("CandidateShardRequest");
+        TCandidateRequest request;
+        request.Kind = kind;
+        request.EnabledFeatures = std::move(PendingFeatures);
+        request.EvalStepCount = evalStepCount;
+        PendingFeatures.clear();
+        const TString message = SaveShardMessage(request);
+
+        // Everything is sent before anything is received, so the workers score concurrently
+        for (auto& worker : Workers) {
+            worker->Send(message);
+        }
+        TCandidateAnswer best;
+        for (auto& worker : Workers) {
+            const TCandidateAnswer answer = LoadShardMessage<TCandidateAnswer>(worker->Receive());
+            // Ties go to the lowest bin, as in the local selection
+            const bool isBetter = answer.BinIndex >= 0 &&
+                                  (best.BinIndex < 0 || answer.Score > best.Score ||
+                                   (answer.Score == best.Score && answer.BinIndex < best.BinIndex));
+            if (isBetter) {
+                best = answer;
+            }
+        }
+        Y_ENSURE(best.BinIndex >= 0, "Candidate workers have no candidates left");
+        return {best.BinIndex, best.Score};
+    }
+
+    void ServeCandidateShard(const TBinFeatureSet& label, const TBinFeatureSet& features, int shardIndex, int shardCount,
+                             IShardChannel& coordinator, int threadCount) {
+        Y_ENSURE(0 <= shardIndex && shardIndex < shardCount, "Candidate shard " << shardIndex << " is out of [0; " << shardCount << ")");
+        const TLabelCodesPtr labelCodes = MakeAtomicShared<TLabelCodes>(label);
+
+        TCandidateHello hello;
+        hello.ShardIndex = shardIndex;
+        hello.ShardCount = shardCount;
+        hello.LineCount = labelCodes->size();
+        hello.BinCount = features.GetBinCount();
+        coordinator.Send(SaveShardMessage(hello));
+
+        // Interleaved, so that every worker gets bins of every feature and the features which are
+        // selected early don't leave some of the workers idle
+        yvector<int> ownBins;
+        for (int binIndex = shardIndex; binIndex < features.GetBinCount(); binIndex += shardCount) {
+            ownBins.push_back(binIndex);
+        }
+
+        TBackground bg(features);
+        bg.DisableAll();
+        TCachingBinScorer binScorer(labelCodes, features.GetBinCount());
+        TMutualInformationCalculator miCalc(labelCodes->size());
+        miCalc.AddFirstVariableCodes(*labelCodes);
+
+        while (true) {
+            const TCandidateRequest request = LoadShardMessage<TCandidateRequest>(coordinator.Receive());
+            if (request.Kind == ERequestKind::Finish) {
+                return;
+            }
+            TTraceSpan span("ServeCandidateRequest");
+            if (!request.EnabledFeatures.empty()) {
+                bg.SetFeaturesEnabled(yvector<int>(request.EnabledFeatures.begin(), request.EnabledFeatures.end()));
+            }
+
+            yvector<int> candidates;
+            for (int binIndex : ownBins) {
+                if (!bg.IsFeatureEnabled(features.GetFeatureIndexByBinIndex(binIndex))) {
+                    candidates.push_back(binIndex);
+                }
+            }
+            const int stepCount = Min(bg.EnabledBinCount(), int(request.EvalStepCount));
+            auto kernel = [&](int binIndex) {
+                if (request.Kind == ERequestKind::MutualInformation) {
+                    return miCalc.GetValueWithSecondVariableBin(features.GetBin(binIndex));
+                }
+                return binScorer.Evaluate(bg, binIndex, stepCount).Score;
+            };
+            // The score of the best bin is sent too, and evaluating a bin again would change the
+            // scorer cache, so all the scores are kept
+            yvector<double> scores;
+            if (threadCount > 1 && candidates.size() > 1) {
+                ParallelForEach(candidates.begin(), candidates.end(), kernel, scores, threadCount);
+            } else {
+                scores.reserve(candidates.size());
+                for (int binIndex : candidates) {
+                    scores.push_back(kernel(binIndex));
+                }
+            }
+
+            TCandidateAnswer answer;
+            const auto best = MaxElement(scores.begin(), scores.end());
+            if (best != scores.end()) {
+                answer.BinIndex = candidates[best - scores.begin()];
+                answer.Score = *best;
+            }
+            coordinator.Send(SaveShardMessage(answer));
+        }
+    }
+}
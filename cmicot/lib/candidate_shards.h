@@ -0,0 +1,50 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "shard_channel.h"
+
+#include <util/generic/ptr.h>
+#include <util/generic/vector.h>
+
+namespace NCmicot {
+    /// Coordinator of workers which all hold the whole pool and split the candidate bins between
+    /// them: worker i of n scores the bins with binIndex % n == i. Every worker mirrors the enabled
+    /// features of the coordinator and keeps a scorer cache of its own bins, and only the best bin of
+    /// every worker is sent back, so a step costs a message per worker whatever the bin count.
+    class TCandidateShards {
+    public:
+        /// Every shard index of [0; workers.size()) must be served exactly once, by a worker with
+        /// lineCount lines and binCount bins in the layout of the coordinator's feature set.
+        TCandidateShards(ui64 lineCount, int binCount, yvector<THolder<IShardChannel>> workers);
+        /// Stops the workers.
+        ~TCandidateShards();
+
+        /// Enables the features at the workers, with a single TBackground::SetFeaturesEnabled call,
+        /// before the next step.
+        void EnableFeatures(const yvector<int>& featureIndexes);
+
+        /// Bin with the maximal mutual information with the label, and the information.
+        std::pair<int, double> GetBinWithMaximalMutualInformation();
+
+        /// Disabled bin with the maximal score of TCachingBinScorer::Evaluate with
+        /// min(enabled bin count, evalStepCount) steps, and the score.
+        std::pair<int, double> GetBestBin(int evalStepCount);
+
+        enum class ERequestKind: ui8 {
+            Finish,
+            MutualInformation,
+            Score,
+        };
+
+    private:
+        std::pair<int, double> Request(ERequestKind kind, int evalStepCount);
+
+        yvector<THolder<IShardChannel>> Workers;
+        yvector<i32> PendingFeatures;
+    };
+
+    /// Scores the candidate bins of shard shardIndex of shardCount for a coordinator until the
+    /// coordinator stops.
+    void ServeCandidateShard(const TBinFeatureSet& label, const TBinFeatureSet& features, int shardIndex, int shardCount,
+                             IShardChannel& coordinator, int threadCount);
+}
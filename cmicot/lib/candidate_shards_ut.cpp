@@ -0,0 +1,77 @@
+#include "candidate_shards.h"
+#include "selection.h"
+#include "test_pool_gen.h"
+
+#include <library/threading/future/async.h>
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+#include <util/thread/queue.h>
+
+namespace NCmicot {
+    namespace {
+        yvector<int> SelectWithCandidateShards(const TBinFeatureSet& label, const TBinFeatureSet& features,
+                                               TFastSelectionOptions options, int shardCount) {
+            yvector<THolder<IShardChannel>> workerChannels;
+            yvector<THolder<IShardChannel>> coordinatorChannels;
+            for (int i : xrange(shardCount)) {
+                Y_UNUSED(i);
+                auto channels = MakeShardChannelPair();
+                coordinatorChannels.push_back(std::move(channels.first));
+                workerChannels.push_back(std::move(channels.second));
+            }
+
+            TMtpQueue queue;
+            queue.Start(shardCount);
+            yvector<NThreading::TFuture<void>> workers;
+            // Served in reverse, as workers may connect in any order
+            for (int i : xrange(shardCount)) {
+                workers.push_back(NThreading::Async([&, i] {
+                    ServeCandidateShard(label, features, shardCount - 1 - i, shardCount, *workerChannels[i], 2);
+                }, queue));
+            }
+
+            yvector<int> selected;
+            options.CandidateShards = new TCandidateShards(label.GetBin(0).size(), features.GetBinCount(),
+                                                           std::move(coordinatorChannels));
+            FastFeatureSelection(label, features, options, [&selected](int feature) {
+                selected.push_back(feature);
+            });
+            // Stops the workers
+            options.CandidateShards.Reset(nullptr);
+            for (auto& worker : workers) {
+                worker.GetValue(TDuration::Minutes(1));
+            }
+            return selected;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(CandidateShards) {
+        SIMPLE_UNIT_TEST(SelectionMatchesLocal) {
+            TReallyFastRng32 rng(20170801);
+            const int binSize = 500;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 12, binSize, {1, 4});
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 4;
+            yvector<int> expected;
+            FastFeatureSelection(label, features, options, [&expected](int feature) {
+                expected.push_back(feature);
+            });
+
+            // Near the end some of the workers have no candidates left
+            UNIT_ASSERT_VALUES_EQUAL(SelectWithCandidateShards(label, features, options, 3), expected);
+            UNIT_ASSERT_VALUES_EQUAL(SelectWithCandidateShards(label, features, options, 1), expected);
+
+            options.InitialFeatures = {expected[2], expected[0]};
+            options.FeatureCount = 7;
+            expected.clear();
+            FastFeatureSelection(label, features, options, [&expected](int feature) {
+                expected.push_back(feature);
+            });
+            UNIT_ASSERT_VALUES_EQUAL(SelectWithCandidateShards(label, features, options, 4), expected);
+        }
+    }
+}
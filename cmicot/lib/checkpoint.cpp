@@ -0,0 +1,59 @@
+#include "checkpoint.h"
+
+#include <util/digest/murmur.h>
+#include <util/generic/yexception.h>
+#include <util/stream/file.h>
+#include <util/system/file.h>
+#include <util/system/fs.h>
+
+namespace NCmicot {
+    namespace {
+        constexpr ui32 CHECKPOINT_MAGIC = 0x544b4d43; // "CMKT"
+        constexpr ui32 CHECKPOINT_VERSION = 2;
+    }
+
+    ui64 GetPoolHash(const TLabelCodes& labelCodes, const TBinFeatureSet& features) {
+        const yvector<ui32>& codes = labelCodes.GetCodes();
+        ui64 hash = MurmurHash<ui64>(codes.data(), codes.size() * sizeof(ui32), 0);
+        yvector<ui64> words;
+        for (int binIndex : features.AllBinIndexes()) {
+            const i32 featureIndex = features.GetFeatureIndexByBinIndex(binIndex);
+            hash = MurmurHash<ui64>(&featureIndex, sizeof(featureIndex), hash);
+            const TBinRef bin = features.GetBin(binIndex);
+            words.assign((bin.size() + 63) / 64, 0);
+            bin.ForEach([&words](size_t i, bool bit) {
+                words[i / 64] |= ui64(bit) << (i % 64);
+            });
+            hash = MurmurHash<ui64>(words.data(), words.size() * sizeof(ui64), hash);
+        }
+        return hash;
+    }
+
+    void SaveCheckpoint(const TSelectionCheckpoint& checkpoint, const TString& path) {
+        const TString tmpPath = path + ".tmp";
+        {
+            TFile file(tmpPath, CreateAlways | WrOnly);
+            TFileOutput out(file);
+            ::SaveMany(&out, CHECKPOINT_MAGIC, CHECKPOINT_VERSION, checkpoint);
+            out.Finish();
+            file.Flush();
+        }
+        Y_ENSURE(NFs::Rename(tmpPath, path), "Failed to rename " << tmpPath << " to " << path);
+    }
+
+    TMaybe<TSelectionCheckpoint> LoadCheckpoint(const TString& path) {
+        if (!NFs::Exists(path)) {
+            return Nothing();
+        }
+
+        TFileInput in(path);
+        ui32 magic = 0, version = 0;
+        ::LoadMany(&in, magic, version);
+        Y_ENSURE(magic == CHECKPOINT_MAGIC, path << " is not a checkpoint file");
+        Y_ENSURE(version == CHECKPOINT_VERSION, "Checkpoint " << path << " has unsupported version " << version);
+
+        TSelectionCheckpoint result;
+        ::Load(&in, result);
+        return result;
+    }
+}
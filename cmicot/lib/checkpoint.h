@@ -0,0 +1,40 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "bin_score.h"
+#include "label_codes.h"
+
+#include <util/generic/maybe.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/ysaveload.h>
+
+namespace NCmicot {
+    /// State of FastFeatureSelection after an outer step. The background is restored by enabling
+    /// SelectedFeatures in order, the rest of the state is the caching scorer's per-bin steps.
+    struct TSelectionCheckpoint {
+        // Describe the run the checkpoint belongs to, so that it isn't resumed with another pool
+        ui64 LineCount = 0;
+        i32 FeatureCount = 0;
+        i32 BinCount = 0;
+        i32 EvalStepCount = 0;
+        ui64 PoolHash = 0;
+
+        yvector<int> SelectedFeatures;
+        yvector<TBinScore> Cache;
+
+        Y_SAVELOAD_DEFINE(LineCount, FeatureCount, BinCount, EvalStepCount, PoolHash, SelectedFeatures, Cache);
+    };
+
+    /// Hash of the label codes, the feature-bin map and the bits of every bin, so that a checkpoint
+    /// isn't resumed with another pool of the same shape. Bins which are kept elsewhere, e.g. by the
+    /// workers of a sharded pool, are empty here and don't count.
+    ui64 GetPoolHash(const TLabelCodes& labelCodes, const TBinFeatureSet& features);
+
+    /// Writes the checkpoint to a temporary file next to path and renames it over path, so that path
+    /// always holds a complete checkpoint.
+    void SaveCheckpoint(const TSelectionCheckpoint& checkpoint, const TString& path);
+
+    /// Returns Nothing() if there is no file at path.
+    TMaybe<TSelectionCheckpoint> LoadCheckpoint(const TString& path);
+}
@@ -1,36 +1,88 @@
 #include "cmi_calculator.h"
+#include "metrics.h"
 
 namespace NCmicot {
-    TCmiCalculator::TCmiCalculator(size_t binSize)
-        : FirstCondition(binSize)
-        , Condition(binSize)
-        , FirstSecondCondition(binSize)
-        , SecondCondition(binSize)
+    TCmiCalculator::TCmiCalculator(size_t binSize, TLineWeightsPtr weights)
+        : FirstCondition(binSize, weights)
+        , Condition(binSize, weights)
+        , FirstSecondCondition(binSize, weights)
+        , SecondCondition(binSize, weights)
     {
     }
 
-    void TCmiCalculator::AddFirstVariableBin(const TBin& bin) {
+    void TCmiCalculator::AddFirstVariableBin(TBinRef bin) {
         FirstCondition.AddBin(bin);
         FirstSecondCondition.AddBin(bin);
     }
 
-    void TCmiCalculator::AddSecondVariableBin(const TBin& bin) {
+    void TCmiCalculator::AddFirstVariableCodes(const TLabelCodes& codes) {
+        FirstCondition.AddCodes(codes.GetCodes(), codes.GetClassCount());
+        FirstSecondCondition.AddCodes(codes.GetCodes(), codes.GetClassCount());
+    }
+
+    void TCmiCalculator::AddSecondVariableBin(TBinRef bin) {
         SecondCondition.AddBin(bin);
         FirstSecondCondition.AddBin(bin);
     }
 
-    void TCmiCalculator::AddConditionBin(const TBin& bin) {
+    void TCmiCalculator::AddConditionBin(TBinRef bin) {
         FirstCondition.AddBin(bin);
         Condition.AddBin(bin);
         FirstSecondCondition.AddBin(bin);
         SecondCondition.AddBin(bin);
     }
 
-    double TCmiCalculator::GetValueWithConditionBin(const TBin& bin) const {
+    double TCmiCalculator::GetValueWithConditionBin(TBinRef bin) const {
+        CountCmiCall();
         return FirstCondition.GetEntropyWithExtraBin(bin) - Condition.GetEntropyWithExtraBin(bin) - FirstSecondCondition.GetEntropyWithExtraBin(bin) + SecondCondition.GetEntropyWithExtraBin(bin);
     }
 
+    yvector<double> TCmiCalculator::GetValuesWithConditionBin(TBinRef bin, NArrayRef::TConstArrayRef<const TCmiCalculator*> calculators) {
+        yvector<const TEntropyCalculator*> entropyCalculators;
+        for (const TCmiCalculator* calculator : calculators) {
+            CountCmiCall();
+            entropyCalculators.insert(entropyCalculators.end(), {&calculator->FirstCondition, &calculator->Condition,
+                                                                 &calculator->FirstSecondCondition, &calculator->SecondCondition});
+        }
+        const yvector<double> entropies = TEntropyCalculator::GetEntropiesWithExtraBin(bin, entropyCalculators);
+
+        yvector<double> result;
+        result.reserve(calculators.size());
+        for (size_t i = 0; i < calculators.size(); ++i) {
+            result.push_back(entropies[4 * i] - entropies[4 * i + 1] - entropies[4 * i + 2] + entropies[4 * i + 3]);
+        }
+        return result;
+    }
+
     double TCmiCalculator::GetValue() const {
         return FirstCondition.GetEntropy() - Condition.GetEntropy() - FirstSecondCondition.GetEntropy() + SecondCondition.GetEntropy();
     }
+
+    TCmiCounts TCmiCalculator::GetCountsWithConditionBin(TBinRef bin) const {
+        CountCmiCall();
+        return {{FirstCondition.GetValueCountsWithExtraBin(bin), Condition.GetValueCountsWithExtraBin(bin),
+                 FirstSecondCondition.GetValueCountsWithExtraBin(bin), SecondCondition.GetValueCountsWithExtraBin(bin)}};
+    }
+
+    TCmiCounts TCmiCalculator::GetCountsWithSecondBin(TBinRef bin) const {
+        CountCmiCall();
+        return {{FirstCondition.GetValueCounts(), Condition.GetValueCounts(),
+                 FirstSecondCondition.GetValueCountsWithExtraBin(bin), SecondCondition.GetValueCountsWithExtraBin(bin)}};
+    }
+
+    TCmiCounts TCmiCalculator::GetCounts() const {
+        return {{FirstCondition.GetValueCounts(), Condition.GetValueCounts(),
+                 FirstSecondCondition.GetValueCounts(), SecondCondition.GetValueCounts()}};
+    }
+
+    void AddCmiCounts(TCmiCounts& sum, const TCmiCounts& counts) {
+        for (size_t i = 0; i < sum.size(); ++i) {
+            AddValueCounts(sum[i], counts[i]);
+        }
+    }
+
+    double GetCmi(const TCmiCounts& counts, size_t totalValues) {
+        return GetEntropy(counts[0], totalValues) - GetEntropy(counts[1], totalValues) -
+               GetEntropy(counts[2], totalValues) + GetEntropy(counts[3], totalValues);
+    }
 }
@@ -2,19 +2,40 @@
 
 #include "binarize.h"
 #include "entropy_calculator.h"
+#include "label_codes.h"
+
+#include <array>
 
 namespace NCmicot {
+    /// Value counts of the four entropies a CMI value is made of, in the order of
+    /// TCmiCalculator::GetValue: first with condition, condition, first with second and condition,
+    /// second with condition.
+    using TCmiCounts = std::array<TValueCounts, 4>;
+
+    void AddCmiCounts(TCmiCounts& sum, const TCmiCounts& counts);
+    double GetCmi(const TCmiCounts& counts, size_t totalValues);
+
     class TCmiCalculator {
     public:
-        TCmiCalculator(size_t binSize);
+        /// With weights, every line counts as many times as its weight, see TLineWeights.
+        TCmiCalculator(size_t binSize, TLineWeightsPtr weights = nullptr);
 
-        void AddFirstVariableBin(const TBin& bin);
-        void AddSecondVariableBin(const TBin& bin);
-        void AddConditionBin(const TBin& bin);
+        void AddFirstVariableBin(TBinRef bin);
+        void AddFirstVariableCodes(const TLabelCodes& codes);
+        void AddSecondVariableBin(TBinRef bin);
+        void AddConditionBin(TBinRef bin);
 
-        double GetValueWithConditionBin(const TBin& bin) const;
+        double GetValueWithConditionBin(TBinRef bin) const;
+        /// GetValueWithConditionBin of every calculator of calculators, e.g. of several labels side by
+        /// side, with a single pass over the bin.
+        static yvector<double> GetValuesWithConditionBin(TBinRef bin, NArrayRef::TConstArrayRef<const TCmiCalculator*> calculators);
         double GetValue() const;
 
+        TCmiCounts GetCountsWithConditionBin(TBinRef bin) const;
+        /// Counts of the value with bin added to the second variable.
+        TCmiCounts GetCountsWithSecondBin(TBinRef bin) const;
+        TCmiCounts GetCounts() const;
+
     private:
         TEntropyCalculator FirstCondition;
         TEntropyCalculator Condition;
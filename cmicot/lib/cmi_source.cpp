@@ -0,0 +1,59 @@
+#include "cmi_source.h"
+#include "mutual_information_calculator.h"
+
+namespace NCmicot {
+    TCmiCalculator MakeLabelCmiCalculator(const TLabelCodes& label, TLineWeightsPtr weights) {
+        TCmiCalculator result(label.size(), std::move(weights));
+        result.AddFirstVariableCodes(label);
+        return result;
+    }
+
+    /* TLocalCmiEstimator */
+
+    void TLocalCmiEstimator::AddSecondVariableBin(int binIndex) {
+        Calculator.AddSecondVariableBin(Features.GetBin(binIndex));
+    }
+
+    void TLocalCmiEstimator::AddConditionBin(int binIndex) {
+        Calculator.AddConditionBin(Features.GetBin(binIndex));
+    }
+
+    yvector<double> TLocalCmiEstimator::GetValuesWithConditionBins(const yvector<int>& binIndexes) {
+        yvector<double> result;
+        result.reserve(binIndexes.size());
+        for (int binIndex : binIndexes) {
+            result.push_back(Calculator.GetValueWithConditionBin(Features.GetBin(binIndex)));
+        }
+        return result;
+    }
+
+    double TLocalCmiEstimator::GetValue() {
+        return Calculator.GetValue();
+    }
+
+    /* TLocalCmiSource */
+
+    TLocalCmiSource::TLocalCmiSource(TLabelCodesPtr label, const TBinFeatureSet& features, TLineWeightsPtr weights)
+        : Label(std::move(label))
+        , Features(features)
+        , Weights(std::move(weights))
+        , LabelCmi(MakeLabelCmiCalculator(*Label, Weights))
+    {
+    }
+
+    THolder<ICmiEstimator> TLocalCmiSource::MakeEstimator() {
+        return new TLocalCmiEstimator(LabelCmi, Features);
+    }
+
+    yvector<double> TLocalCmiSource::GetMutualInformation(const yvector<int>& binIndexes) {
+        TMutualInformationCalculator calculator(Label->size(), Weights);
+        calculator.AddFirstVariableCodes(*Label);
+
+        yvector<double> result;
+        result.reserve(binIndexes.size());
+        for (int binIndex : binIndexes) {
+            result.push_back(calculator.GetValueWithSecondVariableBin(Features.GetBin(binIndex)));
+        }
+        return result;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "cmi_calculator.h"
+#include "label_codes.h"
+
+#include <util/generic/ptr.h>
+#include <util/generic/vector.h>
+
+namespace NCmicot {
+    /// I(label; second | condition) with the second and condition variables given by bin indexes,
+    /// so that the bins don't have to be in the same process.
+    class ICmiEstimator {
+    public:
+        virtual ~ICmiEstimator() {
+        }
+
+        virtual void AddSecondVariableBin(int binIndex) = 0;
+        virtual void AddConditionBin(int binIndex) = 0;
+
+        /// Values with every bin added to the condition in turn, in the order of binIndexes.
+        virtual yvector<double> GetValuesWithConditionBins(const yvector<int>& binIndexes) = 0;
+        virtual double GetValue() = 0;
+    };
+
+    /// Makes estimators over a fixed label and a fixed set of bins.
+    class ICmiSource {
+    public:
+        virtual ~ICmiSource() {
+        }
+
+        /// Estimator with only the label added.
+        virtual THolder<ICmiEstimator> MakeEstimator() = 0;
+
+        /// Mutual information of the label with every bin, in the order of binIndexes.
+        virtual yvector<double> GetMutualInformation(const yvector<int>& binIndexes) = 0;
+    };
+
+    using TCmiSourcePtr = TAtomicSharedPtr<ICmiSource>;
+
+    /// Estimator over bins of the current process.
+    class TLocalCmiEstimator: public ICmiEstimator {
+    public:
+        TLocalCmiEstimator(TCmiCalculator calculator, const TBinFeatureSet& features)
+            : Calculator(std::move(calculator))
+            , Features(features)
+        {
+        }
+
+        void AddSecondVariableBin(int binIndex) override;
+        void AddConditionBin(int binIndex) override;
+        yvector<double> GetValuesWithConditionBins(const yvector<int>& binIndexes) override;
+        double GetValue() override;
+
+    private:
+        TCmiCalculator Calculator;
+        const TBinFeatureSet& Features;
+    };
+
+    class TLocalCmiSource: public ICmiSource {
+    public:
+        /// With weights, every line counts as many times as its weight, see TLineWeights.
+        TLocalCmiSource(TLabelCodesPtr label, const TBinFeatureSet& features, TLineWeightsPtr weights = nullptr);
+
+        THolder<ICmiEstimator> MakeEstimator() override;
+        yvector<double> GetMutualInformation(const yvector<int>& binIndexes) override;
+
+    private:
+        TLabelCodesPtr Label;
+        const TBinFeatureSet& Features;
+        TLineWeightsPtr Weights;
+        const TCmiCalculator LabelCmi;
+    };
+
+    TCmiCalculator MakeLabelCmiCalculator(const TLabelCodes& label, TLineWeightsPtr weights = nullptr);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "bin.h"
+
 #include <util/generic/vector.h>
 #include <util/generic/xrange.h>
 #include <util/system/yassert.h>
@@ -22,6 +24,21 @@ namespace NCmicot {
             }
         }
 
+        inline void Flatten(yvector<ui64>& result, TBinRef bin) {
+            if (result.empty()) {
+                result.resize(bin.size(), 0);
+            }
+
+            bin.ForEach([&result](size_t i, bool bit) {
+                if (i < result.size()) {
+                    result[i] <<= 1;
+                    if (bit) {
+                        result[i] |= 1;
+                    }
+                }
+            });
+        }
+
         inline void FlattenBins(yvector<ui64>&) {
         }
 
@@ -38,6 +55,12 @@ namespace NCmicot {
             Impl::Flatten(result, bin);
             FlattenBins(result, args...);
         }
+
+        template <typename... Args>
+        void FlattenBins(yvector<ui64>& result, const TBinRef& bin, const Args&... args) {
+            Impl::Flatten(result, bin);
+            FlattenBins(result, args...);
+        }
     }
 
     template <typename... Args>
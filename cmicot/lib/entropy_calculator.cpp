@@ -1,6 +1,9 @@
 #include "entropy_calculator.h"
+#include "metrics.h"
+#include "perf_counters.h"
 
 #include <util/generic/algorithm.h>
+#include <util/generic/bitops.h>
 #include <util/generic/ymath.h>
 #include <util/system/yassert.h>
 
@@ -10,7 +13,9 @@ namespace NCmicot {
     namespace {
         THolder<IFrequencyCounter> BuildFrequencyCounter(ui64 minValue, ui64 maxValue) {
             const auto rangeSize = maxValue - minValue + 1;
-            if (rangeSize > (1 << 22)) {
+            const bool useHashMap = rangeSize > (1 << 22);
+            CountFrequencyCounter(useHashMap);
+            if (useHashMap) {
                 return new THashMapCounter;
             } else {
                 return new TVectorCounter(minValue, maxValue);
@@ -20,48 +25,191 @@ namespace NCmicot {
 
     /* TEntropyCalculator */
 
-    TEntropyCalculator::TEntropyCalculator(size_t binSize)
-        : BinCount(0)
+    TEntropyCalculator::TEntropyCalculator(size_t binSize, TLineWeightsPtr weights)
+        : UsedBitCount(0)
         , Values(binSize, 0)
+        , Weights(std::move(weights))
+        , TotalWeight(binSize)
     {
+        if (Weights) {
+            Y_VERIFY(Weights->size() == binSize, "Value size = %lu, weight count = %lu", binSize, Weights->size());
+            TotalWeight = Accumulate(Weights->begin(), Weights->end(), size_t(0));
+        }
     }
 
-    void TEntropyCalculator::AddBin(const TBin& bin) {
+    void TEntropyCalculator::AddBin(TBinRef bin) {
+        TPerfRegionGuard perfRegion(EPerfRegion::CodeBuilding);
         Y_VERIFY(bin.size() == Values.size(), "Value size = %lu, bin size = %lu", Values.size(), bin.size());
-        Y_VERIFY(++BinCount <= MAX_BIN_COUNT, "You can use no more than %d bins", MAX_BIN_COUNT);
+        Y_VERIFY(++UsedBitCount <= MAX_BIN_COUNT, "You can use no more than %d bins", MAX_BIN_COUNT);
 
-        for (size_t i = 0; i < bin.size(); ++i) {
+        bin.ForEach([this](size_t i, bool bit) {
             Values[i] <<= 1;
-            if (bin[i]) {
+            if (bit) {
                 Values[i] |= 1;
             }
+        });
+    }
+
+    void TEntropyCalculator::AddCodes(const yvector<ui32>& codes, ui32 cardinality) {
+        TPerfRegionGuard perfRegion(EPerfRegion::CodeBuilding);
+        Y_VERIFY(codes.size() == Values.size(), "Value size = %lu, code count = %lu", Values.size(), codes.size());
+        Y_VERIFY(cardinality > 0, "Cardinality must be positive");
+
+        UsedBitCount += MostSignificantBit(cardinality) + (IsPowerOf2(cardinality) ? 0 : 1);
+        Y_VERIFY(UsedBitCount <= MAX_BIN_COUNT, "You can use no more than %d bits", MAX_BIN_COUNT);
+
+        for (size_t i = 0; i < codes.size(); ++i) {
+            Values[i] = Values[i] * cardinality + codes[i];
         }
     }
 
     double TEntropyCalculator::GetEntropy() const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        return CountValues()->GetEntropy(TotalWeight);
+    }
+
+    double TEntropyCalculator::GetEntropyWithExtraBin(TBinRef bin) const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        return CountValuesWithExtraBin(bin)->GetEntropy(TotalWeight);
+    }
+
+    TValueCounts TEntropyCalculator::GetValueCounts() const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        return CountValues()->GetValueCounts();
+    }
+
+    TValueCounts TEntropyCalculator::GetValueCountsWithExtraBin(TBinRef bin) const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        return CountValuesWithExtraBin(bin)->GetValueCounts();
+    }
+
+    THolder<IFrequencyCounter> TEntropyCalculator::CountValues() const {
         decltype(Values.begin()) minIter, maxIter;
         std::tie(minIter, maxIter) = MinMaxElement(Values.begin(), Values.end());
         auto freqCounter = BuildFrequencyCounter(*minIter, *maxIter);
 
-        for (auto x : Values) {
-            freqCounter->Add(x);
+        if (Weights) {
+            for (size_t i = 0; i < Values.size(); ++i) {
+                if (const ui8 weight = (*Weights)[i]) {
+                    freqCounter->Add(Values[i], weight);
+                }
+            }
+        } else {
+            for (auto x : Values) {
+                freqCounter->Add(x);
+            }
         }
 
-        return freqCounter->GetEntropy(Values.size());
+        return freqCounter;
     }
 
-    double TEntropyCalculator::GetEntropyWithExtraBin(const TBin& bin) const {
+    THolder<IFrequencyCounter> TEntropyCalculator::CountValuesWithExtraBin(TBinRef bin) const {
         Y_VERIFY(bin.size() == Values.size(), "Value size = %lu, bin size = %lu", Values.size(), bin.size());
 
         decltype(Values.begin()) minIter, maxIter;
         std::tie(minIter, maxIter) = MinMaxElement(Values.begin(), Values.end());
         auto freqCounter = BuildFrequencyCounter(2 * *minIter, 2 * *maxIter + 1);
 
-        for (size_t i = 0; i < bin.size(); ++i) {
-            freqCounter->Add(2 * Values[i] + bin[i]);
+        IFrequencyCounter& counter = *freqCounter;
+        if (Weights) {
+            const TLineWeights& weights = *Weights;
+            bin.ForEach([this, &counter, &weights](size_t i, bool bit) {
+                if (const ui8 weight = weights[i]) {
+                    counter.Add(2 * Values[i] + bit, weight);
+                }
+            });
+        } else {
+            bin.ForEach([this, &counter](size_t i, bool bit) {
+                counter.Add(2 * Values[i] + bit);
+            });
+        }
+
+        return freqCounter;
+    }
+
+    yvector<double> TEntropyCalculator::GetEntropies(NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas) const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        decltype(Values.begin()) minIter, maxIter;
+        std::tie(minIter, maxIter) = MinMaxElement(Values.begin(), Values.end());
+        return GetReplicaEntropies(*minIter, *maxIter, replicas, [this](auto&& add) {
+            for (size_t i = 0; i < Values.size(); ++i) {
+                add(i, Values[i]);
+            }
+        });
+    }
+
+    yvector<double> TEntropyCalculator::GetEntropiesWithExtraBin(TBinRef bin, NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas) const {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        Y_VERIFY(bin.size() == Values.size(), "Value size = %lu, bin size = %lu", Values.size(), bin.size());
+        decltype(Values.begin()) minIter, maxIter;
+        std::tie(minIter, maxIter) = MinMaxElement(Values.begin(), Values.end());
+        return GetReplicaEntropies(2 * *minIter, 2 * *maxIter + 1, replicas, [this, bin](auto&& add) {
+            bin.ForEach([this, &add](size_t i, bool bit) {
+                add(i, 2 * Values[i] + bit);
+            });
+        });
+    }
+
+    yvector<double> TEntropyCalculator::GetEntropiesWithExtraBin(TBinRef bin, NArrayRef::TConstArrayRef<const TEntropyCalculator*> calculators) {
+        TPerfRegionGuard perfRegion(EPerfRegion::EntropyCounting);
+        yvector<THolder<IFrequencyCounter>> counters;
+        yvector<const ui64*> values;
+        yvector<const ui8*> weights;
+        for (const TEntropyCalculator* calculator : calculators) {
+            const yvector<ui64>& calculatorValues = calculator->Values;
+            Y_VERIFY(bin.size() == calculatorValues.size(), "Value size = %lu, bin size = %lu", calculatorValues.size(), bin.size());
+            decltype(calculatorValues.begin()) minIter, maxIter;
+            std::tie(minIter, maxIter) = MinMaxElement(calculatorValues.begin(), calculatorValues.end());
+            counters.push_back(BuildFrequencyCounter(2 * *minIter, 2 * *maxIter + 1));
+            values.push_back(calculatorValues.data());
+            weights.push_back(calculator->Weights ? calculator->Weights->data() : nullptr);
+        }
+
+        bin.ForEach([&](size_t i, bool bit) {
+            for (size_t k = 0; k < counters.size(); ++k) {
+                if (!weights[k]) {
+                    counters[k]->Add(2 * values[k][i] + bit);
+                } else if (const ui8 weight = weights[k][i]) {
+                    counters[k]->Add(2 * values[k][i] + bit, weight);
+                }
+            }
+        });
+
+        yvector<double> result;
+        result.reserve(counters.size());
+        for (size_t k = 0; k < counters.size(); ++k) {
+            result.push_back(counters[k]->GetEntropy(calculators[k]->TotalWeight));
+        }
+        return result;
+    }
+
+    template <class TForEachValue>
+    yvector<double> TEntropyCalculator::GetReplicaEntropies(ui64 minValue, ui64 maxValue, NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas,
+                                                            TForEachValue forEachValue) const {
+        yvector<THolder<IFrequencyCounter>> counters;
+        yvector<const ui8*> weights;
+        yvector<size_t> totalWeights(replicas.size(), 0);
+        for (const TLineWeightsPtr& replica : replicas) {
+            Y_VERIFY(replica->size() == Values.size(), "Value size = %lu, weight count = %lu", Values.size(), replica->size());
+            counters.push_back(BuildFrequencyCounter(minValue, maxValue));
+            weights.push_back(replica->data());
         }
 
-        return freqCounter->GetEntropy(Values.size());
+        forEachValue([&](size_t i, ui64 value) {
+            for (size_t replica = 0; replica < counters.size(); ++replica) {
+                if (const ui8 weight = weights[replica][i]) {
+                    counters[replica]->Add(value, weight);
+                    totalWeights[replica] += weight;
+                }
+            }
+        });
+
+        yvector<double> result;
+        result.reserve(counters.size());
+        for (size_t replica = 0; replica < counters.size(); ++replica) {
+            result.push_back(counters[replica]->GetEntropy(totalWeights[replica]));
+        }
+        return result;
     }
 
     /* TVectorCounter */
@@ -76,6 +224,10 @@ namespace NCmicot {
         ++ValueCount[value - MinValue];
     }
 
+    void TVectorCounter::Add(ui64 value, ui64 count) {
+        ValueCount[value - MinValue] += count;
+    }
+
     double TVectorCounter::GetEntropy(size_t totalValues) const {
         double result = 0.0;
         for (auto kv : ValueCount) {
@@ -86,12 +238,26 @@ namespace NCmicot {
         return -result / totalValues;
     }
 
+    TValueCounts TVectorCounter::GetValueCounts() const {
+        TValueCounts result;
+        for (size_t i = 0; i < ValueCount.size(); ++i) {
+            if (ValueCount[i] > 0) {
+                result.emplace_back(MinValue + i, ValueCount[i]);
+            }
+        }
+        return result;
+    }
+
     /* THashMapCounter */
 
     void THashMapCounter::Add(ui64 value) {
         ++ValueCount[value];
     }
 
+    void THashMapCounter::Add(ui64 value, ui64 count) {
+        ValueCount[value] += count;
+    }
+
     double THashMapCounter::GetEntropy(size_t totalValues) const {
         double result = 0.0;
         for (const auto& kv : ValueCount) {
@@ -99,4 +265,41 @@ namespace NCmicot {
         }
         return -result / totalValues;
     }
+
+    TValueCounts THashMapCounter::GetValueCounts() const {
+        TValueCounts result(ValueCount.begin(), ValueCount.end());
+        Sort(result.begin(), result.end());
+        return result;
+    }
+
+    /* Value counts */
+
+    void AddValueCounts(TValueCounts& sum, const TValueCounts& counts) {
+        TValueCounts result;
+        result.reserve(sum.size() + counts.size());
+        auto left = sum.begin();
+        auto right = counts.begin();
+        while (left != sum.end() || right != counts.end()) {
+            if (right == counts.end() || (left != sum.end() && left->first < right->first)) {
+                result.push_back(*left++);
+            } else if (left == sum.end() || right->first < left->first) {
+                result.push_back(*right++);
+            } else {
+                result.emplace_back(left->first, left->second + right->second);
+                ++left;
+                ++right;
+            }
+        }
+        sum = std::move(result);
+    }
+
+    double GetEntropy(const TValueCounts& counts, size_t totalValues) {
+        // Ascending values, the summation order of TVectorCounter, so merged shards give exactly the
+        // local value counted by it. THashMapCounter sums in hash order and may differ in the last bits
+        double result = 0.0;
+        for (const auto& valueAndCount : counts) {
+            result += valueAndCount.second * Log2(1.0 * valueAndCount.second / totalValues);
+        }
+        return -result / totalValues;
+    }
 }
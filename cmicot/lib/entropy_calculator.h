@@ -2,24 +2,66 @@
 
 #include "binarize.h"
 
+#include <util/generic/array_ref.h>
+#include <util/generic/ptr.h>
 #include <util/generic/vector.h>
 #include <util/system/types.h>
 
+#include <utility>
+
 namespace NCmicot {
+    /// Frequencies of values as (value, count) pairs sorted by value. Frequencies of disjoint sets
+    /// of lines add up, so the counts of pool shards can be merged before the entropy is computed.
+    using TValueCounts = yvector<std::pair<ui64, ui64>>;
+
+    /// Adds counts to sum, both sorted by value.
+    void AddValueCounts(TValueCounts& sum, const TValueCounts& counts);
+    double GetEntropy(const TValueCounts& counts, size_t totalValues);
+
+    /// Integer weights of the lines, e.g. how many times a bootstrap replica has drawn every line.
+    /// A line of weight w counts as w copies of it.
+    using TLineWeights = yvector<ui8>;
+    using TLineWeightsPtr = TAtomicSharedPtr<const TLineWeights>;
+
+    struct IFrequencyCounter;
+
     class TEntropyCalculator {
     public:
-        TEntropyCalculator(size_t binSize);
+        /// Every line is counted once without weights.
+        TEntropyCalculator(size_t binSize, TLineWeightsPtr weights = nullptr);
 
-        void AddBin(const TBin& bin);
+        void AddBin(TBinRef bin);
+        /// Appends a digit of radix cardinality to every value, codes must be in [0; cardinality).
+        void AddCodes(const yvector<ui32>& codes, ui32 cardinality);
 
         double GetEntropy() const;
-        double GetEntropyWithExtraBin(const TBin& bin) const;
+        double GetEntropyWithExtraBin(TBinRef bin) const;
+
+        TValueCounts GetValueCounts() const;
+        TValueCounts GetValueCountsWithExtraBin(TBinRef bin) const;
+
+        /// Entropies with the lines weighted by each of replicas in turn, counted in a single pass
+        /// over the values. Weights of the calculator itself are ignored.
+        yvector<double> GetEntropies(NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas) const;
+        yvector<double> GetEntropiesWithExtraBin(TBinRef bin, NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas) const;
+        /// GetEntropyWithExtraBin of every calculator of calculators, e.g. of several labels side by
+        /// side, counted in a single pass over the bin.
+        static yvector<double> GetEntropiesWithExtraBin(TBinRef bin, NArrayRef::TConstArrayRef<const TEntropyCalculator*> calculators);
 
         static constexpr int MAX_BIN_COUNT = 64;
 
     private:
-        int BinCount;
+        THolder<IFrequencyCounter> CountValues() const;
+        THolder<IFrequencyCounter> CountValuesWithExtraBin(TBinRef bin) const;
+        /// forEachValue calls its argument with every line index and its value.
+        template <class TForEachValue>
+        yvector<double> GetReplicaEntropies(ui64 minValue, ui64 maxValue, NArrayRef::TConstArrayRef<TLineWeightsPtr> replicas,
+                                            TForEachValue forEachValue) const;
+
+        int UsedBitCount;
         yvector<ui64> Values;
+        TLineWeightsPtr Weights;
+        size_t TotalWeight;
     };
 
     struct IFrequencyCounter {
@@ -27,14 +69,19 @@ namespace NCmicot {
         }
 
         virtual void Add(ui64 value) = 0;
+        /// Adds count occurrences of value, count must be positive.
+        virtual void Add(ui64 value, ui64 count) = 0;
         virtual double GetEntropy(size_t totalValues) const = 0;
+        virtual TValueCounts GetValueCounts() const = 0;
     };
 
     class TVectorCounter: public IFrequencyCounter {
     public:
         TVectorCounter(ui64 minValue, ui64 maxValue);
         void Add(ui64 value) override;
+        void Add(ui64 value, ui64 count) override;
         double GetEntropy(size_t totalValues) const override;
+        TValueCounts GetValueCounts() const override;
 
     private:
         ui64 MinValue;
@@ -44,7 +91,9 @@ namespace NCmicot {
     class THashMapCounter: public IFrequencyCounter {
     public:
         void Add(ui64 value) override;
+        void Add(ui64 value, ui64 count) override;
         double GetEntropy(size_t totalValues) const override;
+        TValueCounts GetValueCounts() const override;
 
     private:
         yhash<ui64, size_t> ValueCount;
@@ -83,6 +83,71 @@ namespace NCmicot {
             UNIT_ASSERT_NO_EXCEPTION(ec.GetEntropy());
         }
 
+        SIMPLE_UNIT_TEST(CodesAreEquivalentToBins) {
+            const int binSize = 1000;
+            TReallyFastRng32 rng(20170412);
+
+            const TBin first = RandomBin(binSize, rng);
+            const TBin second = RandomBin(binSize, rng);
+            yvector<ui32> codes;
+            for (int i : xrange(binSize)) {
+                codes.push_back(2 * first[i] + second[i]);
+            }
+
+            TEntropyCalculator byBins(binSize);
+            byBins.AddBin(first);
+            byBins.AddBin(second);
+
+            TEntropyCalculator byCodes(binSize);
+            byCodes.AddCodes(codes, 4);
+
+            UNIT_ASSERT_DOUBLES_EQUAL(byBins.GetEntropy(), byCodes.GetEntropy(), 1e-8);
+            const TBin extra = RandomBin(binSize, rng);
+            UNIT_ASSERT_DOUBLES_EQUAL(byBins.GetEntropyWithExtraBin(extra), byCodes.GetEntropyWithExtraBin(extra), 1e-8);
+        }
+
+        SIMPLE_UNIT_TEST(WeightsAreEquivalentToRepeatedLines) {
+            const int binSize = 500;
+            TReallyFastRng32 rng(20170921);
+
+            yvector<TLineWeightsPtr> replicas;
+            yvector<TBin> firstBins(3), secondBins(3), extraBins(3);
+            const TBin first = RandomBin(binSize, rng);
+            const TBin second = RandomBin(binSize, rng);
+            const TBin extra = RandomBin(binSize, rng);
+            for (int replica : xrange(3)) {
+                auto weights = MakeAtomicShared<TLineWeights>();
+                for (int i : xrange(binSize)) {
+                    weights->push_back(rng.Uniform(4));
+                    firstBins[replica].insert(firstBins[replica].end(), weights->back(), first[i]);
+                    secondBins[replica].insert(secondBins[replica].end(), weights->back(), second[i]);
+                    extraBins[replica].insert(extraBins[replica].end(), weights->back(), extra[i]);
+                }
+                replicas.push_back(weights);
+            }
+
+            TEntropyCalculator unweighted(binSize);
+            unweighted.AddBin(first);
+            unweighted.AddBin(second);
+            const yvector<double> entropies = unweighted.GetEntropies(replicas);
+            const yvector<double> entropiesWithExtraBin = unweighted.GetEntropiesWithExtraBin(extra, replicas);
+            for (int replica : xrange(3)) {
+                TEntropyCalculator weighted(binSize, replicas[replica]);
+                weighted.AddBin(first);
+                weighted.AddBin(second);
+
+                TEntropyCalculator repeated(firstBins[replica].size());
+                repeated.AddBin(firstBins[replica]);
+                repeated.AddBin(secondBins[replica]);
+
+                // Same counts in the same order, so the values are exactly equal
+                UNIT_ASSERT_VALUES_EQUAL(weighted.GetEntropy(), repeated.GetEntropy());
+                UNIT_ASSERT_VALUES_EQUAL(weighted.GetEntropyWithExtraBin(extra), repeated.GetEntropyWithExtraBin(extraBins[replica]));
+                UNIT_ASSERT_VALUES_EQUAL(entropies[replica], weighted.GetEntropy());
+                UNIT_ASSERT_VALUES_EQUAL(entropiesWithExtraBin[replica], weighted.GetEntropyWithExtraBin(extra));
+            }
+        }
+
         SIMPLE_UNIT_TEST(FrequencyCountersGiveSameResults) {
             const ui64 minValue = 13574;
             const ui64 maxValue = minValue + 1000000;
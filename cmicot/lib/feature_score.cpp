@@ -7,10 +7,9 @@
 namespace NCmicot {
     TCmimScore GetCmimScore(const TBinFeatureSet& label, TBackground background, int featureIndex,
                             int threadCount) {
-        TCmiCalculator cmiCalc(label.GetBin(0).size());
-        for (const TBin& labelBin : label.AllBins()) {
-            cmiCalc.AddFirstVariableBin(labelBin);
-        }
+        const TLabelCodes labelCodes(label);
+        TCmiCalculator cmiCalc(labelCodes.size());
+        cmiCalc.AddFirstVariableCodes(labelCodes);
 
         for (int binIndex : background.GetFeatureBinIndexes(featureIndex)) {
             cmiCalc.AddSecondVariableBin(background.GetBin(binIndex));
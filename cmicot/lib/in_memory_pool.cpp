@@ -0,0 +1,98 @@
+#include "in_memory_pool.h"
+#include "options.h"
+#include "trace.h"
+
+#include <library/grid_creator/binarization.h>
+#include <library/threading/algorithm/parallel_algorithm.h>
+
+#include <util/generic/maybe.h>
+#include <util/generic/yexception.h>
+
+namespace NCmicot {
+    TInMemoryPool::TInMemoryPool(NArrayRef::TConstArrayRef<float> label, const TInMemoryBinarization& binarization)
+        : Binarization(binarization)
+        , Binarizer(CreateBinarizer(binarization.Binarizer))
+        , LineCount(label.size())
+    {
+        Y_ENSURE(LineCount > 0, "Pool has no lines");
+        Y_ENSURE(Binarization.BorderCount > 0 && Binarization.ThreadCount > 0, "Border and thread counts should be positive");
+        Label = TBinFeatureSet(BinarizeFeature(label, [this](yvector<float>& values) {
+            return Binarizer->BestSplit(values, Binarization.BorderCount);
+        }));
+    }
+
+    TInMemoryPool::~TInMemoryPool() = default;
+
+    int TInMemoryPool::AddFloatFeatures(NArrayRef::TConstArrayRef<const float*> columns) {
+        const int firstFeature = Features.GetFeatureCount();
+        auto borderBuilder = [this](yvector<float>& values) {
+            return Binarizer->BestSplit(values, Binarization.BorderCount);
+        };
+        auto column = [&](size_t index) {
+            Y_ENSURE(columns[index], "Column " << index << " is null");
+            return NArrayRef::TConstArrayRef<float>(columns[index], LineCount);
+        };
+
+        if (Binarization.FeatureStorage == EFeatureStorage::Levels) {
+            yvector<TLevelFeature> levelFeatures;
+            auto kernel = [&](size_t index) {
+                TTraceSpan span("BinarizeColumn", "column", index);
+                return BinarizeFeatureToLevels(column(index), borderBuilder);
+            };
+            ParallelForEach(columns.size(), kernel, levelFeatures, Binarization.ThreadCount);
+            for (auto& feature : levelFeatures) {
+                Features.AddLevelFeature(std::move(feature));
+            }
+        } else {
+            yvector<yvector<TBin>> binarizedFeatures;
+            auto kernel = [&](size_t index) {
+                TTraceSpan span("BinarizeColumn", "column", index);
+                return BinarizeFeature(column(index), borderBuilder);
+            };
+            ParallelForEach(columns.size(), kernel, binarizedFeatures, Binarization.ThreadCount);
+            for (auto& feature : binarizedFeatures) {
+                Features.AddFeature(std::move(feature));
+            }
+        }
+        return firstFeature;
+    }
+
+    int TInMemoryPool::AddPackedFeature(NArrayRef::TConstArrayRef<const ui64*> bins) {
+        Y_ENSURE(!bins.empty(), "Packed feature has no bins");
+        yvector<TBin> feature;
+        feature.reserve(bins.size());
+        for (const ui64* words : bins) {
+            Y_ENSURE(words, "Packed bin is null");
+            feature.push_back(UnpackBin(words, LineCount));
+        }
+        return Features.AddFeature(std::move(feature));
+    }
+
+    void SelectFeatures(const TInMemoryPool& pool, TFastSelectionOptions options,
+                        std::function<void(const TSelectionStepMetrics&)> onFeatureSelected) {
+        Y_ENSURE(pool.GetFeatures().GetFeatureCount() > 0, "Pool has no features");
+
+        // A feature is chosen by a step if the step metrics come right after it is selected
+        int selectedCount = 0;
+        TMaybe<int> pending;
+        auto reportPending = [&] {
+            if (pending) {
+                TSelectionStepMetrics metrics;
+                metrics.Step = selectedCount;
+                metrics.SelectedFeature = *pending;
+                pending.Clear();
+                onFeatureSelected(metrics);
+            }
+        };
+        options.OnStepFinished = [&](const TSelectionStepMetrics& metrics) {
+            pending.Clear();
+            onFeatureSelected(metrics);
+        };
+        FastFeatureSelection(pool.GetLabel(), pool.GetFeatures(), options, [&](int featureIndex) {
+            reportPending();
+            ++selectedCount;
+            pending = featureIndex;
+        });
+        reportPending();
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "binarize.h"
+#include "bin_feature_set.h"
+#include "metrics.h"
+#include "selection.h"
+
+#include <util/generic/array_ref.h>
+#include <util/generic/ptr.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+
+#include <functional>
+
+namespace NSplitSelection {
+    class IBinarizer;
+}
+
+namespace NCmicot {
+    /// Binarization of the float columns of a TInMemoryPool, as -x, --binarization, --feature-storage
+    /// and --thread-count of the command line.
+    struct TInMemoryBinarization {
+        TString Binarizer = "medianPlusUniform";
+        int BorderCount = 10;
+        EFeatureStorage FeatureStorage = EFeatureStorage::Bins;
+        int ThreadCount = 1;
+    };
+
+    /// Pool built from columns owned by the caller, for embedding the selection without pool files.
+    /// Every column is binarized or unpacked straight from the caller's buffer when it is added, and
+    /// the buffer isn't used afterwards.
+    class TInMemoryPool {
+    public:
+        /// The label is binarized like a feature.
+        TInMemoryPool(NArrayRef::TConstArrayRef<float> label, const TInMemoryBinarization& binarization);
+        ~TInMemoryPool();
+
+        /// Binarizes the columns in parallel and adds them as features, in this order. Every column
+        /// has a value per line. Returns the index of the first added feature.
+        int AddFloatFeatures(NArrayRef::TConstArrayRef<const float*> columns);
+
+        /// Adds a feature with already binarized bins. Every bin has a bit per line, packed into
+        /// 64-bit words: line i is bit i % 64 of word i / 64. Returns the index of the feature.
+        int AddPackedFeature(NArrayRef::TConstArrayRef<const ui64*> bins);
+
+        ui64 GetLineCount() const {
+            return LineCount;
+        }
+
+        const TBinFeatureSet& GetLabel() const {
+            return Label;
+        }
+
+        const TBinFeatureSet& GetFeatures() const {
+            return Features;
+        }
+
+    private:
+        TInMemoryBinarization Binarization;
+        THolder<NSplitSelection::IBinarizer> Binarizer;
+        ui64 LineCount;
+        TBinFeatureSet Label;
+        TBinFeatureSet Features;
+    };
+
+    /// Runs FastFeatureSelection over the pool and calls onFeatureSelected with the metrics of every
+    /// step right after it, including the score and the wall time. OnStepFinished of options is
+    /// replaced. Kernels are counted only if options.CountKernels is set, and only those of this
+    /// call, so several calls may run at once. Features which aren't chosen by a step of this run
+    /// (initial features and the ones restored from a checkpoint) are reported with Score and
+    /// WallSeconds of 0.
+    void SelectFeatures(const TInMemoryPool& pool, TFastSelectionOptions options,
+                        std::function<void(const TSelectionStepMetrics&)> onFeatureSelected);
+}
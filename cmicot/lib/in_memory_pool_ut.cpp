@@ -0,0 +1,160 @@
+#include "in_memory_pool.h"
+#include "test_pool_gen.h"
+
+#include <library/grid_creator/binarization.h>
+#include <library/threading/future/async.h>
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+#include <util/thread/queue.h>
+
+namespace NCmicot {
+    namespace {
+        /// Float columns where the label is a noisy function of the first two features.
+        yvector<yvector<float>> MakeColumns(TReallyFastRng32& rng, int lineCount, int featureCount) {
+            yvector<yvector<float>> columns(featureCount + 1, yvector<float>(lineCount));
+            for (int line : xrange(lineCount)) {
+                for (int column : xrange(1, featureCount + 1)) {
+                    columns[column][line] = rng.GenRandReal1();
+                }
+                columns[0][line] = (columns[1][line] > 0.5) + (columns[2][line] > 0.3) + 0.5 * rng.GenRandReal1();
+            }
+            return columns;
+        }
+
+        yvector<int> Select(const TInMemoryPool& pool, yvector<TSelectionStepMetrics>* steps = nullptr, bool countKernels = false) {
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            options.FeatureCount = 4;
+            options.ThreadCount = 2;
+            options.CountKernels = countKernels;
+            yvector<int> result;
+            SelectFeatures(pool, options, [&](const TSelectionStepMetrics& metrics) {
+                result.push_back(metrics.SelectedFeature);
+                if (steps) {
+                    steps->push_back(metrics);
+                }
+            });
+            return result;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(InMemoryPool) {
+        SIMPLE_UNIT_TEST(SameAsRawPool) {
+            TReallyFastRng32 rng(20170903);
+            const yvector<yvector<float>> columns = MakeColumns(rng, 500, 6);
+
+            yvector<yvector<double>> rawPool;
+            for (const auto& column : columns) {
+                rawPool.emplace_back(column.begin(), column.end());
+            }
+            auto borderBuilder = [](yvector<float>& values) {
+                return NSplitSelection::TMedianBinarizer().BestSplit(values, 4, false);
+            };
+            const auto expectedPool = BinarizeRawPool(rawPool, borderBuilder, 1);
+            yvector<int> expected;
+            FastFeatureSelection(expectedPool.first, expectedPool.second, 3, 1, 4, [&expected](int feature) {
+                expected.push_back(feature);
+            });
+
+            for (EFeatureStorage storage : {EFeatureStorage::Bins, EFeatureStorage::Levels}) {
+                TInMemoryBinarization binarization;
+                binarization.Binarizer = "median";
+                binarization.BorderCount = 4;
+                binarization.FeatureStorage = storage;
+                binarization.ThreadCount = 2;
+                TInMemoryPool pool(columns[0], binarization);
+                const yvector<const float*> features = {columns[1].data(), columns[2].data(), columns[3].data()};
+                UNIT_ASSERT_VALUES_EQUAL(pool.AddFloatFeatures(features), 0);
+                const yvector<const float*> moreFeatures = {columns[4].data(), columns[5].data(), columns[6].data()};
+                UNIT_ASSERT_VALUES_EQUAL(pool.AddFloatFeatures(moreFeatures), 3);
+                UNIT_ASSERT_VALUES_EQUAL(pool.GetLineCount(), 500);
+                UNIT_ASSERT_VALUES_EQUAL(pool.GetFeatures().GetBinCount(), expectedPool.second.GetBinCount());
+
+                yvector<TSelectionStepMetrics> steps;
+                UNIT_ASSERT_VALUES_EQUAL(Select(pool, &steps), expected);
+                for (int i : xrange(steps.ysize())) {
+                    UNIT_ASSERT_VALUES_EQUAL(steps[i].Step, i + 1);
+                    UNIT_ASSERT(steps[i].Candidates > 0);
+                }
+            }
+        }
+
+        SIMPLE_UNIT_TEST(PackedFeatures) {
+            TReallyFastRng32 rng(20170904);
+            const int lineCount = 130;
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 5, lineCount, {1, 4});
+
+            const yvector<yvector<float>> columns = MakeColumns(rng, lineCount, 2);
+            TInMemoryPool pool(columns[0], TInMemoryBinarization());
+            for (int feature : xrange(features.GetFeatureCount())) {
+                yvector<yvector<ui64>> words;
+                for (int binIndex : features.GetFeatureBinIndexes(feature)) {
+                    words.emplace_back((lineCount + 63) / 64);
+                    for (int line : xrange(lineCount)) {
+                        words.back()[line / 64] |= ui64(features.GetBin(binIndex)[line]) << (line % 64);
+                    }
+                }
+                yvector<const ui64*> bins;
+                for (const auto& bin : words) {
+                    bins.push_back(bin.data());
+                }
+                UNIT_ASSERT_VALUES_EQUAL(pool.AddPackedFeature(bins), feature);
+            }
+            UNIT_ASSERT(pool.GetFeatures().AllBins() == features.AllBins());
+
+            // Initial features are reported without a step
+            TFastSelectionOptions options;
+            options.InitialFeatures = {3};
+            yvector<TSelectionStepMetrics> steps;
+            SelectFeatures(pool, options, [&steps](const TSelectionStepMetrics& metrics) {
+                steps.push_back(metrics);
+            });
+            UNIT_ASSERT_VALUES_EQUAL(steps.size(), 5);
+            UNIT_ASSERT_VALUES_EQUAL(steps[0].SelectedFeature, 3);
+            UNIT_ASSERT_VALUES_EQUAL(steps[0].Candidates, 0);
+            UNIT_ASSERT_VALUES_EQUAL(steps[1].Step, 2);
+            UNIT_ASSERT(steps[1].Candidates > 0);
+
+            UNIT_ASSERT_EXCEPTION(TInMemoryPool(columns[0], [] {
+                TInMemoryBinarization binarization;
+                binarization.Binarizer = "unknown";
+                return binarization;
+            }()), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(ConcurrentSelections) {
+            TReallyFastRng32 rng(20170905);
+            const yvector<yvector<float>> columns = MakeColumns(rng, 400, 6);
+            TInMemoryPool pool(columns[0], TInMemoryBinarization());
+            const yvector<const float*> features = {columns[1].data(), columns[2].data(), columns[3].data(), columns[4].data()};
+            pool.AddFloatFeatures(features);
+
+            yvector<TSelectionStepMetrics> expectedSteps;
+            const yvector<int> expected = Select(pool, &expectedSteps, true);
+
+            // Neither selection sees the kernels of the other one
+            TMtpQueue queue;
+            queue.Start(2);
+            yvector<TSelectionStepMetrics> countedSteps, uncountedSteps;
+            auto counted = NThreading::Async([&] { return Select(pool, &countedSteps, true); }, queue);
+            auto uncounted = NThreading::Async([&] { return Select(pool, &uncountedSteps, false); }, queue);
+            UNIT_ASSERT(counted.GetValue(TDuration::Max()) == expected);
+            UNIT_ASSERT(uncounted.GetValue(TDuration::Max()) == expected);
+
+            UNIT_ASSERT_VALUES_EQUAL(countedSteps.size(), expectedSteps.size());
+            UNIT_ASSERT_VALUES_EQUAL(uncountedSteps.size(), expectedSteps.size());
+            for (size_t i : xrange(expectedSteps.size())) {
+                const TKernelCounters& kernels = countedSteps[i].Kernels;
+                const TKernelCounters& expectedKernels = expectedSteps[i].Kernels;
+                UNIT_ASSERT_VALUES_EQUAL(kernels.Evaluations, expectedKernels.Evaluations);
+                UNIT_ASSERT_VALUES_EQUAL(kernels.CmiCalls, expectedKernels.CmiCalls);
+                UNIT_ASSERT_VALUES_EQUAL(kernels.VectorCounters, expectedKernels.VectorCounters);
+                UNIT_ASSERT(kernels.VectorCounters > 0);
+                UNIT_ASSERT_VALUES_EQUAL(uncountedSteps[i].Kernels.VectorCounters, 0);
+                UNIT_ASSERT_VALUES_EQUAL(uncountedSteps[i].Kernels.CmiCalls, 0);
+            }
+        }
+    }
+}
@@ -1,5 +1,8 @@
 #include "io.h"
+#include "bgzf.h"
 #include "feature_score.h"
+#include "perf_counters.h"
+#include "trace.h"
 
 #include <library/threading/future/async.h>
 #include <library/threading/future/future.h>
@@ -7,58 +10,156 @@
 #include <util/generic/algorithm.h>
 #include <util/generic/string.h>
 #include <util/generic/yexception.h>
+#include <util/generic/deque.h>
 #include <util/generic/hash.h>
+#include <util/generic/ptr.h>
 #include <util/stream/input.h>
 #include <util/stream/file.h>
 #include <util/stream/output.h>
+#include <util/stream/str.h>
+#include <util/stream/zlib.h>
 #include <util/string/cast.h>
 #include <util/string/iterator.h>
 #include <util/string/join.h>
+#include <util/string/strip.h>
 #include <util/stream/format.h>
 #include <util/stream/labeled.h>
+#include <util/generic/bitops.h>
 #include <util/generic/xrange.h>
+#include <util/random/fast.h>
 #include <util/thread/queue.h>
 
+#include <cstring>
+
+#ifdef _sse2_
+#include <emmintrin.h>
+#endif
+
 namespace NCmicot {
     namespace {
         auto FormatScore(double score) -> decltype(Prec(0.0, PREC_POINT_DIGITS, 1)) {
             return Prec(score + 1e-9, PREC_POINT_DIGITS, 8);
         }
 
+        class TColumnProjection {
+        public:
+            explicit TColumnProjection(const TReadPoolOptions& options)
+                : KeepRest(options.UseColumns.empty())
+            {
+                Y_ENSURE(options.UseColumns.empty() || options.IgnoreColumns.empty(),
+                         "Columns to use and columns to ignore can't be given at the same time");
+                for (int column : options.UseColumns) {
+                    Y_ENSURE(column >= 0, "Incorrect column index " << column);
+                    Set(column, true);
+                }
+                for (int column : options.IgnoreColumns) {
+                    Y_ENSURE(column > 0, "Column " << column << " can't be ignored");
+                    Set(column, false);
+                }
+                Set(0, true);
+            }
+
+            bool Keep(size_t column) const {
+                return column < Mask.size() ? Mask[column] : KeepRest;
+            }
+
+            size_t MentionedColumnCount() const {
+                return Mask.size();
+            }
+
+        private:
+            void Set(size_t column, bool keep) {
+                if (column >= Mask.size()) {
+                    Mask.resize(column + 1, KeepRest);
+                }
+                Mask[column] = keep;
+            }
+
+            yvector<bool> Mask;
+            bool KeepRest;
+        };
+
+        struct TParsedBatch {
+            TRawPool Columns;
+            size_t FieldCount = 0;
+            /// Values of every column converted to float and sorted, filled only if requested.
+            yvector<yvector<float>> SortedRuns;
+        };
+
+        using TParsedBatchPtr = TAtomicSharedPtr<TParsedBatch>;
+
         struct TBatchParser {
             yvector<TString> Lines;
-            int FirstLineNo;
+            yvector<int> LineNos;
+            TColumnProjection Projection;
+            bool SortValues = false;
+
+            TParsedBatchPtr operator()() const {
+                TTraceSpan span("ParseBatch", "lines", Lines.size());
+                auto batch = MakeAtomicShared<TParsedBatch>(Parse());
+                if (SortValues) {
+                    SortRuns(*batch);
+                }
+                return batch;
+            }
 
-            TRawPool operator()() const {
-                TRawPool result;
+            static void SortRuns(TParsedBatch& batch) {
+                TTraceSpan span("SortRuns", "columns", batch.Columns.size());
+                batch.SortedRuns.resize(batch.Columns.size());
+                for (int column : xrange(batch.Columns.size())) {
+                    auto& run = batch.SortedRuns[column];
+                    run.assign(batch.Columns[column].begin(), batch.Columns[column].end());
+                    Sort(run.begin(), run.end());
+                }
+            }
+
+            TParsedBatch Parse() const {
+                TPerfRegionGuard perfRegion(EPerfRegion::TsvParsing);
+                TParsedBatch result;
                 yvector<double> numbers;
 
-                for (int i = 0, curLine = FirstLineNo; i < Lines.ysize(); ++i, ++curLine) {
+                for (int i : xrange(Lines.ysize())) {
+                    const TStringBuf line = Lines[i];
                     numbers.clear();
-                    for (const auto& iter : StringSplitter(Lines[i]).Split('\t')) {
-                        double currentNumber;
-                        if (TryFromString(iter.Token(), currentNumber)) {
-                            numbers.push_back(currentNumber);
-                        } else {
-                            ythrow yexception() << "Failed to parse double from \"" << iter.Token()
-                                                << "\" in line " << curLine;
+
+                    size_t fieldCount = 0;
+                    for (size_t begin = 0;; ++fieldCount) {
+                        size_t end = line.find('\t', begin);
+                        if (end == TStringBuf::npos) {
+                            end = line.size();
+                        }
+                        if (Projection.Keep(fieldCount)) {
+                            const TStringBuf token = line.SubStr(begin, end - begin);
+                            double currentNumber;
+                            if (TryFromString(token, currentNumber)) {
+                                numbers.push_back(currentNumber);
+                            } else {
+                                ythrow yexception() << "Failed to parse double from \"" << token
+                                                    << "\" in line " << LineNos[i];
+                            }
+                        }
+                        if (end == line.size()) {
+                            ++fieldCount;
+                            break;
                         }
+                        begin = end + 1;
                     }
 
-                    if (result.empty()) {
-                        result.resize(numbers.size());
-                        for (auto& column : result) {
+                    if (result.Columns.empty()) {
+                        result.FieldCount = fieldCount;
+                        result.Columns.resize(numbers.size());
+                        for (auto& column : result.Columns) {
                             column.reserve(Lines.size());
                         }
                     } else {
-                        Y_ENSURE(result.size() == numbers.size(),
-                                 "In line " << curLine << " there are " << numbers.size() << " columns while "
+                        Y_ENSURE(result.FieldCount == fieldCount,
+                                 "In line " << LineNos[i] << " there are " << fieldCount << " columns while "
                                                                                              "in line "
-                                            << FirstLineNo << " there are " << result.size() << " columns");
+                                            << LineNos.front() << " there are " << result.FieldCount << " columns");
                     }
 
                     for (int column : xrange(numbers.size())) {
-                        result[column].push_back(numbers[column]);
+                        result.Columns[column].push_back(numbers[column]);
                     }
                 }
 
@@ -71,51 +172,535 @@ namespace NCmicot {
             size_t DoRead(void* buf, size_t len) override {
                 return Cin.Read(buf, len);
             }
+
+            size_t DoReadTo(TString& st, char ch) override {
+                return Cin.ReadTo(st, ch);
+            }
         };
-    }
 
-    TRawPool ReadPool(IInputStream& in, int linesInBatch, IMtpQueue& queue) {
-        yvector<NThreading::TFuture<TRawPool>> futures;
+        /// Returns the bytes which were read to detect the format before the rest of the input.
+        class TPrefixedInput : public IInputStream {
+        public:
+            TPrefixedInput(TString prefix, THolder<IInputStream> slave)
+                : Prefix(std::move(prefix))
+                , Slave(std::move(slave))
+            {
+            }
 
-        for (int lineNo = 1;;) {
-            yvector<TString> lines;
-            lines.reserve(linesInBatch);
+        protected:
+            size_t DoRead(void* buf, size_t len) override {
+                if (Offset < Prefix.size()) {
+                    const size_t size = Min(len, Prefix.size() - Offset);
+                    memcpy(buf, Prefix.data() + Offset, size);
+                    Offset += size;
+                    return size;
+                }
+                return Slave->Read(buf, len);
+            }
 
-            TString currentLine;
-            for (int i = 0; i < linesInBatch && in.ReadLine(currentLine); ++i) {
-                lines.push_back(currentLine);
+            size_t DoReadTo(TString& st, char ch) override {
+                if (Offset < Prefix.size()) {
+                    return IInputStream::DoReadTo(st, ch);
+                }
+                return Slave->ReadTo(st, ch);
             }
 
-            if (lines.empty()) {
-                break;
+        private:
+            TString Prefix;
+            size_t Offset = 0;
+            THolder<IInputStream> Slave;
+        };
+
+        class TOwningZDecompress : public IInputStream {
+        public:
+            explicit TOwningZDecompress(THolder<IInputStream> slave)
+                : Slave(std::move(slave))
+                , Decompress(Slave.Get(), ZLib::GZip, 1 << 16)
+            {
             }
 
-            int firstLineNo = lineNo;
-            lineNo += lines.size();
-            futures.push_back(NThreading::Async(TBatchParser{std::move(lines), firstLineNo}, queue));
+        protected:
+            size_t DoRead(void* buf, size_t len) override {
+                return Decompress.Read(buf, len);
+            }
+
+            size_t DoReadTo(TString& st, char ch) override {
+                return Decompress.ReadTo(st, ch);
+            }
+
+        private:
+            THolder<IInputStream> Slave;
+            TZDecompress Decompress;
+        };
+
+        constexpr size_t FORMAT_HEADER_SIZE = 18;
+
+        constexpr size_t WRITER_BLOCK_SIZE = 1 << 20;
+
+        constexpr char PACKED_POOL_MAGIC[8] = {'C', 'M', 'I', 'P', 'A', 'C', 'K', 0};
+        constexpr ui32 PACKED_POOL_VERSION = 1;
+
+        template <class T>
+        void LoadArray(IInputStream& in, T* data, size_t count) {
+            const size_t size = count * sizeof(T);
+            Y_ENSURE(in.Load(data, size) == size, "Truncated packed pool");
         }
 
-        TRawPool result;
-        for (const NThreading::TFuture<TRawPool>& parseResult : futures) {
-            parseResult.Wait();
+        /// Reads count values in chunks and grows result only as they arrive, so the counts of a
+        /// corrupt header fail as a truncated pool rather than as a huge allocation. The input may be
+        /// decompressed on the fly, so its size isn't known in advance.
+        template <class T>
+        void LoadVector(IInputStream& in, yvector<T>& result, size_t count) {
+            constexpr size_t CHUNK_SIZE = (1 << 20) / sizeof(T);
+            result.clear();
+            while (result.size() < count) {
+                const size_t loaded = result.size();
+                const size_t chunkSize = Min(CHUNK_SIZE, count - loaded);
+                result.resize(loaded + chunkSize);
+                LoadArray(in, result.data() + loaded, chunkSize);
+            }
+        }
+
+        void SkipArray(IInputStream& in, size_t size) {
+            while (size > 0) {
+                const size_t skipped = in.Skip(size);
+                Y_ENSURE(skipped > 0, "Truncated packed pool");
+                size -= skipped;
+            }
+        }
+
+        /// Reads the map and the label of the lines of a shard, then the same lines of every bin if
+        /// readBins is set. Lines of other shards are skipped.
+        TPackedPool ReadPackedPoolLines(IInputStream& in, size_t shardIndex, size_t shardCount, bool readBins) {
+            char magic[sizeof(PACKED_POOL_MAGIC)];
+            ui32 version = 0;
+            ui64 lineCount = 0;
+            ui64 binCount = 0;
+            LoadArray(in, magic, sizeof(magic));
+            Y_ENSURE(memcmp(magic, PACKED_POOL_MAGIC, sizeof(magic)) == 0, "Input is not a packed pool");
+            LoadArray(in, &version, 1);
+            Y_ENSURE(version == PACKED_POOL_VERSION, "Unsupported packed pool version " << version);
+            LoadArray(in, &lineCount, 1);
+            LoadArray(in, &binCount, 1);
+            Y_ENSURE(lineCount <= Max<size_t>() / sizeof(double) && binCount <= static_cast<ui64>(Max<i32>()),
+                     "Corrupt packed pool header: " << lineCount << " lines, " << binCount << " bins");
+
+            const size_t wordCount = (lineCount + 63) / 64;
+            const size_t firstWord = wordCount * shardIndex / shardCount;
+            const size_t lastWord = wordCount * (shardIndex + 1) / shardCount;
+            const size_t firstLine = Min<size_t>(firstWord * 64, lineCount);
+            const size_t shardLineCount = Min<size_t>(lastWord * 64, lineCount) - firstLine;
+
+            TPackedPool result;
+            result.FirstLine = firstLine;
+            yvector<i32> map;
+            LoadVector(in, map, binCount);
+            result.BinToFeatureMap.assign(map.begin(), map.end());
+            SkipArray(in, firstLine * sizeof(double));
+            LoadVector(in, result.Pool.Label, shardLineCount);
+            if (!readBins) {
+                return result;
+            }
+            SkipArray(in, (lineCount - firstLine - shardLineCount) * sizeof(double));
+
+            // The shard starts at a word boundary, so its words unpack as a bin of their own
+            yvector<ui64> words(lastWord - firstWord);
+            result.Pool.Bins.reserve(binCount);
+            for (ui64 bin = 0; bin < binCount; ++bin) {
+                SkipArray(in, firstWord * sizeof(ui64));
+                LoadArray(in, words.data(), words.size());
+                SkipArray(in, (wordCount - lastWord) * sizeof(ui64));
+                result.Pool.Bins.push_back(UnpackBin(words.data(), shardLineCount));
+            }
+            return result;
+        }
+
+        TString CompressToBgzf(TStringBuf text) {
+            TString result;
+            TStringOutput out(result);
+            for (size_t offset = 0; offset < text.size(); offset += BGZF_MAX_BLOCK_DATA_SIZE) {
+                WriteBgzfBlock(text.SubStr(offset, BGZF_MAX_BLOCK_DATA_SIZE), out);
+            }
+            return result;
+        }
+
+        /// Formats (and compresses if asked) blocks in parallel and writes them in order. Only a
+        /// bounded number of blocks is kept in memory at once.
+        template <class TFormatBlock>
+        void WriteBlocksInOrder(size_t blockCount, const TFormatBlock& formatBlock, const TPoolWriterOptions& options,
+                                IOutputStream& out) {
+            TMtpQueue queue;
+            queue.Start(options.ThreadCount);
+
+            const bool compress = options.Compress;
+            ydeque<NThreading::TFuture<TString>> pending;
+            auto writeFront = [&] {
+                {
+                    TTraceSpan span("WaitBlock");
+                    pending.front().Wait();
+                }
+                const TString& block = pending.front().GetValue();
+                out.Write(block.data(), block.size());
+                pending.pop_front();
+            };
+
+            for (size_t block : xrange(blockCount)) {
+                if (pending.size() >= 2 * static_cast<size_t>(options.ThreadCount)) {
+                    writeFront();
+                }
+                pending.push_back(NThreading::Async([&formatBlock, block, compress] {
+                    TTraceSpan span("FormatBlock", "block", block);
+                    const TString text = formatBlock(block);
+                    return compress ? CompressToBgzf(text) : text;
+                }, queue));
+            }
+            while (!pending.empty()) {
+                writeFront();
+            }
+            if (compress) {
+                WriteBgzfEof(out);
+            }
+        }
+
+        yvector<float> MergeSortedRuns(yvector<yvector<float>> runs) {
+            if (runs.empty()) {
+                return {};
+            }
+            while (runs.size() > 1) {
+                yvector<yvector<float>> merged;
+                for (size_t i = 0; i + 1 < runs.size(); i += 2) {
+                    merged.emplace_back(runs[i].size() + runs[i + 1].size());
+                    std::merge(runs[i].begin(), runs[i].end(), runs[i + 1].begin(), runs[i + 1].end(), merged.back().begin());
+                }
+                if (runs.size() % 2) {
+                    merged.push_back(std::move(runs.back()));
+                }
+                runs = std::move(merged);
+            }
+            return std::move(runs.front());
+        }
+
+        /// Splits the input into batches of lines, applying row sampling and the row limit. Lines
+        /// dropped by sampling are never copied. Calls onBatch(lines, lineNos) for every batch.
+        template <class TOnBatch>
+        void ReadLineBatches(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, TOnBatch&& onBatch) {
+            Y_ENSURE(options.RowSampleRate > 0 && options.RowSampleRate <= 1,
+                     "Row sample rate should be in (0, 1], got " << options.RowSampleRate);
+            TFastRng64 rng(options.Seed);
+
+            ui64 keptLineCount = 0;
+            auto limitReached = [&] {
+                return options.RowLimit && keptLineCount >= *options.RowLimit;
+            };
+
+            for (int lineNo = 1; !limitReached();) {
+                yvector<TString> lines;
+                yvector<int> lineNos;
+                lines.reserve(linesInBatch);
+                lineNos.reserve(linesInBatch);
+
+                TTraceSpan span("ReadLines");
+                TString currentLine;
+                while (lines.ysize() < linesInBatch && !limitReached() && in.ReadLine(currentLine)) {
+                    const int currentLineNo = lineNo++;
+                    if (options.RowSampleRate < 1 && rng.GenRandReal2() >= options.RowSampleRate) {
+                        continue;
+                    }
+                    lines.push_back(currentLine);
+                    lineNos.push_back(currentLineNo);
+                    ++keptLineCount;
+                }
+
+                if (lines.empty()) {
+                    break;
+                }
+
+                onBatch(std::move(lines), std::move(lineNos));
+            }
+        }
+
+        struct TBinaryBatch {
+            yvector<double> Label;
+            yvector<yvector<ui64>> Words;
+            size_t FieldCount = 0;
+        };
+
+        /// Parses lines of a binary pool: the label is parsed as a number, all the other fields are
+        /// expected to be 0 or 1 and are ORed into packed words, bit (line % 64) of word (line / 64).
+        struct TBinaryBatchParser {
+            yvector<TString> Lines;
+            yvector<int> LineNos;
+
+            TBinaryBatch operator()() const {
+                TTraceSpan span("ParseBinaryBatch", "lines", Lines.size());
+                TPerfRegionGuard perfRegion(EPerfRegion::BinaryParsing);
+                TBinaryBatch result;
+                result.Label.reserve(Lines.size());
+                const size_t wordCount = (Lines.size() + 63) / 64;
+
+                for (int i : xrange(Lines.ysize())) {
+                    const TStringBuf line = Lines[i];
+                    TStringBuf labelToken, bits;
+                    if (!line.TrySplit('\t', labelToken, bits)) {
+                        labelToken = line;
+                    }
+
+                    double label;
+                    if (!TryFromString(labelToken, label)) {
+                        ythrow yexception() << "Failed to parse double from \"" << labelToken << "\" in line " << LineNos[i];
+                    }
+                    result.Label.push_back(label);
+
+                    const size_t fieldCount = labelToken.size() == line.size() ? 1 : 2 + Count(bits.begin(), bits.end(), '\t');
+                    if (i == 0) {
+                        result.FieldCount = fieldCount;
+                        result.Words.assign(fieldCount - 1, yvector<ui64>(wordCount));
+                    } else {
+                        Y_ENSURE(result.FieldCount == fieldCount,
+                                 "In line " << LineNos[i] << " there are " << fieldCount << " columns while "
+                                                                                             "in line "
+                                            << LineNos.front() << " there are " << result.FieldCount << " columns");
+                    }
+
+                    const size_t binCount = fieldCount - 1;
+                    const size_t word = i / 64;
+                    const ui64 bit = 1ull << (i % 64);
+                    size_t column = 0;
+                    if (bits.size() + 1 == 2 * binCount) {
+                        column = ParseFixedWidth(bits, word, bit, result.Words);
+                    }
+                    for (size_t begin = 2 * column; column < binCount; ++column) {
+                        size_t end = bits.find('\t', begin);
+                        if (end == TStringBuf::npos) {
+                            end = bits.size();
+                        }
+                        if (ParseBit(bits.SubStr(begin, end - begin), LineNos[i])) {
+                            result.Words[column][word] |= bit;
+                        }
+                        begin = end + 1;
+                    }
+                }
+
+                return result;
+            }
+
+        private:
+            static bool ParseBit(TStringBuf token, int lineNo) {
+                if (token.size() == 1 && (token[0] == '0' || token[0] == '1')) {
+                    return token[0] == '1';
+                }
+                double value;
+                if (!TryFromString(token, value)) {
+                    ythrow yexception() << "Failed to parse double from \"" << token << "\" in line " << lineNo;
+                }
+                Y_ENSURE(static_cast<ui32>(value) <= 1, value << " is not a binary value");
+                return static_cast<ui32>(value);
+            }
+
+            /// Handles the common case of single character fields "b\tb\t...\tb". Returns the number of
+            /// leading columns consumed, the rest (if any) is left to the generic loop.
+            static size_t ParseFixedWidth(TStringBuf bits, size_t word, ui64 bit, yvector<yvector<ui64>>& words) {
+                size_t column = 0;
+#ifdef _sse2_
+                // Every 16 bytes hold 8 fields: bit characters at even positions and tabs at odd ones
+                const __m128i tabs = _mm_set1_epi8('\t');
+                const __m128i zeros = _mm_set1_epi8('0');
+                const __m128i ones = _mm_set1_epi8('1');
+                for (; 2 * column + 16 <= bits.size(); column += 8) {
+                    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits.data() + 2 * column));
+                    const int tabMask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, tabs));
+                    const int oneMask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, ones));
+                    const int zeroMask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, zeros));
+                    if (tabMask != 0xaaaa || (oneMask | zeroMask) != 0x5555) {
+                        return column;
+                    }
+                    for (int mask = oneMask; mask; mask &= mask - 1) {
+                        words[column + CountTrailingZeroBits(static_cast<ui32>(mask)) / 2][word] |= bit;
+                    }
+                }
+#endif
+                for (; 2 * column < bits.size(); ++column) {
+                    const char c = bits[2 * column];
+                    if ((c != '0' && c != '1') || (2 * column + 1 < bits.size() && bits[2 * column + 1] != '\t')) {
+                        return column;
+                    }
+                    if (c == '1') {
+                        words[column][word] |= bit;
+                    }
+                }
+                return column;
+            }
+        };
+    }
+
+    TSortedRawPool ReadPoolSorted(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue,
+                                  yvector<int>* keptColumns, bool sortValues) {
+        TTraceSpan span("ReadPool");
+        const TColumnProjection projection(options);
+
+        TSortedRawPool result;
+        TRawPool& columns = result.Columns;
+        yvector<yvector<yvector<float>>> sortedRuns;
+        size_t fieldCount = 0;
+
+        // Batches are moved into the columns in input order as soon as they are ready, so parsed data
+        // doesn't pile up while the rest of the input is being read
+        auto consume = [&](TParsedBatch& data) {
+            if (columns.empty()) {
+                columns.resize(data.Columns.size());
+                sortedRuns.resize(data.Columns.size());
+                fieldCount = data.FieldCount;
+            }
+            Y_ENSURE(fieldCount == data.FieldCount, LabeledOutput(fieldCount, data.FieldCount));
+            for (int column : xrange(columns.size())) {
+                auto& values = columns[column];
+                if (values.empty()) {
+                    values = std::move(data.Columns[column]);
+                } else {
+                    values.insert(values.end(), data.Columns[column].begin(), data.Columns[column].end());
+                    yvector<double>().swap(data.Columns[column]);
+                }
+                if (sortValues) {
+                    sortedRuns[column].push_back(std::move(data.SortedRuns[column]));
+                }
+            }
+        };
+
+        ydeque<NThreading::TFuture<TParsedBatchPtr>> pending;
+        auto drain = [&](bool wait) {
+            while (!pending.empty() && (wait || pending.front().HasValue() || pending.front().HasException())) {
+                if (wait) {
+                    TTraceSpan waitSpan("WaitBatch");
+                    pending.front().Wait();
+                }
+                consume(*pending.front().GetValue());
+                pending.pop_front();
+            }
+        };
+
+        ReadLineBatches(in, options, linesInBatch, [&](yvector<TString>&& lines, yvector<int>&& lineNos) {
+            // Runs are sorted inside the parsing task, so the reader thread never does it
+            pending.push_back(NThreading::Async(TBatchParser{std::move(lines), std::move(lineNos), projection, sortValues}, queue));
+            drain(false);
+        });
+        drain(true);
+
+        if (!columns.empty()) {
+            Y_ENSURE(projection.MentionedColumnCount() <= fieldCount,
+                     "Column " << projection.MentionedColumnCount() - 1 << " is requested while the pool has only "
+                               << fieldCount << " columns");
+        }
+        if (keptColumns) {
+            keptColumns->clear();
+            for (size_t column : xrange(fieldCount)) {
+                if (projection.Keep(column)) {
+                    keptColumns->push_back(column);
+                }
+            }
+        }
+
+        if (sortValues) {
+            result.SortedValues.resize(columns.size());
+            // The merges write into the locals of this function, so all of them are finished before an
+            // error of any of them is thrown
+            yvector<NThreading::TFuture<void>> merges;
+            auto waitMerges = [&merges] {
+                for (const auto& merge : merges) {
+                    merge.Wait();
+                }
+            };
+            try {
+                for (int column : xrange(columns.size())) {
+                    merges.push_back(NThreading::Async([&result, &sortedRuns, column] {
+                        TTraceSpan span("MergeSortedRuns", "column", column);
+                        result.SortedValues[column] = MergeSortedRuns(std::move(sortedRuns[column]));
+                    }, queue));
+                }
+            } catch (...) {
+                waitMerges();
+                throw;
+            }
+            waitMerges();
+            for (const auto& merge : merges) {
+                merge.GetValue();
+            }
+        }
+
+        return result;
+    }
+
+    TSortedRawPool ReadPoolSorted(IInputStream& in, const TReadPoolOptions& options, yvector<int>* keptColumns) {
+        TMtpQueue queue;
+        queue.Start(16);
+        return ReadPoolSorted(in, options, 20000, queue, keptColumns, true);
+    }
+
+    TRawPool ReadPool(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue,
+                      yvector<int>* keptColumns) {
+        return ReadPoolSorted(in, options, linesInBatch, queue, keptColumns, false).Columns;
+    }
+
+    TRawPool ReadPool(IInputStream& in, const TReadPoolOptions& options, yvector<int>* keptColumns) {
+        TMtpQueue queue;
+        queue.Start(16);
+        return ReadPool(in, options, 20000, queue, keptColumns);
+    }
+
+    TBinaryPool ReadBinaryPool(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue) {
+        Y_ENSURE(options.UseColumns.empty() && options.IgnoreColumns.empty(),
+                 "Column projection isn't supported for binary pools");
+        TTraceSpan span("ReadBinaryPool");
+        // Whole words per batch, so that the packed columns of batches can be simply concatenated
+        linesInBatch = (linesInBatch + 63) / 64 * 64;
+
+        yvector<NThreading::TFuture<TBinaryBatch>> futures;
+        ReadLineBatches(in, options, linesInBatch, [&](yvector<TString>&& lines, yvector<int>&& lineNos) {
+            futures.push_back(NThreading::Async(TBinaryBatchParser{std::move(lines), std::move(lineNos)}, queue));
+        });
+
+        TBinaryPool result;
+        yvector<yvector<ui64>> words;
+        size_t fieldCount = 0;
+        for (const NThreading::TFuture<TBinaryBatch>& parseResult : futures) {
+            {
+                TTraceSpan waitSpan("WaitBatch");
+                parseResult.Wait();
+            }
             const auto& data = parseResult.GetValue();
 
-            if (result.empty()) {
-                result.resize(data.size());
+            if (result.Label.empty()) {
+                fieldCount = data.FieldCount;
+                words.resize(data.Words.size());
             }
-            Y_ENSURE(result.size() == data.size(), LabeledOutput(result.size(), data.size()));
-            for (int column : xrange(result.size())) {
-                result[column].insert(result[column].end(), data[column].begin(), data[column].end());
+            Y_ENSURE(fieldCount == data.FieldCount, LabeledOutput(fieldCount, data.FieldCount));
+            result.Label.insert(result.Label.end(), data.Label.begin(), data.Label.end());
+            for (int column : xrange(words.size())) {
+                words[column].insert(words[column].end(), data.Words[column].begin(), data.Words[column].end());
             }
         }
 
+        const size_t lineCount = result.Label.size();
+        result.Bins.reserve(words.size());
+        for (auto& columnWords : words) {
+            result.Bins.push_back(UnpackBin(columnWords.data(), lineCount));
+            yvector<ui64>().swap(columnWords);
+        }
+
         return result;
     }
 
-    TRawPool ReadPool(IInputStream& in) {
+    TBinaryPool ReadBinaryPool(IInputStream& in, const TReadPoolOptions& options) {
         TMtpQueue queue;
         queue.Start(16);
-        return ReadPool(in, 20000, queue);
+        return ReadBinaryPool(in, options, 20000, queue);
+    }
+
+    TRawPool ReadPool(IInputStream& in, int linesInBatch, IMtpQueue& queue) {
+        return ReadPool(in, TReadPoolOptions(), linesInBatch, queue);
+    }
+
+    TRawPool ReadPool(IInputStream& in) {
+        return ReadPool(in, TReadPoolOptions());
     }
 
     yvector<int> ReadBinToFeatureMap(IInputStream& in) {
@@ -144,21 +729,67 @@ namespace NCmicot {
         return result;
     }
 
+    yvector<int> ReadFeatureList(IInputStream& in) {
+        yvector<int> result;
+        int lineNo = 0;
+        for (TString line; in.ReadLine(line);) {
+            ++lineNo;
+            const TStringBuf token = StripString(TStringBuf(line));
+            if (token.empty()) {
+                continue;
+            }
+            int featureIndex;
+            Y_ENSURE(TryFromString(token, featureIndex) && featureIndex >= 0,
+                     "Incorrect feature index \"" << token << "\" in line " << lineNo);
+            result.push_back(featureIndex);
+        }
+        return result;
+    }
+
     void OutputScore(double score, IOutputStream& out) {
         out << FormatScore(score) << Endl;
     }
 
-    void OutputPool(const TBinFeatureSet& label, const TBinFeatureSet& features, IOutputStream& out) {
+    void OutputPool(const TBinFeatureSet& label, const TBinFeatureSet& features, IOutputStream& out,
+                    const TPoolWriterOptions& options) {
         const yvector<ui64> labelValues = UniteLabelBins(label.AllBins());
-        const int lineCount = labelValues.ysize();
-
-        for (int line : xrange(lineCount)) {
-            out << labelValues[line];
-            for (const TBin& bin : features.AllBins()) {
-                out << '\t' << bin[line];
+        const size_t lineCount = labelValues.size();
+        const size_t binCount = features.GetBinCount();
+        const size_t linesInBlock = Max<size_t>(1, WRITER_BLOCK_SIZE / (2 * binCount + 1));
+        const size_t blockCount = (lineCount + linesInBlock - 1) / linesInBlock;
+
+        auto formatBlock = [&](size_t block) {
+            const size_t firstLine = block * linesInBlock;
+            const size_t lastLine = Min(lineCount, firstLine + linesInBlock);
+
+            // Every line is the label followed by binCount "\tb" pairs; lay out the labels and the
+            // tabs first and then write the bits column by column
+            char labelBuffer[32];
+            yvector<size_t> bitsOffset;
+            bitsOffset.reserve(lastLine - firstLine);
+            TString result;
+            for (size_t line : xrange(firstLine, lastLine)) {
+                result.append(labelBuffer, ToString(labelValues[line], labelBuffer, sizeof(labelBuffer)));
+                bitsOffset.push_back(result.size() + 1);
+                result.append(2 * binCount, '\t');
+                result.push_back('\n');
             }
-            out << '\n';
-        }
+            char* data = result.begin();
+            static constexpr char BIT_CHAR[] = {'0', '1'};
+            for (size_t bin : xrange(binCount)) {
+                const TBinRef binRef = features.GetBin(bin);
+                for (size_t i : xrange(bitsOffset.size())) {
+                    data[bitsOffset[i] + 2 * bin] = BIT_CHAR[binRef[firstLine + i]];
+                }
+            }
+            return result;
+        };
+
+        WriteBlocksInOrder(blockCount, formatBlock, options, out);
+    }
+
+    void OutputPool(const TBinFeatureSet& label, const TBinFeatureSet& features, IOutputStream& out) {
+        OutputPool(label, features, out, TPoolWriterOptions());
     }
 
     void OutputFeatureSizes(const TBinFeatureSet& features, IOutputStream& out) {
@@ -167,16 +798,71 @@ namespace NCmicot {
         }
     }
 
+    void OutputBinFeatureMap(const TBinFeatureSet& features, IOutputStream& out, const TPoolWriterOptions& options) {
+        const size_t binCount = features.GetBinCount();
+        const size_t binsInBlock = WRITER_BLOCK_SIZE / 16;
+
+        auto formatBlock = [&](size_t block) {
+            char buffer[32];
+            TString result;
+            for (size_t bin : xrange(block * binsInBlock, Min(binCount, (block + 1) * binsInBlock))) {
+                result.append(buffer, ToString(features.GetFeatureIndexByBinIndex(bin), buffer, sizeof(buffer)));
+                result.push_back('\t');
+                result.append(buffer, ToString(bin, buffer, sizeof(buffer)));
+                result.push_back('\n');
+            }
+            return result;
+        };
+
+        WriteBlocksInOrder((binCount + binsInBlock - 1) / binsInBlock, formatBlock, options, out);
+    }
+
     void OutputBinFeatureMap(const TBinFeatureSet& features, IOutputStream& out) {
-        int globalBinIndex = 0;
-        for (int featureIndex : xrange(features.GetFeatureCount())) {
-            for (int binIndex : xrange(features.GetFeature(featureIndex).size())) {
-                Y_UNUSED(binIndex);
-                out << featureIndex << '\t' << globalBinIndex++ << '\n';
+        OutputBinFeatureMap(features, out, TPoolWriterOptions());
+    }
+
+    void OutputPackedPool(const TBinaryPool& pool, const yvector<int>& binToFeatureMap, IOutputStream& out) {
+        const ui64 lineCount = pool.Label.size();
+        const ui64 binCount = pool.Bins.size();
+        Y_ENSURE(binToFeatureMap.size() == binCount, "Map has " << binToFeatureMap.size() << " bins, while the pool has " << binCount);
+
+        out.Write(PACKED_POOL_MAGIC, sizeof(PACKED_POOL_MAGIC));
+        out.Write(&PACKED_POOL_VERSION, sizeof(PACKED_POOL_VERSION));
+        out.Write(&lineCount, sizeof(lineCount));
+        out.Write(&binCount, sizeof(binCount));
+        const yvector<i32> map(binToFeatureMap.begin(), binToFeatureMap.end());
+        out.Write(map.data(), map.size() * sizeof(i32));
+        out.Write(pool.Label.data(), lineCount * sizeof(double));
+
+        yvector<ui64> words((lineCount + 63) / 64);
+        for (const TBin& bin : pool.Bins) {
+            Y_ENSURE(bin.size() == lineCount, "Bin has " << bin.size() << " lines, while the label has " << lineCount);
+            Fill(words.begin(), words.end(), 0);
+            for (size_t line : xrange(lineCount)) {
+                words[line / 64] |= static_cast<ui64>(bin[line]) << (line % 64);
             }
+            out.Write(words.data(), words.size() * sizeof(ui64));
         }
     }
 
+    TPackedPool ReadPackedPool(IInputStream& in) {
+        return ReadPackedPoolLines(in, 0, 1, true);
+    }
+
+    TPackedPool ReadPackedPoolShard(IInputStream& in, size_t shardIndex, size_t shardCount) {
+        Y_ENSURE(shardIndex < shardCount, "Shard " << shardIndex << " is out of range [0; " << shardCount << ")");
+        return ReadPackedPoolLines(in, shardIndex, shardCount, true);
+    }
+
+    TPackedPool ReadPackedPoolLabel(IInputStream& in) {
+        return ReadPackedPoolLines(in, 0, 1, false);
+    }
+
+    void OutputBlocks(size_t blockCount, const std::function<TString(size_t)>& formatBlock,
+                      const TPoolWriterOptions& options, IOutputStream& out) {
+        WriteBlocksInOrder(blockCount, formatBlock, options, out);
+    }
+
     TOutputter BuildOutputChain(yvector<EOutputFormat> flags, TBinFeatureSet& label,
                                 TBinFeatureSet& features, TFeatureScore& scoringResult) {
         if (flags.empty()) {
@@ -244,11 +930,30 @@ namespace NCmicot {
         };
     }
 
-    THolder<IInputStream> OpenInput(const TString& filename) {
+    THolder<IInputStream> OpenInput(THolder<IInputStream> in, int threadCount) {
+        TString header;
+        header.ReserveAndResize(FORMAT_HEADER_SIZE);
+        header.resize(in->Load(header.begin(), FORMAT_HEADER_SIZE));
+
+        const bool isGzip = header.size() >= 2 && static_cast<unsigned char>(header[0]) == 0x1f &&
+                            static_cast<unsigned char>(header[1]) == 0x8b;
+        const bool isBgzf = IsBgzfHeader(header);
+
+        THolder<IInputStream> input = new TPrefixedInput(std::move(header), std::move(in));
+        if (isBgzf) {
+            return new TParallelBgzfInput(std::move(input), threadCount);
+        }
+        if (isGzip) {
+            return new TOwningZDecompress(std::move(input));
+        }
+        return input;
+    }
+
+    THolder<IInputStream> OpenInput(const TString& filename, int threadCount) {
         if (filename == STRINGBUF("-")) {
-            return new TCinWrapper;
+            return OpenInput(new TCinWrapper, threadCount);
         }
-        return new TIFStream(filename);
+        return OpenInput(new TIFStream(filename), threadCount);
     }
 }
 
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "bin.h"
+
+#include <util/generic/maybe.h>
+#include <util/generic/string.h>
 #include <util/generic/vector.h>
 
 #include <functional>
@@ -11,13 +15,78 @@ class IMtpQueue;
 namespace NCmicot {
     using TRawPool = yvector<yvector<double>>;
 
-    THolder<IInputStream> OpenInput(const TString& filename);
+    /// Opens a file or stdin ("-"). Gzip input is decompressed transparently, BGZF input is
+    /// decompressed in threadCount threads ahead of the reader.
+    THolder<IInputStream> OpenInput(const TString& filename, int threadCount = 1);
+    THolder<IInputStream> OpenInput(THolder<IInputStream> in, int threadCount = 1);
+
+    /// Restrictions applied while a raw pool is parsed. Columns are indexed as in the tsv file,
+    /// i.e. the label is column 0 and it is always kept. Fields of skipped columns are only scanned
+    /// for the delimiter, and skipped lines are never split at all.
+    struct TReadPoolOptions {
+        yvector<int> UseColumns;
+        yvector<int> IgnoreColumns;
+        double RowSampleRate = 1.0;
+        TMaybe<ui64> RowLimit;
+        ui64 Seed = 0;
+    };
 
     TRawPool ReadPool(IInputStream& in, int linesInBatch, IMtpQueue& queue);
     TRawPool ReadPool(IInputStream& in);
 
+    /// If keptColumns isn't null, it receives the tsv index of every column of the result.
+    TRawPool ReadPool(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue,
+                      yvector<int>* keptColumns = nullptr);
+    TRawPool ReadPool(IInputStream& in, const TReadPoolOptions& options, yvector<int>* keptColumns = nullptr);
+
+    /// Raw pool along with the values of every column converted to float and sorted, which is the
+    /// input border builders need.
+    struct TSortedRawPool {
+        TRawPool Columns;
+        yvector<yvector<float>> SortedValues;
+    };
+
+    /// Pipelined version of ReadPool: every parsed batch is sorted column by column in the task
+    /// which has parsed it and then moved into the columns while the input is still being read.
+    /// Only a merge of the sorted runs is left for the end. With sortValues == false the
+    /// SortedValues are left empty.
+    TSortedRawPool ReadPoolSorted(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue,
+                                  yvector<int>* keptColumns = nullptr, bool sortValues = true);
+    TSortedRawPool ReadPoolSorted(IInputStream& in, const TReadPoolOptions& options, yvector<int>* keptColumns = nullptr);
+
+    /// Binary pool: a numeric label followed by 0/1 columns.
+    struct TBinaryPool {
+        yvector<double> Label;
+        yvector<TBin> Bins;
+    };
+
+    /// Reads a binary pool without materializing its bins as doubles: 0/1 fields are packed into
+    /// 64-bit words while parsing and only the label is parsed as a number.
+    TBinaryPool ReadBinaryPool(IInputStream& in, const TReadPoolOptions& options, int linesInBatch, IMtpQueue& queue);
+    TBinaryPool ReadBinaryPool(IInputStream& in, const TReadPoolOptions& options = TReadPoolOptions());
+
     yvector<int> ReadBinToFeatureMap(IInputStream& in);
 
+    /// Binary pool along with its bin-feature map in a single file which is loaded without any
+    /// parsing: a header, the map, the label as doubles and every bin as little-endian 64-bit words
+    /// holding 64 lines each.
+    struct TPackedPool {
+        TBinaryPool Pool;
+        yvector<int> BinToFeatureMap;
+        /// Index of the first read line in the whole pool.
+        size_t FirstLine = 0;
+    };
+
+    TPackedPool ReadPackedPool(IInputStream& in);
+    /// Reads lines of shard shardIndex out of shardCount. Shards are cut at multiples of 64 lines,
+    /// so the shards of a small pool may be empty.
+    TPackedPool ReadPackedPoolShard(IInputStream& in, size_t shardIndex, size_t shardCount);
+    /// Reads the label and the map only.
+    TPackedPool ReadPackedPoolLabel(IInputStream& in);
+
+    /// Reads feature indexes, one per line, in the format of the selection output.
+    yvector<int> ReadFeatureList(IInputStream& in);
+
     enum class EOutputFormat {
         FullResult,
         UsedBins,
@@ -37,9 +106,25 @@ namespace NCmicot {
 
     class TBinFeatureSet;
 
+    struct TPoolWriterOptions {
+        int ThreadCount = 1;
+        /// Write BGZF, which is gzip readable by any gzip tool and by OpenInput in parallel.
+        bool Compress = false;
+    };
+
+    /// Formats blocks of lines in ThreadCount threads and writes them in order.
+    void OutputPool(const TBinFeatureSet& label, const TBinFeatureSet& features, IOutputStream& out,
+                    const TPoolWriterOptions& options);
     void OutputPool(const TBinFeatureSet& label, const TBinFeatureSet& features, IOutputStream& out);
     void OutputFeatureSizes(const TBinFeatureSet& features, IOutputStream& out);
+    void OutputBinFeatureMap(const TBinFeatureSet& features, IOutputStream& out, const TPoolWriterOptions& options);
     void OutputBinFeatureMap(const TBinFeatureSet& features, IOutputStream& out);
+    void OutputPackedPool(const TBinaryPool& pool, const yvector<int>& binToFeatureMap, IOutputStream& out);
+
+    /// Calls formatBlock for blocks 0..blockCount-1 in options.ThreadCount threads and writes the
+    /// results in order, compressed if asked. Only a few blocks are kept in memory at once.
+    void OutputBlocks(size_t blockCount, const std::function<TString(size_t)>& formatBlock,
+                      const TPoolWriterOptions& options, IOutputStream& out);
 
     using TOutputter = std::function<void(IOutputStream&)>;
 
@@ -1,3 +1,5 @@
+#include "bgzf.h"
+#include "bin_feature_set.h"
 #include "io.h"
 
 #include <library/unittest/registar.h>
@@ -7,6 +9,7 @@
 #include <util/random/fast.h>
 #include <util/random/shuffle.h>
 #include <util/stream/str.h>
+#include <util/stream/zlib.h>
 #include <util/string/join.h>
 #include <util/thread/queue.h>
 
@@ -85,7 +88,256 @@ namespace NCmicot {
         }
     }
 
+    SIMPLE_UNIT_TEST_SUITE(ReadPoolWithOptions) {
+        SIMPLE_UNIT_TEST(ColumnProjection) {
+            const TString data = "1\t2\tnot a number\t5.6\n"
+                                "0\t7\t-\t9\n";
+
+            TReadPoolOptions options;
+            options.UseColumns = {3, 1};
+            {
+                TStringInput si(data);
+                yvector<int> keptColumns;
+                const TRawPool pool = ReadPool(si, options, &keptColumns);
+                UNIT_ASSERT_EQUAL(pool, TRawPool({{1.0, 0.0}, {2.0, 7.0}, {5.6, 9.0}}));
+                UNIT_ASSERT_EQUAL(keptColumns, yvector<int>({0, 1, 3}));
+            }
+
+            options.UseColumns.clear();
+            options.IgnoreColumns = {2};
+            {
+                TStringInput si(data);
+                UNIT_ASSERT_EQUAL(ReadPool(si, options), TRawPool({{1.0, 0.0}, {2.0, 7.0}, {5.6, 9.0}}));
+            }
+
+            options.IgnoreColumns = {0, 2};
+            {
+                TStringInput si(data);
+                UNIT_ASSERT_EXCEPTION(ReadPool(si, options), yexception);
+            }
+
+            options.IgnoreColumns.clear();
+            options.UseColumns = {4};
+            {
+                TStringInput si(data);
+                UNIT_ASSERT_EXCEPTION(ReadPool(si, options), yexception);
+            }
+        }
+
+        SIMPLE_UNIT_TEST(SkippedColumnsStillCounted) {
+            const TString data = "1\t2\t3\n"
+                                "1\t2\n";
+
+            TReadPoolOptions options;
+            options.UseColumns = {1};
+            TStringInput si(data);
+            UNIT_ASSERT_EXCEPTION(ReadPool(si, options), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(SortedValues) {
+            TReallyFastRng32 rng(20170411);
+            const int lineCount = 1000;
+            const int columnCount = 4;
+
+            TStringStream ss;
+            for (int line : xrange(lineCount)) {
+                Y_UNUSED(line);
+                for (int column : xrange(columnCount)) {
+                    ss << (column ? "\t" : "") << rng.Uniform(100) / 4.0;
+                }
+                ss << '\n';
+            }
+            const TString data = ss.Str();
+
+            auto queue = CreateMtpQueue(3);
+            TStringInput plainInput(data);
+            const TRawPool pool = ReadPool(plainInput, 64, *queue);
+            TStringInput sortedInput(data);
+            const TSortedRawPool sorted = ReadPoolSorted(sortedInput, TReadPoolOptions(), 64, *queue);
+
+            UNIT_ASSERT_EQUAL(sorted.Columns, pool);
+            UNIT_ASSERT_VALUES_EQUAL(sorted.SortedValues.size(), columnCount);
+            for (int column : xrange(columnCount)) {
+                yvector<float> expected(pool[column].begin(), pool[column].end());
+                Sort(expected.begin(), expected.end());
+                UNIT_ASSERT_EQUAL(sorted.SortedValues[column], expected);
+            }
+        }
+
+        SIMPLE_UNIT_TEST(RowSampling) {
+            TStringStream ss;
+            const int lineCount = 1000;
+            for (int line : xrange(lineCount)) {
+                ss << line << '\t' << line * 2 << '\n';
+            }
+            const TString data = ss.Str();
+
+            TReadPoolOptions options;
+            options.RowSampleRate = 0.3;
+            options.Seed = 20170101;
+
+            auto queue = CreateMtpQueue(2);
+            auto read = [&] {
+                TStringInput si(data);
+                return ReadPool(si, options, 64, *queue);
+            };
+
+            const TRawPool sample = read();
+            UNIT_ASSERT_EQUAL(sample, read());
+            UNIT_ASSERT(sample[0].ysize() > lineCount / 5 && sample[0].ysize() < lineCount * 2 / 5);
+            UNIT_ASSERT(IsSorted(sample[0].begin(), sample[0].end()));
+            for (int i : xrange(sample[0].size())) {
+                UNIT_ASSERT_VALUES_EQUAL(sample[1][i], sample[0][i] * 2);
+            }
+
+            options.RowLimit = 10;
+            const TRawPool limited = read();
+            UNIT_ASSERT_VALUES_EQUAL(limited[0].size(), 10);
+            UNIT_ASSERT(Equal(limited[0].begin(), limited[0].end(), sample[0].begin()));
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(ReadBinaryPool) {
+        SIMPLE_UNIT_TEST(SameAsGenericParser) {
+            TReallyFastRng32 rng(20170410);
+            const int lineCount = 300;
+            const int binCount = 37;
+
+            TStringStream ss;
+            for (int line : xrange(lineCount)) {
+                ss << rng.Uniform(5) * 0.5;
+                for (int bin : xrange(binCount)) {
+                    ss << '\t';
+                    // Some lines aren't fixed width, they take the generic path
+                    if (line % 7 == 0 && bin == 20) {
+                        ss << "1.0";
+                    } else {
+                        ss << rng.Uniform(2);
+                    }
+                }
+                ss << '\n';
+            }
+            const TString data = ss.Str();
+
+            TStringInput rawInput(data);
+            const TRawPool raw = ReadPool(rawInput);
+
+            auto queue = CreateMtpQueue(2);
+            TStringInput binaryInput(data);
+            const TBinaryPool binary = ReadBinaryPool(binaryInput, TReadPoolOptions(), 100, *queue);
+
+            UNIT_ASSERT_EQUAL(binary.Label, raw[0]);
+            UNIT_ASSERT_VALUES_EQUAL(binary.Bins.size(), binCount);
+            for (int bin : xrange(binCount)) {
+                UNIT_ASSERT_VALUES_EQUAL(binary.Bins[bin].size(), lineCount);
+                for (int line : xrange(lineCount)) {
+                    UNIT_ASSERT_VALUES_EQUAL(binary.Bins[bin][line], raw[bin + 1][line] == 1);
+                }
+            }
+        }
+
+        SIMPLE_UNIT_TEST(IncorrectData) {
+            for (const TString data : {"1\t0\t1\n0\t2\t1\n", "1\t0\t1\n0\t1\n", "1\t0\tx\n", "a\t0\t1\n"}) {
+                TStringInput si(data);
+                UNIT_ASSERT_EXCEPTION(ReadBinaryPool(si), yexception);
+            }
+        }
+
+        SIMPLE_UNIT_TEST(PackedRoundTrip) {
+            TReallyFastRng32 rng(20170620);
+            TBinaryPool pool;
+            const int lineCount = 130;
+            for (int line : xrange(lineCount)) {
+                pool.Label.push_back(rng.Uniform(4) * 0.5 + line);
+            }
+            for (int bin : xrange(5)) {
+                Y_UNUSED(bin);
+                TBin column(lineCount);
+                for (int line : xrange(lineCount)) {
+                    column[line] = rng.Uniform(2);
+                }
+                pool.Bins.push_back(std::move(column));
+            }
+            const yvector<int> map = {0, 0, 1, 2, 2};
+
+            TStringStream packed;
+            OutputPackedPool(pool, map, packed);
+            const TPackedPool restored = ReadPackedPool(packed);
+            UNIT_ASSERT_EQUAL(restored.Pool.Label, pool.Label);
+            UNIT_ASSERT_EQUAL(restored.Pool.Bins, pool.Bins);
+            UNIT_ASSERT_EQUAL(restored.BinToFeatureMap, map);
+
+            // 130 lines are 3 words, so the shards are 0, 64, 64 and 2 lines long
+            TBinaryPool merged;
+            merged.Bins.resize(pool.Bins.size());
+            for (size_t shard : xrange(4)) {
+                TStringInput shardInput(packed.Str());
+                const TPackedPool part = ReadPackedPoolShard(shardInput, shard, 4);
+                UNIT_ASSERT_VALUES_EQUAL(part.FirstLine, merged.Label.size());
+                UNIT_ASSERT_EQUAL(part.BinToFeatureMap, map);
+                merged.Label.insert(merged.Label.end(), part.Pool.Label.begin(), part.Pool.Label.end());
+                for (size_t bin : xrange(part.Pool.Bins.size())) {
+                    merged.Bins[bin].insert(merged.Bins[bin].end(), part.Pool.Bins[bin].begin(), part.Pool.Bins[bin].end());
+                }
+            }
+            UNIT_ASSERT_EQUAL(merged.Label, pool.Label);
+            UNIT_ASSERT_EQUAL(merged.Bins, pool.Bins);
+
+            TStringInput labelInput(packed.Str());
+            const TPackedPool labelOnly = ReadPackedPoolLabel(labelInput);
+            UNIT_ASSERT_EQUAL(labelOnly.Pool.Label, pool.Label);
+            UNIT_ASSERT(labelOnly.Pool.Bins.empty());
+
+            TStringStream truncated;
+            OutputPackedPool(pool, map, truncated);
+            TString data = truncated.Str();
+            data.resize(data.size() - 1);
+            TStringInput truncatedInput(data);
+            UNIT_ASSERT_EXCEPTION(ReadPackedPool(truncatedInput), yexception);
+
+            const TString tsv = "1\t0\t1\n";
+            TStringInput tsvInput(tsv);
+            UNIT_ASSERT_EXCEPTION(ReadPackedPool(tsvInput), yexception);
+
+            // Counts of a corrupt header are never allocated before the data is there
+            auto withCount = [&packed](size_t offset, ui64 count) {
+                TString data = packed.Str();
+                data.replace(offset, sizeof(count), reinterpret_cast<const char*>(&count), sizeof(count));
+                return data;
+            };
+            for (const TString& corrupt : {withCount(12, ui64(1) << 40), withCount(20, ui64(1) << 30), withCount(12, ui64(1) << 62)}) {
+                TStringInput corruptInput(corrupt);
+                UNIT_ASSERT_EXCEPTION(ReadPackedPool(corruptInput), yexception);
+            }
+
+            // Padding bits past the last line are ignored
+            TString padded = packed.Str();
+            padded.begin()[padded.size() - 1] |= 0x80;
+            TStringInput paddedInput(padded);
+            UNIT_ASSERT_EQUAL(ReadPackedPool(paddedInput).Pool.Bins, pool.Bins);
+        }
+    }
+
     SIMPLE_UNIT_TEST_SUITE(IO) {
+        SIMPLE_UNIT_TEST(OpenCompressedInput) {
+            const TString data = "1\t2\t3.4\n"
+                                 "0\t7\t8\n";
+            const TRawPool expected = {{1, 0}, {2, 7}, {3.4, 8}};
+
+            TStringStream gzipped;
+            {
+                TZLibCompress compress(&gzipped, ZLib::GZip);
+                compress << data;
+            }
+            TStringStream bgzf;
+            WriteBgzfBlock(data, bgzf);
+            WriteBgzfEof(bgzf);
+
+            for (const TString& input : {data, gzipped.Str(), bgzf.Str()}) {
+                UNIT_ASSERT_EQUAL(ReadPool(*OpenInput(new TStringInput(input), 2)), expected);
+            }
+        }
+
         SIMPLE_UNIT_TEST(ReadCorrectBinToFeaturesMap) {
             TReallyFastRng32 rng(20160126);
 
@@ -124,6 +376,56 @@ namespace NCmicot {
             UNIT_ASSERT_EQUAL(binCount, anotherBinCount);
         }
 
+        SIMPLE_UNIT_TEST(ParallelPoolWriter) {
+            TReallyFastRng32 rng(20170415);
+            const int lineCount = 5000;
+
+            auto randomBins = [&](int count) {
+                yvector<TBin> bins(count, TBin(lineCount));
+                for (auto& bin : bins) {
+                    for (int line : xrange(lineCount)) {
+                        bin[line] = rng.Uniform(2);
+                    }
+                }
+                return bins;
+            };
+            const TBinFeatureSet label(randomBins(3));
+            TBinFeatureSet features;
+            for (int featureIndex : xrange(40)) {
+                features.AddFeature(randomBins(1 + featureIndex % 4));
+            }
+
+            TStringStream expectedPool;
+            for (int line : xrange(lineCount)) {
+                ui64 labelValue = 0;
+                for (int bin : xrange(label.GetBinCount())) {
+                    labelValue |= static_cast<ui64>(label.GetBin(bin)[line]) << bin;
+                }
+                expectedPool << labelValue;
+                for (int bin : xrange(features.GetBinCount())) {
+                    expectedPool << '\t' << features.GetBin(bin)[line];
+                }
+                expectedPool << '\n';
+            }
+            TStringStream expectedMap;
+            for (int bin : xrange(features.GetBinCount())) {
+                expectedMap << features.GetFeatureIndexByBinIndex(bin) << '\t' << bin << '\n';
+            }
+
+            TPoolWriterOptions options;
+            options.ThreadCount = 3;
+            for (bool compress : {false, true}) {
+                options.Compress = compress;
+                TStringStream pool, map;
+                OutputPool(label, features, pool, options);
+                OutputBinFeatureMap(features, map, options);
+
+                UNIT_ASSERT_VALUES_EQUAL(OpenInput(new TStringInput(pool.Str()))->ReadAll(), expectedPool.Str());
+                UNIT_ASSERT_VALUES_EQUAL(OpenInput(new TStringInput(map.Str()))->ReadAll(), expectedMap.Str());
+                UNIT_ASSERT_VALUES_EQUAL(compress, IsBgzfHeader(pool.Str()));
+            }
+        }
+
         SIMPLE_UNIT_TEST(ReadBinToFeatureMapThrowsOnIncorrectData) {
             {
                 TStringStream ss("upyachka");
@@ -0,0 +1,47 @@
+#include "label_codes.h"
+#include "entropy_calculator.h"
+
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
+
+namespace NCmicot {
+    namespace {
+        double CodesEntropy(const yvector<ui32>& codes, ui32 classCount) {
+            TEntropyCalculator calc(codes.size());
+            calc.AddCodes(codes, classCount);
+            return calc.GetEntropy();
+        }
+    }
+
+    TLabelCodes::TLabelCodes(const TBinFeatureSet& label) {
+        Y_ENSURE(label.GetBinCount() > 0, "Label has no bins");
+        Y_ENSURE(label.GetBinCount() <= 64, "Label has " << label.GetBinCount() << " bins, at most 64 are supported");
+
+        yvector<ui64> rawCodes(label.GetBin(0).size(), 0);
+        for (int binIndex : label.AllBinIndexes()) {
+            label.GetBin(binIndex).ForEach([&rawCodes, binIndex](size_t i, bool bit) {
+                rawCodes[i] |= static_cast<ui64>(bit) << binIndex;
+            });
+        }
+
+        yvector<ui64> classes = rawCodes;
+        Sort(classes.begin(), classes.end());
+        classes.erase(Unique(classes.begin(), classes.end()), classes.end());
+
+        Codes.reserve(rawCodes.size());
+        for (ui64 rawCode : rawCodes) {
+            Codes.push_back(LowerBound(classes.begin(), classes.end(), rawCode) - classes.begin());
+        }
+        ClassCount = classes.size();
+        Entropy = CodesEntropy(Codes, ClassCount);
+    }
+
+    TLabelCodes::TLabelCodes(yvector<ui32> codes, ui32 classCount)
+        : Codes(std::move(codes))
+        , ClassCount(classCount)
+    {
+        Y_ENSURE(AllOf(Codes, [classCount](ui32 code) { return code < classCount; }),
+                 "Label code is out of range [0; " << classCount << ")");
+        Entropy = CodesEntropy(Codes, ClassCount);
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "bin_feature_set.h"
+
+#include <util/generic/ptr.h>
+#include <util/generic/vector.h>
+
+namespace NCmicot {
+    /// Label as a column of dense class ids 0..ClassCount-1. It is built once per pool and shared
+    /// read-only by all calculators, which count it as a single digit of radix ClassCount instead
+    /// of replaying every thermometer label bin as a separate bit.
+    class TLabelCodes {
+    public:
+        explicit TLabelCodes(const TBinFeatureSet& label);
+        TLabelCodes(yvector<ui32> codes, ui32 classCount);
+
+        const yvector<ui32>& GetCodes() const {
+            return Codes;
+        }
+
+        ui32 GetClassCount() const {
+            return ClassCount;
+        }
+
+        size_t size() const {
+            return Codes.size();
+        }
+
+        double GetEntropy() const {
+            return Entropy;
+        }
+
+    private:
+        yvector<ui32> Codes;
+        ui32 ClassCount;
+        double Entropy;
+    };
+
+    using TLabelCodesPtr = TAtomicSharedPtr<const TLabelCodes>;
+}
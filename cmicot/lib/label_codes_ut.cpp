@@ -0,0 +1,63 @@
+#include "label_codes.h"
+#include "cmi_calculator.h"
+#include "entropy.h"
+#include "test_pool_gen.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+
+namespace NCmicot {
+    SIMPLE_UNIT_TEST_SUITE(LabelCodes) {
+        SIMPLE_UNIT_TEST(DenseCodes) {
+            // Thermometer label with 3 levels: raw codes 0, 1 and 3
+            const TBinFeatureSet label({
+                {false, true, true, false, true},
+                {false, false, true, false, true},
+            });
+
+            const TLabelCodes codes(label);
+            UNIT_ASSERT_VALUES_EQUAL(codes.GetClassCount(), 3);
+            UNIT_ASSERT_VALUES_EQUAL(codes.GetCodes(), yvector<ui32>({0, 1, 2, 0, 2}));
+            UNIT_ASSERT_DOUBLES_EQUAL(codes.GetEntropy(), Entropy(label.AllBins()), 1e-8);
+        }
+
+        SIMPLE_UNIT_TEST(InvalidCodes) {
+            UNIT_ASSERT_EXCEPTION(TLabelCodes(yvector<ui32>({0, 1, 5}), 3), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(CmiDoesntDependOnLabelRepresentation) {
+            TReallyFastRng32 rng(20170412);
+            const int binSize = 2000;
+
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {8, 8});
+            const TLabelCodes codes(label);
+            UNIT_ASSERT(codes.GetClassCount() <= 256);
+
+            TCmiCalculator byBins(binSize);
+            for (const TBin& bin : label.AllBins()) {
+                byBins.AddFirstVariableBin(bin);
+            }
+            TCmiCalculator byCodes(binSize);
+            byCodes.AddFirstVariableCodes(codes);
+
+            for (int step : xrange(5)) {
+                Y_UNUSED(step);
+                const TBin second = RandomBin(binSize, rng);
+                const TBin condition = RandomBin(binSize, rng);
+                const TBin extra = RandomBin(binSize, rng);
+
+                for (TCmiCalculator* calc : {&byBins, &byCodes}) {
+                    calc->AddSecondVariableBin(second);
+                    calc->AddConditionBin(condition);
+                }
+
+                UNIT_ASSERT_DOUBLES_EQUAL(byBins.GetValue(), byCodes.GetValue(), 1e-8);
+                UNIT_ASSERT_DOUBLES_EQUAL(byBins.GetValueWithConditionBin(extra),
+                                          byCodes.GetValueWithConditionBin(extra), 1e-8);
+            }
+        }
+    }
+}
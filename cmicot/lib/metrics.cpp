@@ -0,0 +1,64 @@
+#include "metrics.h"
+
+#include <library/json/writer/json.h>
+
+#include <util/stream/output.h>
+
+namespace NCmicot {
+    namespace NPrivate {
+        thread_local TKernelCounters* ThreadKernelCounters = nullptr;
+    }
+
+    TKernelCounters& TKernelCounters::operator+=(const TKernelCounters& other) {
+        Evaluations += other.Evaluations;
+        CmiCalls += other.CmiCalls;
+        MaxStepsReused += other.MaxStepsReused;
+        MaxStepsRecomputed += other.MaxStepsRecomputed;
+        MinStepsReused += other.MinStepsReused;
+        MinStepsRecomputed += other.MinStepsRecomputed;
+        VectorCounters += other.VectorCounters;
+        HashCounters += other.HashCounters;
+        return *this;
+    }
+
+    void CountEvaluation(int maxReused, int maxRecomputed, int minReused, int minRecomputed) {
+        TKernelCounters* counters = GetThreadKernelCounters();
+        if (!counters) {
+            return;
+        }
+        ++counters->Evaluations;
+        counters->MaxStepsReused += maxReused;
+        counters->MaxStepsRecomputed += maxRecomputed;
+        counters->MinStepsReused += minReused;
+        counters->MinStepsRecomputed += minRecomputed;
+    }
+
+    void OutputStepMetrics(const TSelectionStepMetrics& metrics, IOutputStream& out) {
+        const TKernelCounters& kernels = metrics.Kernels;
+        const char* counterType = "none";
+        if (kernels.VectorCounters > 0) {
+            counterType = kernels.HashCounters > 0 ? "mixed" : "vector";
+        } else if (kernels.HashCounters > 0) {
+            counterType = "hash";
+        }
+
+        NJsonWriter::TBuf json;
+        json.BeginObject()
+            .WriteKey("step").WriteInt(metrics.Step)
+            .WriteKey("feature").WriteInt(metrics.SelectedFeature)
+            .WriteKey("wall_seconds").WriteDouble(metrics.WallSeconds)
+            .WriteKey("candidates").WriteULongLong(metrics.Candidates)
+            .WriteKey("score").WriteDouble(metrics.Score)
+            .WriteKey("evaluations").WriteULongLong(kernels.Evaluations)
+            .WriteKey("cmi_calls").WriteULongLong(kernels.CmiCalls)
+            .WriteKey("max_steps_reused").WriteULongLong(kernels.MaxStepsReused)
+            .WriteKey("max_steps_recomputed").WriteULongLong(kernels.MaxStepsRecomputed)
+            .WriteKey("min_steps_reused").WriteULongLong(kernels.MinStepsReused)
+            .WriteKey("min_steps_recomputed").WriteULongLong(kernels.MinStepsRecomputed)
+            .WriteKey("vector_counters").WriteULongLong(kernels.VectorCounters)
+            .WriteKey("hash_counters").WriteULongLong(kernels.HashCounters)
+            .WriteKey("counter_type").WriteString(counterType)
+        .EndObject();
+        out << json.Str() << '\n';
+    }
+}
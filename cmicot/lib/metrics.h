@@ -0,0 +1,86 @@
+#pragma once
+
+#include <util/system/types.h>
+
+class IOutputStream;
+
+namespace NCmicot {
+    /// Counts of the selection kernels. They are counted only on the threads which have a target
+    /// installed by TKernelCountersGuard, into plain per-thread counters, so the kernels never write
+    /// memory shared by threads. Without a target counting costs a single pointer check.
+    struct TKernelCounters {
+        ui64 Evaluations = 0;
+        ui64 CmiCalls = 0;
+        ui64 MaxStepsReused = 0;
+        ui64 MaxStepsRecomputed = 0;
+        ui64 MinStepsReused = 0;
+        ui64 MinStepsRecomputed = 0;
+        ui64 VectorCounters = 0;
+        ui64 HashCounters = 0;
+
+        TKernelCounters& operator+=(const TKernelCounters& other);
+    };
+
+    namespace NPrivate {
+        extern thread_local TKernelCounters* ThreadKernelCounters;
+    }
+
+    /// Target of the kernel counts of the current thread, nullptr if they aren't counted.
+    inline TKernelCounters* GetThreadKernelCounters() {
+        return NPrivate::ThreadKernelCounters;
+    }
+
+    /// Counts the kernels of the current thread into counters while it lives, and restores the
+    /// previous target after that. Tasks of ParallelMinElementBy and ParallelMaxElementBy count into
+    /// the target of the thread which runs them.
+    class TKernelCountersGuard {
+    public:
+        explicit TKernelCountersGuard(TKernelCounters* counters)
+            : Previous(NPrivate::ThreadKernelCounters)
+        {
+            NPrivate::ThreadKernelCounters = counters;
+        }
+
+        ~TKernelCountersGuard() {
+            NPrivate::ThreadKernelCounters = Previous;
+        }
+
+        TKernelCountersGuard(const TKernelCountersGuard&) = delete;
+        TKernelCountersGuard& operator=(const TKernelCountersGuard&) = delete;
+
+    private:
+        TKernelCounters* Previous;
+    };
+
+    inline void CountCmiCall() {
+        if (TKernelCounters* counters = GetThreadKernelCounters()) {
+            ++counters->CmiCalls;
+        }
+    }
+
+    inline void CountFrequencyCounter(bool isHash) {
+        if (TKernelCounters* counters = GetThreadKernelCounters()) {
+            ++(isHash ? counters->HashCounters : counters->VectorCounters);
+        }
+    }
+
+    /// Step counts of a single TCachingBinScorer evaluation.
+    void CountEvaluation(int maxReused, int maxRecomputed, int minReused, int minRecomputed);
+
+    /// What one step of the outer selection loop did.
+    struct TSelectionStepMetrics {
+        /// Number of features selected after this step.
+        int Step = 0;
+        int SelectedFeature = -1;
+        double WallSeconds = 0.0;
+        /// Bins scored to choose the feature.
+        ui64 Candidates = 0;
+        /// Score of the best bin of the feature: its mutual information with the label at the first
+        /// step, and its TCachingBinScorer score later.
+        double Score = 0.0;
+        TKernelCounters Kernels;
+    };
+
+    /// Writes the metrics as a single line JSON object.
+    void OutputStepMetrics(const TSelectionStepMetrics& metrics, IOutputStream& out);
+}
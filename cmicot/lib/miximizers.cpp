@@ -1,21 +1,27 @@
 #include "miximizers.h"
 #include "algorithm.h"
+#include "trace.h"
 
 namespace NCmicot {
     TParallelMiximizer::TParallelMiximizer(const TBinFeatureSet& label, int maximizeSteps,
                                            int minimizeSteps, int maxParallel)
-        : Cmi(label.GetBin(0).size())
+        : TParallelMiximizer(TLabelCodes(label), maximizeSteps, minimizeSteps, maxParallel)
+    {
+    }
+
+    TParallelMiximizer::TParallelMiximizer(const TLabelCodes& label, int maximizeSteps,
+                                           int minimizeSteps, int maxParallel)
+        : Cmi(label.size())
         , MaxSteps(maximizeSteps)
         , MinSteps(minimizeSteps)
         , MaxParallel(maxParallel)
     {
-        for (const TBin& bin : label.AllBins()) {
-            Cmi.AddFirstVariableBin(bin);
-        }
+        Cmi.AddFirstVariableCodes(label);
     }
 
     yvector<TStepResult> TParallelMiximizer::DoMaximizePhase(TBackground& bg, int evalBinIndex) {
-        Y_ENSURE(bg.EnabledBins().ysize() >= MaxSteps,
+        TTraceSpan span("MaximizePhase", "bin", evalBinIndex);
+        Y_ENSURE(bg.EnabledBinCount() >= MaxSteps,
                  "Not enough enabled bins, must be at least " << MaxSteps);
 
         auto localBg = bg;
@@ -45,7 +51,8 @@ namespace NCmicot {
 
     yvector<TStepResult> TParallelMiximizer::DoMinimizePhase(TBackground& bg, int evalBinIndex,
                                                              const yvector<TStepResult>& maxSteps) {
-        Y_ENSURE(bg.EnabledBins().ysize() >= MinSteps,
+        TTraceSpan span("MinimizePhase", "bin", evalBinIndex);
+        Y_ENSURE(bg.EnabledBinCount() >= MinSteps,
                  "Not enough enabled bins, must be at least " << MinSteps);
 
         yvector<TStepResult> result;
@@ -19,6 +19,8 @@ namespace NCmicot {
     public:
         TParallelMiximizer(const TBinFeatureSet& label, int maximizeSteps, int minimizeSteps,
                            int maxParallel);
+        TParallelMiximizer(const TLabelCodes& label, int maximizeSteps, int minimizeSteps,
+                           int maxParallel);
 
         yvector<TStepResult> DoMaximizePhase(TBackground& bg, int evalBinIndex) override;
         yvector<TStepResult> DoMinimizePhase(TBackground& bg, int evalBinIndex,
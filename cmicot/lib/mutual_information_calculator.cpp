@@ -2,16 +2,27 @@
 #include "entropy.h"
 
 namespace NCmicot {
-    void TMutualInformationCalculator::AddFirstVariableBin(const TBin& bin) {
+    void TMutualInformationCalculator::AddFirstVariableBin(TBinRef bin) {
         First.AddBin(bin);
     }
 
-    TMutualInformationCalculator::TMutualInformationCalculator(size_t binSize)
-        : First(binSize)
+    void TMutualInformationCalculator::AddFirstVariableCodes(const TLabelCodes& codes) {
+        First.AddCodes(codes.GetCodes(), codes.GetClassCount());
+    }
+
+    TMutualInformationCalculator::TMutualInformationCalculator(size_t binSize, TLineWeightsPtr weights)
+        : First(binSize, weights)
     {
+        if (weights) {
+            WeightedLines.ConstructInPlace(binSize, std::move(weights));
+        }
+    }
+
+    double TMutualInformationCalculator::GetValueWithSecondVariableBin(TBinRef bin) const {
+        return GetValueWithSecondVariableBin(bin, WeightedLines ? WeightedLines->GetEntropyWithExtraBin(bin) : Entropy(bin));
     }
 
-    double TMutualInformationCalculator::GetValueWithSecondVariableBin(const TBin& bin) const {
-        return First.GetEntropy() + Entropy(bin) - First.GetEntropyWithExtraBin(bin);
+    double TMutualInformationCalculator::GetValueWithSecondVariableBin(TBinRef bin, double binEntropy) const {
+        return MutualInformation(First.GetEntropy(), binEntropy, First.GetEntropyWithExtraBin(bin));
     }
 }
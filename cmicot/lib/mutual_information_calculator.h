@@ -2,16 +2,32 @@
 
 #include "binarize.h"
 #include "entropy_calculator.h"
+#include "label_codes.h"
+
+#include <util/generic/maybe.h>
 
 namespace NCmicot {
+    /// Mutual information of two variables from their entropies and the entropy of the pair. Every
+    /// kernel counting it from separately computed entropies uses this, so all of them give exactly
+    /// the values of TMutualInformationCalculator.
+    inline double MutualInformation(double firstEntropy, double secondEntropy, double jointEntropy) {
+        return firstEntropy + secondEntropy - jointEntropy;
+    }
+
     class TMutualInformationCalculator {
     public:
-        TMutualInformationCalculator(size_t binSize);
+        /// With weights, every line counts as many times as its weight, see TLineWeights.
+        TMutualInformationCalculator(size_t binSize, TLineWeightsPtr weights = nullptr);
 
-        void AddFirstVariableBin(const TBin& bin);
-        double GetValueWithSecondVariableBin(const TBin& bin) const;
+        void AddFirstVariableBin(TBinRef bin);
+        void AddFirstVariableCodes(const TLabelCodes& codes);
+        double GetValueWithSecondVariableBin(TBinRef bin) const;
+        /// Same as above for a bin with a known entropy, which doesn't depend on the first variable.
+        double GetValueWithSecondVariableBin(TBinRef bin, double binEntropy) const;
 
     private:
         TEntropyCalculator First;
+        /// Weighted calculator without variables for the entropy of a bin, only with weights.
+        TMaybe<TEntropyCalculator> WeightedLines;
     };
 }
@@ -4,8 +4,12 @@
 
 #include <util/stream/input.h>
 #include <util/stream/file.h>
+#include <util/generic/algorithm.h>
 #include <util/generic/hash.h>
+#include <util/generic/xrange.h>
 #include <util/string/join.h>
+#include <util/string/cast.h>
+#include <util/string/iterator.h>
 #include <util/string/split.h>
 
 extern const TString& NCmicotEBinScoreNormalizationAllNames();
@@ -25,12 +29,69 @@ namespace NCmicot {
         dest = value;
     }
 
+    yvector<int> ParseColumnList(const TString& list) {
+        yvector<int> result;
+        for (const auto& it : StringSplitter(list).Split(',')) {
+            const TStringBuf item = it.Token();
+            TStringBuf first, last;
+            if (item.TrySplit('-', first, last)) {
+                const int from = FromString<int>(first);
+                const int to = FromString<int>(last);
+                Y_ENSURE(from <= to, "Incorrect column range " << item);
+                for (int column = from; column <= to; ++column) {
+                    result.push_back(column);
+                }
+            } else {
+                result.push_back(FromString<int>(item));
+            }
+        }
+        return result;
+    }
+
+    namespace {
+        using TBinBuilder = std::function<NSplitSelection::IBinarizer*()>;
+
+        const yhash<TString, TBinBuilder>& GetBuilderByName() {
+            static const yhash<TString, TBinBuilder> builderByName = {
+                {"medianPlusUniform", [] { return new NSplitSelection::TMedianPlusUniformBinarizer; }},
+                {"median", [] { return new NSplitSelection::TMedianBinarizer; }},
+                {"minEntropy", [] { return new NSplitSelection::TMinEntropyBinarizer; }},
+                {"medianInBin", [] { return new NSplitSelection::TMedianInBinBinarizer; }},
+                {"maxSumLog", [] { return new NSplitSelection::TMaxSumLogBinarizer; }},
+            };
+            return builderByName;
+        }
+    }
+
+    yvector<TString> GetBinarizerNames() {
+        return Keys(GetBuilderByName());
+    }
+
+    THolder<NSplitSelection::IBinarizer> CreateBinarizer(const TString& name) {
+        const auto it = GetBuilderByName().find(name);
+        Y_ENSURE(it != GetBuilderByName().end(), "Unknown binarization " << name << ", should be one of: " << JoinSeq(", ", GetBinarizerNames()));
+        return THolder<NSplitSelection::IBinarizer>(it->second());
+    }
+
     NLastGetopt::TOpts CreateCommandLineOptions(TOptions& opts) {
         auto result = NLastGetopt::TOpts::Default();
 
         result.AddCharOption('t', "Eval algorithm step count")
               .DefaultValue("6")
               .Handler1T<int>([&](int value) { EnsurePositive(value, opts.EvalStepCount); });
+        result.AddLongOption("t-sweep", "Rank the features for every -t of the range FROM..TO in a single run instead of for -t. Every output line is the -t and a feature")
+              .RequiredArgument("FROM..TO")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  TStringBuf from, to;
+                  Y_ENSURE(TStringBuf(param).TrySplit("..", from, to), "-t sweep should be given as FROM..TO");
+                  const int first = FromString<int>(from);
+                  const int last = FromString<int>(to);
+                  Y_ENSURE(0 < first && first <= last, "-t sweep should be a non-empty range of positive values");
+                  opts.EvalStepSweep.clear();
+                  for (int stepCount : xrange(first, last + 1)) {
+                      opts.EvalStepSweep.push_back(stepCount);
+                  }
+              });
         result.AddLongOption("thread-count", "Threads to use during maximization and minimization")
               .RequiredArgument()
               .Handler1T<int>([&](int value) { EnsurePositive(value, opts.ThreadCount); })
@@ -42,30 +103,83 @@ namespace NCmicot {
         result.AddLongOption("map", "File with feature-bin map")
               .RequiredArgument()
               .StoreResultT<TString>(&opts.FeatureBinMapFilename);
+        result.AddLongOption("packed-pool", "File with binarized pool and feature-bin map in the packed format of cmicot-pool-gen. This option can't be used with --pool, --binary-pool and --map")
+              .RequiredArgument()
+              .StoreResultT<TString>(&opts.PackedPoolFilename);
+        result.AddLongOption("window", "Directory with a sliding window of packed pool blocks, which is selected over instead of a pool. It is created if it doesn't exist")
+              .RequiredArgument("DIR")
+              .StoreResultT<TString>(&opts.WindowDirectory);
+        result.AddLongOption("append-block", "Packed pool to append to --window as its newest block before the selection")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.AppendBlockFilename);
+        result.AddLongOption("window-blocks", "Retire the oldest blocks of --window before the selection, so that at most this many are left")
+              .RequiredArgument("BLOCK COUNT")
+              .Handler1T<size_t>([&opts](size_t blockCount) {
+                  Y_ENSURE(blockCount > 0, "Window block count should be positive");
+                  opts.WindowBlockCount = blockCount;
+              });
         result.AddLongOption("pool", "File with raw pool. This is option can't be used with --binary-pool and --map")
               .RequiredArgument()
               .StoreResultT<TString>(&opts.RawPoolFilename);
+        result.AddLongOption("use-columns", "Columns of --pool to read, e.g. 1,3,5-8. Column 0 is the label and it is always read")
+              .RequiredArgument("COLUMNS")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.ReadPoolOptions.UseColumns = ParseColumnList(param);
+              });
+        result.AddLongOption("ignore-columns", "Columns of --pool to skip, e.g. 2,10-20. Can't be used with --use-columns")
+              .RequiredArgument("COLUMNS")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.ReadPoolOptions.IgnoreColumns = ParseColumnList(param);
+              });
+        result.AddLongOption("label-columns", "Columns of --pool which are labels, starting with column 0, e.g. 0,1,2. Features are ranked for every label, and every output line is the label column and a feature")
+              .RequiredArgument("COLUMNS")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.LabelColumns = ParseColumnList(param);
+                  Y_ENSURE(opts.LabelColumns.front() == 0, "Label columns should start with column 0");
+                  yvector<int> sorted = opts.LabelColumns;
+                  Sort(sorted.begin(), sorted.end());
+                  Y_ENSURE(Unique(sorted.begin(), sorted.end()) == sorted.end(), "Label columns should be different");
+              });
+        result.AddLongOption("row-sample-rate", "Fraction of pool lines to read, each line is kept independently with this probability")
+              .RequiredArgument("RATE")
+              .Handler1T<double>([&opts](double rate) {
+                  Y_ENSURE(rate > 0 && rate <= 1, "Row sample rate should be in (0, 1]");
+                  opts.ReadPoolOptions.RowSampleRate = rate;
+              });
+        result.AddLongOption("row-limit", "Stop reading the pool after this many lines are kept")
+              .RequiredArgument("LINE COUNT")
+              .Handler1T<ui64>([&opts](ui64 limit) {
+                  Y_ENSURE(limit > 0);
+                  opts.ReadPoolOptions.RowLimit = limit;
+              });
+        result.AddLongOption("seed", "Random seed for --row-sample-rate, --bootstrap and --permutations")
+              .RequiredArgument()
+              .StoreResult(&opts.ReadPoolOptions.Seed)
+              .DefaultValue("0");
         result.AddLongOption("select-count", "How many features should be selected")
               .RequiredArgument("FEATURE COUNT")
               .Handler1T<int>([&](int featureCount) {
                   Y_ENSURE(featureCount > 0);
                   opts.FeatureCountToSelect = featureCount;
               });
+        result.AddLongOption("bootstrap", "Select --select-count features in every of R bootstrap replicas of the pool, and output how often every feature is selected. Every output line is a feature and its selection frequency")
+              .RequiredArgument("R")
+              .Handler1T<int>([&opts](int replicaCount) {
+                  Y_ENSURE(replicaCount > 0, "Bootstrap replica count should be positive");
+                  opts.BootstrapReplicaCount = replicaCount;
+              });
+        result.AddLongOption("permutations", "Test the score of every selected feature against P permutations of the label. Every output line is a feature and its p-value")
+              .RequiredArgument("P")
+              .Handler1T<int>([&opts](int permutationCount) {
+                  Y_ENSURE(permutationCount > 0, "Permutation count should be positive");
+                  opts.PermutationCount = permutationCount;
+              });
 
-        using TBinBuilder = std::function<NSplitSelection::IBinarizer*()>;
-        static const yhash<TString, TBinBuilder> builderByName = {
-            {"medianPlusUniform", [] { return new NSplitSelection::TMedianPlusUniformBinarizer; }},
-            {"median", [] { return new NSplitSelection::TMedianBinarizer; }},
-            {"minEntropy", [] { return new NSplitSelection::TMinEntropyBinarizer; }},
-            {"medianInBin", [] { return new NSplitSelection::TMedianInBinBinarizer; }},
-            {"maxSumLog", [] { return new NSplitSelection::TMaxSumLogBinarizer; }},
-        };
-
-        const TString help = "Binarization mode. Should be one of: " + JoinSeq(", ", Keys(builderByName));
+        const TString help = "Binarization mode. Should be one of: " + JoinSeq(", ", GetBinarizerNames());
         result.AddLongOption("binarization", help)
               .RequiredArgument()
               .Handler1T<TString>([&opts](const TString& param) {
-                  opts.Binarizer = builderByName.at(param)();
+                  opts.Binarizer = CreateBinarizer(param);
               })
               .DefaultValue("medianPlusUniform");
 
@@ -74,6 +188,17 @@ namespace NCmicot {
               .Handler1T<int>([&](int value) { EnsurePositive(value, opts.BorderCount); })
               .DefaultValue("10");
 
+        static const yhash<TString, EFeatureStorage> storageByName = {
+            {"bins", EFeatureStorage::Bins},
+            {"levels", EFeatureStorage::Levels},
+        };
+        result.AddLongOption("feature-storage", "How binarized features of --pool are kept in memory. Should be one of: " + JoinSeq(", ", Keys(storageByName)))
+              .RequiredArgument()
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.FeatureStorage = storageByName.at(param);
+              })
+              .DefaultValue("bins");
+
         result.AddLongOption("just-binarize", "Output binarized pool and feature-bin map instead of doing feature selection. Please provide filenames where pool and map should be stored separated by a comma")
               .RequiredArgument("PoolFile,MapFile")
               .Handler1T<TString>([&opts](const TString& param) {
@@ -83,6 +208,72 @@ namespace NCmicot {
                   opts.FeatureBinMapOutputFile = mapFile;
               });
 
+        result.AddLongOption("initial-features", "File with features (one index per line) which are taken as already selected. Only the rest of the features is ranked")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.InitialFeaturesFile);
+        result.AddLongOption("checkpoint", "Save the selection state to this file after every selected feature")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.CheckpointFile);
+        result.AddLongOption("resume", "Continue the selection from --checkpoint file if it exists")
+              .NoArgument()
+              .SetFlag(&opts.Resume);
+        result.AddLongOption("metrics-file", "Write timings and kernel counters of every selection step to this file as JSON lines")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.MetricsFile);
+        result.AddLongOption("trace", "Record reading, binarization and selection spans of all threads and write them to this file in Chrome trace-event format")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.TraceFile);
+        result.AddLongOption("perf-counters", "Measure cycles, instructions, LLC and branch misses of the hot kernels and print them to stderr at the end")
+              .NoArgument()
+              .SetFlag(&opts.PerfCounters);
+        result.AddLongOption("shard-workers", "Comma separated local sockets of --serve-shard workers. The selection over --packed-pool merges the counts of the workers, which own all of its lines")
+              .RequiredArgument("SOCKETS")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.ShardWorkers.clear();
+                  for (const auto& it : StringSplitter(param).Split(',')) {
+                      opts.ShardWorkers.push_back(TString(it.Token()));
+                  }
+              });
+        result.AddLongOption("shard-processes", "Split the lines of --packed-pool between this many forked worker processes and merge their counts")
+              .RequiredArgument("COUNT")
+              .Handler1T<int>([&opts](int param) { EnsurePositive(param, opts.ShardProcesses); });
+        result.AddLongOption("serve-shard", "Serve the lines of --shard of --packed-pool to a coordinator connecting to this local socket instead of doing feature selection")
+              .RequiredArgument("SOCKET")
+              .StoreResultT<TString>(&opts.ServeShardSocket);
+        result.AddLongOption("candidate-workers", "Comma separated local sockets of --serve-candidates workers, which hold the whole pool and score its candidate bins in turn")
+              .RequiredArgument("SOCKETS")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  opts.CandidateWorkers.clear();
+                  for (const auto& it : StringSplitter(param).Split(',')) {
+                      opts.CandidateWorkers.push_back(TString(it.Token()));
+                  }
+              });
+        result.AddLongOption("candidate-processes", "Split the candidate bins between this many forked worker processes, which share the read pool")
+              .RequiredArgument("COUNT")
+              .Handler1T<int>([&opts](int param) { EnsurePositive(param, opts.CandidateProcesses); });
+        result.AddLongOption("serve-candidates", "Score the candidate bins of --shard for a coordinator connecting to this local socket instead of doing feature selection")
+              .RequiredArgument("SOCKET")
+              .StoreResultT<TString>(&opts.ServeCandidatesSocket);
+        result.AddLongOption("shard", "Shard of --serve-shard or --serve-candidates as INDEX/COUNT, e.g. 0/4")
+              .RequiredArgument("INDEX/COUNT")
+              .Handler1T<TString>([&opts](const TString& param) {
+                  TStringBuf index, count;
+                  Y_ENSURE(TStringBuf(param).TrySplit('/', index, count), "Shard should be given as INDEX/COUNT");
+                  opts.ShardIndex = FromString<int>(index);
+                  opts.ShardCount = FromString<int>(count);
+                  Y_ENSURE(0 <= opts.ShardIndex && opts.ShardIndex < opts.ShardCount, "Shard index should be in [0; COUNT)");
+              })
+              .DefaultValue("0/1");
+        result.AddLongOption("serve", "Keep pools loaded and serve selection requests at this local socket until a shutdown request. The other options are ignored, except --thread-count")
+              .RequiredArgument("SOCKET")
+              .StoreResultT<TString>(&opts.ServeSocket);
+        result.AddLongOption("jobs", "Run the selections listed in this file, a line per job: the output file, then -t, --thread-count, --select-count, --candidates and --initial-features of the job. The pool is read once and --thread-count jobs run at a time")
+              .RequiredArgument("FILE")
+              .StoreResultT<TString>(&opts.JobsFile);
+        result.AddLongOption("compress-output", "Write the files of --just-binarize gzip-compressed (in BGZF blocks)")
+              .NoArgument()
+              .SetFlag(&opts.CompressOutput);
+
         result.SetFreeArgsMax(0);
 
         return result;
@@ -1,10 +1,14 @@
 #pragma once
 
+#include "binarize.h"
+#include "io.h"
+
 #include <library/getopt/last_getopt.h>
 
 #include <util/generic/ptr.h>
 #include <util/generic/string.h>
 #include <util/generic/maybe.h>
+#include <util/generic/vector.h>
 
 namespace NSplitSelection {
     class IBinarizer;
@@ -14,15 +18,55 @@ namespace NCmicot {
     struct TOptions {
         int ThreadCount;
         int EvalStepCount;
+        /// -t values of --t-sweep, empty without it.
+        yvector<int> EvalStepSweep;
         TMaybe<TString> RawPoolFilename;
         TMaybe<TString> BinaryPoolFilename;
         TMaybe<TString> FeatureBinMapFilename;
+        TMaybe<TString> PackedPoolFilename;
+        TMaybe<TString> WindowDirectory;
+        TMaybe<TString> AppendBlockFilename;
+        /// Blocks of --window-blocks, the window keeps all of them without it.
+        TMaybe<size_t> WindowBlockCount;
         TMaybe<TString> BinaryPoolOutputFile;
         TMaybe<TString> FeatureBinMapOutputFile;
         TMaybe<int> FeatureCountToSelect;
+        /// Replicas of --bootstrap, 0 without it.
+        int BootstrapReplicaCount = 0;
+        /// Label permutations of --permutations, 0 without it.
+        int PermutationCount = 0;
         THolder<NSplitSelection::IBinarizer> Binarizer;
         int BorderCount;
+        EFeatureStorage FeatureStorage = EFeatureStorage::Bins;
+        TReadPoolOptions ReadPoolOptions;
+        /// Columns of --pool which are labels, column 0 first. Empty if column 0 is the only label.
+        yvector<int> LabelColumns;
+        bool CompressOutput = false;
+        TMaybe<TString> CheckpointFile;
+        bool Resume = false;
+        TMaybe<TString> InitialFeaturesFile;
+        TMaybe<TString> MetricsFile;
+        TMaybe<TString> TraceFile;
+        bool PerfCounters = false;
+        yvector<TString> ShardWorkers;
+        int ShardProcesses = 0;
+        TMaybe<TString> ServeShardSocket;
+        int ShardIndex = 0;
+        int ShardCount = 1;
+        yvector<TString> CandidateWorkers;
+        int CandidateProcesses = 0;
+        TMaybe<TString> ServeCandidatesSocket;
+        TMaybe<TString> ServeSocket;
+        TMaybe<TString> JobsFile;
     };
 
+    /// Names of the --binarization modes.
+    yvector<TString> GetBinarizerNames();
+    /// Binarizer of --binarization mode name. Throws if there is no such mode.
+    THolder<NSplitSelection::IBinarizer> CreateBinarizer(const TString& name);
+
+    /// Parses a comma separated list of indexes and closed ranges, e.g. "1,3,5-8".
+    yvector<int> ParseColumnList(const TString& list);
+
     NLastGetopt::TOpts CreateCommandLineOptions(TOptions& opts);
 }
@@ -0,0 +1,260 @@
+#include "perf_counters.h"
+
+#include <util/generic/singleton.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/stream/format.h>
+#include <util/stream/output.h>
+#include <util/string/cast.h>
+#include <util/system/error.h>
+#include <util/system/guard.h>
+#include <util/system/mutex.h>
+
+#if defined(_linux_)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+namespace NCmicot {
+    namespace NPrivate {
+        TAtomic PerfCountersEnabled = 0;
+    }
+
+    namespace {
+        constexpr size_t REGION_COUNT = static_cast<size_t>(EPerfRegion::Count);
+        constexpr size_t COUNTER_COUNT = static_cast<size_t>(EPerfCounter::Count);
+
+        const char* const REGION_NAMES[REGION_COUNT] = {
+            "entropy counting",
+            "code building",
+            "binarization compare",
+            "tsv parsing",
+            "binary parsing",
+        };
+
+        const char* const COUNTER_NAMES[COUNTER_COUNT] = {
+            "cycles",
+            "instructions",
+            "llc misses",
+            "branch misses",
+        };
+
+        struct TRegionTotals {
+            ui64 Calls = 0;
+            NHPTimer::STime Time = 0;
+            ui64 Counters[COUNTER_COUNT] = {};
+
+            void Add(const TRegionTotals& other) {
+                Calls += other.Calls;
+                Time += other.Time;
+                for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+                    Counters[i] += other.Counters[i];
+                }
+            }
+        };
+
+        /// Hardware counters of the calling thread, opened as one group so that they are read by a
+        /// single syscall. Counters which can't be opened read as zero.
+        class TCounterGroup {
+        public:
+            TCounterGroup() {
+#if defined(_linux_)
+                static const ui64 CONFIGS[COUNTER_COUNT][2] = {
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+                    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                };
+                for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+                    perf_event_attr attr;
+                    memset(&attr, 0, sizeof(attr));
+                    attr.size = sizeof(attr);
+                    attr.type = CONFIGS[counter][0];
+                    attr.config = CONFIGS[counter][1];
+                    attr.read_format = PERF_FORMAT_GROUP;
+                    // User space only, which is allowed with the default perf_event_paranoid
+                    attr.exclude_kernel = 1;
+                    attr.exclude_hv = 1;
+
+                    const int fd = syscall(__NR_perf_event_open, &attr, 0, -1, LeaderFd, 0);
+                    if (fd < 0) {
+                        FailedCounters |= 1 << counter;
+                        if (!Error) {
+                            Error = TString(COUNTER_NAMES[counter]) + ": " + LastSystemErrorText();
+                        }
+                        continue;
+                    }
+                    if (LeaderFd < 0) {
+                        LeaderFd = fd;
+                    }
+                    Fds.push_back(fd);
+                    Counters.push_back(counter);
+                }
+#else
+                FailedCounters = (1 << COUNTER_COUNT) - 1;
+                Error = "perf_event_open is only available on Linux";
+#endif
+            }
+
+            ~TCounterGroup() {
+#if defined(_linux_)
+                for (int fd : Fds) {
+                    close(fd);
+                }
+#endif
+            }
+
+            void Read(ui64* counters) const {
+                memset(counters, 0, COUNTER_COUNT * sizeof(ui64));
+#if defined(_linux_)
+                if (LeaderFd < 0) {
+                    return;
+                }
+                ui64 values[1 + COUNTER_COUNT];
+                const ssize_t size = read(LeaderFd, values, sizeof(values));
+                if (size < static_cast<ssize_t>(sizeof(ui64))) {
+                    return;
+                }
+                for (size_t i = 0; i < values[0] && i < Counters.size(); ++i) {
+                    counters[Counters[i]] = values[1 + i];
+                }
+#endif
+            }
+
+            ui32 GetFailedCounters() const {
+                return FailedCounters;
+            }
+
+            const TString& GetError() const {
+                return Error;
+            }
+
+        private:
+            int LeaderFd = -1;
+            yvector<int> Fds;
+            yvector<size_t> Counters;
+            ui32 FailedCounters = 0;
+            TString Error;
+        };
+
+        struct TThreadState;
+
+        struct TPerfRegistry {
+            TMutex Lock;
+            yvector<TThreadState*> LiveThreads;
+            TRegionTotals FinishedThreads[REGION_COUNT];
+            ui32 FailedCounters = 0;
+            TString Error;
+        };
+
+        /// Counters and totals of a thread. Totals are moved to the registry when the thread exits,
+        /// pool threads don't live until the report.
+        struct TThreadState {
+            TCounterGroup Group;
+            TRegionTotals Totals[REGION_COUNT];
+
+            TThreadState() {
+                TPerfRegistry& registry = *Singleton<TPerfRegistry>();
+                with_lock (registry.Lock) {
+                    registry.LiveThreads.push_back(this);
+                    registry.FailedCounters |= Group.GetFailedCounters();
+                    if (!registry.Error && Group.GetError()) {
+                        registry.Error = Group.GetError();
+                    }
+                }
+            }
+
+            ~TThreadState() {
+                TPerfRegistry& registry = *Singleton<TPerfRegistry>();
+                with_lock (registry.Lock) {
+                    for (size_t region = 0; region < REGION_COUNT; ++region) {
+                        registry.FinishedThreads[region].Add(Totals[region]);
+                    }
+                    registry.LiveThreads.erase(std::remove(registry.LiveThreads.begin(), registry.LiveThreads.end(), this),
+                                               registry.LiveThreads.end());
+                }
+            }
+        };
+
+        TThreadState& GetThreadState() {
+            static thread_local TThreadState state;
+            return state;
+        }
+    }
+
+    namespace NPrivate {
+        void ReadPerfSample(TPerfSample& sample) {
+            GetThreadState().Group.Read(sample.Counters);
+            NHPTimer::GetTime(&sample.Time);
+        }
+
+        void AddPerfSample(EPerfRegion region, const TPerfSample& start) {
+            NHPTimer::STime time;
+            NHPTimer::GetTime(&time);
+            TThreadState& state = GetThreadState();
+            ui64 counters[COUNTER_COUNT];
+            state.Group.Read(counters);
+
+            TRegionTotals& totals = state.Totals[static_cast<size_t>(region)];
+            ++totals.Calls;
+            totals.Time += time - start.Time;
+            for (size_t i = 0; i < COUNTER_COUNT; ++i) {
+                totals.Counters[i] += counters[i] - start.Counters[i];
+            }
+        }
+    }
+
+    void StartPerfCounters() {
+        // Calibrates the timer now rather than inside the first measured region
+        NHPTimer::GetClockRate();
+        GetThreadState();
+        AtomicSet(NPrivate::PerfCountersEnabled, 1);
+    }
+
+    void StopPerfCounters() {
+        AtomicSet(NPrivate::PerfCountersEnabled, 0);
+    }
+
+    void ReportPerfCounters(IOutputStream& out) {
+        TPerfRegistry& registry = *Singleton<TPerfRegistry>();
+        with_lock (registry.Lock) {
+            TRegionTotals totals[REGION_COUNT];
+            for (size_t region = 0; region < REGION_COUNT; ++region) {
+                totals[region] = registry.FinishedThreads[region];
+                for (const TThreadState* state : registry.LiveThreads) {
+                    totals[region].Add(state->Totals[region]);
+                }
+            }
+
+            out << RightPad("region", 22) << LeftPad("calls", 12) << LeftPad("seconds", 12);
+            for (const char* name : COUNTER_NAMES) {
+                out << LeftPad(name, 16);
+            }
+            out << LeftPad("IPC", 8) << '\n';
+
+            auto isAvailable = [&registry](EPerfCounter counter) {
+                return !(registry.FailedCounters & (1 << static_cast<size_t>(counter)));
+            };
+            for (size_t region = 0; region < REGION_COUNT; ++region) {
+                const TRegionTotals& regionTotals = totals[region];
+                out << RightPad(REGION_NAMES[region], 22) << LeftPad(regionTotals.Calls, 12)
+                    << LeftPad(FloatToString(NHPTimer::GetSeconds(regionTotals.Time), PREC_POINT_DIGITS, 3), 12);
+                for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+                    const bool available = isAvailable(static_cast<EPerfCounter>(counter));
+                    out << LeftPad(available ? ToString(regionTotals.Counters[counter]) : TString("n/a"), 16);
+                }
+                const ui64 cycles = regionTotals.Counters[static_cast<size_t>(EPerfCounter::Cycles)];
+                const ui64 instructions = regionTotals.Counters[static_cast<size_t>(EPerfCounter::Instructions)];
+                const bool hasIpc = isAvailable(EPerfCounter::Cycles) && isAvailable(EPerfCounter::Instructions) && cycles > 0;
+                out << LeftPad(hasIpc ? FloatToString(1.0 * instructions / cycles, PREC_POINT_DIGITS, 2) : TString("n/a"), 8) << '\n';
+            }
+            if (registry.Error) {
+                out << "Some hardware counters are unavailable (" << registry.Error << "), only time is measured for them\n";
+            }
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <util/system/atomic.h>
+#include <util/system/hp_timer.h>
+#include <util/system/types.h>
+
+class IOutputStream;
+
+namespace NCmicot {
+    /// Kernels measured with hardware counters.
+    enum class EPerfRegion {
+        EntropyCounting,
+        CodeBuilding,
+        BinarizationCompare,
+        TsvParsing,
+        BinaryParsing,
+        Count,
+    };
+
+    enum class EPerfCounter {
+        Cycles,
+        Instructions,
+        LlcMisses,
+        BranchMisses,
+        Count,
+    };
+
+    namespace NPrivate {
+        extern TAtomic PerfCountersEnabled;
+
+        struct TPerfSample {
+            NHPTimer::STime Time;
+            ui64 Counters[static_cast<size_t>(EPerfCounter::Count)];
+        };
+
+        void ReadPerfSample(TPerfSample& sample);
+        void AddPerfSample(EPerfRegion region, const TPerfSample& start);
+    }
+
+    /// Starts measuring the regions. The counters of every thread are opened by perf_event_open
+    /// when the thread enters its first region. Where counters can't be opened (not Linux,
+    /// perf_event_paranoid, containers) only the time of the regions is measured.
+    void StartPerfCounters();
+
+    /// Stops measuring the regions. Totals measured so far are kept for the report.
+    void StopPerfCounters();
+
+    /// Writes per region totals over all threads: calls, time and the counters which could be opened.
+    /// Measured code must not run concurrently with this.
+    void ReportPerfCounters(IOutputStream& out);
+
+    inline bool PerfCountersEnabled() {
+        return AtomicGet(NPrivate::PerfCountersEnabled);
+    }
+
+    /// Adds time and counters between construction and destruction to the region totals. Costs a
+    /// single flag check if measuring wasn't started.
+    class TPerfRegionGuard {
+    public:
+        explicit TPerfRegionGuard(EPerfRegion region)
+            : Region(region)
+            , Enabled(PerfCountersEnabled())
+        {
+            if (Enabled) {
+                NPrivate::ReadPerfSample(Start);
+            }
+        }
+
+        ~TPerfRegionGuard() {
+            if (Enabled) {
+                NPrivate::AddPerfSample(Region, Start);
+            }
+        }
+
+        TPerfRegionGuard(const TPerfRegionGuard&) = delete;
+        TPerfRegionGuard& operator=(const TPerfRegionGuard&) = delete;
+
+    private:
+        EPerfRegion Region;
+        bool Enabled;
+        NPrivate::TPerfSample Start;
+    };
+}
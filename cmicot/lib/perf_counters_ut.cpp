@@ -0,0 +1,31 @@
+#include "perf_counters.h"
+#include "entropy_calculator.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/stream/str.h>
+
+namespace NCmicot {
+    SIMPLE_UNIT_TEST_SUITE(PerfCounters) {
+        SIMPLE_UNIT_TEST(ReportsRegions) {
+            StartPerfCounters();
+            TEntropyCalculator calculator(4);
+            calculator.AddBin(TBin{true, false, true, true});
+            calculator.GetEntropy();
+            StopPerfCounters();
+            UNIT_ASSERT(!PerfCountersEnabled());
+
+            TStringStream out;
+            ReportPerfCounters(out);
+            const TString& report = out.Str();
+
+            // Counters may be unavailable here, but the table is always complete
+            UNIT_ASSERT(report.StartsWith("region"));
+            UNIT_ASSERT(report.Contains("\nentropy counting"));
+            UNIT_ASSERT(report.Contains("\ncode building"));
+            UNIT_ASSERT(report.Contains("\nbinarization compare"));
+            UNIT_ASSERT(report.Contains("\ntsv parsing"));
+            UNIT_ASSERT(report.Contains("\nbinary parsing"));
+        }
+    }
+}
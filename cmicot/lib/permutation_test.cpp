@@ -0,0 +1,219 @@
+#include "permutation_test.h"
+#include "algorithm.h"
+#include "cmi_source.h"
+#include "entropy.h"
+#include "entropy_calculator.h"
+#include "mutual_information_calculator.h"
+#include "trace.h"
+
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
+#include <util/generic/ylimits.h>
+#include <util/random/fast.h>
+#include <util/random/shuffle.h>
+
+namespace NCmicot {
+    namespace {
+        /// Labels scored together. Every label holds a CMI calculator of its own during the search,
+        /// so the batch size bounds the memory of a thread.
+        constexpr int PERMUTATION_BATCH_SIZE = 8;
+
+        yvector<double> GetMutualInformation(NArrayRef::TConstArrayRef<TLabelCodesPtr> labels, TBinRef bin) {
+            yvector<TEntropyCalculator> labelCalcs;
+            yvector<const TEntropyCalculator*> labelCalcPtrs;
+            labelCalcs.reserve(labels.size());
+            for (const TLabelCodesPtr& label : labels) {
+                labelCalcs.emplace_back(label->size());
+                labelCalcs.back().AddCodes(label->GetCodes(), label->GetClassCount());
+                labelCalcPtrs.push_back(&labelCalcs.back());
+            }
+            const double binEntropy = Entropy(bin);
+            const yvector<double> jointEntropies = TEntropyCalculator::GetEntropiesWithExtraBin(bin, labelCalcPtrs);
+
+            yvector<double> result;
+            for (size_t k : xrange(labels.size())) {
+                result.push_back(MutualInformation(labelCalcs[k].GetEntropy(), binEntropy, jointEntropies[k]));
+            }
+            return result;
+        }
+
+        /// Greedy steps of every label: the candidates of a label are the bins it hasn't chosen yet.
+        /// Every candidate bin is counted once for all the labels, and a label takes the first
+        /// maximal (or minimal) value, as the selection does.
+        yvector<int> ChooseBins(const yvector<TCmiCalculator>& calculators, const TBinFeatureSet& features,
+                                const yvector<int>& candidateBins, const yvector<yvector<int>>& chosen, bool maximize) {
+            yvector<std::pair<int, double>> best(calculators.size(), {-1, maximize ? -Max<double>() : Max<double>()});
+            for (int binIndex : candidateBins) {
+                yvector<size_t> active;
+                yvector<const TCmiCalculator*> activeCalculators;
+                for (size_t k : xrange(calculators.size())) {
+                    if (Find(chosen[k].begin(), chosen[k].end(), binIndex) == chosen[k].end()) {
+                        active.push_back(k);
+                        activeCalculators.push_back(&calculators[k]);
+                    }
+                }
+                if (active.empty()) {
+                    continue;
+                }
+                const yvector<double> values = TCmiCalculator::GetValuesWithConditionBin(features.GetBin(binIndex), activeCalculators);
+                for (size_t i : xrange(active.size())) {
+                    std::pair<int, double>& labelBest = best[active[i]];
+                    if (labelBest.first == -1 || (maximize ? values[i] > labelBest.second : values[i] < labelBest.second)) {
+                        labelBest = {binIndex, values[i]};
+                    }
+                }
+            }
+
+            yvector<int> result;
+            for (const auto& labelBest : best) {
+                Y_VERIFY(labelBest.first != -1, "No bin to choose");
+                result.push_back(labelBest.first);
+            }
+            return result;
+        }
+
+        /// Minimax score of the evaluated bin for every label, as TCachingBinScorer::Evaluate
+        /// computes it without a cache.
+        yvector<double> EvaluateBin(NArrayRef::TConstArrayRef<TLabelCodesPtr> labels, const TBinFeatureSet& features,
+                                    const yvector<int>& enabledBins, int evalBinIndex, int stepCount) {
+            const TBinRef evalBin = features.GetBin(evalBinIndex);
+            auto makeCalculators = [&] {
+                yvector<TCmiCalculator> result;
+                for (const TLabelCodesPtr& label : labels) {
+                    result.push_back(MakeLabelCmiCalculator(*label));
+                    result.back().AddSecondVariableBin(evalBin);
+                }
+                return result;
+            };
+
+            yvector<yvector<int>> maximizingBins(labels.size());
+            {
+                TTraceSpan span("Maximize", "bin", evalBinIndex);
+                yvector<TCmiCalculator> maximizers = makeCalculators();
+                for (int step : xrange(stepCount - 1)) {
+                    Y_UNUSED(step);
+                    const yvector<int> bins = ChooseBins(maximizers, features, enabledBins, maximizingBins, true);
+                    for (size_t k : xrange(labels.size())) {
+                        maximizingBins[k].push_back(bins[k]);
+                        maximizers[k].AddConditionBin(features.GetBin(bins[k]));
+                    }
+                }
+            }
+
+            TTraceSpan span("Minimize", "bin", evalBinIndex);
+            yvector<TCmiCalculator> minimizers = makeCalculators();
+            yvector<yvector<int>> minimizingBins(labels.size());
+            for (int step : xrange(stepCount)) {
+                const yvector<int> bins = ChooseBins(minimizers, features, enabledBins, minimizingBins, false);
+                for (size_t k : xrange(labels.size())) {
+                    minimizingBins[k].push_back(bins[k]);
+                    minimizers[k].AddConditionBin(features.GetBin(bins[k]));
+                    if (step < maximizingBins[k].ysize()) {
+                        minimizers[k].AddSecondVariableBin(features.GetBin(maximizingBins[k][step]));
+                    }
+                }
+            }
+
+            yvector<double> result;
+            for (size_t k : xrange(labels.size())) {
+                result.push_back(minimizers[k].GetValue() / labels[k]->GetEntropy());
+            }
+            return result;
+        }
+    }
+
+    yvector<double> ScoreFeatureForLabels(
+        NArrayRef::TConstArrayRef<TLabelCodesPtr> labels,
+        const TBinFeatureSet& features,
+        const yvector<int>& prefix,
+        int featureIndex,
+        int evalStepCount)
+    {
+        yvector<int> enabledBins;
+        for (int prefixFeature : prefix) {
+            for (int binIndex : features.GetFeatureBinIndexes(prefixFeature)) {
+                enabledBins.push_back(binIndex);
+            }
+        }
+        Sort(enabledBins.begin(), enabledBins.end());
+        const int stepCount = Min(enabledBins.ysize(), evalStepCount);
+
+        yvector<double> result(labels.size(), -Max<double>());
+        for (int binIndex : features.GetFeatureBinIndexes(featureIndex)) {
+            const yvector<double> scores = prefix.empty()
+                ? GetMutualInformation(labels, features.GetBin(binIndex))
+                : EvaluateBin(labels, features, enabledBins, binIndex, stepCount);
+            for (size_t k : xrange(labels.size())) {
+                result[k] = Max(result[k], scores[k]);
+            }
+        }
+        return result;
+    }
+
+    yvector<double> PermutationTest(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& sequence,
+        int permutationCount,
+        ui64 seed,
+        const TFastSelectionOptions& options)
+    {
+        Y_ENSURE(permutationCount > 0, "Permutation count should be positive");
+        yvector<bool> isInSequence(features.GetFeatureCount());
+        for (int featureIndex : sequence) {
+            Y_ENSURE(0 <= featureIndex && featureIndex < features.GetFeatureCount(),
+                     "Feature " << featureIndex << " is out of range [0; " << features.GetFeatureCount() << ")");
+            Y_ENSURE(!isInSequence[featureIndex], "Feature " << featureIndex << " is given twice");
+            isInSequence[featureIndex] = true;
+        }
+        const TLabelCodesPtr labelCodes = MakeAtomicShared<TLabelCodes>(label);
+
+        // Every permutation has a seed of its own, so the results don't depend on the batches
+        TReallyFastRng32 rng(seed);
+        yvector<ui64> permutationSeeds;
+        for (int permutation : xrange(permutationCount)) {
+            Y_UNUSED(permutation);
+            permutationSeeds.push_back(rng.GenRand64());
+        }
+
+        // Label 0 is the label itself, so its scores are computed exactly as the permuted ones
+        const int labelCount = permutationCount + 1;
+        const int batchCount = (labelCount + PERMUTATION_BATCH_SIZE - 1) / PERMUTATION_BATCH_SIZE;
+        auto scoreBatch = [&](int batch) {
+            TTraceSpan span("PermutationBatch", "batch", batch);
+            yvector<TLabelCodesPtr> labels;
+            for (int labelIndex : xrange(batch * PERMUTATION_BATCH_SIZE, Min(labelCount, (batch + 1) * PERMUTATION_BATCH_SIZE))) {
+                if (labelIndex == 0) {
+                    labels.push_back(labelCodes);
+                    continue;
+                }
+                yvector<ui32> codes = labelCodes->GetCodes();
+                TReallyFastRng32 permutationRng(permutationSeeds[labelIndex - 1]);
+                Shuffle(codes.begin(), codes.end(), permutationRng);
+                labels.push_back(MakeAtomicShared<TLabelCodes>(std::move(codes), labelCodes->GetClassCount()));
+            }
+
+            yvector<yvector<double>> scores;
+            for (size_t i : xrange(sequence.size())) {
+                const yvector<int> prefix(sequence.begin(), sequence.begin() + i);
+                scores.push_back(ScoreFeatureForLabels(labels, features, prefix, sequence[i], options.EvalStepCount));
+            }
+            return scores;
+        };
+        yvector<yvector<yvector<double>>> batchScores;
+        ParallelForEach(batchCount, scoreBatch, batchScores, options.ThreadCount);
+
+        yvector<double> result;
+        for (size_t i : xrange(sequence.size())) {
+            const double observed = batchScores[0][i][0];
+            int atLeastObserved = 0;
+            for (int labelIndex : xrange(1, labelCount)) {
+                if (batchScores[labelIndex / PERMUTATION_BATCH_SIZE][i][labelIndex % PERMUTATION_BATCH_SIZE] >= observed) {
+                    ++atLeastObserved;
+                }
+            }
+            result.push_back((1.0 + atLeastObserved) / labelCount);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "label_codes.h"
+#include "selection.h"
+
+#include <util/generic/array_ref.h>
+#include <util/generic/vector.h>
+#include <util/system/types.h>
+
+namespace NCmicot {
+    /// Scores of the feature after the features of prefix for every label of labels, which label
+    /// the same lines. The first feature is scored by the mutual information of its best bin with
+    /// the label, and the others by the minimax search of the selection with evalStepCount steps.
+    /// The labels are packed side by side: every pass over the bits of a bin feeds all of them.
+    yvector<double> ScoreFeatureForLabels(
+        NArrayRef::TConstArrayRef<TLabelCodesPtr> labels,
+        const TBinFeatureSet& features,
+        const yvector<int>& prefix,
+        int featureIndex,
+        int evalStepCount);
+
+    /// p-values of the scores of the features of sequence, every feature scored after the features
+    /// before it, against permutationCount labels shuffled by a generator seeded with seed. The
+    /// label and its permutations are scored in batches, and the batches run in ThreadCount
+    /// threads. Only EvalStepCount and ThreadCount of options are used.
+    yvector<double> PermutationTest(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& sequence,
+        int permutationCount,
+        ui64 seed,
+        const TFastSelectionOptions& options);
+}
@@ -0,0 +1,62 @@
+#include "permutation_test.h"
+#include "test_pool_gen.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/random/fast.h>
+
+namespace NCmicot {
+    SIMPLE_UNIT_TEST_SUITE(PermutationTest) {
+        SIMPLE_UNIT_TEST(BatchesGiveSeparateScores) {
+            TReallyFastRng32 rng(20170925);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 8, binSize, {1, 4});
+            const TLabelCodesPtr labelCodes = MakeAtomicShared<TLabelCodes>(label);
+            const TLabelCodesPtr otherCodes = MakeAtomicShared<TLabelCodes>(RandomLabelCodes(binSize, 3, rng));
+
+            // With one step there are no maximizing steps, and the search is the one of the selection
+            TFastSelectionOptions options;
+            options.EvalStepCount = 1;
+            const yvector<int> sequence = {5, 2, 7};
+            yvector<double> expected;
+            ScoreFeatures(label, features, sequence, options, [&expected](int, double score) {
+                expected.push_back(score);
+            });
+            for (size_t i : xrange(sequence.size())) {
+                const yvector<int> prefix(sequence.begin(), sequence.begin() + i);
+                const yvector<double> scores = ScoreFeatureForLabels({labelCodes}, features, prefix, sequence[i], 1);
+                UNIT_ASSERT_VALUES_EQUAL(scores[0], expected[i]);
+            }
+
+            const yvector<int> prefix = {1, 4, 6};
+            const yvector<double> batch = ScoreFeatureForLabels({labelCodes, otherCodes}, features, prefix, 3, 3);
+            UNIT_ASSERT_VALUES_EQUAL(batch[0], ScoreFeatureForLabels({labelCodes}, features, prefix, 3, 3)[0]);
+            UNIT_ASSERT_VALUES_EQUAL(batch[1], ScoreFeatureForLabels({otherCodes}, features, prefix, 3, 3)[0]);
+        }
+
+        SIMPLE_UNIT_TEST(PValues) {
+            TReallyFastRng32 rng(20170926);
+            const int binSize = 200;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 2});
+            TBinFeatureSet features = MakeRandomFeatures(rng, 5, binSize, {1, 3});
+            const int copy = features.AddFeature({label.GetFeature(0)[0]});
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 2;
+            options.ThreadCount = 1;
+            const int permutationCount = 20;
+            const yvector<double> pValues = PermutationTest(label, features, {copy, 2, 0}, permutationCount, 1, options);
+            UNIT_ASSERT_VALUES_EQUAL(pValues.size(), 3);
+            // No permutation of the label carries as much information as its own bin
+            UNIT_ASSERT_VALUES_EQUAL(pValues[0], 1.0 / (permutationCount + 1));
+            for (double pValue : pValues) {
+                UNIT_ASSERT(0 < pValue && pValue <= 1);
+            }
+
+            options.ThreadCount = 3;
+            UNIT_ASSERT_VALUES_EQUAL(PermutationTest(label, features, {copy, 2, 0}, permutationCount, 1, options), pValues);
+            UNIT_ASSERT_EXCEPTION(PermutationTest(label, features, {2, 2}, permutationCount, 1, options), yexception);
+        }
+    }
+}
@@ -0,0 +1,112 @@
+#include "pool_loader.h"
+#include "binarize.h"
+#include "io.h"
+
+#include <library/grid_creator/binarization.h>
+#include <library/threading/algorithm/parallel_algorithm.h>
+
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
+#include <util/generic/yexception.h>
+
+namespace NCmicot {
+    namespace {
+        /// Takes the label columns after column 0 out of the read columns and binarizes them.
+        yvector<TBinFeatureSet> TakeOtherLabels(TSortedRawPool& pool, yvector<int>& keptColumns, const yvector<int>& labelColumns,
+                                                TBorderBuilder borderBuilder, int threadCount) {
+            yvector<bool> isLabel(keptColumns.size());
+            yvector<int> labelIndexes;
+            for (int column : yvector<int>(labelColumns.begin() + 1, labelColumns.end())) {
+                const auto it = Find(keptColumns.begin(), keptColumns.end(), column);
+                Y_ENSURE(it != keptColumns.end(), "Label column " << column << " isn't in the pool");
+                labelIndexes.push_back(it - keptColumns.begin());
+                isLabel[labelIndexes.back()] = true;
+            }
+
+            yvector<yvector<TBin>> labelBins;
+            auto kernel = [&](size_t i) {
+                return BinarizeFeature(pool.Columns[labelIndexes[i]], borderBuilder);
+            };
+            ParallelForEach(labelIndexes.size(), kernel, labelBins, threadCount);
+            yvector<TBinFeatureSet> result;
+            for (auto& bins : labelBins) {
+                result.emplace_back(std::move(bins));
+            }
+
+            size_t featureCount = 0;
+            for (size_t index : xrange(keptColumns.size())) {
+                if (isLabel[index]) {
+                    continue;
+                }
+                if (featureCount != index) {
+                    pool.Columns[featureCount] = std::move(pool.Columns[index]);
+                    pool.SortedValues[featureCount] = std::move(pool.SortedValues[index]);
+                    keptColumns[featureCount] = keptColumns[index];
+                }
+                ++featureCount;
+            }
+            pool.Columns.resize(featureCount);
+            pool.SortedValues.resize(featureCount);
+            keptColumns.resize(featureCount);
+            return result;
+        }
+    }
+
+    TLoadedPool LoadPool(const TOptions& options) {
+        auto borderBuilder = [&options](yvector<float>& values) {
+            return options.Binarizer->BestSplit(values, options.BorderCount);
+        };
+        auto sortedBorderBuilder = [&options](yvector<float>& sortedValues) {
+            return options.Binarizer->BestSplit(sortedValues, options.BorderCount, true);
+        };
+        const bool hasColumnOptions = !options.ReadPoolOptions.UseColumns.empty() || !options.ReadPoolOptions.IgnoreColumns.empty();
+
+        TLoadedPool result;
+        if (options.PackedPoolFilename) {
+            Y_ENSURE(!options.RawPoolFilename && !options.BinaryPoolFilename && !options.FeatureBinMapFilename,
+                     "--packed-pool can't be combined with --pool, --binary-pool or --map");
+            Y_ENSURE(!hasColumnOptions && options.ReadPoolOptions.RowSampleRate >= 1 && !options.ReadPoolOptions.RowLimit,
+                     "Column and row options can't be used with --packed-pool");
+            Y_ENSURE(options.LabelColumns.size() <= 1, "--label-columns can only be used with --pool");
+            TPackedPool packed = ReadPackedPool(*OpenInput(*options.PackedPoolFilename, options.ThreadCount));
+            result.Label = TBinFeatureSet(BinarizeFeature(packed.Pool.Label, borderBuilder));
+            result.Features = BinarizeWithMap(std::move(packed.Pool.Bins), packed.BinToFeatureMap);
+        } else if (options.RawPoolFilename) {
+            Y_ENSURE(!options.BinaryPoolFilename && !options.FeatureBinMapFilename,
+                     "Provide either only --pool option or both --binary-pool and --map");
+            TReadPoolOptions readOptions = options.ReadPoolOptions;
+            if (!readOptions.UseColumns.empty()) {
+                readOptions.UseColumns.insert(readOptions.UseColumns.end(), options.LabelColumns.begin(), options.LabelColumns.end());
+            }
+            for (int column : options.LabelColumns) {
+                Y_ENSURE(!IsIn(readOptions.IgnoreColumns, column), "Label column " << column << " can't be ignored");
+            }
+            TSortedRawPool pool = ReadPoolSorted(*OpenInput(*options.RawPoolFilename, options.ThreadCount), readOptions,
+                                                 &result.KeptColumns);
+            if (options.LabelColumns.size() > 1) {
+                result.OtherLabels = TakeOtherLabels(pool, result.KeptColumns, options.LabelColumns, borderBuilder, options.ThreadCount);
+            }
+            std::tie(result.Label, result.Features) = BinarizeRawPool(pool.Columns, std::move(pool.SortedValues), sortedBorderBuilder,
+                                                                      options.ThreadCount, options.FeatureStorage);
+        } else {
+            Y_ENSURE(options.BinaryPoolFilename && options.FeatureBinMapFilename,
+                     "Provide either only --pool option or both --binary-pool and --map");
+            Y_ENSURE(!hasColumnOptions, "--use-columns and --ignore-columns can only be used with --pool");
+            Y_ENSURE(options.LabelColumns.size() <= 1, "--label-columns can only be used with --pool");
+            TBinaryPool pool = ReadBinaryPool(*OpenInput(*options.BinaryPoolFilename, options.ThreadCount), options.ReadPoolOptions);
+            const yvector<int> binToFeatureMap = ReadBinToFeatureMap(*OpenInput(*options.FeatureBinMapFilename, options.ThreadCount));
+            result.Label = TBinFeatureSet(BinarizeFeature(pool.Label, borderBuilder));
+            result.Features = BinarizeWithMap(std::move(pool.Bins), binToFeatureMap);
+        }
+        return result;
+    }
+
+    int ToKeptFeature(int featureId, const yvector<int>& keptColumns) {
+        if (keptColumns.empty()) {
+            return featureId;
+        }
+        const auto column = LowerBound(keptColumns.begin(), keptColumns.end(), featureId + 1);
+        Y_ENSURE(column != keptColumns.end() && *column == featureId + 1, "Feature " << featureId << " wasn't read from the pool");
+        return column - keptColumns.begin() - 1;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "options.h"
+
+#include <util/generic/vector.h>
+
+namespace NCmicot {
+    struct TLoadedPool {
+        TBinFeatureSet Label;
+        TBinFeatureSet Features;
+        /// Columns of a raw pool which were read, the label column first. Empty if all the columns
+        /// were read.
+        yvector<int> KeptColumns;
+        /// Labels of --label-columns after column 0, in their order. Their columns aren't features.
+        yvector<TBinFeatureSet> OtherLabels;
+    };
+
+    /// Reads and binarizes the pool of --pool, --binary-pool with --map or --packed-pool.
+    TLoadedPool LoadPool(const TOptions& options);
+
+    /// Index among the read features of feature featureId of the pool.
+    int ToKeptFeature(int featureId, const yvector<int>& keptColumns);
+
+    /// Index in the pool of the read feature featureIndex.
+    inline int ToPoolFeature(int featureIndex, const yvector<int>& keptColumns) {
+        return keptColumns.empty() ? featureIndex : keptColumns[featureIndex + 1] - 1;
+    }
+}
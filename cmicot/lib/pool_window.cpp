@@ -0,0 +1,209 @@
+#include "pool_window.h"
+#include "algorithm.h"
+#include "mutual_information_calculator.h"
+#include "trace.h"
+
+#include <util/digest/murmur.h>
+#include <util/folder/path.h>
+#include <util/generic/algorithm.h>
+#include <util/generic/buffer.h>
+#include <util/generic/xrange.h>
+#include <util/generic/yexception.h>
+#include <util/stream/file.h>
+#include <util/string/cast.h>
+#include <util/system/file.h>
+#include <util/system/fs.h>
+
+namespace NCmicot {
+    namespace {
+        constexpr ui32 WINDOW_MAGIC = 0x574b4d43; // "CMKW"
+        constexpr ui32 WINDOW_VERSION = 2;
+        const TString STATE_FILE = "window.state";
+
+        TBlockSource GetBlockSource(const TString& path) {
+            TBlockSource result;
+            result.Name = TFsPath(path).GetName();
+            TFileInput in(path);
+            TBuffer buffer(1 << 20);
+            while (const size_t size = in.Read(buffer.Data(), buffer.Capacity())) {
+                result.Hash = MurmurHash<ui64>(buffer.Data(), size, result.Hash);
+                result.Size += size;
+            }
+            return result;
+        }
+
+        TBlockStats CountBlock(const TBinaryPool& pool, const yvector<TBin>& labelBins, int threadCount) {
+            TTraceSpan span("CountBlock");
+            const yvector<ui64> rawCodes = UniteLabelBins(labelBins);
+            yvector<ui64> classes = rawCodes;
+            Sort(classes.begin(), classes.end());
+            classes.erase(Unique(classes.begin(), classes.end()), classes.end());
+            yvector<ui32> codes;
+            codes.reserve(rawCodes.size());
+            for (ui64 rawCode : rawCodes) {
+                codes.push_back(LowerBound(classes.begin(), classes.end(), rawCode) - classes.begin());
+            }
+
+            TBlockStats result;
+            result.LineCount = rawCodes.size();
+            yvector<ui64> classCounts(classes.size(), 0);
+            for (ui32 code : codes) {
+                ++classCounts[code];
+            }
+            for (size_t code : xrange(classes.size())) {
+                result.LabelCounts.emplace_back(classes[code], classCounts[code]);
+            }
+
+            // Counted by the codes of the block, which are in the order of the raw codes
+            auto kernel = [&](size_t binIndex) {
+                const TBin& bin = pool.Bins[binIndex];
+                yvector<ui64> counts(2 * classes.size(), 0);
+                for (size_t i : xrange(bin.size())) {
+                    ++counts[2 * codes[i] + bin[i]];
+                }
+                TValueCounts binCounts;
+                for (size_t value : xrange(counts.size())) {
+                    if (counts[value] > 0) {
+                        binCounts.emplace_back(2 * classes[value / 2] + value % 2, counts[value]);
+                    }
+                }
+                return binCounts;
+            };
+            ParallelForEach(pool.Bins.size(), kernel, result.LabelBinCounts, threadCount);
+            return result;
+        }
+    }
+
+    TPoolWindow::TPoolWindow(const TString& directory)
+        : Directory(directory)
+    {
+        NFs::MakeDirectoryRecursive(Directory, NFs::FP_COMMON_FILE, false);
+        const TString statePath = GetPath(STATE_FILE);
+        if (NFs::Exists(statePath)) {
+            TFileInput in(statePath);
+            ui32 magic = 0, version = 0;
+            ::LoadMany(&in, magic, version);
+            Y_ENSURE(magic == WINDOW_MAGIC, statePath << " is not a pool window state file");
+            Y_ENSURE(version == WINDOW_VERSION, "Pool window state " << statePath << " has unsupported version " << version);
+            ::Load(&in, State);
+        }
+    }
+
+    void TPoolWindow::AppendBlock(const TString& path, TBorderBuilder borderBuilder, int threadCount) {
+        TTraceSpan span("AppendBlock");
+        TBlockSource source = GetBlockSource(path);
+        const auto appended = Find(State.BlockSources.begin(), State.BlockSources.end(), source);
+        Y_ENSURE(appended == State.BlockSources.end(),
+                 "Block " << path << " is already in the window as " << State.Blocks[appended - State.BlockSources.begin()]);
+        TPackedPool packed = ReadPackedPool(*OpenInput(path, threadCount));
+        if (State.Blocks.empty()) {
+            State.BinToFeatureMap = packed.BinToFeatureMap;
+            yvector<float> values(packed.Pool.Label.begin(), packed.Pool.Label.end());
+            const yhash_set<float> borders = borderBuilder(values);
+            State.LabelBorders.assign(borders.begin(), borders.end());
+            Sort(State.LabelBorders.begin(), State.LabelBorders.end());
+        }
+        Y_ENSURE(packed.BinToFeatureMap == State.BinToFeatureMap, "Block " << path << " has another feature-bin map than the window");
+
+        TBlockStats stats = CountBlock(packed.Pool, BinarizeLabel(packed.Pool.Label), threadCount);
+        const TString name = "block." + ToString(State.NextBlockId++) + ".packed";
+        NFs::Copy(path, GetPath(name));
+        State.Blocks.push_back(name);
+        State.BlockSources.push_back(std::move(source));
+        State.BlockStats.push_back(std::move(stats));
+    }
+
+    void TPoolWindow::RetireBlocks(size_t blockCount) {
+        while (State.Blocks.size() > blockCount) {
+            RetiredBlocks.push_back(State.Blocks.front());
+            State.Blocks.erase(State.Blocks.begin());
+            State.BlockSources.erase(State.BlockSources.begin());
+            State.BlockStats.erase(State.BlockStats.begin());
+        }
+    }
+
+    void TPoolWindow::Save() {
+        const TString statePath = GetPath(STATE_FILE);
+        const TString tmpPath = statePath + ".tmp";
+        {
+            TFile file(tmpPath, CreateAlways | WrOnly);
+            TFileOutput out(file);
+            ::SaveMany(&out, WINDOW_MAGIC, WINDOW_VERSION, State);
+            out.Finish();
+            file.Flush();
+        }
+        Y_ENSURE(NFs::Rename(tmpPath, statePath), "Failed to rename " << tmpPath << " to " << statePath);
+
+        // A file may be gone already if an earlier run failed right after removing it
+        for (const TString& block : RetiredBlocks) {
+            const TString path = GetPath(block);
+            if (NFs::Exists(path)) {
+                Y_ENSURE(NFs::Remove(path), "Failed to remove " << path);
+            }
+        }
+        RetiredBlocks.clear();
+    }
+
+    std::pair<TBinFeatureSet, TBinFeatureSet> TPoolWindow::LoadPool(int threadCount) const {
+        TTraceSpan span("LoadWindow");
+        Y_ENSURE(!State.Blocks.empty(), "Pool window " << Directory << " has no blocks");
+        yvector<double> label;
+        yvector<TBin> bins(State.BinToFeatureMap.size());
+        for (const TString& block : State.Blocks) {
+            TPackedPool packed = ReadPackedPool(*OpenInput(GetPath(block), threadCount));
+            label.insert(label.end(), packed.Pool.Label.begin(), packed.Pool.Label.end());
+            for (size_t binIndex : xrange(bins.size())) {
+                bins[binIndex].insert(bins[binIndex].end(), packed.Pool.Bins[binIndex].begin(), packed.Pool.Bins[binIndex].end());
+            }
+        }
+        return {TBinFeatureSet(BinarizeLabel(label)), BinarizeWithMap(std::move(bins), State.BinToFeatureMap)};
+    }
+
+    TAtomicSharedPtr<const TSelectionPoolData> TPoolWindow::MakePoolData(const TBinFeatureSet& label) const {
+        TTraceSpan span("MakeWindowPoolData");
+        auto result = MakeAtomicShared<TSelectionPoolData>();
+        result->LabelCodes = MakeAtomicShared<TLabelCodes>(label);
+
+        ui64 lineCount = 0;
+        TValueCounts labelCounts;
+        yvector<TValueCounts> labelBinCounts(State.BinToFeatureMap.size());
+        for (const TBlockStats& stats : State.BlockStats) {
+            lineCount += stats.LineCount;
+            AddValueCounts(labelCounts, stats.LabelCounts);
+            for (size_t binIndex : xrange(labelBinCounts.size())) {
+                AddValueCounts(labelBinCounts[binIndex], stats.LabelBinCounts[binIndex]);
+            }
+        }
+        Y_ENSURE(lineCount == result->LabelCodes->size(), "Pool window counts " << lineCount << " lines, while the label has "
+                                                                                  << result->LabelCodes->size());
+
+        // Mutual information from the counts of the entropies
+        const double labelEntropy = GetEntropy(labelCounts, lineCount);
+        for (const TValueCounts& counts : labelBinCounts) {
+            ui64 bitCounts[2] = {0, 0};
+            for (const auto& valueAndCount : counts) {
+                bitCounts[valueAndCount.first % 2] += valueAndCount.second;
+            }
+            TValueCounts binCounts;
+            for (ui64 bit : {0, 1}) {
+                if (bitCounts[bit] > 0) {
+                    binCounts.emplace_back(bit, bitCounts[bit]);
+                }
+            }
+            result->LabelInformation.push_back(MutualInformation(labelEntropy, GetEntropy(binCounts, lineCount), GetEntropy(counts, lineCount)));
+        }
+        return result;
+    }
+
+    TString TPoolWindow::GetPath(const TString& name) const {
+        return Directory + "/" + name;
+    }
+
+    yvector<TBin> TPoolWindow::BinarizeLabel(const yvector<double>& label) const {
+        // The borders are inserted in the same order every time, so the label bins keep their order
+        const yvector<float>& labelBorders = State.LabelBorders;
+        return BinarizeFeature(label, [&labelBorders](yvector<float>&) {
+            return yhash_set<float>(labelBorders.begin(), labelBorders.end());
+        });
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "binarize.h"
+#include "entropy_calculator.h"
+#include "io.h"
+#include "selection.h"
+
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/ysaveload.h>
+
+namespace NCmicot {
+    /// Counts of a block of lines, which add up over the blocks of a window.
+    struct TBlockStats {
+        ui64 LineCount = 0;
+        /// Lines of every raw label code, the label bits as TLabelCodes joins them.
+        TValueCounts LabelCounts;
+        /// Lines of every 2 * raw label code + bit, for every bin.
+        yvector<TValueCounts> LabelBinCounts;
+
+        Y_SAVELOAD_DEFINE(LineCount, LabelCounts, LabelBinCounts);
+    };
+
+    /// Identity of the file a block was appended from, so that the same file isn't appended twice.
+    struct TBlockSource {
+        /// File name without the directory.
+        TString Name;
+        ui64 Size = 0;
+        /// MurmurHash of the contents.
+        ui64 Hash = 0;
+
+        bool operator==(const TBlockSource& other) const {
+            return Name == other.Name && Size == other.Size && Hash == other.Hash;
+        }
+
+        Y_SAVELOAD_DEFINE(Name, Size, Hash);
+    };
+
+    /// Persistent state of a TPoolWindow.
+    struct TPoolWindowState {
+        yvector<int> BinToFeatureMap;
+        /// Borders of the label, fixed by the first block so that the label codes of all the blocks agree.
+        yvector<float> LabelBorders;
+        /// Block files of the window directory, oldest first, their sources and their counts.
+        yvector<TString> Blocks;
+        yvector<TBlockSource> BlockSources;
+        yvector<TBlockStats> BlockStats;
+        ui64 NextBlockId = 0;
+
+        Y_SAVELOAD_DEFINE(BinToFeatureMap, LabelBorders, Blocks, BlockSources, BlockStats, NextBlockId);
+    };
+
+    /// Trailing window of line blocks kept in a directory, e.g. a block per day of logs. Every block
+    /// is a packed pool with the same feature-bin map. The label and bin counts of every block are
+    /// kept in the state file of the directory, so appending a block counts only its own lines and
+    /// retiring one only drops its counts.
+    class TPoolWindow {
+    public:
+        /// Opens the window of directory, which is created if it doesn't exist.
+        explicit TPoolWindow(const TString& directory);
+
+        /// Copies the packed pool of path into the window as its newest block and counts its lines.
+        /// The label borders are built by borderBuilder from the first block. Throws if a block of
+        /// the window was appended from a file with the same name, size and contents.
+        void AppendBlock(const TString& path, TBorderBuilder borderBuilder, int threadCount);
+        /// Retires the oldest blocks, so that at most blockCount blocks are left. Their files are
+        /// removed by the next Save.
+        void RetireBlocks(size_t blockCount);
+        /// Writes the state file of the directory, and then removes the files of the retired blocks.
+        /// The old state is replaced only by a complete one, so a failed run leaves at most some files
+        /// which no state refers to.
+        void Save();
+
+        size_t GetBlockCount() const {
+            return State.Blocks.size();
+        }
+
+        /// Reads the blocks, oldest first, as a single pool with the label binarized by the window borders.
+        std::pair<TBinFeatureSet, TBinFeatureSet> LoadPool(int threadCount) const;
+
+        /// Pool data of label, the label of LoadPool, taken from the counts of the blocks without a
+        /// pass over the bins.
+        TAtomicSharedPtr<const TSelectionPoolData> MakePoolData(const TBinFeatureSet& label) const;
+
+    private:
+        TString GetPath(const TString& name) const;
+        yvector<TBin> BinarizeLabel(const yvector<double>& label) const;
+
+        TString Directory;
+        TPoolWindowState State;
+        yvector<TString> RetiredBlocks;
+    };
+}
@@ -0,0 +1,139 @@
+#include "pool_window.h"
+#include "test_pool_gen.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/folder/path.h>
+#include <util/generic/algorithm.h>
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/string/cast.h>
+#include <util/system/fs.h>
+
+namespace NCmicot {
+    namespace {
+        TBinaryPool MakeRandomBlock(TReallyFastRng32& rng, int lineCount, int binCount) {
+            TBinaryPool result;
+            for (int i : xrange(lineCount)) {
+                Y_UNUSED(i);
+                result.Label.push_back(rng.Uniform(3));
+            }
+            for (int bin : xrange(binCount)) {
+                Y_UNUSED(bin);
+                result.Bins.push_back(RandomBin(lineCount, rng));
+            }
+            return result;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(PoolWindow) {
+        SIMPLE_UNIT_TEST(SameAsWholePool) {
+            TReallyFastRng32 rng(20170930);
+            const yvector<int> map = {0, 0, 1, 2, 2, 2, 3, 4, 4};
+            const TString directory = "pool_window_ut";
+            NFs::RemoveRecursive(directory);
+            auto borderBuilder = [](yvector<float>& values) {
+                return yhash_set<float>(values.begin(), values.end());
+            };
+
+            yvector<TBinaryPool> blocks;
+            for (int block : xrange(4)) {
+                blocks.push_back(MakeRandomBlock(rng, 150 + 10 * block, map.ysize()));
+                TOFStream out("pool_window_ut.block");
+                OutputPackedPool(blocks.back(), map, out);
+                out.Finish();
+
+                // Every day the window is opened again, as by a daily job
+                TPoolWindow window(directory);
+                window.AppendBlock("pool_window_ut.block", borderBuilder, 2);
+                window.RetireBlocks(2);
+                window.Save();
+            }
+            NFs::Remove("pool_window_ut.block");
+
+            const TPoolWindow window(directory);
+            UNIT_ASSERT_VALUES_EQUAL(window.GetBlockCount(), 2);
+            const auto pool = window.LoadPool(2);
+            yvector<double> label;
+            yvector<TBin> bins(map.size());
+            for (const TBinaryPool& block : {blocks[2], blocks[3]}) {
+                label.insert(label.end(), block.Label.begin(), block.Label.end());
+                for (size_t binIndex : xrange(bins.size())) {
+                    bins[binIndex].insert(bins[binIndex].end(), block.Bins[binIndex].begin(), block.Bins[binIndex].end());
+                }
+            }
+            UNIT_ASSERT_VALUES_EQUAL(pool.second.AllBins(), bins);
+            UNIT_ASSERT_VALUES_EQUAL(pool.first.GetBinCount(), 3);
+
+            // The counts give exactly the values of a pass over the bins
+            const auto poolData = window.MakePoolData(pool.first);
+            const auto expected = MakeSelectionPoolData(pool.first, pool.second, 2);
+            UNIT_ASSERT_VALUES_EQUAL(poolData->LabelInformation, expected->LabelInformation);
+            UNIT_ASSERT_VALUES_EQUAL(poolData->LabelCodes->GetCodes(), expected->LabelCodes->GetCodes());
+
+            yvector<TString> files;
+            TFsPath(directory).ListNames(files);
+            UNIT_ASSERT_VALUES_EQUAL(files.size(), 3);
+            NFs::RemoveRecursive(directory);
+        }
+
+        SIMPLE_UNIT_TEST(RetireAndAppendAgain) {
+            TReallyFastRng32 rng(20171001);
+            const yvector<int> map = {0, 1, 1, 2};
+            const TString directory = "pool_window_ut_retire";
+            NFs::RemoveRecursive(directory);
+            auto borderBuilder = [](yvector<float>& values) {
+                return yhash_set<float>(values.begin(), values.end());
+            };
+            auto writeBlock = [&](const TString& path) {
+                TOFStream out(path);
+                OutputPackedPool(MakeRandomBlock(rng, 100, map.ysize()), map, out);
+                out.Finish();
+            };
+            yvector<TString> files;
+            auto listFiles = [&] {
+                files.clear();
+                TFsPath(directory).ListNames(files);
+                Sort(files.begin(), files.end());
+                return files;
+            };
+
+            writeBlock("pool_window_ut.first");
+            writeBlock("pool_window_ut.second");
+            {
+                TPoolWindow window(directory);
+                window.AppendBlock("pool_window_ut.first", borderBuilder, 1);
+                window.AppendBlock("pool_window_ut.second", borderBuilder, 1);
+                // The same file twice, even under another path, is refused and leaves the window as is
+                UNIT_ASSERT_EXCEPTION(window.AppendBlock("./pool_window_ut.second", borderBuilder, 1), yexception);
+                UNIT_ASSERT_VALUES_EQUAL(window.GetBlockCount(), 2);
+                window.Save();
+            }
+            {
+                // A run which fails before Save retires nothing, its state is the saved one
+                TPoolWindow window(directory);
+                UNIT_ASSERT_EXCEPTION(window.AppendBlock("pool_window_ut.second", borderBuilder, 1), yexception);
+                window.RetireBlocks(1);
+                UNIT_ASSERT_VALUES_EQUAL(listFiles(), (yvector<TString>{"block.0.packed", "block.1.packed", "window.state"}));
+            }
+            TPoolWindow window(directory);
+            UNIT_ASSERT_VALUES_EQUAL(window.GetBlockCount(), 2);
+            UNIT_ASSERT_VALUES_EQUAL(window.LoadPool(1).first.GetBin(0).size(), 200);
+
+            // Files already removed by an earlier run are skipped
+            window.RetireBlocks(0);
+            NFs::Remove(directory + "/block.0.packed");
+            window.Save();
+            UNIT_ASSERT_VALUES_EQUAL(listFiles(), yvector<TString>{"window.state"});
+            UNIT_ASSERT_VALUES_EQUAL(TPoolWindow(directory).GetBlockCount(), 0);
+
+            // A retired block may come back
+            window.AppendBlock("pool_window_ut.first", borderBuilder, 1);
+            UNIT_ASSERT_VALUES_EQUAL(window.GetBlockCount(), 1);
+
+            NFs::Remove("pool_window_ut.first");
+            NFs::Remove("pool_window_ut.second");
+            NFs::RemoveRecursive(directory);
+        }
+    }
+}
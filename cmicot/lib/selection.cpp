@@ -3,70 +3,476 @@
 #include "mutual_information_calculator.h"
 #include "bin_score.h"
 #include "caching_bin_scorer.h"
+#include "checkpoint.h"
+#include "entropy.h"
+#include "trace.h"
+
+#include <util/datetime/base.h>
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
 
 namespace NCmicot {
     namespace {
-        int GetBinWithMaximalMutualInformationWithLabel(const TBinFeatureSet& label,
-                                                        const TBinFeatureSet& features, int threadCount) {
-            TMutualInformationCalculator miCalc(label.AllBins().front().size());
-            for (const auto& bin : label.AllBins()) {
-                miCalc.AddFirstVariableBin(bin);
-            }
+        /// Best bin and its information.
+        std::pair<int, double> GetBinWithMaximalMutualInformationWithLabel(const TLabelCodes& label, const TBinFeatureSet& features,
+                                                                           const yvector<int>& binIndexes, int threadCount) {
+            TMutualInformationCalculator miCalc(label.size());
+            miCalc.AddFirstVariableCodes(label);
 
             auto kernel = [&](int binIndex) {
                 return miCalc.GetValueWithSecondVariableBin(features.GetBin(binIndex));
             };
-            return *ParallelMaxElementBy(features.AllBinIndexes(), kernel, threadCount);
+            const int best = *ParallelMaxElementBy(binIndexes, kernel, threadCount);
+            return {best, kernel(best)};
+        }
+
+        std::pair<int, double> GetBinWithMaximalMutualInformationWithLabel(ICmiSource& source, const yvector<int>& binIndexes) {
+            const yvector<double> values = source.GetMutualInformation(binIndexes);
+            const auto best = MaxElement(values.begin(), values.end());
+            return {binIndexes[best - values.begin()], *best};
+        }
+
+        /// Bin of the first selected feature, with the most information about the label.
+        std::pair<int, double> GetFirstStepBin(const TLabelCodes& label, const TBinFeatureSet& features, const yvector<int>& binIndexes,
+                                               const TFastSelectionOptions& options) {
+            if (options.CandidateShards) {
+                return options.CandidateShards->GetBinWithMaximalMutualInformation();
+            } else if (options.PoolData) {
+                const yvector<double>& information = options.PoolData->LabelInformation;
+                std::pair<int, double> result = {binIndexes[0], information[binIndexes[0]]};
+                for (int binIndex : binIndexes) {
+                    if (information[binIndex] > result.second) {
+                        result = {binIndex, information[binIndex]};
+                    }
+                }
+                return result;
+            } else if (options.CmiSource) {
+                return GetBinWithMaximalMutualInformationWithLabel(*options.CmiSource, binIndexes);
+            }
+            return GetBinWithMaximalMutualInformationWithLabel(label, features, binIndexes, options.ThreadCount);
+        }
+
+        /// Keeps the bins of the candidate features, or all the bins if no candidates are given.
+        class TCandidateFilter {
+        public:
+            TCandidateFilter(const TBinFeatureSet& features, const yvector<int>& candidateFeatures)
+                : Features(features)
+                , IsCandidateFeature(features.GetFeatureCount(), candidateFeatures.empty())
+            {
+                for (int featureIndex : candidateFeatures) {
+                    Y_ENSURE(0 <= featureIndex && featureIndex < features.GetFeatureCount(),
+                             "Candidate feature " << featureIndex << " is out of range [0; " << features.GetFeatureCount() << ")");
+                    IsCandidateFeature[featureIndex] = true;
+                }
+            }
+
+            yvector<int> operator()(const yvector<int>& binIndexes) const {
+                yvector<int> result;
+                for (int binIndex : binIndexes) {
+                    if (IsCandidateFeature[Features.GetFeatureIndexByBinIndex(binIndex)]) {
+                        result.push_back(binIndex);
+                    }
+                }
+                return result;
+            }
+
+        private:
+            const TBinFeatureSet& Features;
+            yvector<bool> IsCandidateFeature;
+        };
+
+        bool IsCancelled(const TFastSelectionOptions& options) {
+            return options.IsCancelled && options.IsCancelled();
+        }
+    }
+
+    TAtomicSharedPtr<const TSelectionPoolData> MakeSelectionPoolData(const TBinFeatureSet& label, const TBinFeatureSet& features,
+                                                                     int threadCount) {
+        return MakeSelectionPoolData(NArrayRef::TConstArrayRef<TBinFeatureSet>(&label, 1), features, threadCount)[0];
+    }
+
+    yvector<TAtomicSharedPtr<const TSelectionPoolData>> MakeSelectionPoolData(NArrayRef::TConstArrayRef<TBinFeatureSet> labels,
+                                                                              const TBinFeatureSet& features, int threadCount) {
+        TTraceSpan span("MakeSelectionPoolData");
+        yvector<TAtomicSharedPtr<TSelectionPoolData>> data;
+        yvector<TEntropyCalculator> labelCalcs;
+        yvector<double> labelEntropies;
+        labelCalcs.reserve(labels.size());
+        for (const TBinFeatureSet& label : labels) {
+            data.push_back(MakeAtomicShared<TSelectionPoolData>());
+            data.back()->LabelCodes = MakeAtomicShared<TLabelCodes>(label);
+            labelCalcs.emplace_back(data.back()->LabelCodes->size());
+            labelCalcs.back().AddCodes(data.back()->LabelCodes->GetCodes(), data.back()->LabelCodes->GetClassCount());
+            labelEntropies.push_back(labelCalcs.back().GetEntropy());
+        }
+        yvector<const TEntropyCalculator*> calculators;
+        for (const auto& labelCalc : labelCalcs) {
+            calculators.push_back(&labelCalc);
+        }
+
+        // The joint entropies with all the labels are counted in a single pass over the bin
+        auto kernel = [&](int binIndex) {
+            const TBinRef bin = features.GetBin(binIndex);
+            const double binEntropy = Entropy(bin);
+            yvector<double> result = TEntropyCalculator::GetEntropiesWithExtraBin(bin, calculators);
+            for (int labelIndex : xrange(result.ysize())) {
+                result[labelIndex] = MutualInformation(labelEntropies[labelIndex], binEntropy, result[labelIndex]);
+            }
+            return result;
+        };
+        yvector<yvector<double>> binInformation;
+        const yvector<int> allBins = features.AllBinIndexes();
+        ParallelForEach(allBins.begin(), allBins.end(), kernel, binInformation, threadCount);
+
+        yvector<TAtomicSharedPtr<const TSelectionPoolData>> result;
+        for (int labelIndex : xrange(data.ysize())) {
+            for (const auto& information : binInformation) {
+                data[labelIndex]->LabelInformation.push_back(information[labelIndex]);
+            }
+            result.push_back(data[labelIndex]);
         }
+        return result;
     }
 
     void FastFeatureSelection(
         const TBinFeatureSet& label,
         const TBinFeatureSet& features,
-        int evalStepCount,
-        int threadCount,
-        int featureCount,
+        const TFastSelectionOptions& options,
         std::function<void(int)> onFeatureSelected)
     {
+        Y_ENSURE(!options.CandidateShards || (!options.CmiSource && options.CheckpointFile.empty() && options.CandidateFeatures.empty()),
+                 "Candidate shards can't be combined with a CMI source, a checkpoint or candidate features");
+        const int threadCount = options.ThreadCount;
+        const TLabelCodesPtr labelCodes = options.PoolData ? options.PoolData->LabelCodes : TLabelCodesPtr(MakeAtomicShared<TLabelCodes>(label));
         TBackground bg(features);
 
-        bg.DisableAll();
-        {
-            int bestFeature = features.GetFeatureIndexByBinIndex(
-                GetBinWithMaximalMutualInformationWithLabel(label, features, threadCount));
+        const TCandidateFilter candidateBins(features, options.CandidateFeatures);
+        TCachingBinScorer binScorer(labelCodes, features.GetBinCount(), options.CmiSource);
 
-            bg.SetFeatureEnabled(bestFeature, true);
-            onFeatureSelected(bestFeature);
+        TSelectionCheckpoint checkpoint;
+        checkpoint.LineCount = labelCodes->size();
+        checkpoint.FeatureCount = features.GetFeatureCount();
+        checkpoint.BinCount = features.GetBinCount();
+        checkpoint.EvalStepCount = options.EvalStepCount;
+        if (!options.CheckpointFile.empty()) {
+            checkpoint.PoolHash = GetPoolHash(*labelCodes, features);
         }
 
-        TCachingBinScorer binScorer(label, features.GetBinCount());
+        auto selectFeature = [&](int featureIndex) {
+            bg.SetFeatureEnabled(featureIndex, true);
+            if (options.CandidateShards) {
+                options.CandidateShards->EnableFeatures({featureIndex});
+            }
+            checkpoint.SelectedFeatures.push_back(featureIndex);
+            onFeatureSelected(featureIndex);
+        };
+        TInstant stepStart;
+        TKernelCounters stepCounters;
+        THolder<TKernelCountersGuard> countersGuard;
+        if (options.OnStepFinished && options.CountKernels) {
+            countersGuard.Reset(new TKernelCountersGuard(&stepCounters));
+        }
+        auto startStep = [&] {
+            if (options.OnStepFinished) {
+                stepStart = TInstant::Now();
+                stepCounters = TKernelCounters();
+            }
+        };
+        auto finishStep = [&](ui64 candidates, double score) {
+            if (options.OnStepFinished) {
+                TSelectionStepMetrics metrics;
+                metrics.Step = checkpoint.SelectedFeatures.ysize();
+                metrics.SelectedFeature = checkpoint.SelectedFeatures.back();
+                metrics.WallSeconds = (TInstant::Now() - stepStart).SecondsFloat();
+                metrics.Candidates = candidates;
+                metrics.Score = score;
+                metrics.Kernels = stepCounters;
+                options.OnStepFinished(metrics);
+            }
+        };
+        auto saveCheckpoint = [&] {
+            if (!options.CheckpointFile.empty()) {
+                checkpoint.Cache = binScorer.GetCache();
+                SaveCheckpoint(checkpoint, options.CheckpointFile);
+            }
+        };
+
+        bg.DisableAll();
+        TMaybe<TSelectionCheckpoint> loaded;
+        if (options.Resume && !options.CheckpointFile.empty()) {
+            loaded = LoadCheckpoint(options.CheckpointFile);
+        }
+        if (loaded) {
+            Y_ENSURE(loaded->LineCount == checkpoint.LineCount && loaded->FeatureCount == checkpoint.FeatureCount &&
+                     loaded->BinCount == checkpoint.BinCount && loaded->EvalStepCount == checkpoint.EvalStepCount &&
+                     loaded->PoolHash == checkpoint.PoolHash,
+                     "Checkpoint " << options.CheckpointFile << " was made for another pool or -t value");
+            Y_ENSURE(!loaded->SelectedFeatures.empty(), "Checkpoint " << options.CheckpointFile << " is empty");
+            Y_ENSURE(loaded->SelectedFeatures.size() >= options.InitialFeatures.size() &&
+                     Equal(options.InitialFeatures.begin(), options.InitialFeatures.end(), loaded->SelectedFeatures.begin()),
+                     "Checkpoint " << options.CheckpointFile << " doesn't start with the initial features");
+            binScorer.RestoreCache(std::move(loaded->Cache));
+            for (int featureIndex : loaded->SelectedFeatures) {
+                selectFeature(featureIndex);
+            }
+        } else if (!options.InitialFeatures.empty()) {
+            // The whole prefix is enabled at once, so the first evaluation of every candidate searches
+            // through all of its bins and fills the scorer cache in a single pass
+            yvector<bool> isGiven(features.GetFeatureCount());
+            for (int featureIndex : options.InitialFeatures) {
+                Y_ENSURE(0 <= featureIndex && featureIndex < features.GetFeatureCount(),
+                         "Initial feature " << featureIndex << " is out of range [0; " << features.GetFeatureCount() << ")");
+                Y_ENSURE(!isGiven[featureIndex], "Initial feature " << featureIndex << " is given twice");
+                isGiven[featureIndex] = true;
+                checkpoint.SelectedFeatures.push_back(featureIndex);
+                onFeatureSelected(featureIndex);
+            }
+            bg.SetFeaturesEnabled(options.InitialFeatures);
+            if (options.CandidateShards) {
+                options.CandidateShards->EnableFeatures(options.InitialFeatures);
+            }
+        } else if (!IsCancelled(options)) {
+            TTraceSpan span("SelectionStep", "step", 1);
+            startStep();
+            const yvector<int> allBins = features.AllBinIndexes();
+            const yvector<int> firstStepBins = candidateBins(allBins);
+            Y_ENSURE(!firstStepBins.empty(), "There are no candidate features");
+            const std::pair<int, double> bestBin = GetFirstStepBin(*labelCodes, features, firstStepBins, options);
+            selectFeature(features.GetFeatureIndexByBinIndex(bestBin.first));
+            finishStep(firstStepBins.size(), bestBin.second);
+            saveCheckpoint();
+        }
 
+        // Evaluating the best bin again would change the scorer cache, so the scores are kept
+        yvector<double> binScores(features.GetBinCount());
         auto kernel = [&](int binIndex) {
-            int stepCount = Min(bg.EnabledBinIndexes().ysize(), evalStepCount);
-            return binScorer.Evaluate(bg, binIndex, stepCount).Score;
+            int stepCount = Min(bg.EnabledBinIndexes().ysize(), options.EvalStepCount);
+            return binScores[binIndex] = binScorer.Evaluate(bg, binIndex, stepCount).Score;
         };
-        int featuresToSelectCount = Min(featureCount, features.GetFeatureCount()) - 1;
-        for (int step = 0; step < featuresToSelectCount; ++step) {
-            const auto disabledBins = bg.DisabledBinIndexes();
-            const auto bestBinIter = ParallelMaxElementBy(disabledBins, kernel, threadCount);
-            Y_VERIFY(bestBinIter != disabledBins.end(), "");
+        const int featuresToSelectCount = Min(options.FeatureCount, features.GetFeatureCount());
+        while (checkpoint.SelectedFeatures.ysize() < featuresToSelectCount && !IsCancelled(options)) {
+            const auto disabledBins = candidateBins(bg.DisabledBinIndexes());
+            if (disabledBins.empty()) {
+                break;
+            }
+            TTraceSpan span("SelectionStep", "step", checkpoint.SelectedFeatures.size() + 1);
+            startStep();
+            std::pair<int, double> bestBin;
+            if (options.CandidateShards) {
+                bestBin = options.CandidateShards->GetBestBin(options.EvalStepCount);
+            } else {
+                const auto bestBinIter = ParallelMaxElementBy(disabledBins, kernel, threadCount);
+                Y_VERIFY(bestBinIter != disabledBins.end(), "");
+                bestBin = {*bestBinIter, binScores[*bestBinIter]};
+            }
 
-            int bestFeature = features.GetFeatureIndexByBinIndex(*bestBinIter);
-            bg.SetFeatureEnabled(bestFeature, true);
+            selectFeature(features.GetFeatureIndexByBinIndex(bestBin.first));
+            finishStep(disabledBins.size(), bestBin.second);
+            saveCheckpoint();
+        }
+    }
 
-            onFeatureSelected(bestFeature);
+    void FastFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        int evalStepCount,
+        int threadCount,
+        int featureCount,
+        std::function<void(int)> onFeatureSelected)
+    {
+        TFastSelectionOptions options;
+        options.EvalStepCount = evalStepCount;
+        options.ThreadCount = threadCount;
+        options.FeatureCount = featureCount;
+        FastFeatureSelection(label, features, options, std::move(onFeatureSelected));
+    }
+
+    void MultiLabelFeatureSelection(
+        NArrayRef::TConstArrayRef<TBinFeatureSet> labels,
+        const TBinFeatureSet& features,
+        const TFastSelectionOptions& options,
+        std::function<void(int, int)> onFeatureSelected)
+    {
+        Y_ENSURE(!options.CmiSource && !options.CandidateShards && !options.PoolData && options.CheckpointFile.empty(),
+                 "Selection for several labels can't have a CMI source, candidate shards, pool data or a checkpoint");
+        const auto poolData = MakeSelectionPoolData(labels, features, options.ThreadCount);
+        for (int labelIndex : xrange(labels.size())) {
+            if (IsCancelled(options)) {
+                break;
+            }
+            TTraceSpan span("LabelSelection", "label", labelIndex);
+            TFastSelectionOptions labelOptions = options;
+            labelOptions.PoolData = poolData[labelIndex];
+            FastFeatureSelection(labels[labelIndex], features, labelOptions, [&](int featureIndex) {
+                onFeatureSelected(labelIndex, featureIndex);
+            });
+        }
+    }
+
+    void EvalStepSweepFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& evalStepCounts,
+        const TFastSelectionOptions& options,
+        std::function<void(int, int)> onFeatureSelected)
+    {
+        Y_ENSURE(!options.CmiSource && !options.CandidateShards && options.CheckpointFile.empty(),
+                 "-t sweep can't have a CMI source, candidate shards or a checkpoint");
+        Y_ENSURE(!evalStepCounts.empty() && AllOf(evalStepCounts, [](int stepCount) { return stepCount > 0; }),
+                 "-t values of a sweep should be positive");
+        const TLabelCodesPtr labelCodes = options.PoolData ? options.PoolData->LabelCodes : TLabelCodesPtr(MakeAtomicShared<TLabelCodes>(label));
+        const TCandidateFilter candidateBins(features, options.CandidateFeatures);
+
+        // -t values which have selected the same features so far share the background and the
+        // scorer. The steps of every -t are a prefix of the steps of the largest -t of its group,
+        // so a single evaluation of a candidate scores it for all of them.
+        struct TSweepGroup {
+            yvector<int> Orders;
+            TBackground Background;
+            TCachingBinScorer Scorer;
+            int SelectedCount;
+        };
+        yvector<THolder<TSweepGroup>> groups;
+        groups.emplace_back(new TSweepGroup{xrange(evalStepCounts.ysize()), TBackground(features),
+                                            TCachingBinScorer(labelCodes, features.GetBinCount()), 0});
+        TSweepGroup& first = *groups[0];
+        auto selectFeature = [&](TSweepGroup& group, int featureIndex) {
+            group.Background.SetFeatureEnabled(featureIndex, true);
+            ++group.SelectedCount;
+            for (int order : group.Orders) {
+                onFeatureSelected(order, featureIndex);
+            }
+        };
+
+        first.Background.DisableAll();
+        if (!options.InitialFeatures.empty()) {
+            for (int featureIndex : options.InitialFeatures) {
+                Y_ENSURE(0 <= featureIndex && featureIndex < features.GetFeatureCount(),
+                         "Initial feature " << featureIndex << " is out of range [0; " << features.GetFeatureCount() << ")");
+                Y_ENSURE(!first.Background.IsFeatureEnabled(featureIndex), "Initial feature " << featureIndex << " is given twice");
+                selectFeature(first, featureIndex);
+            }
+            first.Background.SetFeaturesEnabled(options.InitialFeatures);
+        } else if (!IsCancelled(options)) {
+            TTraceSpan span("SelectionStep", "step", 1);
+            const yvector<int> allBins = features.AllBinIndexes();
+            const yvector<int> firstStepBins = candidateBins(allBins);
+            Y_ENSURE(!firstStepBins.empty(), "There are no candidate features");
+            selectFeature(first, features.GetFeatureIndexByBinIndex(GetFirstStepBin(*labelCodes, features, firstStepBins, options).first));
+        }
+
+        const int featuresToSelectCount = Min(options.FeatureCount, features.GetFeatureCount());
+        yvector<yvector<double>> stepScores(features.GetBinCount());
+        for (size_t groupIndex = 0; groupIndex < groups.size(); ++groupIndex) {
+            TSweepGroup& group = *groups[groupIndex];
+            while (group.SelectedCount < featuresToSelectCount && !IsCancelled(options)) {
+                const auto disabledBins = candidateBins(group.Background.DisabledBinIndexes());
+                if (disabledBins.empty()) {
+                    break;
+                }
+                TTraceSpan span("SelectionStep", "step", group.SelectedCount + 1);
+                int maxEvalStepCount = 0;
+                for (int order : group.Orders) {
+                    maxEvalStepCount = Max(maxEvalStepCount, evalStepCounts[order]);
+                }
+                const int stepCount = Min(group.Background.EnabledBinIndexes().ysize(), maxEvalStepCount);
+                auto kernel = [&](int binIndex) {
+                    stepScores[binIndex].clear();
+                    group.Scorer.Evaluate(group.Background, binIndex, stepCount, &stepScores[binIndex]);
+                };
+                ParallelForEach(disabledBins.begin(), disabledBins.end(), kernel, options.ThreadCount);
+
+                // The first best bin, as the selection with this -t alone would choose
+                yvector<std::pair<int, yvector<int>>> choices;
+                for (int order : group.Orders) {
+                    const int scoreIndex = Min(evalStepCounts[order], stepCount) - 1;
+                    int bestBin = disabledBins[0];
+                    for (int binIndex : disabledBins) {
+                        if (stepScores[binIndex][scoreIndex] > stepScores[bestBin][scoreIndex]) {
+                            bestBin = binIndex;
+                        }
+                    }
+                    const int featureIndex = features.GetFeatureIndexByBinIndex(bestBin);
+                    auto choice = FindIf(choices, [featureIndex](const auto& c) { return c.first == featureIndex; });
+                    if (choice == choices.end()) {
+                        choices.push_back({featureIndex, {}});
+                        choice = choices.end() - 1;
+                    }
+                    choice->second.push_back(order);
+                }
+                for (auto& choice : yvector<std::pair<int, yvector<int>>>(choices.begin() + 1, choices.end())) {
+                    groups.emplace_back(new TSweepGroup{std::move(choice.second), group.Background, group.Scorer, group.SelectedCount});
+                    selectFeature(*groups.back(), choice.first);
+                }
+                group.Orders = std::move(choices[0].second);
+                selectFeature(group, choices[0].first);
+            }
+        }
+    }
+
+    void ScoreFeatures(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& sequence,
+        const TFastSelectionOptions& options,
+        std::function<void(int, double)> onFeatureScored)
+    {
+        const TLabelCodesPtr labelCodes = options.PoolData ? options.PoolData->LabelCodes : TLabelCodesPtr(MakeAtomicShared<TLabelCodes>(label));
+        yvector<bool> isInSequence(features.GetFeatureCount());
+        for (int featureIndex : sequence) {
+            Y_ENSURE(0 <= featureIndex && featureIndex < features.GetFeatureCount(),
+                     "Feature " << featureIndex << " is out of range [0; " << features.GetFeatureCount() << ")");
+            Y_ENSURE(!isInSequence[featureIndex], "Feature " << featureIndex << " is given twice");
+            isInSequence[featureIndex] = true;
+        }
+
+        for (size_t i : xrange(sequence.size())) {
+            if (IsCancelled(options)) {
+                return;
+            }
+            TTraceSpan span("ScoreFeature", "feature", sequence[i]);
+            const auto featureBins = features.GetFeatureBinIndexes(sequence[i]);
+            const yvector<int> binIndexes(featureBins.begin(), featureBins.end());
+
+            yvector<double> scores;
+            if (i == 0 && options.PoolData) {
+                for (int binIndex : binIndexes) {
+                    scores.push_back(options.PoolData->LabelInformation[binIndex]);
+                }
+            } else if (i == 0) {
+                TMutualInformationCalculator miCalc(labelCodes->size());
+                miCalc.AddFirstVariableCodes(*labelCodes);
+                auto kernel = [&](int binIndex) {
+                    return miCalc.GetValueWithSecondVariableBin(features.GetBin(binIndex));
+                };
+                ParallelForEach(binIndexes.begin(), binIndexes.end(), kernel, scores, options.ThreadCount);
+            } else {
+                // A fresh background and cache for every prefix, as for initial features
+                TBackground bg(features);
+                bg.DisableAll();
+                bg.SetFeaturesEnabled(yvector<int>(sequence.begin(), sequence.begin() + i));
+                TCachingBinScorer binScorer(labelCodes, features.GetBinCount());
+                const int stepCount = Min(bg.EnabledBinCount(), options.EvalStepCount);
+                auto kernel = [&](int binIndex) {
+                    return binScorer.Evaluate(bg, binIndex, stepCount).Score;
+                };
+                ParallelForEach(binIndexes.begin(), binIndexes.end(), kernel, scores, options.ThreadCount);
+            }
+            onFeatureScored(sequence[i], *MaxElement(scores.begin(), scores.end()));
         }
     }
 
     void FeatureSelection(const TBinFeatureSet& label, const TBinFeatureSet& features,
                           int evalStepCount,
                           int threadCount, std::function<void(int)> onFeatureSelected) {
+        const TLabelCodes labelCodes(label);
         TBackground bg(features);
 
         bg.DisableAll();
         {
+            const yvector<int> allBins = features.AllBinIndexes();
             int bestFeature = features.GetFeatureIndexByBinIndex(
-                GetBinWithMaximalMutualInformationWithLabel(label, features, threadCount));
+                GetBinWithMaximalMutualInformationWithLabel(labelCodes, features, allBins, threadCount).first);
 
             bg.SetFeatureEnabled(bestFeature, true);
             onFeatureSelected(bestFeature);
@@ -74,7 +480,7 @@ namespace NCmicot {
 
         auto kernel = [&](int binIndex) {
             int stepCount = Min(bg.EnabledBinIndexes().ysize(), evalStepCount);
-            return BuildBinScorerForEval(label, stepCount - 1, stepCount, threadCount)->Eval(bg, binIndex).Score;
+            return BuildBinScorerForEval(labelCodes, stepCount - 1, stepCount, threadCount)->Eval(bg, binIndex).Score;
         };
         for (int step = 0; step < features.GetFeatureCount() - 1; ++step) {
             int bestBin = *MaxElementBy(bg.DisabledBinIndexes(), kernel);
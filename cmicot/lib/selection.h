@@ -1,8 +1,15 @@
 #pragma once
 
 #include "bin_feature_set.h"
+#include "candidate_shards.h"
+#include "cmi_source.h"
+#include "label_codes.h"
+#include "metrics.h"
 
+#include <util/generic/array_ref.h>
+#include <util/generic/string.h>
 #include <util/generic/vector.h>
+#include <util/generic/ylimits.h>
 
 #include <functional>
 
@@ -10,6 +17,61 @@ namespace NCmicot {
     void FeatureSelection(const TBinFeatureSet& label, const TBinFeatureSet& features,
                           int evalStepCount, int threadCount, std::function<void(int)> onFeatureSelected);
 
+    /// Values of a pool which don't depend on the selection options. They are computed once and
+    /// shared read-only by all the selections over the pool.
+    struct TSelectionPoolData {
+        TLabelCodesPtr LabelCodes;
+        /// Mutual information of every bin with the label, which chooses the first feature.
+        yvector<double> LabelInformation;
+    };
+
+    TAtomicSharedPtr<const TSelectionPoolData> MakeSelectionPoolData(const TBinFeatureSet& label, const TBinFeatureSet& features,
+                                                                     int threadCount);
+
+    /// Pool data of every label of labels over the same features. Every bin is scanned once for
+    /// all the labels, and its entropy, which doesn't depend on the label, is computed once.
+    yvector<TAtomicSharedPtr<const TSelectionPoolData>> MakeSelectionPoolData(NArrayRef::TConstArrayRef<TBinFeatureSet> labels,
+                                                                              const TBinFeatureSet& features, int threadCount);
+
+    struct TFastSelectionOptions {
+        int EvalStepCount = 6;
+        int ThreadCount = 1;
+        int FeatureCount = Max<int>();
+        /// Features which are taken as already selected, in this order. They are reported first and
+        /// only the rest of the features is ranked.
+        yvector<int> InitialFeatures;
+        /// If set, the selection state is saved to this file after every selected feature.
+        TString CheckpointFile;
+        /// Continue from CheckpointFile if it exists. Features selected before are reported again.
+        bool Resume = false;
+        /// If set, this is called after every selection step.
+        std::function<void(const TSelectionStepMetrics&)> OnStepFinished;
+        /// Count the kernels of every step into TSelectionStepMetrics::Kernels. The counts are kept
+        /// by this selection only, but they cost some time, so the steps are zero otherwise.
+        bool CountKernels = false;
+        /// If set, all the information values are requested from it, e.g. from the workers of a
+        /// sharded pool, and the bins of the features are used only for their feature-bin layout.
+        TCmiSourcePtr CmiSource;
+        /// If set, the candidate bins are scored by these workers, which mirror the selected
+        /// features. Can't be combined with CmiSource or CheckpointFile, because the scorer caches
+        /// are kept by the workers.
+        TAtomicSharedPtr<TCandidateShards> CandidateShards;
+        /// If not empty, only these features are ranked after the initial ones.
+        yvector<int> CandidateFeatures;
+        /// If set, this is checked before every selection step, and the selection stops when it
+        /// returns true.
+        std::function<bool()> IsCancelled;
+        /// If set, the label codes and the first step are taken from it. It must be made for the same
+        /// pool, and with a CmiSource, for the same line weights.
+        TAtomicSharedPtr<const TSelectionPoolData> PoolData;
+    };
+
+    void FastFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const TFastSelectionOptions& options,
+        std::function<void(int)> onFeatureSelected);
+
     void FastFeatureSelection(
         const TBinFeatureSet& label,
         const TBinFeatureSet& features,
@@ -18,6 +80,40 @@ namespace NCmicot {
         int featureCount,
         std::function<void(int)> onFeatureSelected);
 
+    /// Ranks the features for every label of labels, as FastFeatureSelection would do for each of
+    /// them, one label after another. The features and the pool data of all the labels are shared.
+    /// onFeatureSelected gets the index of the label in labels and the selected feature. options
+    /// can't have a CMI source, candidate shards, pool data or a checkpoint.
+    void MultiLabelFeatureSelection(
+        NArrayRef::TConstArrayRef<TBinFeatureSet> labels,
+        const TBinFeatureSet& features,
+        const TFastSelectionOptions& options,
+        std::function<void(int, int)> onFeatureSelected);
+
+    /// Ranks the features as FastFeatureSelection would do with every EvalStepCount of
+    /// evalStepCounts, in a single run. The maximizing and minimizing steps of a smaller -t are a
+    /// prefix of the steps of a larger one, so while the rankings of several -t values agree, every
+    /// candidate is evaluated once for the largest of them and scored for all of them on the way.
+    /// onFeatureSelected gets the index of the -t in evalStepCounts and the selected feature.
+    /// options can't have a CMI source, candidate shards or a checkpoint, and OnStepFinished isn't
+    /// called.
+    void EvalStepSweepFeatureSelection(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& evalStepCounts,
+        const TFastSelectionOptions& options,
+        std::function<void(int, int)> onFeatureSelected);
+
+    /// Scores every feature of sequence as a candidate of the first step after the features before it
+    /// were given as initial features, and the first feature by the mutual information of its best
+    /// bin with the label. Only EvalStepCount, ThreadCount, IsCancelled and PoolData of options are used.
+    void ScoreFeatures(
+        const TBinFeatureSet& label,
+        const TBinFeatureSet& features,
+        const yvector<int>& sequence,
+        const TFastSelectionOptions& options,
+        std::function<void(int, double)> onFeatureScored);
+
     yvector<int> FeatureSelection(const TBinFeatureSet& label, const TBinFeatureSet& features,
                                   int evalStepCount, int threadCount);
 }
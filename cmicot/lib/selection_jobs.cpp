@@ -0,0 +1,172 @@
+#include "selection_jobs.h"
+#include "options.h"
+#include "trace.h"
+
+#include <library/getopt/small/last_getopt.h>
+
+#include <util/folder/path.h>
+#include <util/generic/hash.h>
+#include <util/generic/yexception.h>
+#include <util/stream/file.h>
+#include <util/stream/input.h>
+#include <util/stream/output.h>
+#include <util/string/iterator.h>
+#include <util/string/strip.h>
+#include <util/system/atomic.h>
+#include <util/system/condvar.h>
+#include <util/system/guard.h>
+#include <util/system/mutex.h>
+#include <util/thread/queue.h>
+
+namespace NCmicot {
+    void ParseCommandArgs(const NLastGetopt::TOpts& options, const TString& command, const yvector<TString>& args) {
+        yvector<const char*> argv = {command.data()};
+        for (const TString& arg : args) {
+            Y_ENSURE(arg != "--help" && arg != "-?" && arg != "--svnrevision" && arg != "-V",
+                     "Option " << arg << " can't be used in " << command);
+            argv.push_back(arg.data());
+        }
+        NLastGetopt::TOptsParseResultException parsed(&options, argv.size(), argv.data());
+        Y_UNUSED(parsed);
+    }
+
+    TSelectionArgs ParseSelectionArgs(const TString& command, const yvector<TString>& args, bool isScoring,
+                                      const TFastSelectionOptions& defaults) {
+        TSelectionArgs result;
+        result.Options = defaults;
+
+        int featureCount = 0;
+        NLastGetopt::TOpts options;
+        options.AddCharOption('t', "Eval algorithm step count")
+               .RequiredArgument()
+               .StoreResult(&result.Options.EvalStepCount);
+        options.AddLongOption("thread-count", "Threads of the selection")
+               .RequiredArgument()
+               .StoreResult(&result.Options.ThreadCount);
+        if (isScoring) {
+            options.AddLongOption("features", "Features to score, in this order")
+                   .Required()
+                   .RequiredArgument("FEATURES")
+                   .StoreResultT<TString>(&result.Features);
+        } else {
+            options.AddLongOption("select-count", "Number of features to select")
+                   .RequiredArgument()
+                   .StoreResult(&featureCount);
+            options.AddLongOption("candidates", "Features to rank, all of them by default")
+                   .RequiredArgument("FEATURES")
+                   .StoreResultT<TString>(&result.Candidates);
+            options.AddLongOption("initial-features", "Features taken as already selected")
+                   .RequiredArgument("FEATURES")
+                   .StoreResultT<TString>(&result.InitialFeatures);
+        }
+        options.SetFreeArgsMax(0);
+
+        ParseCommandArgs(options, command, args);
+
+        Y_ENSURE(result.Options.EvalStepCount > 0 && result.Options.ThreadCount > 0 && featureCount >= 0,
+                 "-t, --thread-count and --select-count should be positive");
+        if (featureCount > 0) {
+            result.Options.FeatureCount = featureCount;
+        }
+        return result;
+    }
+
+    yvector<int> ToKeptFeatures(const TString& list, const yvector<int>& keptColumns) {
+        yvector<int> result;
+        for (int featureId : ParseColumnList(list)) {
+            result.push_back(ToKeptFeature(featureId, keptColumns));
+        }
+        return result;
+    }
+
+    TFastSelectionOptions ToSelectionOptions(const TSelectionArgs& args, const yvector<int>& keptColumns) {
+        TFastSelectionOptions result = args.Options;
+        if (args.Candidates) {
+            result.CandidateFeatures = ToKeptFeatures(*args.Candidates, keptColumns);
+        }
+        if (args.InitialFeatures) {
+            result.InitialFeatures = ToKeptFeatures(*args.InitialFeatures, keptColumns);
+        }
+        return result;
+    }
+
+    yvector<TSelectionJob> ReadSelectionJobs(IInputStream& input, const TFastSelectionOptions& defaults) {
+        yvector<TSelectionJob> result;
+        yhash<TString, int> outputLines;
+        TString line;
+        for (int lineNumber = 1; input.ReadLine(line); ++lineNumber) {
+            const TString stripped = StripString(line);
+            if (stripped.empty() || stripped.StartsWith('#')) {
+                continue;
+            }
+            yvector<TString> tokens;
+            for (const auto& it : StringSplitter(stripped).SplitBySet(" \t\r").SkipEmpty()) {
+                tokens.push_back(TString(it.Token()));
+            }
+            TSelectionJob job;
+            job.OutputFile = tokens[0];
+            TFsPath outputPath(job.OutputFile);
+            if (outputPath.IsRelative()) {
+                outputPath = TFsPath::Cwd() / outputPath;
+            }
+            const auto output = outputLines.insert({outputPath.Fix().GetPath(), lineNumber});
+            Y_ENSURE(output.second, "Job at line " << lineNumber << " writes " << job.OutputFile << " as the job at line "
+                                                   << output.first->second);
+            try {
+                job.Args = ParseSelectionArgs("job", yvector<TString>(tokens.begin() + 1, tokens.end()), false, defaults);
+            } catch (...) {
+                ythrow yexception() << "Job at line " << lineNumber << ": " << CurrentExceptionMessage();
+            }
+            result.push_back(std::move(job));
+        }
+        return result;
+    }
+
+    int RunSelectionJobs(const TBinFeatureSet& label, const TBinFeatureSet& features, const yvector<int>& keptColumns,
+                         const yvector<TSelectionJob>& jobs, int threadCount) {
+        const TAtomicSharedPtr<const TSelectionPoolData> poolData = MakeSelectionPoolData(label, features, threadCount);
+
+        TAtomic failedCount = 0;
+        TMutex errorLock;
+        // Every job holds its threads from the budget while it runs, so the threads of the jobs at a
+        // time add up to at most threadCount. Jobs start in the order of the list
+        TMutex budgetLock;
+        TCondVar budgetFreed;
+        int freeThreads = threadCount;
+        TMtpQueue queue;
+        queue.Start(threadCount);
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            const int jobThreads = Min(jobs[i].Args.Options.ThreadCount, threadCount);
+            with_lock (budgetLock) {
+                while (freeThreads < jobThreads) {
+                    budgetFreed.WaitI(budgetLock);
+                }
+                freeThreads -= jobThreads;
+            }
+            queue.SafeAddFunc([&, i, jobThreads] {
+                const TSelectionJob& job = jobs[i];
+                TTraceSpan span("SelectionJob", "job", i);
+                try {
+                    TFastSelectionOptions options = ToSelectionOptions(job.Args, keptColumns);
+                    options.ThreadCount = jobThreads;
+                    options.PoolData = poolData;
+                    TOFStream output(job.OutputFile);
+                    FastFeatureSelection(label, features, options, [&](int featureIndex) {
+                        output << ToPoolFeature(featureIndex, keptColumns) << Endl;
+                    });
+                } catch (...) {
+                    AtomicIncrement(failedCount);
+                    with_lock (errorLock) {
+                        Cerr << "Job " << job.OutputFile << " failed: " << CurrentExceptionMessage() << Endl;
+                    }
+                }
+                with_lock (budgetLock) {
+                    freeThreads += jobThreads;
+                }
+                budgetFreed.BroadCast();
+            });
+        }
+        queue.Stop();
+        return AtomicGet(failedCount);
+    }
+}
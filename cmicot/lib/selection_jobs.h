@@ -0,0 +1,60 @@
+#pragma once
+
+#include "pool_loader.h"
+#include "selection.h"
+
+#include <util/generic/maybe.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+
+class IInputStream;
+
+namespace NLastGetopt {
+    class TOpts;
+}
+
+namespace NCmicot {
+    /// Selection options given as command line arguments, by a server request or a job: -t,
+    /// --thread-count and either --select-count, --candidates and --initial-features, or --features
+    /// to score. Feature lists are kept as given, with the feature ids of the pool.
+    struct TSelectionArgs {
+        TFastSelectionOptions Options;
+        TMaybe<TString> Features;
+        TMaybe<TString> Candidates;
+        TMaybe<TString> InitialFeatures;
+    };
+
+    /// Parses args, the options of command, except for the options which would exit the process,
+    /// such as --help.
+    void ParseCommandArgs(const NLastGetopt::TOpts& options, const TString& command, const yvector<TString>& args);
+
+    /// Parses args, the options of command. Options which aren't given keep their values in defaults.
+    TSelectionArgs ParseSelectionArgs(const TString& command, const yvector<TString>& args, bool isScoring,
+                                      const TFastSelectionOptions& defaults = TFastSelectionOptions());
+
+    /// Indexes among the read features of a list of pool feature ids, e.g. "1,3,5-8".
+    yvector<int> ToKeptFeatures(const TString& list, const yvector<int>& keptColumns);
+
+    /// Selection options of args with the candidates and the initial features of a pool.
+    TFastSelectionOptions ToSelectionOptions(const TSelectionArgs& args, const yvector<int>& keptColumns);
+
+    /// A selection over a shared pool with its own options and output file.
+    struct TSelectionJob {
+        TString OutputFile;
+        TSelectionArgs Args;
+    };
+
+    /// Reads a job per line: the output file and then the selection options, e.g.
+    /// "top10.txt -t 3 --select-count 10 --candidates 1-40". Empty lines and lines starting with #
+    /// are skipped. Options which aren't given keep their values in defaults. Throws if two jobs
+    /// write the same output file.
+    yvector<TSelectionJob> ReadSelectionJobs(IInputStream& input, const TFastSelectionOptions& defaults);
+
+    /// Runs the jobs over a pool read with keptColumns in threadCount threads, and writes the selected
+    /// features of every job to its output file, one pool feature id per line. A job starts when its
+    /// --thread-count threads are free, but at most threadCount of them. The label codes and
+    /// the first step are computed once for all the jobs. A failed job doesn't stop the others, its
+    /// error is written to stderr. Returns the number of failed jobs.
+    int RunSelectionJobs(const TBinFeatureSet& label, const TBinFeatureSet& features, const yvector<int>& keptColumns,
+                         const yvector<TSelectionJob>& jobs, int threadCount);
+}
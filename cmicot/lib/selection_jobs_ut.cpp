@@ -0,0 +1,71 @@
+#include "selection_jobs.h"
+#include "test_pool_gen.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/stream/str.h>
+#include <util/string/cast.h>
+#include <util/system/fs.h>
+
+namespace NCmicot {
+    SIMPLE_UNIT_TEST_SUITE(SelectionJobs) {
+        SIMPLE_UNIT_TEST(SameAsSeparateSelections) {
+            TReallyFastRng32 rng(20170910);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 10, binSize, {1, 4});
+            // The pool was read without column 3, its feature 2
+            const yvector<int> keptColumns = {0, 1, 2, 4, 5, 6, 7, 8, 9, 10, 11};
+
+            TFastSelectionOptions defaults;
+            defaults.EvalStepCount = 3;
+            defaults.FeatureCount = 4;
+            const TString jobList =
+                "# Output, options\n"
+                "jobs_ut.0 --thread-count 2\n"
+                "\n"
+                "jobs_ut.1 -t 2 --select-count 3 --candidates 3-7 --initial-features 9\n"
+                "jobs_ut.2 --thread-count 8\n";
+            TStringInput input(jobList);
+            const yvector<TSelectionJob> jobs = ReadSelectionJobs(input, defaults);
+            UNIT_ASSERT_VALUES_EQUAL(jobs.size(), 3);
+            UNIT_ASSERT_VALUES_EQUAL(jobs[0].OutputFile, "jobs_ut.0");
+            UNIT_ASSERT_VALUES_EQUAL(jobs[0].Args.Options.EvalStepCount, 3);
+            UNIT_ASSERT_VALUES_EQUAL(jobs[1].Args.Options.FeatureCount, 3);
+            UNIT_ASSERT_VALUES_EQUAL(RunSelectionJobs(label, features, keptColumns, jobs, 2), 0);
+
+            for (const TSelectionJob& job : jobs) {
+                const TFastSelectionOptions options = ToSelectionOptions(job.Args, keptColumns);
+                TString expected;
+                FastFeatureSelection(label, features, options, [&](int featureIndex) {
+                    expected += ToString(ToPoolFeature(featureIndex, keptColumns)) + "\n";
+                });
+                UNIT_ASSERT_VALUES_EQUAL(TIFStream(job.OutputFile).ReadAll(), expected);
+                NFs::Remove(job.OutputFile);
+            }
+
+            // Shared pool data gives the same scores
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            yvector<double> expected, scores;
+            ScoreFeatures(label, features, {4, 1, 7}, options, [&expected](int, double score) {
+                expected.push_back(score);
+            });
+            options.PoolData = MakeSelectionPoolData(label, features, 2);
+            ScoreFeatures(label, features, {4, 1, 7}, options, [&scores](int, double score) {
+                scores.push_back(score);
+            });
+            UNIT_ASSERT_VALUES_EQUAL(scores, expected);
+
+            const TString badJobList = "jobs_ut.2 --select-count 0 --frobnicate\n";
+            TStringInput badInput(badJobList);
+            UNIT_ASSERT_EXCEPTION(ReadSelectionJobs(badInput, defaults), yexception);
+
+            const TString sameOutputJobList = "jobs_ut.3 -t 2\n./jobs_ut.3 -t 3\n";
+            TStringInput sameOutputInput(sameOutputJobList);
+            UNIT_ASSERT_EXCEPTION(ReadSelectionJobs(sameOutputInput, defaults), yexception);
+        }
+    }
+}
@@ -1,14 +1,20 @@
 #include "selection.h"
 #include <cmicot/lib/binarize.h>
 #include <cmicot/lib/bin_feature_set.h>
+#include <cmicot/lib/io.h>
 #include <cmicot/lib/test_pool_gen.h>
 
+#include <library/grid_creator/binarization.h>
+
 #include <library/unittest/registar.h>
 
 #include <util/generic/algorithm.h>
 #include <util/generic/xrange.h>
 #include <util/random/fast.h>
 #include <util/random/shuffle.h>
+#include <util/stream/str.h>
+#include <util/string/cast.h>
+#include <util/system/fs.h>
 
 namespace NCmicot {
     SIMPLE_UNIT_TEST_SUITE(Selection) {
@@ -110,5 +116,292 @@ namespace NCmicot {
                 UNIT_ASSERT_VALUES_EQUAL(fastResult.size(), featureCount);
             }
         }
+
+        SIMPLE_UNIT_TEST(LevelCodedStorage) {
+            TReallyFastRng32 rng(20170411);
+            const int lineCount = 400;
+            const int featureCount = 8;
+
+            TRawPool pool(featureCount + 1, yvector<double>(lineCount));
+            for (int line : xrange(lineCount)) {
+                for (int feature : xrange(1, featureCount + 1)) {
+                    pool[feature][line] = rng.Uniform(20);
+                }
+                pool[0][line] = (pool[1][line] > 10) ^ (pool[3][line] < 5);
+            }
+
+            auto borderBuilder = [](yvector<float>& values) {
+                return NSplitSelection::TMedianPlusUniformBinarizer().BestSplit(values, 4, false);
+            };
+
+            auto select = [&](EFeatureStorage storage) {
+                TBinFeatureSet label, features;
+                std::tie(label, features) = BinarizeRawPool(pool, borderBuilder, 2, storage);
+
+                yvector<int> result;
+                FastFeatureSelection(label, features, 3, 2, featureCount, [&](int feature) {
+                    result.push_back(feature);
+                });
+                return result;
+            };
+
+            UNIT_ASSERT_VALUES_EQUAL(select(EFeatureStorage::Levels), select(EFeatureStorage::Bins));
+        }
+
+        SIMPLE_UNIT_TEST(ResumeFromCheckpoint) {
+            TReallyFastRng32 rng(20170420);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {3, 3});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 12, binSize, {1, 4});
+
+            auto select = [&](const TFastSelectionOptions& options) {
+                yvector<int> result;
+                FastFeatureSelection(label, features, options, [&](int feature) {
+                    result.push_back(feature);
+                });
+                return result;
+            };
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 4;
+            options.ThreadCount = 2;
+            const yvector<int> uninterrupted = select(options);
+
+            options.CheckpointFile = "selection_ut.checkpoint";
+            options.Resume = true;
+            NFs::Remove(options.CheckpointFile);
+
+            options.FeatureCount = 5;
+            const yvector<int> prefix = select(options);
+            UNIT_ASSERT(Equal(prefix.begin(), prefix.end(), uninterrupted.begin()));
+
+            options.FeatureCount = Max<int>();
+            UNIT_ASSERT_VALUES_EQUAL(select(options), uninterrupted);
+
+            // A checkpoint can't be resumed with different parameters
+            options.EvalStepCount = 3;
+            UNIT_ASSERT_EXCEPTION(select(options), yexception);
+
+            // Nor with another pool of the same shape
+            options.EvalStepCount = 4;
+            const TBinFeatureSet otherLabel = MakeRandomLabel(rng, binSize, {3, 3});
+            UNIT_ASSERT_EXCEPTION(FastFeatureSelection(otherLabel, features, options, [](int) {}), yexception);
+
+            NFs::Remove(options.CheckpointFile);
+        }
+
+        SIMPLE_UNIT_TEST(WarmStart) {
+            TReallyFastRng32 rng(20170421);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 12, binSize, {1, 4});
+
+            auto select = [&](const TFastSelectionOptions& options) {
+                yvector<int> result;
+                FastFeatureSelection(label, features, options, [&](int feature) {
+                    result.push_back(feature);
+                });
+                return result;
+            };
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 4;
+            options.ThreadCount = 2;
+            const yvector<int> full = select(options);
+
+            options.InitialFeatures.assign(full.begin(), full.begin() + 4);
+            UNIT_ASSERT_VALUES_EQUAL(select(options), full);
+
+            options.InitialFeatures = {3, 3};
+            UNIT_ASSERT_EXCEPTION(select(options), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(CandidatesAndCancellation) {
+            TReallyFastRng32 rng(20170422);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 10, binSize, {1, 4});
+
+            auto select = [&](const TFastSelectionOptions& options) {
+                yvector<int> result;
+                FastFeatureSelection(label, features, options, [&](int feature) {
+                    result.push_back(feature);
+                });
+                return result;
+            };
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 4;
+            options.InitialFeatures = {2};
+            options.CandidateFeatures = {9, 1, 4, 7};
+            yvector<int> selected = select(options);
+            UNIT_ASSERT_VALUES_EQUAL(selected.size(), 5);
+            UNIT_ASSERT_VALUES_EQUAL(selected[0], 2);
+            Sort(selected.begin() + 1, selected.end());
+            UNIT_ASSERT_VALUES_EQUAL(selected, yvector<int>({2, 1, 4, 7, 9}));
+
+            options.InitialFeatures.clear();
+            options.CandidateFeatures.clear();
+            const yvector<int> full = select(options);
+            options.IsCancelled = [&] {
+                return selected.size() == 3;
+            };
+            selected.clear();
+            FastFeatureSelection(label, features, options, [&](int feature) {
+                selected.push_back(feature);
+            });
+            UNIT_ASSERT_VALUES_EQUAL(selected, yvector<int>(full.begin(), full.begin() + 3));
+        }
+
+        SIMPLE_UNIT_TEST(ScoreFeatures) {
+            TReallyFastRng32 rng(20170423);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 8, binSize, {1, 4});
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            options.ThreadCount = 2;
+            yvector<int> prefix;
+            for (int step : xrange(4)) {
+                // The feature selected after the prefix has the best score of all the candidates
+                options.InitialFeatures = prefix;
+                options.FeatureCount = step + 1;
+                int expected = -1;
+                FastFeatureSelection(label, features, options, [&](int feature) {
+                    expected = feature;
+                });
+
+                int best = -1;
+                double bestScore = 0.0;
+                for (int feature : xrange(features.GetFeatureCount())) {
+                    if (Find(prefix.begin(), prefix.end(), feature) != prefix.end()) {
+                        continue;
+                    }
+                    yvector<int> sequence = prefix;
+                    sequence.push_back(feature);
+                    yvector<double> scores;
+                    ScoreFeatures(label, features, sequence, options, [&](int scored, double score) {
+                        UNIT_ASSERT_VALUES_EQUAL(scored, sequence[scores.size()]);
+                        scores.push_back(score);
+                    });
+                    UNIT_ASSERT_VALUES_EQUAL(scores.size(), sequence.size());
+                    if (best < 0 || scores.back() > bestScore) {
+                        best = feature;
+                        bestScore = scores.back();
+                    }
+                }
+                UNIT_ASSERT_VALUES_EQUAL(best, expected);
+                prefix.push_back(expected);
+            }
+
+            UNIT_ASSERT_EXCEPTION(ScoreFeatures(label, features, {1, 1}, options, [](int, double) {}), yexception);
+        }
+
+        SIMPLE_UNIT_TEST(StepMetrics) {
+            TReallyFastRng32 rng(20170502);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 3});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 8, binSize, {1, 4});
+
+            yvector<int> selected;
+            yvector<TSelectionStepMetrics> steps;
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            options.ThreadCount = 2;
+            options.CountKernels = true;
+            options.OnStepFinished = [&steps](const TSelectionStepMetrics& metrics) {
+                steps.push_back(metrics);
+            };
+            FastFeatureSelection(label, features, options, [&](int feature) {
+                selected.push_back(feature);
+            });
+
+            UNIT_ASSERT_VALUES_EQUAL(steps.size(), selected.size());
+            for (int i : xrange(steps.ysize())) {
+                const TSelectionStepMetrics& step = steps[i];
+                UNIT_ASSERT_VALUES_EQUAL(step.Step, i + 1);
+                UNIT_ASSERT_VALUES_EQUAL(step.SelectedFeature, selected[i]);
+                UNIT_ASSERT(step.Kernels.VectorCounters > 0);
+                UNIT_ASSERT_VALUES_EQUAL(step.Kernels.HashCounters, 0);
+                if (i == 0) {
+                    UNIT_ASSERT_VALUES_EQUAL(step.Kernels.Evaluations, 0);
+                    continue;
+                }
+                UNIT_ASSERT_VALUES_EQUAL(step.Kernels.Evaluations, step.Candidates);
+                UNIT_ASSERT(step.Kernels.CmiCalls >= step.Candidates);
+                const ui64 maxSteps = step.Kernels.MaxStepsReused + step.Kernels.MaxStepsRecomputed;
+                const ui64 minSteps = step.Kernels.MinStepsReused + step.Kernels.MinStepsRecomputed;
+                UNIT_ASSERT(maxSteps < minSteps && minSteps <= 3 * step.Candidates);
+            }
+            // Later steps search only the bins enabled since the previous one, so some cached steps survive
+            UNIT_ASSERT(steps.back().Kernels.MinStepsReused > 0);
+
+            // Cached steps don't change the scores
+            int scored = 0;
+            ScoreFeatures(label, features, selected, options, [&](int, double score) {
+                UNIT_ASSERT_DOUBLES_EQUAL(steps[scored++].Score, score, 1e-12);
+            });
+            UNIT_ASSERT_VALUES_EQUAL(scored, steps.ysize());
+
+            TStringStream out;
+            OutputStepMetrics(steps[1], out);
+            UNIT_ASSERT(out.Str().StartsWith("{\"step\":2,\"feature\":" + ToString(selected[1]) + ","));
+            UNIT_ASSERT(out.Str().EndsWith("\"counter_type\":\"vector\"}\n"));
+        }
+
+        SIMPLE_UNIT_TEST(MultiLabel) {
+            TReallyFastRng32 rng(20170912);
+            const int binSize = 300;
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 10, binSize, {1, 4});
+            yvector<TBinFeatureSet> labels;
+            labels.push_back(MakeRandomLabel(rng, binSize, {2, 4}));
+            labels.push_back(MakeRandomLabel(rng, binSize, {1, 1}));
+            labels.push_back(MakeRandomLabel(rng, binSize, {3, 3}));
+
+            TFastSelectionOptions options;
+            options.EvalStepCount = 3;
+            options.ThreadCount = 2;
+            options.FeatureCount = 5;
+            yvector<yvector<int>> selected(labels.size());
+            MultiLabelFeatureSelection(labels, features, options, [&selected](int labelIndex, int feature) {
+                selected[labelIndex].push_back(feature);
+            });
+            for (int labelIndex : xrange(labels.ysize())) {
+                yvector<int> expected;
+                FastFeatureSelection(labels[labelIndex], features, options, [&expected](int feature) {
+                    expected.push_back(feature);
+                });
+                UNIT_ASSERT_VALUES_EQUAL(selected[labelIndex], expected);
+            }
+        }
+
+        SIMPLE_UNIT_TEST(EvalStepSweep) {
+            TReallyFastRng32 rng(20170913);
+            const int binSize = 300;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 14, binSize, {1, 4});
+
+            const yvector<int> evalStepCounts = {1, 2, 3, 4, 5, 7};
+            TFastSelectionOptions options;
+            options.ThreadCount = 2;
+            options.FeatureCount = 9;
+            for (const yvector<int>& initialFeatures : {yvector<int>(), yvector<int>{5, 2}}) {
+                options.InitialFeatures = initialFeatures;
+                yvector<yvector<int>> selected(evalStepCounts.size());
+                EvalStepSweepFeatureSelection(label, features, evalStepCounts, options, [&selected](int order, int feature) {
+                    selected[order].push_back(feature);
+                });
+                for (int order : xrange(evalStepCounts.ysize())) {
+                    TFastSelectionOptions orderOptions = options;
+                    orderOptions.EvalStepCount = evalStepCounts[order];
+                    yvector<int> expected;
+                    FastFeatureSelection(label, features, orderOptions, [&expected](int feature) {
+                        expected.push_back(feature);
+                    });
+                    UNIT_ASSERT_VALUES_EQUAL(selected[order], expected);
+                }
+            }
+        }
     }
 }
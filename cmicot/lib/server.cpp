@@ -0,0 +1,430 @@
+#include "server.h"
+#include "selection_jobs.h"
+#include "shard_channel.h"
+#include "trace.h"
+
+#include <library/getopt/small/last_getopt.h>
+#include <library/grid_creator/binarization.h>
+#include <library/json/writer/json.h>
+#include <library/threading/future/async.h>
+
+#include <util/datetime/base.h>
+#include <util/generic/algorithm.h>
+#include <util/generic/maybe.h>
+#include <util/generic/yexception.h>
+#include <util/network/sock.h>
+#include <util/network/socket.h>
+#include <util/stream/buffered.h>
+#include <util/stream/input.h>
+#include <util/stream/output.h>
+#include <util/string/iterator.h>
+#include <util/system/fs.h>
+#include <util/system/guard.h>
+#include <util/thread/pool.h>
+
+namespace NCmicot {
+    namespace {
+        struct TRequest {
+            TString Id;
+            TString Command;
+            yvector<TString> Args;
+        };
+
+        using TCancelFlag = TAtomicSharedPtr<TAtomic>;
+
+        /// Starts the response line of a request, more fields can be added before EndObject().
+        NJsonWriter::TPairContext BeginResponse(NJsonWriter::TBuf& json, const TString& id, TStringBuf event) {
+            return json.BeginObject().WriteKey("id").WriteString(id).WriteKey("event").WriteString(event);
+        }
+
+        /// Pool name and selection arguments of select and score requests.
+        std::pair<TString, TSelectionArgs> ParseSelectionRequest(const TRequest& request, bool isScoring) {
+            Y_ENSURE(!request.Args.empty(), "Request " << request.Command << " should start with a pool name");
+            const yvector<TString> args(request.Args.begin() + 1, request.Args.end());
+            return {request.Args[0], ParseSelectionArgs(request.Command, args, isScoring)};
+        }
+    }
+
+    /* TResidentPools */
+
+    void TResidentPools::Add(const TString& name, TPoolPtr pool) {
+        with_lock (Lock) {
+            Pools[name] = std::move(pool);
+        }
+    }
+
+    TResidentPools::TPoolPtr TResidentPools::Get(const TString& name) const {
+        with_lock (Lock) {
+            const auto it = Pools.find(name);
+            Y_ENSURE(it != Pools.end(), "There is no pool " << name);
+            return it->second;
+        }
+    }
+
+    bool TResidentPools::Remove(const TString& name) {
+        with_lock (Lock) {
+            return Pools.erase(name) > 0;
+        }
+    }
+
+    yvector<std::pair<TString, TResidentPools::TPoolPtr>> TResidentPools::List() const {
+        yvector<std::pair<TString, TPoolPtr>> result;
+        with_lock (Lock) {
+            result.assign(Pools.begin(), Pools.end());
+        }
+        Sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first;
+        });
+        return result;
+    }
+
+    /* TSelectionServer::TConnection */
+
+    class TSelectionServer::TConnection {
+    public:
+        TConnection(TSelectionServer& server, IOutputStream& out)
+            : Server(server)
+            , Out(out)
+        {
+        }
+
+        void HandleLine(const TString& line);
+        /// Waits for all the requests of the connection.
+        void Wait();
+
+    private:
+        void Run(const TRequest& request, const TCancelFlag& cancelled);
+        void Cancel(const TRequest& request);
+        void Load(const TRequest& request);
+        void Unload(const TRequest& request);
+        void ListPools(const TRequest& request);
+        void Select(const TRequest& request, const TCancelFlag& cancelled);
+        void Score(const TRequest& request, const TCancelFlag& cancelled);
+
+        void Write(const NJsonWriter::TBuf& json);
+        void WriteEvent(const TString& id, TStringBuf event);
+        void WriteError(const TString& id, const TString& message);
+
+        TSelectionServer& Server;
+        IOutputStream& Out;
+        TMutex OutputLock;
+        bool IsBroken = false;
+        /// Never held together with OutputLock.
+        TMutex RequestsLock;
+        yhash<TString, TCancelFlag> Running;
+        yvector<NThreading::TFuture<void>> Tasks;
+    };
+
+    void TSelectionServer::TConnection::HandleLine(const TString& line) {
+        yvector<TString> tokens;
+        for (const auto& it : StringSplitter(line).SplitBySet(" \t\r").SkipEmpty()) {
+            tokens.push_back(TString(it.Token()));
+        }
+        if (tokens.empty()) {
+            return;
+        }
+        TRequest request;
+        request.Id = tokens[0];
+        if (tokens.size() < 2) {
+            WriteError(request.Id, "Request should be ID COMMAND [ARGS]");
+            return;
+        }
+        request.Command = tokens[1];
+        request.Args.assign(tokens.begin() + 2, tokens.end());
+
+        // Cancellation and shutdown can't wait in the queue behind the requests they stop
+        if (request.Command == "cancel") {
+            Cancel(request);
+            return;
+        }
+        if (request.Command == "shutdown") {
+            Server.Shutdown();
+            WriteEvent(request.Id, "done");
+            return;
+        }
+
+        const TCancelFlag cancelled = MakeAtomicShared<TAtomic>(0);
+        bool isDuplicate = false;
+        with_lock (RequestsLock) {
+            isDuplicate = !Running.emplace(request.Id, cancelled).second;
+            if (!isDuplicate) {
+                EraseIf(Tasks, [](const NThreading::TFuture<void>& task) {
+                    return task.HasValue() || task.HasException();
+                });
+                Tasks.push_back(NThreading::Async([this, request, cancelled] {
+                    Run(request, cancelled);
+                }, Server.Executor));
+            }
+        }
+        if (isDuplicate) {
+            WriteError(request.Id, "Request " + request.Id + " is already running");
+        }
+    }
+
+    void TSelectionServer::TConnection::Wait() {
+        yvector<NThreading::TFuture<void>> tasks;
+        with_lock (RequestsLock) {
+            tasks = Tasks;
+        }
+        for (const auto& task : tasks) {
+            task.Wait();
+        }
+    }
+
+    void TSelectionServer::TConnection::Run(const TRequest& request, const TCancelFlag& cancelled) {
+        TTraceSpan span("ServerRequest");
+        const TInstant start = TInstant::Now();
+        NJsonWriter::TBuf json;
+        try {
+            if (AtomicGet(*cancelled)) {
+                // Cancelled while waiting in the queue
+            } else if (request.Command == "load") {
+                Load(request);
+            } else if (request.Command == "unload") {
+                Unload(request);
+            } else if (request.Command == "pools") {
+                ListPools(request);
+            } else if (request.Command == "select") {
+                Select(request, cancelled);
+            } else if (request.Command == "score") {
+                Score(request, cancelled);
+            } else {
+                ythrow yexception() << "Unknown command " << request.Command;
+            }
+
+            if (AtomicGet(*cancelled)) {
+                BeginResponse(json, request.Id, "cancelled").EndObject();
+            } else {
+                BeginResponse(json, request.Id, "done")
+                    .WriteKey("seconds").WriteDouble((TInstant::Now() - start).SecondsFloat())
+                .EndObject();
+            }
+        } catch (...) {
+            BeginResponse(json, request.Id, "error")
+                .WriteKey("message").WriteString(CurrentExceptionMessage())
+            .EndObject();
+        }
+        // The ID is free once the client sees the last response
+        with_lock (RequestsLock) {
+            Running.erase(request.Id);
+        }
+        Write(json);
+    }
+
+    void TSelectionServer::TConnection::Cancel(const TRequest& request) {
+        if (request.Args.size() != 1) {
+            WriteError(request.Id, "Request cancel should have the ID of the request to cancel");
+            return;
+        }
+        bool isFound = false;
+        with_lock (RequestsLock) {
+            const auto it = Running.find(request.Args[0]);
+            if (it != Running.end()) {
+                AtomicSet(*it->second, 1);
+                isFound = true;
+            }
+        }
+        if (isFound) {
+            WriteEvent(request.Id, "done");
+        } else {
+            WriteError(request.Id, "There is no running request " + request.Args[0]);
+        }
+    }
+
+    void TSelectionServer::TConnection::Load(const TRequest& request) {
+        Y_ENSURE(!request.Args.empty(), "Request load should start with a pool name");
+        TOptions options;
+        const NLastGetopt::TOpts parser = CreateCommandLineOptions(options);
+        ParseCommandArgs(parser, request.Command, yvector<TString>(request.Args.begin() + 1, request.Args.end()));
+
+        const TString& name = request.Args[0];
+        TResidentPools::TPoolPtr pool = MakeAtomicShared<const TLoadedPool>(LoadPool(options));
+        NJsonWriter::TBuf json;
+        BeginResponse(json, request.Id, "loaded")
+            .WriteKey("pool").WriteString(name)
+            .WriteKey("lines").WriteULongLong(pool->Label.GetBinCount() ? pool->Label.GetBin(0).size() : 0)
+            .WriteKey("features").WriteInt(pool->Features.GetFeatureCount())
+            .WriteKey("bins").WriteInt(pool->Features.GetBinCount())
+        .EndObject();
+        Server.Pools.Add(name, std::move(pool));
+        Write(json);
+    }
+
+    void TSelectionServer::TConnection::Unload(const TRequest& request) {
+        Y_ENSURE(request.Args.size() == 1, "Request unload should have a pool name");
+        Y_ENSURE(Server.Pools.Remove(request.Args[0]), "There is no pool " << request.Args[0]);
+    }
+
+    void TSelectionServer::TConnection::ListPools(const TRequest& request) {
+        Y_ENSURE(request.Args.empty(), "Request pools has no arguments");
+        for (const auto& namedPool : Server.Pools.List()) {
+            const TLoadedPool& pool = *namedPool.second;
+            NJsonWriter::TBuf json;
+            BeginResponse(json, request.Id, "pool")
+                .WriteKey("pool").WriteString(namedPool.first)
+                .WriteKey("lines").WriteULongLong(pool.Label.GetBinCount() ? pool.Label.GetBin(0).size() : 0)
+                .WriteKey("features").WriteInt(pool.Features.GetFeatureCount())
+                .WriteKey("bins").WriteInt(pool.Features.GetBinCount())
+            .EndObject();
+            Write(json);
+        }
+    }
+
+    void TSelectionServer::TConnection::Select(const TRequest& request, const TCancelFlag& cancelled) {
+        const auto args = ParseSelectionRequest(request, false);
+        const TResidentPools::TPoolPtr pool = Server.Pools.Get(args.first);
+        TFastSelectionOptions options = ToSelectionOptions(args.second, pool->KeptColumns);
+        options.IsCancelled = [&cancelled] {
+            return AtomicGet(*cancelled) != 0;
+        };
+
+        int rank = 0;
+        FastFeatureSelection(pool->Label, pool->Features, options, [&](int featureIndex) {
+            NJsonWriter::TBuf json;
+            BeginResponse(json, request.Id, "feature")
+                .WriteKey("rank").WriteInt(++rank)
+                .WriteKey("feature").WriteInt(ToPoolFeature(featureIndex, pool->KeptColumns))
+            .EndObject();
+            Write(json);
+        });
+    }
+
+    void TSelectionServer::TConnection::Score(const TRequest& request, const TCancelFlag& cancelled) {
+        const auto args = ParseSelectionRequest(request, true);
+        const TResidentPools::TPoolPtr pool = Server.Pools.Get(args.first);
+        TFastSelectionOptions options = args.second.Options;
+        options.IsCancelled = [&cancelled] {
+            return AtomicGet(*cancelled) != 0;
+        };
+
+        const yvector<int> sequence = ToKeptFeatures(*args.second.Features, pool->KeptColumns);
+        ScoreFeatures(pool->Label, pool->Features, sequence, options, [&](int featureIndex, double score) {
+            NJsonWriter::TBuf json;
+            BeginResponse(json, request.Id, "score")
+                .WriteKey("feature").WriteInt(ToPoolFeature(featureIndex, pool->KeptColumns))
+                .WriteKey("score").WriteDouble(score)
+            .EndObject();
+            Write(json);
+        });
+    }
+
+    void TSelectionServer::TConnection::Write(const NJsonWriter::TBuf& json) {
+        bool hasBroken = false;
+        with_lock (OutputLock) {
+            if (IsBroken) {
+                return;
+            }
+            try {
+                Out << json.Str() << '\n';
+                Out.Flush();
+            } catch (...) {
+                IsBroken = hasBroken = true;
+            }
+        }
+        if (hasBroken) {
+            // Nobody reads the results anymore
+            with_lock (RequestsLock) {
+                for (auto& request : Running) {
+                    AtomicSet(*request.second, 1);
+                }
+            }
+        }
+    }
+
+    void TSelectionServer::TConnection::WriteEvent(const TString& id, TStringBuf event) {
+        NJsonWriter::TBuf json;
+        BeginResponse(json, id, event).EndObject();
+        Write(json);
+    }
+
+    void TSelectionServer::TConnection::WriteError(const TString& id, const TString& message) {
+        NJsonWriter::TBuf json;
+        BeginResponse(json, id, "error")
+            .WriteKey("message").WriteString(message)
+        .EndObject();
+        Write(json);
+    }
+
+    /* TSelectionServer */
+
+    TSelectionServer::TSelectionServer(int threadCount) {
+        Executor.Start(threadCount);
+    }
+
+    TSelectionServer::~TSelectionServer() {
+        Executor.Stop();
+    }
+
+    void TSelectionServer::ServeConnection(IInputStream& in, IOutputStream& out) {
+        TConnection connection(*this, out);
+        TString line;
+        try {
+            while (in.ReadLine(line)) {
+                connection.HandleLine(line);
+            }
+        } catch (...) {
+            // The requests refer to the connection
+            connection.Wait();
+            throw;
+        }
+        connection.Wait();
+    }
+
+    void TSelectionServer::Listen(const TString& path) {
+        TLocalStreamSocket listener;
+        Y_ENSURE(!listener.Closed(), "Failed to create a local socket");
+        RemoveStaleSocket(path);
+        TSockAddrLocal address(path.data());
+        Y_ENSURE(listener.Bind(&address) == 0, "Failed to bind a local socket to " << path);
+        Y_ENSURE(listener.Listen(16) == 0, "Failed to listen on " << path);
+        SocketPath = path;
+
+        // Threads of the clients with flags set when they end. TAdaptiveMtpQueue::Stop would spin
+        // while long requests finish, so the threads are joined
+        yvector<std::pair<TAutoPtr<IThreadPool::IThread>, TAtomicSharedPtr<TAtomic>>> clients;
+        while (!AtomicGet(Stopping)) {
+            TLocalStreamSocket connection;
+            TSockAddrLocal peer;
+            Y_ENSURE(listener.Accept(&connection, &peer) == 0, "Failed to accept a client on " << path);
+            if (AtomicGet(Stopping)) {
+                break;
+            }
+            EraseIf(clients, [](auto& client) {
+                if (!AtomicGet(*client.second)) {
+                    return false;
+                }
+                client.first->Join();
+                return true;
+            });
+            const SOCKET socket = connection.Release();
+            const TAtomicSharedPtr<TAtomic> isFinished = MakeAtomicShared<TAtomic>(0);
+            clients.emplace_back(SystemThreadPool()->Run([this, socket, isFinished] {
+                TSocket client(socket);
+                TSocketInput socketInput(client);
+                TBufferedInput input(&socketInput);
+                TSocketOutput output(client);
+                try {
+                    ServeConnection(input, output);
+                } catch (...) {
+                    // A broken connection ends only its own client
+                }
+                AtomicSet(*isFinished, 1);
+            }), isFinished);
+        }
+        NFs::Remove(path);
+        for (auto& client : clients) {
+            client.first->Join();
+        }
+    }
+
+    void TSelectionServer::Shutdown() {
+        AtomicSet(Stopping, 1);
+        if (SocketPath.empty()) {
+            return;
+        }
+        // Wakes the accepting thread up
+        TLocalStreamSocket socket;
+        TSockAddrLocal address(SocketPath.data());
+        socket.Connect(&address);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "pool_loader.h"
+
+#include <util/generic/hash.h>
+#include <util/generic/ptr.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/system/atomic.h>
+#include <util/system/mutex.h>
+#include <util/thread/queue.h>
+
+class IInputStream;
+class IOutputStream;
+
+namespace NCmicot {
+    /// Pools which stay loaded between the requests of a selection server, by name. Requests keep
+    /// the pools they use, so a pool can be replaced or removed while it is in use.
+    class TResidentPools {
+    public:
+        using TPoolPtr = TAtomicSharedPtr<const TLoadedPool>;
+
+        void Add(const TString& name, TPoolPtr pool);
+        /// Throws if there is no such pool.
+        TPoolPtr Get(const TString& name) const;
+        bool Remove(const TString& name);
+        /// All the pools, sorted by name.
+        yvector<std::pair<TString, TPoolPtr>> List() const;
+
+    private:
+        mutable TMutex Lock;
+        yhash<TString, TPoolPtr> Pools;
+    };
+
+    /// Runs selection and scoring requests over resident pools. A request is a line
+    /// "ID COMMAND ARGS...", and every response is a line with a JSON object of the request ID and
+    /// an event. The requests of all the connections run concurrently on a shared executor, and the
+    /// last response of every request is a "done", "cancelled" or "error" event. See README for the
+    /// commands.
+    class TSelectionServer {
+    public:
+        /// At most threadCount requests run at a time.
+        explicit TSelectionServer(int threadCount);
+        ~TSelectionServer();
+
+        /// Serves the request lines of in until it ends, and then waits for the requests which are
+        /// still running. Requests are cancelled if their responses can't be written to out.
+        void ServeConnection(IInputStream& in, IOutputStream& out);
+
+        /// Accepts clients at the local socket path and serves every one of them in its own thread,
+        /// until a shutdown request. Returns when all the clients have disconnected.
+        void Listen(const TString& path);
+
+    private:
+        class TConnection;
+
+        void Shutdown();
+
+        TResidentPools Pools;
+        TMtpQueue Executor;
+        TAtomic Stopping = 0;
+        TString SocketPath;
+    };
+}
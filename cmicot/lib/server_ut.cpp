@@ -0,0 +1,257 @@
+#include "server.h"
+#include "selection.h"
+
+#include <library/grid_creator/binarization.h>
+#include <library/json/writer/json.h>
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/stream/str.h>
+#include <util/string/join.h>
+#include <util/string/split.h>
+#include <util/system/event.h>
+#include <util/system/fs.h>
+#include <util/system/guard.h>
+#include <util/system/hp_timer.h>
+#include <util/system/mutex.h>
+
+namespace NCmicot {
+    namespace {
+        const TString PoolFile = "server_ut_pool.tsv";
+
+        void WriteRandomPool(TReallyFastRng32& rng, int lineCount, int featureCount) {
+            TOFStream out(PoolFile);
+            for (int line : xrange(lineCount)) {
+                Y_UNUSED(line);
+                out << rng.Uniform(3);
+                for (int feature : xrange(featureCount)) {
+                    Y_UNUSED(feature);
+                    out << '\t' << rng.Uniform(5);
+                }
+                out << '\n';
+            }
+        }
+
+        yvector<TString> Serve(TSelectionServer& server, const TString& requests) {
+            TStringInput in(requests);
+            TStringStream out;
+            server.ServeConnection(in, out);
+            yvector<TString> result;
+            Split(out.Str(), "\n", result);
+            return result;
+        }
+
+        /// Gives the first requests at once and the rest only after the gate is signalled, as a client
+        /// which waits for some responses before sending the next requests.
+        class TGatedInput: public IInputStream {
+        public:
+            TGatedInput(const TString& first, TManualEvent& gate, const TString& rest)
+                : First(first)
+                , Gate(gate)
+                , Rest(rest)
+            {
+            }
+
+        private:
+            size_t DoRead(void* buf, size_t len) override {
+                if (First.empty()) {
+                    Gate.Wait();
+                }
+                TString& source = First.empty() ? Rest : First;
+                const size_t size = Min(len, source.size());
+                memcpy(buf, source.data(), size);
+                source.remove(0, size);
+                return size;
+            }
+
+            TString First;
+            TManualEvent& Gate;
+            TString Rest;
+        };
+
+        /// Collects the responses and signals the gate once a response contains trigger. After that it
+        /// fails every write if isBroken is set, as a client which has disconnected.
+        class TGatedOutput: public IOutputStream {
+        public:
+            TGatedOutput(const TString& trigger, TManualEvent& gate, bool isBroken)
+                : Trigger(trigger)
+                , Gate(gate)
+                , IsBroken(isBroken)
+            {
+            }
+
+            TString Str() const {
+                with_lock (Lock) {
+                    return Data;
+                }
+            }
+
+        private:
+            void DoWrite(const void* buf, size_t len) override {
+                with_lock (Lock) {
+                    if (IsTriggered && IsBroken) {
+                        ythrow yexception() << "Client has disconnected";
+                    }
+                    Data.append(static_cast<const char*>(buf), len);
+                    if (!IsTriggered && Data.Contains(Trigger)) {
+                        IsTriggered = true;
+                        Gate.Signal();
+                    }
+                }
+            }
+
+            TString Trigger;
+            TManualEvent& Gate;
+            bool IsBroken;
+            bool IsTriggered = false;
+            TMutex Lock;
+            TString Data;
+        };
+
+        /// Responses of request id, in order.
+        yvector<TString> ResponsesOf(const yvector<TString>& responses, const TString& id) {
+            yvector<TString> result;
+            for (const TString& response : responses) {
+                if (response.StartsWith("{\"id\":\"" + id + "\",")) {
+                    result.push_back(response);
+                }
+            }
+            return result;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(Server) {
+        SIMPLE_UNIT_TEST(Requests) {
+            TReallyFastRng32 rng(20170901);
+            WriteRandomPool(rng, 400, 7);
+
+            TOptions options;
+            const NLastGetopt::TOpts parser = CreateCommandLineOptions(options);
+            const char* argv[] = {"cmicot", "--pool", PoolFile.data(), "--thread-count", "1", "-x", "2", "--binarization", "median"};
+            NLastGetopt::TOptsParseResult parsed(&parser, Y_ARRAY_SIZE(argv), argv);
+            const TLoadedPool pool = LoadPool(options);
+
+            TFastSelectionOptions selectionOptions;
+            selectionOptions.EvalStepCount = 3;
+            selectionOptions.FeatureCount = 4;
+            yvector<int> expected;
+            FastFeatureSelection(pool.Label, pool.Features, selectionOptions, [&expected](int feature) {
+                expected.push_back(feature);
+            });
+            yvector<double> expectedScores;
+            ScoreFeatures(pool.Label, pool.Features, {expected[1], expected[0]}, selectionOptions, [&](int, double score) {
+                expectedScores.push_back(score);
+            });
+
+            // A single thread runs the requests in order
+            TSelectionServer server(1);
+            const yvector<TString> responses = Serve(server, JoinSeq("\n", {
+                "1 load pool --pool " + PoolFile + " --thread-count 1 -x 2 --binarization median",
+                "2 select pool -t 3 --select-count 4",
+                "3 score pool -t 3 --features " + ToString(expected[1]) + "," + ToString(expected[0]),
+                "4 pools",
+                "5 select unknown",
+                "6 cancel 42",
+                "7 frobnicate",
+                "8 unload pool",
+                "9 pools",
+            }));
+            NFs::Remove(PoolFile);
+
+            yvector<TString> load = ResponsesOf(responses, "1");
+            UNIT_ASSERT_VALUES_EQUAL(load.size(), 2);
+            UNIT_ASSERT_VALUES_EQUAL(load[0], "{\"id\":\"1\",\"event\":\"loaded\",\"pool\":\"pool\",\"lines\":400,\"features\":7,\"bins\":" +
+                                                  ToString(pool.Features.GetBinCount()) + "}");
+            UNIT_ASSERT(load[1].StartsWith("{\"id\":\"1\",\"event\":\"done\",\"seconds\":"));
+
+            const yvector<TString> select = ResponsesOf(responses, "2");
+            UNIT_ASSERT_VALUES_EQUAL(select.size(), expected.size() + 1);
+            for (int i : xrange(expected.ysize())) {
+                UNIT_ASSERT_VALUES_EQUAL(select[i], "{\"id\":\"2\",\"event\":\"feature\",\"rank\":" + ToString(i + 1) +
+                                                        ",\"feature\":" + ToString(expected[i]) + "}");
+            }
+
+            const yvector<TString> score = ResponsesOf(responses, "3");
+            UNIT_ASSERT_VALUES_EQUAL(score.size(), 3);
+            for (int i : xrange(2)) {
+                NJsonWriter::TBuf json;
+                json.BeginObject()
+                    .WriteKey("id").WriteString("3")
+                    .WriteKey("event").WriteString("score")
+                    .WriteKey("feature").WriteInt(expected[1 - i])
+                    .WriteKey("score").WriteDouble(expectedScores[i])
+                .EndObject();
+                UNIT_ASSERT_VALUES_EQUAL(score[i], json.Str());
+            }
+
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "4")[0], "{\"id\":\"4\",\"event\":\"pool\",\"pool\":\"pool\",\"lines\":400,\"features\":7,\"bins\":" +
+                                                                         ToString(pool.Features.GetBinCount()) + "}");
+            const TString unknownPool = ResponsesOf(responses, "5")[0];
+            UNIT_ASSERT(unknownPool.StartsWith("{\"id\":\"5\",\"event\":\"error\"") && unknownPool.Contains("There is no pool unknown"));
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "6")[0], "{\"id\":\"6\",\"event\":\"error\",\"message\":\"There is no running request 42\"}");
+            UNIT_ASSERT(ResponsesOf(responses, "7")[0].Contains("Unknown command frobnicate"));
+            UNIT_ASSERT(ResponsesOf(responses, "8")[0].StartsWith("{\"id\":\"8\",\"event\":\"done\""));
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "9").size(), 1);
+        }
+
+        SIMPLE_UNIT_TEST(Cancellation) {
+            TReallyFastRng32 rng(20170902);
+            WriteRandomPool(rng, 300, 6);
+
+            // The selection waits for the load, so it is still in the queue when it is cancelled
+            TSelectionServer server(1);
+            const yvector<TString> responses = Serve(server, JoinSeq("\n", {
+                "1 load pool --pool " + PoolFile + " --thread-count 1",
+                "2 select pool",
+                "3 cancel 2",
+                "4 select pool --select-count 2",
+            }));
+            NFs::Remove(PoolFile);
+
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "3"), yvector<TString>({"{\"id\":\"3\",\"event\":\"done\"}"}));
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "2").back(), "{\"id\":\"2\",\"event\":\"cancelled\"}");
+            UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "4").size(), 3);
+        }
+
+        SIMPLE_UNIT_TEST(CancelRunningRequest) {
+            TReallyFastRng32 rng(20170903);
+            WriteRandomPool(rng, 400, 24);
+            const TString load = "1 load pool --pool " + PoolFile + " --thread-count 1\n";
+
+            TSelectionServer server(1);
+            THPTimer timer;
+            const yvector<TString> full = Serve(server, load + "2 select pool -t 4\n");
+            const double fullSeconds = timer.Passed();
+            const size_t featureCount = ResponsesOf(full, "2").size() - 1;
+            UNIT_ASSERT_VALUES_EQUAL(featureCount, 24);
+
+            // The cancel request is sent once the selection has reported its first feature
+            {
+                TManualEvent gate;
+                TGatedInput in(load + "2 select pool -t 4\n", gate, "3 cancel 2\n");
+                TGatedOutput out("\"id\":\"2\",\"event\":\"feature\"", gate, false);
+                server.ServeConnection(in, out);
+                yvector<TString> responses;
+                Split(out.Str(), "\n", responses);
+                UNIT_ASSERT_VALUES_EQUAL(ResponsesOf(responses, "3"), yvector<TString>({"{\"id\":\"3\",\"event\":\"done\"}"}));
+                const yvector<TString> select = ResponsesOf(responses, "2");
+                UNIT_ASSERT_VALUES_EQUAL(select.back(), "{\"id\":\"2\",\"event\":\"cancelled\"}");
+                UNIT_ASSERT(select.size() - 1 < featureCount);
+            }
+
+            // A client which disconnects in the middle of a selection cancels it, so the connection
+            // ends long before the selection would
+            {
+                TManualEvent gate;
+                TGatedInput in(load + "2 select pool -t 4\n", gate, "");
+                TGatedOutput out("\"id\":\"2\",\"event\":\"feature\"", gate, true);
+                timer.Reset();
+                server.ServeConnection(in, out);
+                UNIT_ASSERT(timer.Passed() < fullSeconds / 2);
+            }
+            NFs::Remove(PoolFile);
+        }
+    }
+}
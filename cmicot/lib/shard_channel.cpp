@@ -0,0 +1,173 @@
+#include "shard_channel.h"
+
+#include <util/generic/utility.h>
+#include <util/generic/xrange.h>
+#include <util/generic/yexception.h>
+#include <util/network/pair.h>
+#include <util/network/sock.h>
+#include <util/network/socket.h>
+#include <util/stream/output.h>
+#include <util/system/fs.h>
+
+#if defined(_unix_)
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace NCmicot {
+    namespace {
+        /// Length-prefixed messages over a connected stream socket.
+        class TSocketShardChannel: public IShardChannel {
+            static constexpr size_t RECEIVE_CHUNK_SIZE = 1 << 20;
+
+        public:
+            explicit TSocketShardChannel(SOCKET socket)
+                : Socket(socket)
+                , Input(Socket)
+                , Output(Socket)
+            {
+            }
+
+            void Send(const TString& message) override {
+                const ui64 size = message.size();
+                Output.Write(&size, sizeof(size));
+                Output.Write(message.data(), message.size());
+                Output.Flush();
+            }
+
+            TString Receive() override {
+                ui64 size = 0;
+                Input.LoadOrFail(&size, sizeof(size));
+                // The size comes from the peer, so memory grows only as the message really arrives
+                TString result;
+                while (result.size() < size) {
+                    const size_t offset = result.size();
+                    const size_t chunk = Min<ui64>(size - offset, RECEIVE_CHUNK_SIZE);
+                    if (result.capacity() < offset + chunk) {
+                        result.reserve(Max(2 * result.capacity(), offset + chunk));
+                    }
+                    result.resize(offset + chunk);
+                    Input.LoadOrFail(result.begin() + offset, chunk);
+                }
+                return result;
+            }
+
+        private:
+            TSocket Socket;
+            TSocketInput Input;
+            TSocketOutput Output;
+        };
+
+#if defined(_unix_)
+        /// Channel to a forked worker, which is waited for when the channel is closed.
+        class TChildShardChannel: public IShardChannel {
+        public:
+            TChildShardChannel(THolder<IShardChannel> channel, pid_t pid)
+                : Channel(std::move(channel))
+                , Pid(pid)
+            {
+            }
+
+            ~TChildShardChannel() override {
+                Channel.Destroy();
+                waitpid(Pid, nullptr, 0);
+            }
+
+            void Send(const TString& message) override {
+                Channel->Send(message);
+            }
+
+            TString Receive() override {
+                return Channel->Receive();
+            }
+
+        private:
+            THolder<IShardChannel> Channel;
+            pid_t Pid;
+        };
+#endif
+    }
+
+    std::pair<THolder<IShardChannel>, THolder<IShardChannel>> MakeShardChannelPair() {
+        SOCKET sockets[2];
+        Y_ENSURE(SocketPair(sockets) == 0, "Failed to create a socket pair");
+        return {MakeHolder<TSocketShardChannel>(sockets[0]), MakeHolder<TSocketShardChannel>(sockets[1])};
+    }
+
+    THolder<IShardChannel> ConnectShardChannel(const TString& path, TDuration timeout) {
+        const TInstant deadline = timeout.ToDeadLine();
+        TSockAddrLocal address(path.data());
+        while (true) {
+            TLocalStreamSocket socket;
+            Y_ENSURE(!socket.Closed(), "Failed to create a local socket");
+            const int error = socket.Connect(&address);
+            if (error == 0) {
+                return MakeHolder<TSocketShardChannel>(socket.Release());
+            }
+            if (TInstant::Now() >= deadline) {
+                ythrow TSystemError(-error) << "Failed to connect to shard worker " << path;
+            }
+            Sleep(TDuration::MilliSeconds(50));
+        }
+    }
+
+    THolder<IShardChannel> AcceptShardChannel(const TString& path) {
+        TLocalStreamSocket listener;
+        Y_ENSURE(!listener.Closed(), "Failed to create a local socket");
+        RemoveStaleSocket(path);
+        TSockAddrLocal address(path.data());
+        Y_ENSURE(listener.Bind(&address) == 0, "Failed to bind a local socket to " << path);
+        Y_ENSURE(listener.Listen(1) == 0, "Failed to listen on " << path);
+
+        TLocalStreamSocket connection;
+        TSockAddrLocal peer;
+        Y_ENSURE(listener.Accept(&connection, &peer) == 0, "Failed to accept a coordinator on " << path);
+        NFs::Remove(path);
+        return MakeHolder<TSocketShardChannel>(connection.Release());
+    }
+
+    void RemoveStaleSocket(const TString& path) {
+#if defined(_unix_)
+        struct stat status;
+        if (lstat(path.data(), &status) != 0) {
+            return;
+        }
+        Y_ENSURE(S_ISSOCK(status.st_mode), path << " exists and is not a socket");
+        Y_ENSURE(NFs::Remove(path), "Failed to remove the stale socket " << path);
+#else
+        Y_ENSURE(!NFs::Exists(path), path << " already exists");
+#endif
+    }
+
+    yvector<THolder<IShardChannel>> ForkShardWorkers(int shardCount, const std::function<void(int, IShardChannel&)>& serve) {
+#if defined(_unix_)
+        yvector<THolder<IShardChannel>> result;
+        for (int shardIndex : xrange(shardCount)) {
+            auto channels = MakeShardChannelPair();
+            const pid_t pid = fork();
+            Y_ENSURE(pid >= 0, "Failed to fork a shard worker");
+            if (pid == 0) {
+                // The child must not keep the coordinator ends open, or their workers would never see them closed
+                result.clear();
+                channels.first.Destroy();
+                int exitCode = 0;
+                try {
+                    serve(shardIndex, *channels.second);
+                } catch (...) {
+                    Cerr << "Shard worker " << shardIndex << " has failed: " << CurrentExceptionMessage() << Endl;
+                    exitCode = 1;
+                }
+                _exit(exitCode);
+            }
+            channels.second.Destroy();
+            result.push_back(MakeHolder<TChildShardChannel>(std::move(channels.first), pid));
+        }
+        return result;
+#else
+        Y_UNUSED(shardCount, serve);
+        ythrow yexception() << "Shard worker processes can only be forked on Unix";
+#endif
+    }
+}
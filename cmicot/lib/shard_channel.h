@@ -0,0 +1,56 @@
+#pragma once
+
+#include <util/datetime/base.h>
+#include <util/generic/ptr.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/stream/str.h>
+#include <util/ysaveload.h>
+
+#include <functional>
+
+namespace NCmicot {
+    /// Message transport between the coordinator and a worker of a sharded selection.
+    class IShardChannel {
+    public:
+        virtual ~IShardChannel() {
+        }
+
+        virtual void Send(const TString& message) = 0;
+        /// Throws if the other side has closed the channel.
+        virtual TString Receive() = 0;
+    };
+
+    /// Both ends of a connected socket pair, for workers in child processes or threads.
+    std::pair<THolder<IShardChannel>, THolder<IShardChannel>> MakeShardChannelPair();
+
+    /// Connects to a worker listening on the local socket at path, waiting up to timeout for the
+    /// worker to start.
+    THolder<IShardChannel> ConnectShardChannel(const TString& path, TDuration timeout);
+
+    /// Listens on the local socket at path and accepts a single coordinator.
+    THolder<IShardChannel> AcceptShardChannel(const TString& path);
+
+    /// Removes a socket left at path by a previous process, which would make bind fail. Throws if
+    /// path is anything but a socket, so that a mistyped path doesn't remove a regular file.
+    void RemoveStaleSocket(const TString& path);
+
+    /// Forks a worker process for every shard, which runs serve(shardIndex, coordinator) and exits.
+    /// A child is waited for when its channel is destroyed.
+    yvector<THolder<IShardChannel>> ForkShardWorkers(int shardCount, const std::function<void(int, IShardChannel&)>& serve);
+
+    template <class T>
+    TString SaveShardMessage(const T& message) {
+        TStringStream out;
+        ::Save(&out, message);
+        return out.Str();
+    }
+
+    template <class T>
+    T LoadShardMessage(const TString& data) {
+        TStringInput in(data);
+        T result;
+        ::Load(&in, result);
+        return result;
+    }
+}
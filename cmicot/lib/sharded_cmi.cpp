@@ -0,0 +1,276 @@
+#include "sharded_cmi.h"
+#include "trace.h"
+
+#include <library/threading/future/async.h>
+
+#include <util/generic/algorithm.h>
+#include <util/generic/xrange.h>
+#include <util/generic/yexception.h>
+#include <util/system/guard.h>
+#include <util/thread/queue.h>
+
+namespace NCmicot {
+    namespace {
+        struct TShardHello {
+            ui64 FirstLine = 0;
+            ui64 LineCount = 0;
+            i32 BinCount = 0;
+
+            Y_SAVELOAD_DEFINE(FirstLine, LineCount, BinCount);
+        };
+
+        struct TShardLabel {
+            ui32 ClassCount = 0;
+            yvector<ui32> Codes;
+
+            Y_SAVELOAD_DEFINE(ClassCount, Codes);
+        };
+
+        using EQueryKind = TShardedCmiSource::EQueryKind;
+
+        struct TShardQuery {
+            EQueryKind Kind = EQueryKind::Finish;
+            TShardedCmiSource::TOperations Operations;
+            yvector<i32> BinIndexes;
+
+            Y_SAVELOAD_DEFINE(Kind, Operations, BinIndexes);
+        };
+
+        class TShardedCmiEstimator: public ICmiEstimator {
+        public:
+            explicit TShardedCmiEstimator(TShardedCmiSource& source)
+                : Source(source)
+            {
+            }
+
+            void AddSecondVariableBin(int binIndex) override {
+                Operations.push_back(binIndex);
+            }
+
+            void AddConditionBin(int binIndex) override {
+                Operations.push_back(~binIndex);
+            }
+
+            yvector<double> GetValuesWithConditionBins(const yvector<int>& binIndexes) override {
+                yvector<double> result;
+                result.reserve(binIndexes.size());
+                for (const TCmiCounts& counts : Source.Query(EQueryKind::WithConditionBins, Operations, binIndexes)) {
+                    result.push_back(GetCmi(counts, Source.GetLineCount()));
+                }
+                return result;
+            }
+
+            double GetValue() override {
+                return GetCmi(Source.Query(EQueryKind::Value, Operations, {}).front(), Source.GetLineCount());
+            }
+
+        private:
+            TShardedCmiSource& Source;
+            TShardedCmiSource::TOperations Operations;
+        };
+
+        /// Calculator of a worker. The calculator of the previous query is kept, because the next
+        /// one usually adds a single operation to it.
+        class TShardCalculator {
+        public:
+            TShardCalculator(const TBinFeatureSet& features, const TLabelCodes& label)
+                : Features(features)
+                , LabelCmi(MakeLabelCmiCalculator(label))
+                , Calculator(LabelCmi)
+            {
+            }
+
+            const TCmiCalculator& Get(const TShardedCmiSource::TOperations& operations) {
+                const bool isContinuation = operations.size() >= Applied.size() &&
+                                            Equal(Applied.begin(), Applied.end(), operations.begin());
+                if (!isContinuation) {
+                    Calculator = LabelCmi;
+                    Applied.clear();
+                }
+                for (size_t i = Applied.size(); i < operations.size(); ++i) {
+                    const i32 operation = operations[i];
+                    const int binIndex = operation >= 0 ? operation : ~operation;
+                    Y_ENSURE(binIndex < Features.GetBinCount(), "Operation bin " << binIndex << " is out of range");
+                    if (operation >= 0) {
+                        Calculator.AddSecondVariableBin(Features.GetBin(binIndex));
+                    } else {
+                        Calculator.AddConditionBin(Features.GetBin(binIndex));
+                    }
+                    Applied.push_back(operation);
+                }
+                return Calculator;
+            }
+
+        private:
+            const TBinFeatureSet& Features;
+            const TCmiCalculator LabelCmi;
+            TCmiCalculator Calculator;
+            TShardedCmiSource::TOperations Applied;
+        };
+    }
+
+    /* TShardedCmiSource */
+
+    TShardedCmiSource::TShardedCmiSource(TLabelCodesPtr label, int binCount, yvector<THolder<IShardChannel>> workers)
+        : Label(std::move(label))
+        , Workers(std::move(workers))
+    {
+        Y_ENSURE(!Workers.empty(), "No shard workers");
+
+        yvector<std::pair<ui64, ui64>> ranges;
+        for (auto& worker : Workers) {
+            const TShardHello hello = LoadShardMessage<TShardHello>(worker->Receive());
+            Y_ENSURE(hello.BinCount == binCount, "Shard worker has " << hello.BinCount << " bins, while the pool has " << binCount);
+            Y_ENSURE(hello.FirstLine + hello.LineCount <= Label->size(),
+                     "Shard worker lines [" << hello.FirstLine << "; " << hello.FirstLine + hello.LineCount
+                                            << ") are out of the pool with " << Label->size() << " lines");
+            ranges.emplace_back(hello.FirstLine, hello.FirstLine + hello.LineCount);
+
+            TShardLabel shardLabel;
+            shardLabel.ClassCount = Label->GetClassCount();
+            const auto begin = Label->GetCodes().begin() + hello.FirstLine;
+            shardLabel.Codes.assign(begin, begin + hello.LineCount);
+            worker->Send(SaveShardMessage(shardLabel));
+        }
+
+        Sort(ranges.begin(), ranges.end());
+        ui64 coveredLines = 0;
+        for (const auto& range : ranges) {
+            Y_ENSURE(range.first == coveredLines, "Shard workers don't cover lines [" << coveredLines << "; " << range.first
+                                                                                          << ") or overlap there");
+            coveredLines = range.second;
+        }
+        Y_ENSURE(coveredLines == Label->size(), "Shard workers don't cover lines [" << coveredLines << "; " << Label->size() << ")");
+    }
+
+    TShardedCmiSource::~TShardedCmiSource() {
+        try {
+            const TString finish = SaveShardMessage(TShardQuery());
+            for (auto& worker : Workers) {
+                worker->Send(finish);
+            }
+        } catch (...) {
+            // Workers which are already gone don't need to be stopped
+        }
+    }
+
+    THolder<ICmiEstimator> TShardedCmiSource::MakeEstimator() {
+        return MakeHolder<TShardedCmiEstimator>(*this);
+    }
+
+    yvector<double> TShardedCmiSource::GetMutualInformation(const yvector<int>& binIndexes) {
+        // I(label; bin) is the CMI of the bin as the second variable with an empty condition
+        yvector<double> result;
+        result.reserve(binIndexes.size());
+        for (const TCmiCounts& counts : Query(EQueryKind::WithSecondBins, {}, binIndexes)) {
+            result.push_back(GetCmi(counts, GetLineCount()));
+        }
+        return result;
+    }
+
+    yvector<TCmiCounts> TShardedCmiSource::Query(EQueryKind kind, const TOperations& operations, const yvector<int>& binIndexes) {
+        TTraceSpan span("ShardQuery", "bins", binIndexes.size());
+        TShardQuery query;
+        query.Kind = kind;
+        query.Operations = operations;
+        query.BinIndexes.assign(binIndexes.begin(), binIndexes.end());
+        const TString message = SaveShardMessage(query);
+
+        yvector<TCmiCounts> result;
+        with_lock (Lock) {
+            // Everything is sent before anything is received, so the workers count concurrently
+            for (auto& worker : Workers) {
+                worker->Send(message);
+            }
+            for (auto& worker : Workers) {
+                const yvector<TCmiCounts> counts = LoadShardMessage<yvector<TCmiCounts>>(worker->Receive());
+                if (result.empty()) {
+                    result = counts;
+                    continue;
+                }
+                Y_ENSURE(counts.size() == result.size(), "Shard worker has answered with " << counts.size()
+                                                                                             << " counts instead of " << result.size());
+                for (size_t i : xrange(counts.size())) {
+                    AddCmiCounts(result[i], counts[i]);
+                }
+            }
+        }
+        return result;
+    }
+
+    void ServeCmiShard(const TBinFeatureSet& features, ui64 firstLine, IShardChannel& coordinator, int threadCount) {
+        TShardHello hello;
+        hello.FirstLine = firstLine;
+        hello.LineCount = features.GetBinCount() ? features.GetBin(0).size() : 0;
+        hello.BinCount = features.GetBinCount();
+        coordinator.Send(SaveShardMessage(hello));
+
+        TShardLabel shardLabel = LoadShardMessage<TShardLabel>(coordinator.Receive());
+        Y_ENSURE(shardLabel.Codes.size() == hello.LineCount, "Coordinator has sent " << shardLabel.Codes.size()
+                                                                                         << " label lines instead of " << hello.LineCount);
+        // Calculators can't be built over no lines, and an empty shard adds nothing to the counts anyway
+        THolder<TLabelCodes> label;
+        THolder<TShardCalculator> shardCalculator;
+        if (hello.LineCount > 0) {
+            label.Reset(new TLabelCodes(std::move(shardLabel.Codes), shardLabel.ClassCount));
+            shardCalculator.Reset(new TShardCalculator(features, *label));
+        }
+
+        // A step sends many small queries, so their bins are counted by threads started once
+        TMtpQueue queue;
+        if (threadCount > 1) {
+            queue.Start(threadCount);
+        }
+
+        while (true) {
+            const TShardQuery query = LoadShardMessage<TShardQuery>(coordinator.Receive());
+            if (query.Kind == EQueryKind::Finish) {
+                return;
+            }
+            for (i32 binIndex : query.BinIndexes) {
+                Y_ENSURE(0 <= binIndex && binIndex < features.GetBinCount(), "Query bin " << binIndex << " is out of range");
+            }
+
+            TTraceSpan span("ServeShardQuery", "bins", query.BinIndexes.size());
+            yvector<TCmiCounts> result;
+            if (!shardCalculator) {
+                result.resize(query.Kind == EQueryKind::Value ? 1 : query.BinIndexes.size());
+            } else if (query.Kind == EQueryKind::Value) {
+                result.push_back(shardCalculator->Get(query.Operations).GetCounts());
+            } else {
+                const TCmiCalculator& calculator = shardCalculator->Get(query.Operations);
+                const bool isCondition = query.Kind == EQueryKind::WithConditionBins;
+                auto binCounts = [&](i32 binIndex) {
+                    const TBinRef bin = features.GetBin(binIndex);
+                    return isCondition ? calculator.GetCountsWithConditionBin(bin) : calculator.GetCountsWithSecondBin(bin);
+                };
+                if (threadCount > 1 && query.BinIndexes.size() > 1) {
+                    // Every task counts a contiguous part of the bins into its own slots of result
+                    const size_t binCount = query.BinIndexes.size();
+                    const size_t taskCount = Min<size_t>(threadCount, binCount);
+                    result.resize(binCount);
+                    yvector<NThreading::TFuture<void>> tasks;
+                    for (size_t task : xrange(taskCount)) {
+                        tasks.push_back(NThreading::Async([&, task] {
+                            for (size_t i : xrange(binCount * task / taskCount, binCount * (task + 1) / taskCount)) {
+                                result[i] = binCounts(query.BinIndexes[i]);
+                            }
+                        }, queue));
+                    }
+                    for (const auto& task : tasks) {
+                        task.Wait();
+                    }
+                    for (const auto& task : tasks) {
+                        task.GetValue();
+                    }
+                } else {
+                    result.reserve(query.BinIndexes.size());
+                    for (i32 binIndex : query.BinIndexes) {
+                        result.push_back(binCounts(binIndex));
+                    }
+                }
+            }
+            coordinator.Send(SaveShardMessage(result));
+        }
+    }
+}
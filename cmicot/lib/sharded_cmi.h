@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bin_feature_set.h"
+#include "cmi_calculator.h"
+#include "cmi_source.h"
+#include "label_codes.h"
+#include "shard_channel.h"
+
+#include <util/generic/ptr.h>
+#include <util/generic/vector.h>
+#include <util/system/mutex.h>
+
+namespace NCmicot {
+    /// CMI source of a pool whose lines are split between workers. Every quantity is an entropy of
+    /// value counts, and counts of disjoint lines add up, so every query is sent to all the workers
+    /// and their count tables are merged. Queries are sent one at a time and workers answer them
+    /// concurrently.
+    class TShardedCmiSource: public ICmiSource {
+    public:
+        /// The workers must own disjoint line ranges covering all the label lines and have binCount
+        /// bins in the layout of the coordinator's feature set.
+        TShardedCmiSource(TLabelCodesPtr label, int binCount, yvector<THolder<IShardChannel>> workers);
+        /// Stops the workers.
+        ~TShardedCmiSource() override;
+
+        THolder<ICmiEstimator> MakeEstimator() override;
+        yvector<double> GetMutualInformation(const yvector<int>& binIndexes) override;
+
+        /// Operations applied to the calculator with only the label added: second variable bins for
+        /// non-negative values and condition bins ~binIndex for negative ones.
+        using TOperations = yvector<i32>;
+
+        enum class EQueryKind: ui8 {
+            Finish,
+            Value,
+            WithConditionBins,
+            WithSecondBins,
+        };
+
+        /// Merged counts of all the workers, one per bin, or a single one for EQueryKind::Value.
+        yvector<TCmiCounts> Query(EQueryKind kind, const TOperations& operations, const yvector<int>& binIndexes);
+
+        size_t GetLineCount() const {
+            return Label->size();
+        }
+
+    private:
+        TLabelCodesPtr Label;
+        yvector<THolder<IShardChannel>> Workers;
+        TMutex Lock;
+    };
+
+    /// Answers the queries of a coordinator about the lines of features until the coordinator
+    /// stops. firstLine is the index of the first line of features in the whole pool.
+    void ServeCmiShard(const TBinFeatureSet& features, ui64 firstLine, IShardChannel& coordinator, int threadCount);
+}
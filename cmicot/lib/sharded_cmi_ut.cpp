@@ -0,0 +1,155 @@
+#include "sharded_cmi.h"
+#include "selection.h"
+#include "shard_channel.h"
+#include "test_pool_gen.h"
+
+#include <library/threading/future/async.h>
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/network/sock.h>
+#include <util/random/fast.h>
+#include <util/stream/file.h>
+#include <util/system/fs.h>
+#include <util/thread/queue.h>
+
+namespace NCmicot {
+    namespace {
+        TBin Slice(TBinRef bin, size_t begin, size_t end) {
+            const TBin materialized = bin.Materialize();
+            return TBin(materialized.begin() + begin, materialized.begin() + end);
+        }
+
+        /// Lines [begin; end) of every feature, in the same bin layout.
+        TBinFeatureSet SliceFeatures(const TBinFeatureSet& features, size_t begin, size_t end) {
+            TBinFeatureSet result;
+            for (int feature : xrange(features.GetFeatureCount())) {
+                yvector<TBin> bins;
+                for (int bin : features.GetFeatureBinIndexes(feature)) {
+                    bins.push_back(Slice(features.GetBin(bin), begin, end));
+                }
+                result.AddFeature(std::move(bins));
+            }
+            return result;
+        }
+    }
+
+    SIMPLE_UNIT_TEST_SUITE(ShardedCmi) {
+        SIMPLE_UNIT_TEST(MergedCountsGiveLocalValue) {
+            TReallyFastRng32 rng(20170701);
+            const int binSize = 1000;
+            const int split = 371;
+            const TLabelCodes label = RandomLabelCodes(binSize, 5, rng);
+            const yvector<TBin> bins = RandomFeature(4, binSize, rng);
+
+            auto makeCalculator = [&](size_t begin, size_t end) {
+                const yvector<ui32> codes(label.GetCodes().begin() + begin, label.GetCodes().begin() + end);
+                TCmiCalculator result(end - begin);
+                result.AddFirstVariableCodes(TLabelCodes(codes, label.GetClassCount()));
+                result.AddSecondVariableBin(Slice(bins[0], begin, end));
+                result.AddConditionBin(Slice(bins[1], begin, end));
+                return result;
+            };
+            const TCmiCalculator whole = makeCalculator(0, binSize);
+            const TCmiCalculator head = makeCalculator(0, split);
+            const TCmiCalculator tail = makeCalculator(split, binSize);
+
+            TCmiCounts counts = head.GetCountsWithConditionBin(Slice(bins[2], 0, split));
+            AddCmiCounts(counts, tail.GetCountsWithConditionBin(Slice(bins[2], split, binSize)));
+            UNIT_ASSERT_VALUES_EQUAL(GetCmi(counts, binSize), whole.GetValueWithConditionBin(bins[2]));
+
+            counts = head.GetCountsWithSecondBin(Slice(bins[3], 0, split));
+            AddCmiCounts(counts, tail.GetCountsWithSecondBin(Slice(bins[3], split, binSize)));
+            TCmiCalculator withSecond = whole;
+            withSecond.AddSecondVariableBin(bins[3]);
+            UNIT_ASSERT_VALUES_EQUAL(GetCmi(counts, binSize), withSecond.GetValue());
+        }
+
+        SIMPLE_UNIT_TEST(SelectionMatchesLocal) {
+            TReallyFastRng32 rng(20170702);
+            const int binSize = 600;
+            const TBinFeatureSet label = MakeRandomLabel(rng, binSize, {2, 4});
+            const TBinFeatureSet features = MakeRandomFeatures(rng, 10, binSize, {1, 4});
+
+            yvector<int> expected;
+            FastFeatureSelection(label, features, 4, 1, features.GetFeatureCount(), [&expected](int feature) {
+                expected.push_back(feature);
+            });
+
+            // Shards are uneven and one of them is empty
+            const yvector<std::pair<size_t, size_t>> shards = {{0, 250}, {250, 250}, {250, 600}};
+            yvector<TBinFeatureSet> shardFeatures;
+            yvector<THolder<IShardChannel>> workerChannels;
+            yvector<THolder<IShardChannel>> coordinatorChannels;
+            for (const auto& shard : shards) {
+                shardFeatures.push_back(SliceFeatures(features, shard.first, shard.second));
+                auto channels = MakeShardChannelPair();
+                coordinatorChannels.push_back(std::move(channels.first));
+                workerChannels.push_back(std::move(channels.second));
+            }
+
+            TMtpQueue queue;
+            queue.Start(shards.size());
+            yvector<NThreading::TFuture<void>> workers;
+            for (size_t i : xrange(shards.size())) {
+                workers.push_back(NThreading::Async([&, i] {
+                    ServeCmiShard(shardFeatures[i], shards[i].first, *workerChannels[i], 2);
+                }, queue));
+            }
+
+            yvector<int> selected;
+            {
+                TFastSelectionOptions options;
+                options.EvalStepCount = 4;
+                options.CmiSource = new TShardedCmiSource(MakeAtomicShared<TLabelCodes>(label), features.GetBinCount(),
+                                                          std::move(coordinatorChannels));
+                FastFeatureSelection(label, features, options, [&selected](int feature) {
+                    selected.push_back(feature);
+                });
+            }
+            for (auto& worker : workers) {
+                worker.GetValue(TDuration::Minutes(1));
+            }
+            UNIT_ASSERT_VALUES_EQUAL(selected, expected);
+        }
+
+        SIMPLE_UNIT_TEST(OnlyStaleSocketsAreRemoved) {
+            const TString path = "sharded_cmi_ut.socket";
+            NFs::Remove(path);
+            RemoveStaleSocket(path);
+
+            // A mistyped path of a regular file is kept
+            TOFStream(path).Write("data");
+            UNIT_ASSERT_EXCEPTION(RemoveStaleSocket(path), yexception);
+            UNIT_ASSERT_EXCEPTION(AcceptShardChannel(path), yexception);
+            UNIT_ASSERT(NFs::Exists(path));
+            NFs::Remove(path);
+
+            {
+                TLocalStreamSocket socket;
+                TSockAddrLocal address(path.data());
+                UNIT_ASSERT_VALUES_EQUAL(socket.Bind(&address), 0);
+            }
+            UNIT_ASSERT(NFs::Exists(path));
+            RemoveStaleSocket(path);
+            UNIT_ASSERT(!NFs::Exists(path));
+        }
+
+        SIMPLE_UNIT_TEST(LongMessagesAreReceivedInChunks) {
+            auto channels = MakeShardChannelPair();
+            TString message;
+            for (size_t i : xrange(3 * (1 << 20) + 17)) {
+                message.push_back('a' + i % 26);
+            }
+            TMtpQueue queue;
+            queue.Start(1);
+            auto sent = NThreading::Async([&] {
+                channels.first->Send(message);
+                channels.first->Send(TString());
+            }, queue);
+            UNIT_ASSERT_EQUAL(channels.second->Receive(), message);
+            UNIT_ASSERT(channels.second->Receive().empty());
+            sent.GetValue(TDuration::Minutes(1));
+        }
+    }
+}
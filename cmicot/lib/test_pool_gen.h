@@ -2,6 +2,7 @@
 
 #include "binarize.h"
 #include "bin_feature_set.h"
+#include "label_codes.h"
 
 #include <util/generic/vector.h>
 #include <util/random/shuffle.h>
@@ -52,6 +53,24 @@ namespace NCmicot {
         return bin;
     }
 
+    template <class Rng>
+    TLabelCodes RandomLabelCodes(int size, ui32 classCount, Rng& rng) {
+        yvector<ui32> codes(size);
+        for (ui32& code : codes) {
+            code = rng.Uniform(classCount);
+        }
+        return TLabelCodes(std::move(codes), classCount);
+    }
+
+    template <class Rng>
+    yvector<double> RandomFeatureValues(int size, Rng& rng) {
+        yvector<double> result(size);
+        for (double& value : result) {
+            value = rng.GenRandReal1();
+        }
+        return result;
+    }
+
     yvector<int> InvertPermutation(const yvector<int>& permutation);
 
     template <class Rng>
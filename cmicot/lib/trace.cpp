@@ -0,0 +1,142 @@
+#include "trace.h"
+
+#include <library/json/writer/json.h>
+
+#include <util/generic/ptr.h>
+#include <util/generic/singleton.h>
+#include <util/generic/vector.h>
+#include <util/stream/output.h>
+#include <util/system/datetime.h>
+#include <util/system/guard.h>
+#include <util/system/mutex.h>
+
+namespace NCmicot {
+    namespace NPrivate {
+        TAtomic TracingEnabled = 0;
+    }
+
+    namespace {
+        struct TSpan {
+            const char* Name;
+            const char* ArgName;
+            i64 Arg;
+            ui64 Start;
+            ui64 End;
+        };
+
+        struct TThreadBuffer {
+            int ThreadIndex;
+            yvector<TSpan> Spans;
+        };
+
+        /// Buffers outlive their threads: pool threads are short-lived, while their spans are needed
+        /// until the trace is written. The buffer of an exited thread is free and is taken by the
+        /// next new thread, so there are never more buffers than threads alive at once.
+        struct TTraceRegistry {
+            TMutex Lock;
+            yvector<THolder<TThreadBuffer>> Buffers;
+            yvector<TThreadBuffer*> FreeBuffers;
+            ui64 StartTime = 0;
+        };
+
+        /// Takes a buffer for the calling thread and frees it when the thread exits.
+        struct TThreadBufferOwner {
+            TThreadBuffer* Buffer = nullptr;
+
+            TThreadBufferOwner() {
+                TTraceRegistry& registry = *Singleton<TTraceRegistry>();
+                with_lock (registry.Lock) {
+                    if (!registry.FreeBuffers.empty()) {
+                        Buffer = registry.FreeBuffers.back();
+                        registry.FreeBuffers.pop_back();
+                    } else {
+                        registry.Buffers.emplace_back(new TThreadBuffer{registry.Buffers.ysize(), {}});
+                        Buffer = registry.Buffers.back().Get();
+                    }
+                }
+            }
+
+            ~TThreadBufferOwner() {
+                TTraceRegistry& registry = *Singleton<TTraceRegistry>();
+                with_lock (registry.Lock) {
+                    registry.FreeBuffers.push_back(Buffer);
+                }
+            }
+        };
+
+        TThreadBuffer& GetThreadBuffer() {
+            static thread_local TThreadBufferOwner owner;
+            return *owner.Buffer;
+        }
+    }
+
+    namespace NPrivate {
+        ui64 TraceNow() {
+            return MicroSeconds();
+        }
+
+        void RecordSpan(const char* name, const char* argName, i64 arg, ui64 start, ui64 end) {
+            GetThreadBuffer().Spans.push_back({name, argName, arg, start, end});
+        }
+    }
+
+    void StartTracing() {
+        TTraceRegistry& registry = *Singleton<TTraceRegistry>();
+        // The caller gets the first buffer and is shown as the main thread
+        GetThreadBuffer();
+        with_lock (registry.Lock) {
+            registry.StartTime = MicroSeconds();
+        }
+        AtomicSet(NPrivate::TracingEnabled, 1);
+    }
+
+    void FinishTracing(IOutputStream& out) {
+        AtomicSet(NPrivate::TracingEnabled, 0);
+
+        TTraceRegistry& registry = *Singleton<TTraceRegistry>();
+        with_lock (registry.Lock) {
+            NJsonWriter::TBuf json(NJsonWriter::HEM_DONT_ESCAPE_HTML, &out);
+            json.BeginObject();
+            json.WriteKey("displayTimeUnit").WriteString("ms");
+            json.WriteKey("traceEvents").BeginList();
+            for (const auto& buffer : registry.Buffers) {
+                if (buffer->Spans.empty()) {
+                    continue;
+                }
+                json.BeginObject()
+                    .WriteKey("name").WriteString("thread_name")
+                    .WriteKey("ph").WriteString("M")
+                    .WriteKey("pid").WriteInt(1)
+                    .WriteKey("tid").WriteInt(buffer->ThreadIndex)
+                    .WriteKey("args").BeginObject()
+                        .WriteKey("name").WriteString(buffer->ThreadIndex == 0 ? "main" : "worker")
+                    .EndObject()
+                .EndObject();
+
+                for (const TSpan& span : buffer->Spans) {
+                    // Spans started before StartTracing are clamped to its time
+                    const ui64 start = Max(span.Start, registry.StartTime);
+                    json.BeginObject()
+                        .WriteKey("name").WriteString(span.Name)
+                        .WriteKey("cat").WriteString("cmicot")
+                        .WriteKey("ph").WriteString("X")
+                        .WriteKey("pid").WriteInt(1)
+                        .WriteKey("tid").WriteInt(buffer->ThreadIndex)
+                        .WriteKey("ts").WriteULongLong(start - registry.StartTime)
+                        .WriteKey("dur").WriteULongLong(Max(span.End, start) - start);
+                    if (span.ArgName) {
+                        json.WriteKey("args").BeginObject()
+                            .WriteKey(span.ArgName).WriteLongLong(span.Arg)
+                        .EndObject();
+                    }
+                    json.EndObject();
+                }
+                buffer->Spans.clear();
+                buffer->Spans.shrink_to_fit();
+            }
+            json.EndList();
+            json.EndObject();
+        }
+        out << '\n';
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <util/system/atomic.h>
+#include <util/system/types.h>
+
+class IOutputStream;
+
+namespace NCmicot {
+    namespace NPrivate {
+        extern TAtomic TracingEnabled;
+
+        ui64 TraceNow();
+        void RecordSpan(const char* name, const char* argName, i64 arg, ui64 start, ui64 end);
+    }
+
+    /// Starts recording spans of all threads. Every thread appends to its own buffer, so recording
+    /// takes no locks except when a thread takes its buffer and when it exits.
+    void StartTracing();
+
+    /// Stops recording and writes the spans recorded so far in Chrome trace-event JSON format.
+    /// Traced code must not run concurrently with this.
+    void FinishTracing(IOutputStream& out);
+
+    inline bool TracingEnabled() {
+        return AtomicGet(NPrivate::TracingEnabled);
+    }
+
+    /// Records the time between construction and destruction as a complete event. Name and argName
+    /// must be string literals. When tracing is off the span doesn't even read the clock.
+    class TTraceSpan {
+    public:
+        explicit TTraceSpan(const char* name)
+            : TTraceSpan(name, nullptr, 0)
+        {
+        }
+
+        TTraceSpan(const char* name, const char* argName, i64 arg)
+            : Name(TracingEnabled() ? name : nullptr)
+            , ArgName(argName)
+            , Arg(arg)
+            , Start(Name ? NPrivate::TraceNow() : 0)
+        {
+        }
+
+        ~TTraceSpan() {
+            if (Name) {
+                NPrivate::RecordSpan(Name, ArgName, Arg, Start, NPrivate::TraceNow());
+            }
+        }
+
+        TTraceSpan(const TTraceSpan&) = delete;
+        TTraceSpan& operator=(const TTraceSpan&) = delete;
+
+    private:
+        const char* Name;
+        const char* ArgName;
+        i64 Arg;
+        ui64 Start;
+    };
+}
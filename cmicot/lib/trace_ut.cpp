@@ -0,0 +1,79 @@
+#include "trace.h"
+#include "algorithm.h"
+
+#include <library/unittest/registar.h>
+
+#include <util/generic/xrange.h>
+#include <util/stream/str.h>
+#include <util/system/thread.h>
+
+namespace NCmicot {
+    SIMPLE_UNIT_TEST_SUITE(Trace) {
+        SIMPLE_UNIT_TEST(RecordsSpansOfAllThreads) {
+            {
+                TTraceSpan span("BeforeStart");
+            }
+
+            StartTracing();
+            {
+                TTraceSpan span("Outer", "step", 7);
+                yvector<int> items = xrange(4);
+                ParallelMaxElementBy(items, [](int item) { return item; }, 2);
+            }
+            TStringStream out;
+            FinishTracing(out);
+
+            {
+                TTraceSpan span("AfterFinish");
+            }
+            TStringStream empty;
+            FinishTracing(empty);
+
+            const TString& trace = out.Str();
+            UNIT_ASSERT(trace.StartsWith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+            UNIT_ASSERT(trace.Contains("\"name\":\"Outer\",\"cat\":\"cmicot\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"));
+            UNIT_ASSERT(trace.Contains("\"args\":{\"step\":7}"));
+            UNIT_ASSERT(trace.Contains("\"args\":{\"name\":\"worker\"}"));
+            UNIT_ASSERT(!trace.Contains("BeforeStart"));
+
+            size_t taskCount = 0;
+            for (size_t pos = trace.find("\"Task\""); pos != TString::npos; pos = trace.find("\"Task\"", pos + 1)) {
+                ++taskCount;
+            }
+            UNIT_ASSERT_VALUES_EQUAL(taskCount, 4);
+
+            UNIT_ASSERT_VALUES_EQUAL(empty.Str(), "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n");
+        }
+
+        SIMPLE_UNIT_TEST(ExitedThreadsFreeTheirBuffers) {
+            StartTracing();
+            // Every thread exits before the next one starts, so all of them write to one buffer
+            for (int i : xrange(8)) {
+                Y_UNUSED(i);
+                TThread thread([](void*) -> void* {
+                    TTraceSpan span("ShortLived");
+                    return nullptr;
+                }, nullptr);
+                thread.Start();
+                thread.Join();
+            }
+            TStringStream out;
+            FinishTracing(out);
+
+            const TString& trace = out.Str();
+            const TString spanPrefix = "\"name\":\"ShortLived\",\"cat\":\"cmicot\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+            size_t spanCount = 0;
+            TString firstTid;
+            for (size_t pos = trace.find(spanPrefix); pos != TString::npos; pos = trace.find(spanPrefix, pos + 1)) {
+                const size_t tidBegin = pos + spanPrefix.size();
+                const TString tid = trace.substr(tidBegin, trace.find(',', tidBegin) - tidBegin);
+                if (!spanCount) {
+                    firstTid = tid;
+                }
+                UNIT_ASSERT_VALUES_EQUAL(tid, firstTid);
+                ++spanCount;
+            }
+            UNIT_ASSERT_VALUES_EQUAL(spanCount, 8);
+        }
+    }
+}
@@ -0,0 +1,234 @@
+#include <cmicot/lib/io.h>
+#include <cmicot/lib/test_pool_gen.h>
+
+#include <library/getopt/last_getopt.h>
+#include <library/threading/algorithm/parallel_algorithm.h>
+
+#include <util/digest/numeric.h>
+#include <util/generic/string.h>
+#include <util/generic/vector.h>
+#include <util/generic/xrange.h>
+#include <util/random/fast.h>
+#include <util/random/shuffle.h>
+#include <util/stream/file.h>
+#include <util/stream/output.h>
+#include <util/string/cast.h>
+#include <util/system/yassert.h>
+
+using namespace NCmicot;
+
+namespace {
+    struct TGeneratorOptions {
+        int RowCount = 100000;
+        int InteractionCount = 2;
+        int InteractionOrder = 3;
+        TString Target = "xor";
+        int CopiesPerFeature = 1;
+        int CopyNoisePercent = 10;
+        int NoiseFeatureCount = 20;
+        int LabelNoisePercent = 5;
+        ui64 Seed = 0;
+        int ThreadCount = 8;
+        TString Format = "tsv";
+        TString OutputFile = "-";
+        TString TruthFile;
+        bool Compress = false;
+    };
+
+    enum class ERole {
+        Interaction,
+        Copy,
+        Noise,
+    };
+
+    /// A generated feature together with where it came from, which is the ground truth the
+    /// selection results are checked against.
+    struct TGeneratedFeature {
+        TBin Bits;
+        ERole Role;
+        int Group;
+        /// For copies, the interaction feature they copy.
+        int Source;
+    };
+
+    /// Every feature gets its own generator, so the pool doesn't depend on the thread count.
+    TReallyFastRng32 FeatureRng(ui64 seed, int feature) {
+        return TReallyFastRng32(IntHash(seed * 1000003 + feature));
+    }
+
+    yvector<TGeneratedFeature> GenerateFeatures(const TGeneratorOptions& options) {
+        const int interactionFeatureCount = options.InteractionCount * options.InteractionOrder;
+        const int copyCount = interactionFeatureCount * options.CopiesPerFeature;
+        const int featureCount = interactionFeatureCount + copyCount + options.NoiseFeatureCount;
+
+        yvector<TGeneratedFeature> features(featureCount);
+        auto generate = [&](int feature) {
+            TReallyFastRng32 rng = FeatureRng(options.Seed, feature);
+            TGeneratedFeature& result = features[feature];
+            if (feature < interactionFeatureCount) {
+                result = {RandomBin(options.RowCount, rng), ERole::Interaction, feature / options.InteractionOrder, -1};
+            } else if (feature < interactionFeatureCount + copyCount) {
+                const int source = (feature - interactionFeatureCount) / options.CopiesPerFeature;
+                // Sources are generated by the same deterministic rng, so a copy doesn't wait for them
+                TReallyFastRng32 sourceRng = FeatureRng(options.Seed, source);
+                result = {RemoveInfo(RandomBin(options.RowCount, sourceRng), options.CopyNoisePercent, rng), ERole::Copy,
+                          source / options.InteractionOrder, source};
+            } else {
+                result = {RandomBin(options.RowCount, rng), ERole::Noise, -1, -1};
+            }
+            return 0;
+        };
+        const yvector<int> indexes = xrange(featureCount);
+        yvector<int> unused;
+        ParallelForEach(indexes.begin(), indexes.end(), generate, unused, options.ThreadCount);
+        return features;
+    }
+
+    /// The label is the number of interactions which hold on the line. An xor interaction holds if
+    /// its parity is odd, so every proper subset of its features is independent of the label and
+    /// only the whole interaction is informative. An and interaction holds if all of its features
+    /// are set, so its features are informative one by one too.
+    yvector<double> GenerateLabel(const TGeneratorOptions& options, const yvector<TGeneratedFeature>& features) {
+        const bool isXor = options.Target == "xor";
+        yvector<double> label(options.RowCount);
+        TReallyFastRng32 rng(IntHash(options.Seed + 0x9e3779b9));
+        for (int row : xrange(options.RowCount)) {
+            int holdingInteractions = 0;
+            for (int group : xrange(options.InteractionCount)) {
+                bool parity = false;
+                bool allSet = true;
+                for (int i : xrange(options.InteractionOrder)) {
+                    const bool bit = features[group * options.InteractionOrder + i].Bits[row];
+                    parity ^= bit;
+                    allSet &= bit;
+                }
+                holdingInteractions += isXor ? parity : allSet;
+            }
+            if (static_cast<int>(rng.Uniform(100)) < options.LabelNoisePercent) {
+                holdingInteractions = rng.Uniform(options.InteractionCount + 1);
+            }
+            label[row] = holdingInteractions;
+        }
+        return label;
+    }
+
+    /// Writes a line per row: the label and every feature as its bit plus a deterministic fraction,
+    /// so the features are continuous but a median border recovers the bit.
+    void OutputTsv(const TGeneratorOptions& options, const yvector<double>& label, const yvector<TBin>& columns,
+                   IOutputStream& out) {
+        const size_t rowsInBlock = Max<size_t>(1, (1 << 20) / (6 * columns.size() + 8));
+        const size_t blockCount = (label.size() + rowsInBlock - 1) / rowsInBlock;
+
+        auto formatBlock = [&](size_t block) {
+            TString result;
+            char buffer[32];
+            for (size_t row : xrange(block * rowsInBlock, Min(label.size(), (block + 1) * rowsInBlock))) {
+                result.append(buffer, ToString(static_cast<int>(label[row]), buffer, sizeof(buffer)));
+                for (size_t column : xrange(columns.size())) {
+                    const ui32 fraction = IntHash(options.Seed ^ (static_cast<ui64>(row) << 20 | column)) % 1000;
+                    const char value[] = {'\t', static_cast<char>('0' + columns[column][row]), '.',
+                                          static_cast<char>('0' + fraction / 100), static_cast<char>('0' + fraction / 10 % 10),
+                                          static_cast<char>('0' + fraction % 10)};
+                    result.append(value, sizeof(value));
+                }
+                result.push_back('\n');
+            }
+            return result;
+        };
+
+        TPoolWriterOptions writerOptions;
+        writerOptions.ThreadCount = options.ThreadCount;
+        writerOptions.Compress = options.Compress;
+        OutputBlocks(blockCount, formatBlock, writerOptions, out);
+    }
+
+    const char* RoleName(ERole role) {
+        switch (role) {
+            case ERole::Interaction:
+                return "interaction";
+            case ERole::Copy:
+                return "copy";
+            case ERole::Noise:
+                return "noise";
+        }
+        Y_FAIL("Unknown role");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    TGeneratorOptions options;
+
+    auto opts = NLastGetopt::TOpts::Default();
+    opts.AddLongOption("rows", "Line count").RequiredArgument().StoreResult(&options.RowCount).DefaultValue("100000");
+    opts.AddLongOption("interactions", "Number of planted interactions").RequiredArgument().StoreResult(&options.InteractionCount).DefaultValue("2");
+    opts.AddLongOption("order", "Features in every interaction, 2 is a plain XOR").RequiredArgument().StoreResult(&options.InteractionOrder).DefaultValue("3");
+    opts.AddLongOption("target", "How interactions define the label: xor (parity) or and (all features set)")
+        .RequiredArgument()
+        .StoreResult(&options.Target)
+        .DefaultValue("xor");
+    opts.AddLongOption("copies", "Redundant copies of every interaction feature").RequiredArgument().StoreResult(&options.CopiesPerFeature).DefaultValue("1");
+    opts.AddLongOption("copy-noise", "Percent of lines where a copy is reset to 0").RequiredArgument().StoreResult(&options.CopyNoisePercent).DefaultValue("10");
+    opts.AddLongOption("noise-features", "Number of pure noise features").RequiredArgument().StoreResult(&options.NoiseFeatureCount).DefaultValue("20");
+    opts.AddLongOption("label-noise", "Percent of lines with a random label").RequiredArgument().StoreResult(&options.LabelNoisePercent).DefaultValue("5");
+    opts.AddLongOption("seed", "Random seed").RequiredArgument().StoreResult(&options.Seed).DefaultValue("0");
+    opts.AddLongOption("thread-count", "Threads to generate and format the pool").RequiredArgument().StoreResult(&options.ThreadCount).DefaultValue("8");
+    opts.AddLongOption("format", "Output format: tsv (raw pool for --pool) or packed (for --packed-pool)")
+        .RequiredArgument()
+        .StoreResult(&options.Format)
+        .DefaultValue("tsv");
+    opts.AddLongOption('o', "output", "Output file, stdout by default").RequiredArgument("FILE").StoreResult(&options.OutputFile).DefaultValue("-");
+    opts.AddLongOption("truth", "Write the role of every feature to this file").RequiredArgument("FILE").StoreResult(&options.TruthFile);
+    opts.AddLongOption("compress", "Write tsv in BGZF blocks").NoArgument().SetFlag(&options.Compress);
+    opts.SetFreeArgsMax(0);
+    NLastGetopt::TOptsParseResult parsedOpts(&opts, argc, argv);
+
+    Y_ENSURE(options.RowCount > 0 && options.ThreadCount > 0, "Row and thread counts should be positive");
+    Y_ENSURE(options.InteractionCount >= 0 && options.InteractionOrder > 0 && options.CopiesPerFeature >= 0 &&
+             options.NoiseFeatureCount >= 0, "Feature counts can't be negative");
+    Y_ENSURE(options.Target == "xor" || options.Target == "and", "Unknown target " << options.Target);
+    Y_ENSURE(options.Format == "tsv" || options.Format == "packed", "Unknown format " << options.Format);
+
+    yvector<TGeneratedFeature> features = GenerateFeatures(options);
+    Y_ENSURE(!features.empty(), "The pool has no features");
+    const yvector<double> label = GenerateLabel(options, features);
+
+    // Planted features are spread over the pool instead of being the first columns
+    yvector<int> order = xrange(features.ysize());
+    TReallyFastRng32 shuffleRng(IntHash(options.Seed + 1));
+    Shuffle(order.begin(), order.end(), shuffleRng);
+    yvector<int> positions(order.size());
+    for (int position : xrange(order.ysize())) {
+        positions[order[position]] = position;
+    }
+
+    yvector<TBin> columns;
+    columns.reserve(features.size());
+    for (int feature : order) {
+        columns.push_back(std::move(features[feature].Bits));
+    }
+
+    THolder<TOFStream> fileOutput;
+    if (options.OutputFile != "-") {
+        fileOutput.Reset(new TOFStream(options.OutputFile));
+    }
+    IOutputStream& output = fileOutput ? *fileOutput : Cout;
+    if (options.Format == "tsv") {
+        OutputTsv(options, label, columns, output);
+    } else {
+        TBinaryPool pool{label, std::move(columns)};
+        const yvector<int> identityMap = xrange(pool.Bins.ysize());
+        OutputPackedPool(pool, identityMap, output);
+    }
+    output.Flush();
+
+    if (options.TruthFile) {
+        TOFStream truth(options.TruthFile);
+        truth << "feature\trole\tinteraction\tsource\n";
+        for (int position : xrange(order.ysize())) {
+            const TGeneratedFeature& feature = features[order[position]];
+            truth << position << '\t' << RoleName(feature.Role) << '\t' << feature.Group << '\t'
+                  << (feature.Source >= 0 ? positions[feature.Source] : -1) << '\n';
+        }
+    }
+    return 0;
+}